@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "fleet_step.h"
+#include "spatial_hash.h"
+#include "thread_pool.h"
+
+/**
+ * Robot-robot collision detection with the spatial hash against testing every pair. Checks both
+ * find the same pairs on a fleet of up to --brute-robots robots, then steps a fleet of --robots
+ * robots for --steps steps of 0.01 s, rebuilding the hash and finding collisions every step, on
+ * 1 up to --threads threads. Footprints are 1 m x 0.5 m like the main robot.
+ * Usage: collision_bench [--robots N] [--brute-robots N] [--steps N] [--threads N]
+ */
+
+static bool SamePairs(std::vector<CollisionPair> a,
+                      std::vector<CollisionPair> b) {
+  auto order = [](const CollisionPair &x, const CollisionPair &y) {
+    return x.robot_a_ != y.robot_a_ ? x.robot_a_ < y.robot_a_ : x.robot_b_ < y.robot_b_;
+  };
+  std::sort(a.begin(), a.end(), order);
+  std::sort(b.begin(), b.end(), order);
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].robot_a_ != b[i].robot_a_ || a[i].robot_b_ != b[i].robot_b_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  size_t robots = 100000;
+  size_t brute_robots = 10000;
+  size_t steps = 100;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  const double dt = 0.01;
+  const double length = 1;
+  const double width = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--robots") == 0) {
+      robots = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--brute-robots") == 0) {
+      brute_robots = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--steps") == 0) {
+      steps = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else {
+      printf("Usage: %s [--robots N] [--brute-robots N] [--steps N] [--threads N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // Brute force is O(N^2), compare on a smaller fleet
+  {
+    FleetState fleet;
+    SpawnRandomFleet(fleet, brute_robots, 2023);
+    SpatialHash hash;
+    std::vector<CollisionPair> hash_pairs, brute_pairs;
+    auto start = std::chrono::steady_clock::now();
+    hash.Build(fleet, nullptr);
+    hash.FindCollisions(length, width, hash_pairs, nullptr);
+    double hash_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    FindCollisionsBruteForce(fleet, length, width, brute_pairs);
+    double brute_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu robots: %zu colliding pairs, hash %.3f ms, brute force %.3f ms (%.1fx), %s\n",
+           brute_robots, hash_pairs.size(), hash_seconds * 1e3, brute_seconds * 1e3, brute_seconds / hash_seconds,
+           SamePairs(hash_pairs, brute_pairs) ? "same pairs" : "PAIRS DIFFER");
+  }
+
+  FleetState initial;
+  SpawnRandomFleet(initial, robots, 2023);
+  printf("%zu robots, %zu steps\n", robots, steps);
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    // The calling thread helps in ParallelFor, so threads - 1 workers
+    ThreadPool pool(std::max<size_t>(1, threads - 1));
+    FleetState fleet = initial;
+    SpatialHash hash;
+    std::vector<CollisionPair> pairs;
+    size_t pair_total = 0;
+    double build_seconds = 0;
+    double find_seconds = 0;
+    for (size_t step = 0; step < steps; ++step) {
+      StepFleet(fleet, dt);
+      auto start = std::chrono::steady_clock::now();
+      hash.Build(fleet, threads > 1 ? &pool : nullptr);
+      auto built = std::chrono::steady_clock::now();
+      hash.FindCollisions(length, width, pairs, threads > 1 ? &pool : nullptr);
+      auto found = std::chrono::steady_clock::now();
+      build_seconds += std::chrono::duration<double>(built - start).count();
+      find_seconds += std::chrono::duration<double>(found - built).count();
+      pair_total += pairs.size();
+    }
+    const double step_seconds = (build_seconds + find_seconds) / steps;
+    printf("%2zu threads  build %.3f ms  collide %.3f ms  %.0f Hz max  %.1f pairs/step  %llu sorts\n",
+           threads, build_seconds / steps * 1e3, find_seconds / steps * 1e3, 1 / step_seconds,
+           (double)pair_total / steps, (unsigned long long)hash.sorts_);
+  }
+  return 0;
+}
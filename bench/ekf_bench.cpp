@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <Eigen/Cholesky>
+#include "localization.h"
+
+/**
+ * Throughput and consistency of the pose filters. A robot drives a slalom through a field of
+ * landmarks for --steps sim steps while the filter tracks it from noisy odometry, landmarks and
+ * GNSS. Reports filter updates/sec (predicts + measurement updates), the position/heading RMSE
+ * and the average NEES, which should be close to 3 for a consistent 3 state filter.
+ * Usage: ekf_bench [--steps N] [--dt seconds]
+ */
+
+static void RunFilter(EstimatorType estimator,
+                      uint64_t steps,
+                      double dt) {
+  Localization localization;
+  localization.estimator_ = estimator;
+  localization.PlaceLandmarks(200, 50, 7);
+  // Measure every step so the bench is dominated by the filter, not by the truth simulation
+  localization.landmark_period_ = dt;
+  localization.gnss_period_ = 10 * dt;
+  Pose2D truth;
+  localization.Reset(truth, 2023);
+
+  double squared_position_error = 0;
+  double squared_heading_error = 0;
+  double nees = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < steps; ++i) {
+    const double t = i * dt;
+    const double v = 1.5;
+    double w = 0.6 * std::sin(0.2 * t);
+    // Stay inside the landmark field, steer back towards the middle near the edge
+    if (std::hypot(truth.x, truth.y) > 35) {
+      const double heading_error = std::remainder(std::atan2(-truth.x, -truth.y) - truth.theta, 2 * M_PI);
+      w = std::clamp(2 * heading_error, -1.0, 1.0);
+    }
+    StepUnicycle(truth, v, w, dt);
+    truth.theta = WrapAngle(truth.theta);
+    localization.Step(truth, v, w, dt);
+
+    const Pose2D estimate = localization.Estimate();
+    PoseVector error(estimate.x - truth.x, estimate.y - truth.y,
+                     std::remainder(estimate.theta - truth.theta, 2 * M_PI));
+    squared_position_error += error[0] * error[0] + error[1] * error[1];
+    squared_heading_error += error[2] * error[2];
+    nees += error.dot(localization.Covariance().ldlt().solve(error));
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const uint64_t updates = steps + localization.updates_;
+  printf("%s: %llu predicts + %llu updates (%llu gated) in %.3f s, %.3e updates/s\n",
+         estimator == EstimatorType::kEkf ? "EKF" : "UKF",
+         (unsigned long long)steps, (unsigned long long)localization.updates_,
+         (unsigned long long)localization.rejected_, seconds, updates / seconds);
+  printf("     position RMSE %.4f m, heading RMSE %.4f deg, mean NEES %.3f\n",
+         std::sqrt(squared_position_error / steps),
+         std::sqrt(squared_heading_error / steps) * 180 / M_PI,
+         nees / steps);
+}
+
+int main(int argc, char **argv) {
+  uint64_t steps = 1000000;
+  double dt = 0.01;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--steps") == 0) {
+      steps = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--dt") == 0) {
+      dt = atof(argv[++i]);
+    }
+    else {
+      printf("Usage: %s [--steps N] [--dt seconds]\n", argv[0]);
+      return 1;
+    }
+  }
+  RunFilter(EstimatorType::kEkf, steps, dt);
+  RunFilter(EstimatorType::kUkf, steps, dt);
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "fleet_step.h"
+#include "simulator.h"
+
+/**
+ * Compares robot-steps/sec of the fleet step kernels against stepping one Simulator
+ * per robot (the original array of structs path).
+ * Usage: fleet_bench [--robots N] [--steps N]
+ */
+
+static FleetState MakeFleet(size_t robots) {
+  std::mt19937_64 rng(2023);
+  std::uniform_real_distribution<double> position(-50, 50);
+  std::uniform_real_distribution<double> heading(0, 2 * M_PI);
+  std::uniform_real_distribution<double> linear(-2, 2);
+  std::uniform_real_distribution<double> angular(-M_PI, M_PI);
+  FleetState fleet;
+  for (size_t i = 0; i < robots; ++i) {
+    Pose2D pose;
+    pose.x = position(rng);
+    pose.y = position(rng);
+    pose.theta = heading(rng);
+    // Every 8th robot drives straight, to exercise the near zero w case
+    fleet.Add(pose, linear(rng), i % 8 == 0 ? 0 : angular(rng));
+  }
+  return fleet;
+}
+
+static void Report(const char *name,
+                   size_t robots,
+                   size_t steps,
+                   double seconds,
+                   double baseline_seconds) {
+  double rate = robots * (double)steps / seconds;
+  printf("%-12s %10.3f ms  %12.3e robot-steps/s  %6.2fx\n",
+         name, seconds * 1000, rate, baseline_seconds / seconds);
+}
+
+int main(int argc, char **argv) {
+  size_t robots = 100000;
+  size_t steps = 100;
+  const double dt = 0.01;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--robots") == 0) {
+      robots = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--steps") == 0) {
+      steps = strtoull(argv[++i], nullptr, 10);
+    }
+    else {
+      printf("Usage: %s [--robots N] [--steps N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const FleetState initial = MakeFleet(robots);
+  printf("%zu robots, %zu steps, best kernel: %s\n", robots, steps, FleetKernelName(BestFleetKernel()));
+
+  // Baseline, one Simulator per robot
+  std::vector<Simulator> sims(robots);
+  for (size_t i = 0; i < robots; ++i) {
+    sims[i].pose_ = initial.GetPose(i);
+    sims[i].SetCommand(initial.v_[i], initial.w_[i]);
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (size_t s = 0; s < steps; ++s) {
+    for (Simulator &sim : sims) {
+      sim.Step(dt);
+    }
+  }
+  double baseline = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  Report("simulator", robots, steps, baseline, baseline);
+
+  const FleetKernel kernels[] = {FleetKernel::kScalar, FleetKernel::kSse2, FleetKernel::kAvx2};
+  for (FleetKernel kernel : kernels) {
+    if (!FleetKernelSupported(kernel)) {
+      printf("%-12s not supported\n", FleetKernelName(kernel));
+      continue;
+    }
+    FleetState fleet = initial;
+    start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < steps; ++s) {
+      StepFleet(fleet, dt, kernel);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Report(FleetKernelName(kernel), robots, steps, seconds, baseline);
+
+    // Make sure the fast paths still agree with the reference
+    double max_error = 0;
+    for (size_t i = 0; i < robots; ++i) {
+      max_error = std::max(max_error, std::abs(fleet.x_[i] - sims[i].pose_.x));
+      max_error = std::max(max_error, std::abs(fleet.y_[i] - sims[i].pose_.y));
+    }
+    printf("%-12s max position difference from simulator: %.3e m\n", "", max_error);
+  }
+  return 0;
+}
@@ -0,0 +1,202 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "integrators.h"
+
+/**
+ * Accuracy against throughput of the integrators in integrators.h, to pick the cheapest one
+ * that stays inside a drift budget. Writes one CSV row per integrator/step size (or tolerance)
+ * to stdout, plot position_error_m against sim_seconds_per_sec on log axes. steps is the number of
+ * steps actually taken (internal steps for the adaptive one). With --budget the
+ * fastest configuration under the budget for each model is printed to stderr.
+ * Usage: integrator_bench [--duration seconds] [--budget metres]
+ */
+
+struct BenchResult {
+  std::string model_;
+  std::string integrator_;
+  double dt_ = 0;
+  double tolerance_ = 0;
+  uint64_t steps_ = 0;
+  uint64_t evaluations_ = 0;
+  double position_error_ = 0;
+  double heading_error_ = 0;
+  double sim_seconds_per_second_ = 0;
+  double steps_per_second_ = 0;
+};
+
+static std::vector<BenchResult> results;
+
+/**
+ * \return steps actually taken, for the adaptive integrator its own internal steps
+ */
+template <typename Integrator>
+static uint64_t StepsTaken(const Integrator &integrator,
+                           uint64_t steps) {
+  (void)integrator;
+  return steps;
+}
+
+static uint64_t StepsTaken(const DormandPrinceIntegrator &integrator,
+                           uint64_t steps) {
+  (void)steps;
+  return integrator.accepted_ + integrator.rejected_;
+}
+
+/**
+ * Integrate the model for duration seconds from start, repeatedly until enough wall time has
+ * passed to time it, and compare the end state with reference
+ */
+template <typename Integrator, typename Model>
+static void Run(const char *model_name,
+                const char *integrator_name,
+                Integrator integrator,
+                const Model &model,
+                const typename Model::State &start,
+                const typename Model::State &reference,
+                double duration,
+                double dt,
+                double tolerance) {
+  typename Model::State state = start;
+  Integrator first = integrator;
+  const uint64_t steps = StepsTaken(first, IntegrateFor(first, model, state, 0.0, duration, dt));
+  const uint64_t evaluations = first.evaluations_;
+
+  BenchResult result;
+  result.model_ = model_name;
+  result.integrator_ = integrator_name;
+  result.dt_ = dt;
+  result.tolerance_ = tolerance;
+  result.steps_ = steps;
+  result.evaluations_ = evaluations;
+  result.position_error_ = std::hypot(state[0] - reference[0], state[1] - reference[1]);
+  result.heading_error_ = std::abs(std::remainder(state[2] - reference[2], 2 * M_PI));
+
+  // Time it, at least 50 ms of repeats
+  int repeats = 0;
+  double checksum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  double seconds = 0;
+  do {
+    Integrator timed = integrator;
+    state = start;
+    IntegrateFor(timed, model, state, 0.0, duration, dt);
+    checksum += state[0];
+    repeats++;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  } while (seconds < 0.05);
+  // Keeps the compiler from throwing the repeats away
+  if (checksum == 12345.678) {
+    printf("#");
+  }
+  result.sim_seconds_per_second_ = repeats * duration / seconds;
+  result.steps_per_second_ = repeats * (double)steps / seconds;
+  results.push_back(result);
+}
+
+int main(int argc, char **argv) {
+  double duration = 20;
+  double budget = -1;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--duration") == 0) {
+      duration = atof(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--budget") == 0) {
+      budget = atof(argv[++i]);
+    }
+    else {
+      printf("Usage: %s [--duration seconds] [--budget metres]\n", argv[0]);
+      return 1;
+    }
+  }
+  const double step_sizes[] = {0.2, 0.1, 0.05, 0.02, 0.01, 0.005, 0.002, 0.001};
+  const double tolerances[] = {1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9, 1e-10};
+  // The adaptive integrator is asked for the end state in one call and picks its own steps,
+  // at the usual 0.01 s sim step these smooth models never need more than one step per call
+  const double adaptive_dt = duration;
+
+  // Kinematic unicycle driving a circle, the reference is the exact arc in one go
+  UnicycleModel unicycle;
+  unicycle.linear_velocity_ = 1;
+  unicycle.angular_velocity_ = 0.5;
+  const UnicycleModel::State unicycle_start(0, 0, 0);
+  UnicycleModel::State unicycle_reference = unicycle_start;
+  ExactArcIntegrator().Step(unicycle, unicycle_reference, 0, duration);
+  for (double dt : step_sizes) {
+    Run("unicycle", "euler", EulerIntegrator(), unicycle, unicycle_start, unicycle_reference, duration, dt, 0);
+    Run("unicycle", "rk4", Rk4Integrator(), unicycle, unicycle_start, unicycle_reference, duration, dt, 0);
+    Run("unicycle", "exact_arc", ExactArcIntegrator(), unicycle, unicycle_start, unicycle_reference, duration, dt, 0);
+  }
+  for (double tolerance : tolerances) {
+    DormandPrinceIntegrator integrator;
+    integrator.absolute_tolerance_ = tolerance;
+    integrator.relative_tolerance_ = tolerance;
+    integrator.max_step_ = duration;
+    Run("unicycle", "dopri45", integrator, unicycle, unicycle_start, unicycle_reference, duration, adaptive_dt,
+        tolerance);
+  }
+
+  // Starting from rest, the acceleration limits and lag matter. No closed form, the reference
+  // is the adaptive integrator with a very tight tolerance and small steps
+  LaggedUnicycleModel lagged;
+  lagged.linear_velocity_ = 2;
+  lagged.angular_velocity_ = 1;
+  LaggedUnicycleModel::State lagged_start;
+  lagged_start << 0, 0, 0, 0, 0;
+  LaggedUnicycleModel::State lagged_reference = lagged_start;
+  {
+    DormandPrinceIntegrator reference;
+    reference.absolute_tolerance_ = 1e-13;
+    reference.relative_tolerance_ = 1e-13;
+    reference.min_step_ = 1e-9;
+    reference.max_step_ = 1e-3;
+    IntegrateFor(reference, lagged, lagged_reference, 0.0, duration, 1e-3);
+  }
+  for (double dt : step_sizes) {
+    Run("lagged", "euler", EulerIntegrator(), lagged, lagged_start, lagged_reference, duration, dt, 0);
+    Run("lagged", "rk4", Rk4Integrator(), lagged, lagged_start, lagged_reference, duration, dt, 0);
+  }
+  for (double tolerance : tolerances) {
+    DormandPrinceIntegrator integrator;
+    integrator.absolute_tolerance_ = tolerance;
+    integrator.relative_tolerance_ = tolerance;
+    integrator.max_step_ = duration;
+    Run("lagged", "dopri45", integrator, lagged, lagged_start, lagged_reference, duration, adaptive_dt, tolerance);
+  }
+
+  printf("model,integrator,dt,tolerance,steps,evaluations,position_error_m,heading_error_rad,"
+         "steps_per_sec,sim_seconds_per_sec\n");
+  for (const BenchResult &result : results) {
+    printf("%s,%s,%g,%g,%llu,%llu,%.3e,%.3e,%.4e,%.4e\n",
+           result.model_.c_str(), result.integrator_.c_str(), result.dt_, result.tolerance_,
+           (unsigned long long)result.steps_, (unsigned long long)result.evaluations_,
+           result.position_error_, result.heading_error_, result.steps_per_second_,
+           result.sim_seconds_per_second_);
+  }
+
+  if (budget > 0) {
+    for (const char *model : {"unicycle", "lagged"}) {
+      const BenchResult *best = nullptr;
+      for (const BenchResult &result : results) {
+        if (result.model_ == model && result.position_error_ <= budget
+            && (best == nullptr || result.sim_seconds_per_second_ > best->sim_seconds_per_second_)) {
+          best = &result;
+        }
+      }
+      if (best == nullptr) {
+        fprintf(stderr, "%s: nothing meets %g m over %g s\n", model, budget, duration);
+      }
+      else {
+        fprintf(stderr, "%s: fastest under %g m over %g s is %s dt %g tolerance %g (%.3e m, %.3e sim s/s)\n",
+                model, budget, duration, best->integrator_.c_str(), best->dt_, best->tolerance_,
+                best->position_error_, best->sim_seconds_per_second_);
+      }
+    }
+  }
+  return 0;
+}
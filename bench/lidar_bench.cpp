@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "lidar.h"
+#include "thread_pool.h"
+
+/**
+ * Rays/sec of the lidar. A fleet of --robots robots on a 100 m random map each take one
+ * --beams beam scan, against the occupancy grid (DDA), against --segments wall segments (BVH,
+ * scalar and AVX2) and against both, on 1 up to --threads threads. Also checks the AVX2 segment
+ * kernel against the scalar one.
+ * Usage: lidar_bench [--robots N] [--beams N] [--segments N] [--threads N] [--repeats N]
+ */
+
+static double RaysPerSecond(const Lidar &lidar,
+                            const LidarWorld &world,
+                            const FleetState &fleet,
+                            LidarScans &scans,
+                            ThreadPool *pool,
+                            int repeats) {
+  // One untimed scan so the scan buffers are sized and the map pages are in
+  CastFleetScans(lidar, world, fleet, scans, pool, 1);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    CastFleetScans(lidar, world, fleet, scans, pool, 1);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return (double)fleet.Size() * lidar.beam_count_ * repeats / seconds;
+}
+
+int main(int argc, char **argv) {
+  size_t robots = 1000;
+  size_t beams = 1024;
+  size_t segment_count = 2000;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  int repeats = 5;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--robots") == 0) {
+      robots = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--beams") == 0) {
+      beams = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--segments") == 0) {
+      segment_count = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--repeats") == 0) {
+      repeats = std::max(1, atoi(argv[++i]));
+    }
+    else {
+      printf("Usage: %s [--robots N] [--beams N] [--segments N] [--threads N] [--repeats N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  OccupancyGrid grid;
+  grid.Create(2000, 2000, 0.05, -50, -50);
+  AddRandomObstacles(grid, 400, 2023, 0, 0, 3);
+  std::vector<LineSegment> walls;
+  RandomSegments(walls, segment_count, 50, 5, 2023);
+  SegmentBvh bvh;
+  bvh.Build(walls);
+  FleetState fleet;
+  SpawnRandomFleet(fleet, robots, 2023);
+  // Keep everybody on the map
+  for (size_t i = 0; i < fleet.Size(); ++i) {
+    fleet.x_[i] = std::fmod(fleet.x_[i], 45.0);
+    fleet.y_[i] = std::fmod(fleet.y_[i], 45.0);
+  }
+
+  Lidar lidar;
+  lidar.beam_count_ = beams;
+  lidar.max_range_ = 20;
+  lidar.range_noise_ = 0;
+  lidar.Configure();
+
+  // The packet kernel has to find exactly what the scalar one does
+  LidarWorld segments_only;
+  segments_only.segments_ = &bvh;
+  LidarScans scalar_scans, avx2_scans;
+  lidar.kernel_ = LidarKernel::kScalar;
+  CastFleetScans(lidar, segments_only, fleet, scalar_scans, nullptr, 1);
+  lidar.kernel_ = BestLidarKernel();
+  CastFleetScans(lidar, segments_only, fleet, avx2_scans, nullptr, 1);
+  double max_difference = 0;
+  for (size_t i = 0; i < scalar_scans.ranges_.size(); ++i) {
+    max_difference = std::max(max_difference, (double)std::abs(scalar_scans.ranges_[i] - avx2_scans.ranges_[i]));
+  }
+  printf("%zu robots x %zu beams, %zu segments (%zu BVH nodes), %s kernel differs from scalar by %.2e m\n",
+         robots, beams, segment_count, bvh.nodes_.size(), LidarKernelName(BestLidarKernel()), max_difference);
+
+  struct Case {
+    const char *name;
+    bool grid;
+    bool segments;
+    LidarKernel kernel;
+  };
+  const Case cases[] = {
+      {"grid", true, false, LidarKernel::kScalar},
+      {"segments scalar", false, true, LidarKernel::kScalar},
+      {"segments avx2", false, true, LidarKernel::kAvx2},
+      {"grid + segments", true, true, BestLidarKernel()},
+  };
+  LidarScans scans;
+  for (const Case &test : cases) {
+    if (test.kernel == LidarKernel::kAvx2 && BestLidarKernel() != LidarKernel::kAvx2) {
+      continue;
+    }
+    LidarWorld world;
+    world.grid_ = test.grid ? &grid : nullptr;
+    world.segments_ = test.segments ? &bvh : nullptr;
+    lidar.kernel_ = test.kernel;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      // The calling thread helps in ParallelFor, so threads - 1 workers
+      ThreadPool pool(std::max<size_t>(1, threads - 1));
+      const double rate = RaysPerSecond(lidar, world, fleet, scans, threads > 1 ? &pool : nullptr, repeats);
+      printf("%-16s %2zu threads  %.3e rays/s  %.3e rays/s/core\n", test.name, threads, rate, rate / threads);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "localization.h"
+#include "thread_pool.h"
+
+/**
+ * Throughput of the particle filter stages. --particles particles around a robot in a field of
+ * landmarks are predicted, weighted by --landmarks range/bearing measurements, resampled and
+ * summed into an estimate, --repeats times per stage. Each stage is reported in particles/sec
+ * and particles/sec per core, for every kernel and for 1 thread up to --threads threads.
+ * Then a short tracking run checks the filter actually follows the robot.
+ * Usage: pf_bench [--particles N] [--landmarks N] [--threads N] [--repeats N]
+ */
+
+template <typename Fn>
+static double TimeStage(int repeats,
+                        const Fn &fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    fn();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+static void BenchStages(size_t particles,
+                        size_t landmarks,
+                        size_t threads,
+                        int repeats,
+                        ParticleKernel kernel) {
+  // The calling thread helps in ParallelFor, so threads - 1 workers
+  ThreadPool pool(std::max<size_t>(1, threads - 1));
+  ParticleFilter filter;
+  filter.pool_ = threads > 1 ? &pool : nullptr;
+  filter.kernel_ = kernel;
+  // Stages are timed on their own, don't let the update resample
+  filter.resample_threshold_ = 0;
+  PoseCovariance covariance = PoseCovariance::Zero();
+  covariance.diagonal() << 1, 1, 0.1;
+  const Pose2D truth;
+  filter.Reset(particles, truth, covariance, 2023);
+
+  Rng rng(7);
+  std::vector<Eigen::Vector2d> seen_landmarks;
+  std::vector<Eigen::Vector2d> measurements;
+  for (size_t i = 0; i < landmarks; ++i) {
+    seen_landmarks.emplace_back(rng.Uniform(-8, 8), rng.Uniform(-8, 8));
+    measurements.push_back(PredictRangeBearing(PoseVector(truth.x, truth.y, truth.theta), seen_landmarks.back()));
+  }
+
+  const double predict = TimeStage(repeats, [&] {
+    filter.Predict(1, 0.2, 0.01, 0.05, 0.03);
+  });
+  const double weight = TimeStage(repeats, [&] {
+    filter.UpdateRangeBearing(measurements.data(), seen_landmarks.data(), landmarks, 0.1, 0.035);
+  });
+  const double resample = TimeStage(repeats, [&] {
+    filter.Resample();
+  });
+  Pose2D mean;
+  PoseCovariance estimate_covariance;
+  const double estimate = TimeStage(repeats, [&] {
+    filter.Estimate(mean, estimate_covariance);
+  });
+
+  const char *names[] = {"predict", "weight", "resample", "estimate"};
+  const double seconds[] = {predict, weight, resample, estimate};
+  for (int i = 0; i < 4; ++i) {
+    const double rate = particles / seconds[i];
+    printf("%-6s %2zu threads %-8s %9.3f ms  %.3e particles/s  %.3e particles/s/core\n",
+           ParticleKernelName(kernel), threads, names[i], seconds[i] * 1e3, rate, rate / threads);
+  }
+}
+
+static void Track(size_t particles,
+                  size_t threads) {
+  ThreadPool pool(std::max<size_t>(1, threads - 1));
+  Localization localization;
+  localization.particles_.pool_ = threads > 1 ? &pool : nullptr;
+  localization.particle_count_ = particles;
+  localization.PlaceLandmarks(200, 50, 7);
+  Pose2D truth;
+  localization.Reset(truth, 2023);
+  localization.SetEstimator(EstimatorType::kParticle);
+
+  const double dt = 0.01;
+  const uint64_t steps = 3000;
+  double squared_position_error = 0;
+  double squared_heading_error = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < steps; ++i) {
+    const double w = 0.6 * std::sin(0.2 * i * dt);
+    StepUnicycle(truth, 1.5, w, dt);
+    truth.theta = WrapAngle(truth.theta);
+    localization.Step(truth, 1.5, w, dt);
+    const Pose2D estimate = localization.Estimate();
+    squared_position_error += (estimate.x - truth.x) * (estimate.x - truth.x)
+        + (estimate.y - truth.y) * (estimate.y - truth.y);
+    const double heading_error = std::remainder(estimate.theta - truth.theta, 2 * M_PI);
+    squared_heading_error += heading_error * heading_error;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("tracking %zu particles, %llu steps in %.3f s (%llu resamples): position RMSE %.4f m, heading RMSE %.4f deg\n",
+         particles, (unsigned long long)steps, seconds,
+         (unsigned long long)localization.particles_.resamples_,
+         std::sqrt(squared_position_error / steps),
+         std::sqrt(squared_heading_error / steps) * 180 / M_PI);
+}
+
+int main(int argc, char **argv) {
+  size_t particles = 1000000;
+  size_t landmarks = 10;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  int repeats = 10;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--particles") == 0) {
+      particles = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--landmarks") == 0) {
+      landmarks = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--repeats") == 0) {
+      repeats = std::max(1, atoi(argv[++i]));
+    }
+    else {
+      printf("Usage: %s [--particles N] [--landmarks N] [--threads N] [--repeats N]\n", argv[0]);
+      return 1;
+    }
+  }
+  printf("%zu particles, %zu landmarks in view, fleet kernel %s\n",
+         particles, landmarks, FleetKernelName(BestFleetKernel()));
+  for (ParticleKernel kernel : {ParticleKernel::kScalar, ParticleKernel::kAvx2}) {
+    if (kernel == ParticleKernel::kAvx2 && BestParticleKernel() != ParticleKernel::kAvx2) {
+      continue;
+    }
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      BenchStages(particles, landmarks, threads, repeats, kernel);
+    }
+  }
+  Track(std::min<size_t>(particles, 20000), max_threads);
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "planner.h"
+#include "random.h"
+
+/**
+ * Plans/sec of the planner. Builds the distance field of a --size x --size cell random map
+ * (0.05 m cells, so 4000 is a 200 m square) on 1 and all threads, then plans --plans random
+ * start/goal pairs --distance m apart with grid and hybrid A* through a PlannerService of
+ * 1 up to --threads threads.
+ * Usage: planner_bench [--size N] [--obstacles N] [--plans N] [--distance X] [--threads N]
+ */
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+  uint32_t size = 4000;
+  size_t obstacles = 4000;
+  size_t plans = 200;
+  double distance = 40;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--size") == 0) {
+      size = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--obstacles") == 0) {
+      obstacles = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--plans") == 0) {
+      plans = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--distance") == 0) {
+      distance = atof(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else {
+      printf("Usage: %s [--size N] [--obstacles N] [--plans N] [--distance X] [--threads N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const double resolution = 0.05;
+  const double half_extent = size * resolution / 2;
+  OccupancyGrid grid;
+  grid.Create(size, size, resolution, -half_extent, -half_extent);
+  AddRandomObstacles(grid, obstacles, 2023, 0, 0, 3);
+
+  DistanceField field;
+  auto start = std::chrono::steady_clock::now();
+  field.Build(grid, nullptr);
+  const double single = Seconds(start);
+  {
+    ThreadPool pool(max_threads);
+    start = std::chrono::steady_clock::now();
+    field.Build(grid, &pool);
+  }
+  printf("%ux%u cells, %zu obstacles: distance field %.1f ms on 1 thread, %.1f ms on %zu\n", size, size,
+         obstacles, single * 1e3, Seconds(start) * 1e3, max_threads);
+
+  // Random pairs with both ends clear of the map
+  PlanRequest base;
+  Rng rng(2023);
+  std::vector<PlanRequest> requests;
+  while (requests.size() < plans) {
+    PlanRequest request = base;
+    request.start_.x = rng.Uniform(-half_extent + distance / 2, half_extent - distance / 2);
+    request.start_.y = rng.Uniform(-half_extent + distance / 2, half_extent - distance / 2);
+    request.start_.theta = rng.Uniform(0, 2 * M_PI);
+    const double direction = rng.Uniform(0, 2 * M_PI);
+    request.goal_.x = request.start_.x + distance / 2 * std::sin(direction);
+    request.goal_.y = request.start_.y + distance / 2 * std::cos(direction);
+    request.start_.x -= distance / 2 * std::sin(direction);
+    request.start_.y -= distance / 2 * std::cos(direction);
+    request.goal_.theta = rng.Uniform(0, 2 * M_PI);
+    if (field.Clearance(request.start_.x, request.start_.y) >= request.radius_ &&
+        field.Clearance(request.goal_.x, request.goal_.y) >= request.radius_) {
+      requests.push_back(request);
+    }
+  }
+
+  for (PlannerType type : {PlannerType::kGrid, PlannerType::kHybrid}) {
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      PlannerService planner(threads);
+      planner.BuildField(grid);
+      // One untimed round so every worker has grown its workspace
+      for (size_t i = 0; i < std::min<size_t>(threads * 2, requests.size()); ++i) {
+        PlanRequest request = requests[i];
+        request.type_ = type;
+        planner.Request(request);
+      }
+      planner.Wait();
+      PlanResult result;
+      while (planner.PopResult(result)) {
+      }
+      start = std::chrono::steady_clock::now();
+      for (PlanRequest request : requests) {
+        request.type_ = type;
+        planner.Request(request);
+      }
+      planner.Wait();
+      const double seconds = Seconds(start);
+      size_t found = 0;
+      size_t expanded = 0;
+      double length = 0;
+      double plan_seconds = 0;
+      while (planner.PopResult(result)) {
+        found += result.found_;
+        expanded += result.expanded_;
+        length += result.length_;
+        plan_seconds += result.seconds_;
+      }
+      printf("%-9s %2zu threads  %8.1f plans/s  %.1f ms/plan  %zu/%zu found  %.0f expanded/plan  %.1f m/path\n",
+             PlannerTypeName(type), threads, requests.size() / seconds, plan_seconds / requests.size() * 1e3,
+             found, requests.size(), (double)expanded / requests.size(), found > 0 ? length / found : 0.0);
+    }
+  }
+  return 0;
+}
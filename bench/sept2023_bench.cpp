@@ -0,0 +1,439 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include "camera.h"
+#include "fleet_renderer.h"
+#include "fleet_step.h"
+#include "integrators.h"
+#include "point_renderer.h"
+#include "random.h"
+#include "robot.h"
+#include "shader_library.h"
+#include "simulator.h"
+#include "static_batch.h"
+
+/**
+ * Microbenchmarks of the per step and per frame hot paths: the pose integrators, the fleet step,
+ * Robot::UpdateModelMatrix, Camera::GetViewMatrix, setting shader uniforms and a whole frame drawn
+ * into a hidden window. The GL ones are skipped if no OpenGL 3.3 context can be created.
+ * Each benchmark runs for at least --min-time seconds, only those whose name contains --filter run.
+ * --json writes the results in Google Benchmark's JSON format, so its tools/compare.py can diff
+ * two runs to catch regressions.
+ * Usage: sept2023_bench [--filter text] [--min-time seconds] [--fleet N] [--json file]
+ */
+
+/**
+ * Make the compiler assume value is read, so the work producing it isn't optimized away
+ */
+template <typename T>
+static inline void DoNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+struct BenchmarkResult {
+  std::string name_;
+  uint64_t iterations_ = 0;
+  // Per iteration, nanoseconds
+  double real_time_ = 0;
+  double cpu_time_ = 0;
+  // Why it didn't run, empty if it did
+  std::string error_;
+};
+
+struct BenchmarkRunner {
+  std::string filter_;
+  double min_time_ = 0.2;
+  std::vector<BenchmarkResult> results_;
+
+  bool Selected(const char *name) const {
+    return filter_.empty() || strstr(name, filter_.c_str()) != nullptr;
+  }
+
+  /**
+   * Call fn() in a loop, growing the iteration count until one batch takes at least min_time_
+   */
+  template <typename Fn>
+  void Run(const char *name,
+           Fn &&fn) {
+    if (!Selected(name)) {
+      return;
+    }
+    BenchmarkResult result;
+    result.name_ = name;
+    uint64_t iterations = 1;
+    while (true) {
+      const std::clock_t cpu_start = std::clock();
+      const auto start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < iterations; ++i) {
+        fn();
+      }
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      const double cpu_seconds = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+      if (seconds >= min_time_ || iterations >= 1000000000) {
+        result.iterations_ = iterations;
+        result.real_time_ = seconds * 1e9 / iterations;
+        result.cpu_time_ = cpu_seconds * 1e9 / iterations;
+        break;
+      }
+      // Aim a bit past min_time_ so the next batch is very likely the last
+      const double estimate = seconds > 0 ? iterations * min_time_ * 1.4 / seconds : iterations * 10.0;
+      iterations = std::max<uint64_t>(iterations * 2, (uint64_t)std::min(estimate, 1e9));
+    }
+    printf("%-32s %14.1f ns %14.1f ns cpu %12llu\n", name, result.real_time_, result.cpu_time_,
+           (unsigned long long)result.iterations_);
+    results_.push_back(result);
+  }
+
+  void Skip(const char *name,
+            const char *reason) {
+    if (!Selected(name)) {
+      return;
+    }
+    BenchmarkResult result;
+    result.name_ = name;
+    result.error_ = reason;
+    printf("%-32s skipped: %s\n", name, reason);
+    results_.push_back(result);
+  }
+
+  bool WriteJson(const char *path) const;
+};
+
+static std::string JsonString(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+bool BenchmarkRunner::WriteJson(const char *path) const {
+  FILE *file = fopen(path, "w");
+  if (file == nullptr) {
+    printf("ERROR (Bench): Failed to open %s\n", path);
+    return false;
+  }
+  char date[64];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#if defined(NDEBUG)
+  const char *build_type = "release";
+#else
+  const char *build_type = "debug";
+#endif
+  fprintf(file, "{\n  \"context\": {\n");
+  fprintf(file, "    \"date\": \"%s\",\n", date);
+  fprintf(file, "    \"executable\": \"sept2023_bench\",\n");
+  fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+  fprintf(file, "    \"fleet_kernel\": \"%s\",\n", FleetKernelName(BestFleetKernel()));
+  fprintf(file, "    \"library_build_type\": \"%s\"\n", build_type);
+  fprintf(file, "  },\n  \"benchmarks\": [");
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const BenchmarkResult &result = results_[i];
+    const std::string name = JsonString(result.name_);
+    fprintf(file, "%s\n    {\n", i == 0 ? "" : ",");
+    fprintf(file, "      \"name\": %s,\n      \"run_name\": %s,\n      \"run_type\": \"iteration\",\n",
+            name.c_str(), name.c_str());
+    if (!result.error_.empty()) {
+      fprintf(file, "      \"error_occurred\": true,\n      \"error_message\": %s,\n",
+              JsonString(result.error_).c_str());
+    }
+    fprintf(file, "      \"iterations\": %llu,\n", (unsigned long long)result.iterations_);
+    fprintf(file, "      \"real_time\": %.6g,\n      \"cpu_time\": %.6g,\n      \"time_unit\": \"ns\"\n",
+            result.real_time_, result.cpu_time_);
+    fprintf(file, "    }");
+  }
+  fprintf(file, "\n  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+static void RunKinematicsBenchmarks(BenchmarkRunner &runner,
+                                    size_t fleet_size) {
+  const double dt = 0.01;
+  Pose2D pose;
+  runner.Run("StepUnicycle/arc", [&]() {
+    StepUnicycle(pose, 1, 0.5, dt);
+    DoNotOptimize(pose);
+  });
+  runner.Run("StepUnicycle/straight", [&]() {
+    StepUnicycle(pose, 1, 0, dt);
+    DoNotOptimize(pose);
+  });
+
+  UnicycleModel model;
+  model.linear_velocity_ = 1;
+  model.angular_velocity_ = 0.5;
+  UnicycleModel::State state = UnicycleModel::State::Zero();
+  EulerIntegrator euler;
+  runner.Run("Integrator/Euler", [&]() {
+    euler.Step(model, state, 0, dt);
+    DoNotOptimize(state);
+  });
+  Rk4Integrator rk4;
+  runner.Run("Integrator/Rk4", [&]() {
+    rk4.Step(model, state, 0, dt);
+    DoNotOptimize(state);
+  });
+  ExactArcIntegrator exact;
+  runner.Run("Integrator/ExactArc", [&]() {
+    exact.Step(model, state, 0, dt);
+    DoNotOptimize(state);
+  });
+  DormandPrinceIntegrator dormand_prince;
+  runner.Run("Integrator/DormandPrince", [&]() {
+    dormand_prince.Step(model, state, 0, dt);
+    DoNotOptimize(state);
+  });
+
+  FleetState fleet;
+  SpawnRandomFleet(fleet, fleet_size, 2023);
+  const std::string fleet_name = "StepFleet/" + std::to_string(fleet_size);
+  runner.Run(fleet_name.c_str(), [&]() {
+    StepFleet(fleet, dt);
+    DoNotOptimize(fleet.x_[0]);
+  });
+}
+
+static void RunMatrixBenchmarks(BenchmarkRunner &runner) {
+  // No Init, the model matrix doesn't need GL
+  Robot robot;
+  robot.length_ = 1;
+  robot.width_ = 0.5;
+  runner.Run("Robot/UpdateModelMatrix", [&]() {
+    // Keep the input changing so nothing can be hoisted out of the loop
+    robot.position_[2] += 1e-6f;
+    robot.UpdateModelMatrix();
+    DoNotOptimize(robot.model_);
+  });
+
+  Camera camera;
+  camera.position_ = glm::vec3(0, 0, 10);
+  camera.Update();
+  runner.Run("Camera/GetViewMatrix", [&]() {
+    camera.position_[0] += 1e-6f;
+    const glm::mat4 view = camera.GetViewMatrix();
+    DoNotOptimize(view);
+  });
+}
+
+/**
+ * \return a hidden window with a current OpenGL 3.3 core context, null if there is no display/driver
+ */
+static GLFWwindow *CreateHiddenContext() {
+  if (!glfwInit()) {
+    return nullptr;
+  }
+  glfwDefaultWindowHints();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if defined(__APPLE__)
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+#endif
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window = glfwCreateWindow(1200, 800, "sept2023_bench", nullptr, nullptr);
+  if (window == nullptr) {
+    glfwTerminate();
+    return nullptr;
+  }
+  glfwMakeContextCurrent(window);
+  // Never wait for vsync, we want the frame cost not the refresh rate
+  glfwSwapInterval(0);
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return nullptr;
+  }
+  return window;
+}
+
+static void RunGlBenchmarks(BenchmarkRunner &runner,
+                            size_t fleet_size) {
+  const char *gl_names[] = {"Shader/SetVec4ByName", "Shader/SetVec4ByHandle", "Shader/SetFloatByName",
+                            "Shader/SetFloatByHandle", "Frame/Headless", "Fleet/Points", "Fleet/Density",
+                            "StaticBatch/Culled", "StaticBatch/Everything"};
+  bool any_selected = false;
+  for (const char *name : gl_names) {
+    any_selected = any_selected || runner.Selected(name);
+  }
+  if (!any_selected) {
+    return;
+  }
+  GLFWwindow *window = CreateHiddenContext();
+  if (window == nullptr) {
+    for (const char *name : gl_names) {
+      runner.Skip(name, "no OpenGL 3.3 context");
+    }
+    return;
+  }
+
+  PointRenderer points;
+  if (points.Init()) {
+    // Uniforms need the program bound, the driver call is what we're timing
+    points.shader_->Use();
+    const glm::vec4 color(0.2f, 0.6f, 0.2f, 0.5f);
+    runner.Run("Shader/SetVec4ByName", [&]() {
+      points.shader_->SetVec4("color", color);
+    });
+    runner.Run("Shader/SetVec4ByHandle", [&]() {
+      points.shader_->SetVec4(points.color_uniform_, color);
+    });
+    runner.Run("Shader/SetFloatByName", [&]() {
+      points.shader_->SetFloat("pointSize", 2.0f);
+    });
+    runner.Run("Shader/SetFloatByHandle", [&]() {
+      points.shader_->SetFloat(points.point_size_uniform_, 2.0f);
+    });
+    glFinish();
+  }
+  else {
+    for (int i = 0; i < 4; ++i) {
+      runner.Skip(gl_names[i], "point shader failed to load");
+    }
+  }
+
+  // Everything the viewer does per frame except ImGui: step the sim, upload the camera, draw the
+  // robot and the interpolated fleet, and wait for the GPU
+  FrameUniformBuffer frame_uniforms;
+  frame_uniforms.Init();
+  Camera camera;
+  camera.position_ = glm::vec3(0, 0, 100);
+  camera.Update();
+  Robot robot;
+  robot.length_ = 1;
+  robot.width_ = 0.5;
+  robot.Init();
+  FleetRenderer fleet_renderer;
+  const bool loaded = fleet_renderer.Init() && robot.shader_ != nullptr;
+  if (loaded) {
+    Simulator sim;
+    sim.SetCommand(1, 0.5);
+    FleetState fleet;
+    SpawnRandomFleet(fleet, fleet_size, 2023);
+    FleetState previous_fleet;
+    const double dt = 0.01;
+    const std::string frame_name = "Frame/Headless/" + std::to_string(fleet_size);
+    runner.Run(frame_name.c_str(), [&]() {
+      previous_fleet = fleet;
+      sim.Step(dt);
+      StepFleet(fleet, dt);
+      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      const glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 1200.0f / 800.0f, 0.1f, 1000.0f);
+      frame_uniforms.Update(projection, camera.GetViewMatrix());
+      robot.position_ = glm::vec3(sim.pose_.x, sim.pose_.y, sim.pose_.theta);
+      robot.UpdateModelMatrix();
+      robot.Draw();
+      fleet_renderer.Update(previous_fleet, fleet, 0.5, robot.width_, robot.length_, glm::vec4(0, 0, 1, 1));
+      fleet_renderer.Draw();
+      glFinish();
+    });
+    // Upload and draw only, at the levels of detail used when zoomed out
+    const FleetLod lods[2] = {FleetLod::kPoints, FleetLod::kDensity};
+    for (int i = 0; i < 2; ++i) {
+      const std::string name = std::string(i == 0 ? "Fleet/Points/" : "Fleet/Density/") + std::to_string(fleet_size);
+      runner.Run(name.c_str(), [&]() {
+        glClear(GL_COLOR_BUFFER_BIT);
+        fleet_renderer.Update(previous_fleet, fleet, 0.5, robot.width_, robot.length_, glm::vec4(0, 0, 1, 1));
+        fleet_renderer.lod_ = lods[i];
+        fleet_renderer.Draw();
+        glFinish();
+      });
+    }
+    fleet_renderer.lod_ = FleetLod::kBoxes;
+  }
+  else {
+    runner.Skip("Frame/Headless", "robot/fleet shaders failed to load");
+    runner.Skip("Fleet/Points", "robot/fleet shaders failed to load");
+    runner.Skip("Fleet/Density", "robot/fleet shaders failed to load");
+  }
+
+  // 20000 obstacles over a 1 km square, drawn from the normal viewer camera (a few chunks on
+  // screen) and from high enough up that nothing is culled
+  Shader *static_shader = GetShaderLibrary().Load("static_shader.vs", "simple_shader.fs");
+  if (static_shader != nullptr) {
+    StaticBatch batch;
+    const uint32_t material = batch.AddMaterial(static_shader, GL_TRIANGLES, false);
+    Rng rng(2023, 1);
+    for (int i = 0; i < 20000; ++i) {
+      batch.AddBox(material, (float)rng.Uniform(-500, 500), (float)rng.Uniform(-500, 500),
+                   (float)rng.Uniform(0, 2 * M_PI), (float)rng.Uniform(0.5, 3), (float)rng.Uniform(0.5, 3),
+                   glm::vec4(0.4, 0.3, 0.2, 1));
+    }
+    batch.Upload();
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1200.0f / 800.0f, 0.1f, 2000.0f);
+    const float heights[2] = {10, 1300};
+    const char *names[2] = {"StaticBatch/Culled", "StaticBatch/Everything"};
+    for (int i = 0; i < 2; ++i) {
+      camera.position_ = glm::vec3(0, 0, heights[i]);
+      const Frustum frustum = camera.GetFrustum(projection);
+      frame_uniforms.Update(projection, camera.GetViewMatrix());
+      runner.Run(names[i], [&]() {
+        glClear(GL_COLOR_BUFFER_BIT);
+        batch.Draw(frustum);
+        glFinish();
+      });
+      printf("  %s: %zu/%zu chunks, %zu draw calls (%s)\n", names[i], batch.visible_chunks_, batch.chunks_.size(),
+             batch.draw_calls_, batch.indirect_ ? "multi draw indirect" : "draw elements");
+    }
+    batch.Clear();
+  }
+  else {
+    runner.Skip("StaticBatch/Culled", "static shader failed to load");
+    runner.Skip("StaticBatch/Everything", "static shader failed to load");
+  }
+
+  GetShaderLibrary().Clear();
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+int main(int argc, char **argv) {
+  BenchmarkRunner runner;
+  size_t fleet_size = 10000;
+  const char *json_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--filter") == 0) {
+      runner.filter_ = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--min-time") == 0) {
+      runner.min_time_ = atof(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--fleet") == 0) {
+      fleet_size = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--json") == 0) {
+      json_path = argv[++i];
+    }
+    else {
+      printf("Usage: %s [--filter text] [--min-time seconds] [--fleet N] [--json file]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%-32s %17s %21s %12s\n", "benchmark", "time", "cpu", "iterations");
+  RunKinematicsBenchmarks(runner, fleet_size);
+  RunMatrixBenchmarks(runner);
+  RunGlBenchmarks(runner, fleet_size);
+
+  if (json_path != nullptr && !runner.WriteJson(json_path)) {
+    return 1;
+  }
+  return 0;
+}
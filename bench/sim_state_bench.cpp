@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "sim_state.h"
+#include "thread_pool.h"
+
+/**
+ * Snapshot/restore and forking of the sim state. A base state (100 m map, --robots fleet robots,
+ * particle filter of --particles) is saved and loaded back, then checked to carry on bit for bit
+ * like the original. Then --branches forks of it are stepped --steps steps on --threads threads,
+ * each with its own command, every 8th one adding obstacles so it copies the map.
+ * Usage: sim_state_bench [--robots N] [--particles N] [--branches N] [--steps N] [--threads N]
+ */
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+  size_t robots = 10000;
+  size_t particles = 20000;
+  size_t branches = 64;
+  size_t steps = 200;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--robots") == 0) {
+      robots = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--particles") == 0) {
+      particles = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--branches") == 0) {
+      branches = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--steps") == 0) {
+      steps = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else {
+      printf("Usage: %s [--robots N] [--particles N] [--branches N] [--steps N] [--threads N]\n", argv[0]);
+      return 1;
+    }
+  }
+  const double dt = 0.01;
+
+  auto grid = std::make_shared<OccupancyGrid>();
+  grid->Create(2000, 2000, 0.05, -50, -50);
+  AddRandomObstacles(*grid, 400, 2023, 0, 0, 3);
+  SimState base;
+  base.SetGrid(grid);
+  base.sim_.SetCommand(1, 0.3);
+  SpawnRandomFleet(base.fleet_, robots, 2023);
+  base.localization_.particle_count_ = particles;
+  base.localization_.PlaceLandmarks(40, 20, 2023);
+  base.localization_.Reset(base.sim_.pose_, 2023);
+  base.localization_.SetEstimator(EstimatorType::kParticle);
+  for (int i = 0; i < 100; ++i) {
+    base.Step(dt);
+  }
+
+  std::vector<uint8_t> snapshot;
+  auto start = std::chrono::steady_clock::now();
+  SaveSimState(base, snapshot);
+  const double save_time = Seconds(start);
+  std::vector<uint8_t> without_map;
+  SaveSimState(base, without_map, false);
+  SimState restored;
+  start = std::chrono::steady_clock::now();
+  const bool loaded = LoadSimState(snapshot.data(), snapshot.size(), restored);
+  const double load_time = Seconds(start);
+  if (!loaded) {
+    return 1;
+  }
+  printf("Snapshot:  %.2f MB (%.2f MB without the map), saved in %.2f ms, loaded in %.2f ms\n",
+         snapshot.size() / 1e6, without_map.size() / 1e6, save_time * 1e3, load_time * 1e3);
+
+  // The restored state has to carry on exactly like the original
+  SimState original = base.Fork();
+  for (size_t i = 0; i < steps; ++i) {
+    original.Step(dt);
+    restored.Step(dt);
+  }
+  std::vector<uint8_t> expected, actual;
+  SaveSimState(original, expected);
+  SaveSimState(restored, actual);
+  printf("Restore:   %s after %zu more steps\n", expected == actual ? "bit exact" : "DIFFERS", steps);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<SimState> forks;
+  forks.reserve(branches);
+  for (size_t i = 0; i < branches; ++i) {
+    forks.push_back(base.Fork());
+  }
+  const double fork_time = Seconds(start);
+
+  ThreadPool pool(threads);
+  start = std::chrono::steady_clock::now();
+  pool.ParallelFor(branches, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      SimState &branch = forks[i];
+      branch.sim_.SetCommand(1, -1 + 2.0 * i / branches);
+      if (i % 8 == 0) {
+        AddRandomObstacles(*branch.MutableGrid(), 20, i, branch.sim_.pose_.x, branch.sim_.pose_.y, 1);
+      }
+      for (size_t step = 0; step < steps; ++step) {
+        branch.Step(dt);
+      }
+    }
+  });
+  const double branch_time = Seconds(start);
+  size_t shared = 0;
+  double spread = 0;
+  for (const SimState &branch : forks) {
+    shared += branch.Grid() == base.Grid();
+    spread = std::max(spread, std::hypot(branch.sim_.pose_.x - original.sim_.pose_.x,
+                                         branch.sim_.pose_.y - original.sim_.pose_.y));
+  }
+  printf("Forks:     %zu in %.2f ms (%.3f ms each), %zu still share the map\n",
+         branches, fork_time * 1e3, fork_time * 1e3 / branches, shared);
+  printf("Branches:  %zu x %zu steps on %zu threads in %.2f s (%.3e branch steps/s), end %.2f m apart\n",
+         branches, steps, pool.Size(), branch_time, branches * steps / branch_time, spread);
+  return expected == actual ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "path_tracking.h"
+#include "planner.h"
+#include "random.h"
+#include "simulator.h"
+#include "thread_pool.h"
+
+/**
+ * Tracking error and cost of the path tracking controllers. Plans --paths hybrid A* paths across
+ * a random 100 m map, then drives the simulated robot along each with pure pursuit and with MPPI
+ * at 256 up to --rollouts rollouts on 1 up to --threads threads, a control tick every 0.05 s of
+ * sim time. Reports MPPI rollouts/s, ms per tick against the 10 ms budget, cross track error,
+ * time to the goal and collisions.
+ * Usage: tracking_bench [--paths N] [--rollouts N] [--threads N]
+ */
+
+struct TrackingStats {
+  double compute_seconds_ = 0;
+  double max_tick_seconds_ = 0;
+  uint64_t ticks_ = 0;
+  double error_sum_ = 0;
+  double max_error_ = 0;
+  uint64_t samples_ = 0;
+  double drive_time_ = 0;
+  size_t reached_ = 0;
+  uint64_t collisions_ = 0;
+};
+
+/**
+ * Drive the path from its start until the controller says it is done, or 3x the time cruising
+ * the path would take
+ */
+template <typename Controller>
+static void Drive(Controller &controller,
+                  const TrackingPath &path,
+                  const OccupancyGrid &grid,
+                  TrackingStats &stats) {
+  const double dt = 0.01;
+  const int steps_per_tick = 5;
+  Simulator sim;
+  sim.grid_ = &grid;
+  sim.pose_ = path.points_.front();
+  controller.Reset();
+  const double time_limit = 3 * path.Length() / controller.limits_.speed_ + 10;
+  double progress = 0;
+  bool driving = true;
+  while (driving && sim.time_ < time_limit) {
+    double linear = 0;
+    double angular = 0;
+    const auto start = std::chrono::steady_clock::now();
+    driving = controller.Compute(path, sim.pose_, linear, angular);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.compute_seconds_ += seconds;
+    stats.max_tick_seconds_ = std::max(stats.max_tick_seconds_, seconds);
+    stats.ticks_++;
+    sim.SetCommand(linear, angular);
+    for (int i = 0; i < steps_per_tick; ++i) {
+      sim.Step(dt);
+    }
+    progress = path.Project(sim.pose_.x, sim.pose_.y, progress, 2);
+    const Pose2D closest = path.At(progress);
+    const double error = std::hypot(closest.x - sim.pose_.x, closest.y - sim.pose_.y);
+    stats.error_sum_ += error;
+    stats.max_error_ = std::max(stats.max_error_, error);
+    stats.samples_++;
+  }
+  stats.drive_time_ += sim.time_;
+  stats.reached_ += !driving;
+  stats.collisions_ += sim.collisions_;
+}
+
+static void Print(const char *name,
+                  size_t threads,
+                  size_t rollouts,
+                  size_t paths,
+                  const TrackingStats &stats) {
+  const double tick_ms = stats.compute_seconds_ / stats.ticks_ * 1e3;
+  printf("%-12s %2zu threads %5zu rollouts  %.3e rollouts/s  %.3f ms/tick (max %.2f%s)  error %.3f m (max %.2f)  "
+         "%zu/%zu reached in %.1f s  %llu collisions\n",
+         name, threads, rollouts, rollouts * stats.ticks_ / stats.compute_seconds_, tick_ms,
+         stats.max_tick_seconds_ * 1e3, stats.max_tick_seconds_ > 0.01 ? " OVER" : "",
+         stats.error_sum_ / stats.samples_, stats.max_error_, stats.reached_, paths,
+         stats.drive_time_ / std::max<size_t>(1, stats.reached_), (unsigned long long)stats.collisions_);
+}
+
+int main(int argc, char **argv) {
+  size_t path_count = 10;
+  size_t max_rollouts = 4096;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--paths") == 0) {
+      path_count = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--rollouts") == 0) {
+      max_rollouts = std::max<size_t>(256, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else {
+      printf("Usage: %s [--paths N] [--rollouts N] [--threads N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  OccupancyGrid grid;
+  grid.Create(2000, 2000, 0.05, -50, -50);
+  AddRandomObstacles(grid, 150, 2023, 0, 0, 3);
+  PlannerService planner(max_threads);
+  planner.BuildField(grid);
+  const std::shared_ptr<const DistanceField> field = planner.Field();
+
+  // Paths out from the clear spot in the middle to random goals
+  Rng rng(2023);
+  std::vector<TrackingPath> paths;
+  while (paths.size() < path_count) {
+    PlanRequest request;
+    request.goal_.x = rng.Uniform(-40, 40);
+    request.goal_.y = rng.Uniform(-40, 40);
+    request.goal_.theta = rng.Uniform(0, 2 * M_PI);
+    request.radius_ = 0.6;
+    planner.Request(request);
+    planner.Wait();
+    PlanResult result;
+    if (planner.PopResult(result) && result.found_) {
+      paths.emplace_back();
+      paths.back().Set(result.path_);
+    }
+  }
+  double length = 0;
+  for (const TrackingPath &path : paths) {
+    length += path.Length();
+  }
+  printf("%zu paths, %.1f m on average\n", paths.size(), length / paths.size());
+
+  {
+    TrackingStats stats;
+    PurePursuit pure_pursuit;
+    for (const TrackingPath &path : paths) {
+      Drive(pure_pursuit, path, grid, stats);
+    }
+    Print("pure pursuit", 1, 0, paths.size(), stats);
+  }
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    // The calling thread helps in ParallelFor, so threads - 1 workers
+    ThreadPool pool(std::max<size_t>(1, threads - 1));
+    for (size_t rollouts = 256; rollouts <= max_rollouts; rollouts *= 4) {
+      TrackingStats stats;
+      Mppi mppi;
+      mppi.rollouts_ = rollouts;
+      mppi.field_ = field.get();
+      mppi.pool_ = threads > 1 ? &pool : nullptr;
+      for (const TrackingPath &path : paths) {
+        Drive(mppi, path, grid, stats);
+      }
+      Print("mppi", threads, rollouts, paths.size(), stats);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "fleet_state.h"
+#include "fleet_step.h"
+#include "thread_pool.h"
+#include "trail_buffer.h"
+
+/**
+ * Cost of the fleet trails the viewer draws. Fills --points points of trail for each of --robots
+ * robots driving their random commands, then times appending one frame's poses and Douglas-Peucker
+ * simplifying every trail for a range of on screen tolerances (0.5 px at 1 cm to 64 m per pixel)
+ * on 1 up to --threads threads. Reports the points kept, the vertices drawn per robot and ms per
+ * frame against the 16 ms frame budget.
+ * Usage: trail_bench [--robots N] [--points N] [--threads N]
+ */
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+  size_t robot_count = 10000;
+  size_t points = 512;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--robots") == 0) {
+      robot_count = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--points") == 0) {
+      points = std::max<size_t>(2, strtoull(argv[++i], nullptr, 10));
+    }
+    else if (has_value && strcmp(argv[i], "--threads") == 0) {
+      max_threads = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+    }
+    else {
+      printf("Usage: %s [--robots N] [--points N] [--threads N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  FleetState fleet;
+  SpawnRandomFleet(fleet, robot_count, 2023);
+  TrailBuffer trails;
+  trails.Resize(robot_count, points);
+  // A point every 0.1 s of driving, the ring wraps around once
+  const double dt = 0.1;
+  for (size_t i = 0; i < points + points / 2; ++i) {
+    StepFleet(fleet, dt);
+    trails.Append(fleet);
+  }
+  const size_t total = trails.PointCount();
+  printf("%zu robots, %zu trail points (%.1f MB)\n", robot_count, total,
+         trails.points_.size() * sizeof(float) / 1e6);
+
+  const int frames = 10;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < frames; ++i) {
+    StepFleet(fleet, dt);
+    trails.Append(fleet);
+  }
+  printf("append       %8.3f ms/frame\n", Seconds(start) / frames * 1e3);
+
+  TrailStrips strips;
+  const float pixel_tolerance = 0.5f;
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    // The calling thread helps in ParallelFor, so threads - 1 workers
+    ThreadPool pool(std::max<size_t>(1, threads - 1));
+    for (float meters_per_pixel = 0.01f; meters_per_pixel <= 64; meters_per_pixel *= 4) {
+      const float tolerance = pixel_tolerance * meters_per_pixel;
+      start = std::chrono::steady_clock::now();
+      for (int i = 0; i < frames; ++i) {
+        trails.Simplify(tolerance, threads > 1 ? &pool : nullptr, strips);
+      }
+      const double frame_ms = Seconds(start) / frames * 1e3;
+      printf("simplify %2zu threads %7.2f m/px  %10zu -> %9zu points (%5.1f%%, %6.1f per robot)  %8.3f ms/frame%s\n",
+             threads, meters_per_pixel, total, strips.VertexCount(), 100.0 * strips.VertexCount() / total,
+             (double)strips.VertexCount() / robot_count, frame_ms, frame_ms > 16 ? " OVER" : "");
+    }
+  }
+  return 0;
+}
@@ -1,4 +1,6 @@
 #include "camera.h"
+#include <algorithm>
+#include <cmath>
 
 Camera::Camera() {
   position_ = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -31,4 +33,49 @@ void Camera::UpdateZoom(float yoffset) {
   if (zoom_ > 89.0f) {
     zoom_ = 89.0f;
   }
-}
\ No newline at end of file
+}
+
+float Camera::MetersPerPixel(float viewport_height) const {
+  // zoom_ is the vertical field of view, which sees 2 h tan(fov / 2) of the ground from height h
+  const float visible = 2 * std::abs(position_.z) * std::tan(glm::radians(zoom_) / 2);
+  return visible / std::max(1.0f, viewport_height);
+}
+
+Frustum Camera::GetFrustum(const glm::mat4 &projection) const {
+  Frustum frustum;
+  frustum.FromMatrix(projection * GetViewMatrix());
+  return frustum;
+}
+
+void Frustum::FromMatrix(const glm::mat4 &projection_view) {
+  // Gribb/Hartmann: a point is inside when -w <= x, y, z <= w in clip space, each inequality is a
+  // row of the matrix plus or minus the last row. glm is column major, m[column][row]
+  const glm::mat4 &m = projection_view;
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      const float sign = side == 0 ? 1.0f : -1.0f;
+      glm::vec4 &plane = planes_[axis * 2 + side];
+      for (int column = 0; column < 4; ++column) {
+        plane[column] = m[column][3] + sign * m[column][axis];
+      }
+      const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+      if (length > 0) {
+        plane = plane / length;
+      }
+    }
+  }
+}
+
+bool Frustum::IntersectsBox(const glm::vec3 &min,
+                            const glm::vec3 &max) const {
+  for (const glm::vec4 &plane : planes_) {
+    // The corner furthest along the plane normal, if that is outside the whole box is
+    const float x = plane[0] >= 0 ? max[0] : min[0];
+    const float y = plane[1] >= 0 ? max[1] : min[1];
+    const float z = plane[2] >= 0 ? max[2] : min[2];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0) {
+      return false;
+    }
+  }
+  return true;
+}
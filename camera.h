@@ -5,6 +5,27 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+/**
+ * The 6 planes around what a projection * view matrix can see, for throwing away geometry on the
+ * CPU before it costs a draw call
+ */
+struct Frustum {
+  // (a, b, c, d) with a x + b y + c z + d >= 0 on the inside. Left, right, bottom, top, near, far
+  glm::vec4 planes_[6];
+
+  /**
+   * Planes of projection_view (projection * view), normalized so plane distances are in world units
+   */
+  void FromMatrix(const glm::mat4 &projection_view);
+
+  /**
+   * Conservative: false only if the box is entirely outside one plane, so a box near a corner of
+   * the frustum can pass without being visible
+   */
+  bool IntersectsBox(const glm::vec3 &min,
+                     const glm::vec3 &max) const;
+};
+
 /**
  * Made the Camera object a struct to force all members to be public.
  * Avoiding getters/setters cause Im lazy.
@@ -37,6 +58,18 @@ struct Camera {
    */
   glm::mat4 GetViewMatrix() const;
 
+  /**
+   * \return what the camera sees through projection
+   */
+  Frustum GetFrustum(const glm::mat4 &projection) const;
+
+  /**
+   * Size of a pixel on the ground (z = 0) straight below the camera, the level of detail signal:
+   * grows with zoom_ and with the height of the camera
+   * \param viewport_height pixels
+   */
+  float MetersPerPixel(float viewport_height) const;
+
   /**
    * Update the zoom angle of the camera based on some offset
    * \param yoffset how much the user scrolled the mouse in the y direction
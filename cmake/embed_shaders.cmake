@@ -0,0 +1,30 @@
+# Writes OUTPUT, a C++ file defining kEmbeddedShaders (shader_library.h) with the contents of every
+# file in SHADERS, so the viewer can still find its shaders when run away from the source tree.
+# Run as a script: cmake -DOUTPUT=<file.cpp> -DSHADERS="<a.vs>|<b.fs>" -P embed_shaders.cmake
+if(NOT OUTPUT OR NOT SHADERS)
+    message(FATAL_ERROR "embed_shaders.cmake needs OUTPUT and SHADERS")
+endif()
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(contents "// Generated by cmake/embed_shaders.cmake, do not edit\n#include \"shader_library.h\"\n\n")
+string(APPEND contents "const EmbeddedShader kEmbeddedShaders[] = {\n")
+set(count 0)
+foreach(shader IN LISTS SHADERS)
+    get_filename_component(name ${shader} NAME)
+    file(READ ${shader} source)
+    # Raw string literals can't contain their own terminator, fail rather than embed garbage
+    if(source MATCHES "\\)sept2023_shader\"")
+        message(FATAL_ERROR "${shader} contains the raw string terminator")
+    endif()
+    string(APPEND contents "    {\"${name}\", R\"sept2023_shader(${source})sept2023_shader\"},\n")
+    math(EXPR count "${count} + 1")
+endforeach()
+string(APPEND contents "};\n\nconst size_t kEmbeddedShaderCount = ${count};\n")
+
+# Only touch the output when it changes, so editing nothing doesn't rebuild anything
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif()
+if(NOT previous STREQUAL contents)
+    file(WRITE ${OUTPUT} "${contents}")
+endif()
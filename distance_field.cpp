@@ -0,0 +1,137 @@
+#include "distance_field.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "thread_pool.h"
+
+// Rows/columns per task
+static constexpr size_t kDistanceFieldChunk = 64;
+
+static void ForChunks(ThreadPool *pool,
+                      size_t count,
+                      const std::function<void(size_t begin, size_t end)> &fn) {
+  if (pool != nullptr) {
+    pool->ParallelFor(count, kDistanceFieldChunk, fn);
+  }
+  else {
+    fn(0, count);
+  }
+}
+
+void DistanceField::Build(const OccupancyGrid &grid,
+                          ThreadPool *pool) {
+  grid_version_ = grid.version_.load(std::memory_order_acquire);
+  width_ = grid.width_;
+  height_ = grid.height_;
+  resolution_ = grid.resolution_;
+  origin_x_ = grid.origin_x_;
+  origin_y_ = grid.origin_y_;
+  outside_occupied_ = grid.outside_occupied_;
+  const size_t width = width_;
+  const size_t height = height_;
+  distances_.resize(width * height);
+  if (distances_.empty()) {
+    return;
+  }
+  // Squared distances in cells until the end, an "infinite" that still squares inside a float
+  const float infinite = (float)(width + height) * (float)(width + height);
+
+  // Columns: cells to the nearest occupied cell above or below, squared
+  ForChunks(pool, width, [&](size_t begin, size_t end) {
+    for (size_t x = begin; x < end; ++x) {
+      float run = infinite;
+      for (size_t y = 0; y < height; ++y) {
+        const bool occupied = grid.tiles_[grid.CellOffset((uint32_t)x, (uint32_t)y)] >= kOccupiedThreshold;
+        run = occupied ? 0 : run + 1;
+        distances_[y * width + x] = run;
+      }
+      run = infinite;
+      for (size_t y = height; y-- > 0;) {
+        float &distance = distances_[y * width + x];
+        run = distance == 0 ? 0 : run + 1;
+        distance = std::min(distance, run);
+        distance = distance >= infinite ? infinite : distance * distance;
+      }
+    }
+  });
+
+  // Rows: lower envelope of the parabolas (q - x)^2 + column[q] over every q in the row. In
+  // double, q^2 runs out of float precision on big maps
+  ForChunks(pool, height, [&](size_t begin, size_t end) {
+    std::vector<double> row(width);
+    std::vector<int> parabolas(width);
+    std::vector<double> boundaries(width + 1);
+    for (size_t y = begin; y < end; ++y) {
+      float *out = distances_.data() + y * width;
+      std::copy(out, out + width, row.begin());
+      int count = 0;
+      for (int q = 0; q < (int)width; ++q) {
+        if (row[q] >= infinite) {
+          continue;
+        }
+        // Drop the parabolas the new one is below from the boundary on
+        double boundary = 0;
+        while (count > 0) {
+          const int p = parabolas[count - 1];
+          boundary = ((row[q] + (double)q * q) - (row[p] + (double)p * p)) / (2.0 * (q - p));
+          if (boundary > boundaries[count - 1]) {
+            break;
+          }
+          --count;
+        }
+        parabolas[count] = q;
+        boundaries[count] = count == 0 ? -infinite : boundary;
+        ++count;
+      }
+      boundaries[count] = infinite;
+      if (count == 0) {
+        std::fill(out, out + width, infinite);
+        continue;
+      }
+      int k = 0;
+      for (int x = 0; x < (int)width; ++x) {
+        while (boundaries[k + 1] < x) {
+          ++k;
+        }
+        const double dx = x - parabolas[k];
+        out[x] = (float)(dx * dx + row[parabolas[k]]);
+      }
+    }
+  });
+
+  // To metres. Beyond the edge is a wall too if outside_occupied_, nearest straight across
+  ForChunks(pool, height, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      float *out = distances_.data() + y * width;
+      for (size_t x = 0; x < width; ++x) {
+        float distance = out[x] >= infinite ? kNoObstacle : std::sqrt(out[x]) * (float)resolution_;
+        if (outside_occupied_) {
+          const size_t edge = std::min(std::min(x, width - 1 - x), std::min(y, height - 1 - y)) + 1;
+          distance = std::min(distance, (float)(edge * resolution_));
+        }
+        out[x] = distance;
+      }
+    }
+  });
+}
+
+bool DistanceField::Empty() const {
+  return distances_.empty();
+}
+
+float DistanceField::Cell(int64_t x,
+                          int64_t y) const {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+    return outside_occupied_ ? 0 : kNoObstacle;
+  }
+  return distances_[(size_t)y * width_ + x];
+}
+
+double DistanceField::Clearance(double x,
+                                double y) const {
+  const int64_t cell_x = (int64_t)std::floor((x - origin_x_) / resolution_);
+  const int64_t cell_y = (int64_t)std::floor((y - origin_y_) / resolution_);
+  const float distance = Cell(cell_x, cell_y);
+  // From anywhere in this cell to anywhere in the occupied one, at worst a whole diagonal closer
+  return distance == 0 ? 0 : distance - resolution_ * M_SQRT2;
+}
@@ -0,0 +1,61 @@
+#ifndef SEPT2023__DISTANCE_FIELD_H_
+#define SEPT2023__DISTANCE_FIELD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "occupancy_grid.h"
+
+struct ThreadPool;
+
+/**
+ * Distance from every cell of an OccupancyGrid to the nearest occupied cell, so a planner can
+ * check a round robot anywhere on the map with one lookup instead of scanning the cells under
+ * it. Same cells as the grid, row major, one float a cell.
+ *
+ * Built with the exact Euclidean distance transform of Felzenszwalb & Huttenlocher: nearest
+ * occupied cell down each column, then the lower envelope of parabolas along each row. Both
+ * passes are linear in the cell count and every column/row is independent, so they are split
+ * over a ThreadPool.
+ */
+struct DistanceField {
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  double resolution_ = 0.05;
+  double origin_x_ = 0;
+  double origin_y_ = 0;
+  bool outside_occupied_ = true;
+  // m between cell centres, kNoObstacle if there is nothing occupied at all
+  std::vector<float> distances_;
+  // OccupancyGrid::version_ when built, rebuild once it changes
+  uint32_t grid_version_ = 0;
+
+  static constexpr float kNoObstacle = 1e30f;
+
+  /**
+   * Reads every cell of grid. Can run on another thread than the one changing the grid, a
+   * change during the build shows up as a new version_ to rebuild for
+   * \param pool spread over its threads, or null to build on the calling thread
+   */
+  void Build(const OccupancyGrid &grid,
+             ThreadPool *pool);
+
+  bool Empty() const;
+
+  /**
+   * \return distance from cell (x, y)'s centre to the nearest occupied cell's centre, outside the
+   *         map 0 or kNoObstacle depending on outside_occupied_
+   */
+  float Cell(int64_t x,
+             int64_t y) const;
+
+  /**
+   * A disc of radius clearance around (x, y) touches no occupied cell. A lower bound from the
+   * nearest cell centre, short by at most a cell
+   * \return m, 0 or less inside an obstacle
+   */
+  double Clearance(double x,
+                   double y) const;
+};
+
+#endif
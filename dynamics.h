@@ -0,0 +1,71 @@
+#ifndef SEPT2023__DYNAMICS_H_
+#define SEPT2023__DYNAMICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Core>
+
+/**
+ * Continuous time models for the integrators in integrators.h. A model has
+ *   using State = <fixed size Eigen vector>;
+ *   State Derivative(const State &state, double t) const;
+ * Inputs (commands) are members of the model and held constant while integrating.
+ * Same conventions as Pose2D: theta is clockwise from the Y axis, angles in radians.
+ */
+
+/**
+ * Pure kinematic unicycle, the robot does exactly what it is commanded.
+ * State is (x, y, theta)
+ */
+struct UnicycleModel {
+  using State = Eigen::Vector3d;
+
+  // m/s and rad/s (positive is clockwise)
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+
+  State Derivative(const State &state,
+                   double t) const {
+    (void)t;
+    return State(linear_velocity_ * std::sin(state[2]),
+                 linear_velocity_ * std::cos(state[2]),
+                 angular_velocity_);
+  }
+};
+
+/**
+ * Unicycle whose actual velocities lag behind the command through first order actuators,
+ * with acceleration limits. There is no closed form solution once the limits kick in.
+ * State is (x, y, theta, v, w)
+ */
+struct LaggedUnicycleModel {
+  using State = Eigen::Matrix<double, 5, 1>;
+
+  // Commanded velocities, m/s and rad/s
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+  // Actuator time constants, seconds
+  double linear_time_constant_ = 0.2;
+  double angular_time_constant_ = 0.1;
+  // m/s^2 and rad/s^2
+  double max_linear_acceleration_ = 2;
+  double max_angular_acceleration_ = 4;
+
+  State Derivative(const State &state,
+                   double t) const {
+    (void)t;
+    const double v = state[3];
+    const double w = state[4];
+    State derivative;
+    derivative[0] = v * std::sin(state[2]);
+    derivative[1] = v * std::cos(state[2]);
+    derivative[2] = w;
+    derivative[3] = std::clamp((linear_velocity_ - v) / linear_time_constant_,
+                               -max_linear_acceleration_, max_linear_acceleration_);
+    derivative[4] = std::clamp((angular_velocity_ - w) / angular_time_constant_,
+                               -max_angular_acceleration_, max_angular_acceleration_);
+    return derivative;
+  }
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "ekf.h"
+#include <cmath>
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+
+Eigen::Vector2d PredictRangeBearing(const PoseVector &pose,
+                                    const Eigen::Vector2d &landmark) {
+  const double dx = landmark[0] - pose[0];
+  const double dy = landmark[1] - pose[1];
+  // atan2(dx, dy) is the angle clockwise from the Y axis, same as theta
+  return Eigen::Vector2d(std::sqrt(dx * dx + dy * dy),
+                         std::remainder(std::atan2(dx, dy) - pose[2], 2 * M_PI));
+}
+
+PoseCovariance OdometryProcessNoise(double theta,
+                                    double linear_velocity,
+                                    double angular_velocity,
+                                    double dt,
+                                    double linear_noise,
+                                    double angular_noise) {
+  // Jacobian of the step with respect to [v, w], using the heading half way through the step
+  const double mid_theta = theta + 0.5 * angular_velocity * dt;
+  const double s = std::sin(mid_theta);
+  const double c = std::cos(mid_theta);
+  const double distance = linear_velocity * dt;
+  Eigen::Matrix<double, 3, 2> jacobian;
+  jacobian << dt * s, 0.5 * distance * dt * c,
+              dt * c, -0.5 * distance * dt * s,
+              0, dt;
+  const Eigen::Vector2d variance(linear_noise * linear_noise, angular_noise * angular_noise);
+  return jacobian * variance.asDiagonal() * jacobian.transpose();
+}
+
+static Pose2D ToPose(const PoseVector &mean) {
+  Pose2D pose;
+  pose.x = mean[0];
+  pose.y = mean[1];
+  pose.theta = mean[2];
+  return pose;
+}
+
+void Ekf::Reset(const Pose2D &pose,
+                const PoseCovariance &covariance) {
+  mean_ = PoseVector(pose.x, pose.y, pose.theta);
+  covariance_ = covariance;
+}
+
+Pose2D Ekf::Pose() const {
+  return ToPose(mean_);
+}
+
+void Ekf::Predict(double linear_velocity,
+                  double angular_velocity,
+                  double dt,
+                  double linear_noise,
+                  double angular_noise) {
+  const PoseCovariance noise = OdometryProcessNoise(mean_[2], linear_velocity, angular_velocity, dt,
+                                                    linear_noise, angular_noise);
+  Pose2D pose = Pose();
+  StepUnicycle(pose, linear_velocity, angular_velocity, dt);
+  // For both the arc and the straight line, d(x')/d(theta) = dy and d(y')/d(theta) = -dx
+  PoseCovariance jacobian = PoseCovariance::Identity();
+  jacobian(0, 2) = pose.y - mean_[1];
+  jacobian(1, 2) = -(pose.x - mean_[0]);
+  mean_ = PoseVector(pose.x, pose.y, WrapAngle(pose.theta));
+  covariance_ = jacobian * covariance_ * jacobian.transpose() + noise;
+}
+
+bool Ekf::Update(const Eigen::Vector2d &innovation,
+                 const Eigen::Matrix<double, 2, 3> &jacobian,
+                 const Eigen::Matrix2d &noise) {
+  const Eigen::Matrix2d innovation_covariance = jacobian * covariance_ * jacobian.transpose() + noise;
+  const Eigen::Matrix2d inverse = innovation_covariance.inverse();
+  if (innovation.dot(inverse * innovation) > gate_) {
+    return false;
+  }
+  const Eigen::Matrix<double, 3, 2> gain = covariance_ * jacobian.transpose() * inverse;
+  mean_ += gain * innovation;
+  mean_[2] = WrapAngle(mean_[2]);
+  const PoseCovariance i_kh = PoseCovariance::Identity() - gain * jacobian;
+  covariance_ = i_kh * covariance_ * i_kh.transpose() + gain * noise * gain.transpose();
+  return true;
+}
+
+bool Ekf::UpdateRangeBearing(const Eigen::Vector2d &measurement,
+                             const Eigen::Vector2d &landmark,
+                             double range_noise,
+                             double bearing_noise) {
+  const double dx = landmark[0] - mean_[0];
+  const double dy = landmark[1] - mean_[1];
+  const double q = dx * dx + dy * dy;
+  if (q < 1e-12) {
+    // Sitting on the landmark, the bearing is meaningless
+    return false;
+  }
+  const double range = std::sqrt(q);
+  Eigen::Matrix<double, 2, 3> jacobian;
+  jacobian << -dx / range, -dy / range, 0,
+              -dy / q, dx / q, -1;
+  Eigen::Vector2d innovation = measurement - PredictRangeBearing(mean_, landmark);
+  innovation[1] = std::remainder(innovation[1], 2 * M_PI);
+  const Eigen::Vector2d variance(range_noise * range_noise, bearing_noise * bearing_noise);
+  return Update(innovation, jacobian, variance.asDiagonal());
+}
+
+bool Ekf::UpdatePosition(const Eigen::Vector2d &measurement,
+                         double noise) {
+  Eigen::Matrix<double, 2, 3> jacobian;
+  jacobian << 1, 0, 0,
+              0, 1, 0;
+  const Eigen::Vector2d innovation = measurement - mean_.head<2>();
+  return Update(innovation, jacobian, Eigen::Matrix2d::Identity() * noise * noise);
+}
+
+void Ukf::Reset(const Pose2D &pose,
+                const PoseCovariance &covariance) {
+  mean_ = PoseVector(pose.x, pose.y, pose.theta);
+  covariance_ = covariance;
+}
+
+Pose2D Ukf::Pose() const {
+  return ToPose(mean_);
+}
+
+void Ukf::Weights(double &mean_weight0,
+                  double &covariance_weight0,
+                  double &weight) const {
+  const double n = 3;
+  const double lambda = alpha_ * alpha_ * (n + kappa_) - n;
+  mean_weight0 = lambda / (n + lambda);
+  covariance_weight0 = mean_weight0 + 1 - alpha_ * alpha_ + beta_;
+  weight = 1 / (2 * (n + lambda));
+}
+
+bool Ukf::SigmaPoints(Eigen::Matrix<double, 3, 7> &points) const {
+  const double n = 3;
+  const double lambda = alpha_ * alpha_ * (n + kappa_) - n;
+  Eigen::LLT<PoseCovariance> cholesky((n + lambda) * covariance_);
+  if (cholesky.info() != Eigen::Success) {
+    return false;
+  }
+  const PoseCovariance root = cholesky.matrixL();
+  points.col(0) = mean_;
+  for (int i = 0; i < 3; ++i) {
+    points.col(1 + i) = mean_ + root.col(i);
+    points.col(4 + i) = mean_ - root.col(i);
+  }
+  return true;
+}
+
+void Ukf::Predict(double linear_velocity,
+                  double angular_velocity,
+                  double dt,
+                  double linear_noise,
+                  double angular_noise) {
+  const PoseCovariance noise = OdometryProcessNoise(mean_[2], linear_velocity, angular_velocity, dt,
+                                                    linear_noise, angular_noise);
+  Eigen::Matrix<double, 3, 7> points;
+  if (!SigmaPoints(points)) {
+    // Lost positive definiteness to round off, fall back to the mean only
+    points.colwise() = mean_;
+  }
+  double mean_weight0, covariance_weight0, weight;
+  Weights(mean_weight0, covariance_weight0, weight);
+
+  PoseVector mean = PoseVector::Zero();
+  double sum_sin = 0;
+  double sum_cos = 0;
+  for (int i = 0; i < 7; ++i) {
+    Pose2D pose = ToPose(points.col(i));
+    StepUnicycle(pose, linear_velocity, angular_velocity, dt);
+    points.col(i) = PoseVector(pose.x, pose.y, pose.theta);
+    const double w = i == 0 ? mean_weight0 : weight;
+    mean[0] += w * pose.x;
+    mean[1] += w * pose.y;
+    sum_sin += w * std::sin(pose.theta);
+    sum_cos += w * std::cos(pose.theta);
+  }
+  mean[2] = WrapAngle(std::atan2(sum_sin, sum_cos));
+
+  PoseCovariance covariance = noise;
+  for (int i = 0; i < 7; ++i) {
+    PoseVector delta = points.col(i) - mean;
+    delta[2] = std::remainder(delta[2], 2 * M_PI);
+    covariance += (i == 0 ? covariance_weight0 : weight) * delta * delta.transpose();
+  }
+  mean_ = mean;
+  covariance_ = covariance;
+}
+
+/**
+ * Unscented update for a 2D measurement. measure(pose) gives the predicted measurement,
+ * angular_element is the index of an element that needs wrapping (-1 for none)
+ */
+template <typename MeasureFunction>
+static bool UnscentedUpdate(Ukf &filter,
+                            const Eigen::Vector2d &measurement,
+                            const Eigen::Matrix2d &noise,
+                            int angular_element,
+                            MeasureFunction measure) {
+  Eigen::Matrix<double, 3, 7> points;
+  if (!filter.SigmaPoints(points)) {
+    return false;
+  }
+  double mean_weight0, covariance_weight0, weight;
+  filter.Weights(mean_weight0, covariance_weight0, weight);
+
+  Eigen::Matrix<double, 2, 7> predicted;
+  Eigen::Vector2d mean = Eigen::Vector2d::Zero();
+  double sum_sin = 0;
+  double sum_cos = 0;
+  for (int i = 0; i < 7; ++i) {
+    predicted.col(i) = measure(PoseVector(points.col(i)));
+    const double w = i == 0 ? mean_weight0 : weight;
+    mean += w * predicted.col(i);
+    if (angular_element >= 0) {
+      sum_sin += w * std::sin(predicted(angular_element, i));
+      sum_cos += w * std::cos(predicted(angular_element, i));
+    }
+  }
+  if (angular_element >= 0) {
+    mean[angular_element] = std::atan2(sum_sin, sum_cos);
+  }
+
+  Eigen::Matrix2d innovation_covariance = noise;
+  Eigen::Matrix<double, 3, 2> cross_covariance = Eigen::Matrix<double, 3, 2>::Zero();
+  for (int i = 0; i < 7; ++i) {
+    Eigen::Vector2d dz = predicted.col(i) - mean;
+    PoseVector dx = points.col(i) - filter.mean_;
+    dx[2] = std::remainder(dx[2], 2 * M_PI);
+    if (angular_element >= 0) {
+      dz[angular_element] = std::remainder(dz[angular_element], 2 * M_PI);
+    }
+    const double w = i == 0 ? covariance_weight0 : weight;
+    innovation_covariance += w * dz * dz.transpose();
+    cross_covariance += w * dx * dz.transpose();
+  }
+
+  Eigen::Vector2d innovation = measurement - mean;
+  if (angular_element >= 0) {
+    innovation[angular_element] = std::remainder(innovation[angular_element], 2 * M_PI);
+  }
+  const Eigen::Matrix2d inverse = innovation_covariance.inverse();
+  if (innovation.dot(inverse * innovation) > filter.gate_) {
+    return false;
+  }
+  const Eigen::Matrix<double, 3, 2> gain = cross_covariance * inverse;
+  filter.mean_ += gain * innovation;
+  filter.mean_[2] = WrapAngle(filter.mean_[2]);
+  filter.covariance_ -= gain * innovation_covariance * gain.transpose();
+  // Keep it exactly symmetric so the Cholesky doesn't drift
+  filter.covariance_ = 0.5 * (filter.covariance_ + filter.covariance_.transpose()).eval();
+  return true;
+}
+
+bool Ukf::UpdateRangeBearing(const Eigen::Vector2d &measurement,
+                             const Eigen::Vector2d &landmark,
+                             double range_noise,
+                             double bearing_noise) {
+  const Eigen::Vector2d variance(range_noise * range_noise, bearing_noise * bearing_noise);
+  return UnscentedUpdate(*this, measurement, variance.asDiagonal(), 1, [&](const PoseVector &pose) {
+    return PredictRangeBearing(pose, landmark);
+  });
+}
+
+bool Ukf::UpdatePosition(const Eigen::Vector2d &measurement,
+                         double noise) {
+  return UnscentedUpdate(*this, measurement, Eigen::Matrix2d::Identity() * noise * noise, -1,
+                         [](const PoseVector &pose) {
+                           return Eigen::Vector2d(pose.head<2>());
+                         });
+}
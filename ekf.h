@@ -0,0 +1,131 @@
+#ifndef SEPT2023__EKF_H_
+#define SEPT2023__EKF_H_
+
+#include <Eigen/Core>
+#include "unicycle.h"
+
+/**
+ * Pose estimators for the unicycle model. The state is [x, y, theta] with the same conventions as
+ * Pose2D (theta clockwise from the Y axis). Everything is fixed size so predict/update never
+ * allocate. Ekf and Ukf have the same interface so they can be swapped.
+ *
+ * Odometry noise is given as the std dev of the measured linear/angular velocity, measurement
+ * noise as the std dev of each measured element.
+ */
+
+using PoseVector = Eigen::Vector3d;
+using PoseCovariance = Eigen::Matrix3d;
+
+/**
+ * Range (m) and bearing (rad) to a landmark at a known position. The bearing is relative to the
+ * robot heading, positive clockwise like theta
+ */
+Eigen::Vector2d PredictRangeBearing(const PoseVector &pose,
+                                    const Eigen::Vector2d &landmark);
+
+/**
+ * Extended Kalman filter. Motion uses the exact arc model (StepUnicycle), whose Jacobian with
+ * respect to theta is just the [dy, -dx] of the step.
+ */
+struct Ekf {
+  PoseVector mean_ = PoseVector::Zero();
+  PoseCovariance covariance_ = PoseCovariance::Identity() * 1e-6;
+  // Measurements with a squared Mahalanobis distance above this are rejected as outliers.
+  // 13.8 is the 99.9% point of chi squared with 2 degrees of freedom
+  double gate_ = 13.8;
+
+  void Reset(const Pose2D &pose,
+             const PoseCovariance &covariance);
+
+  /**
+   * Propagate with measured (noisy) odometry velocities over dt seconds
+   * \param linear_noise std dev of the measured linear velocity, m/s
+   * \param angular_noise std dev of the measured angular velocity, rad/s
+   */
+  void Predict(double linear_velocity,
+               double angular_velocity,
+               double dt,
+               double linear_noise,
+               double angular_noise);
+
+  /**
+   * \param measurement [range, bearing] as in PredictRangeBearing
+   * \param range_noise std dev, m
+   * \param bearing_noise std dev, rad
+   * \return false if the measurement was gated out (the filter is unchanged)
+   */
+  bool UpdateRangeBearing(const Eigen::Vector2d &measurement,
+                          const Eigen::Vector2d &landmark,
+                          double range_noise,
+                          double bearing_noise);
+
+  /**
+   * Direct position fix (GNSS)
+   * \param noise std dev of each axis, m
+   * \return false if the measurement was gated out
+   */
+  bool UpdatePosition(const Eigen::Vector2d &measurement,
+                      double noise);
+
+  Pose2D Pose() const;
+
+  /**
+   * Kalman update shared by the measurement types, Joseph form so the covariance stays symmetric
+   * positive definite. innovation is measurement - prediction (angles already wrapped)
+   */
+  bool Update(const Eigen::Vector2d &innovation,
+              const Eigen::Matrix<double, 2, 3> &jacobian,
+              const Eigen::Matrix2d &noise);
+};
+
+/**
+ * Unscented Kalman filter, 7 sigma points through the same motion/measurement models. No
+ * Jacobians, handles the nonlinearity of big heading uncertainty better than the Ekf, about 3x
+ * the cost. Angles are averaged on the circle.
+ */
+struct Ukf {
+  PoseVector mean_ = PoseVector::Zero();
+  PoseCovariance covariance_ = PoseCovariance::Identity() * 1e-6;
+  double gate_ = 13.8;
+  // Sigma point spread, see Wan & van der Merwe. With alpha 1 and kappa 0 the centre point has
+  // no weight in the mean, which keeps every weight positive
+  double alpha_ = 1;
+  double beta_ = 2;
+  double kappa_ = 0;
+
+  void Reset(const Pose2D &pose,
+             const PoseCovariance &covariance);
+  void Predict(double linear_velocity,
+               double angular_velocity,
+               double dt,
+               double linear_noise,
+               double angular_noise);
+  bool UpdateRangeBearing(const Eigen::Vector2d &measurement,
+                          const Eigen::Vector2d &landmark,
+                          double range_noise,
+                          double bearing_noise);
+  bool UpdatePosition(const Eigen::Vector2d &measurement,
+                      double noise);
+  Pose2D Pose() const;
+
+  /**
+   * \param points return variable, 2n+1 sigma points of the current mean/covariance
+   * \return false if the covariance isn't positive definite
+   */
+  bool SigmaPoints(Eigen::Matrix<double, 3, 7> &points) const;
+  void Weights(double &mean_weight0,
+               double &covariance_weight0,
+               double &weight) const;
+};
+
+/**
+ * Process noise of one step in state space: the velocity noise mapped through the motion model
+ */
+PoseCovariance OdometryProcessNoise(double theta,
+                                    double linear_velocity,
+                                    double angular_velocity,
+                                    double dt,
+                                    double linear_noise,
+                                    double angular_noise);
+
+#endif
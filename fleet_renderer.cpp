@@ -0,0 +1,261 @@
+#include "fleet_renderer.h"
+#include "robot_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "shader_library.h"
+
+const char *FleetLodName(FleetLod lod) {
+  switch (lod) {
+    case FleetLod::kBoxes:
+      return "boxes";
+    case FleetLod::kPoints:
+      return "points";
+    case FleetLod::kDensity:
+      return "density";
+  }
+  return "unknown";
+}
+
+bool FleetRenderer::Init() {
+  shader_ = GetShaderLibrary().Load("simple_shader.vs", "simple_shader.fs");
+  if (shader_ == nullptr) {
+    return false;
+  }
+  // Without these everything is drawn as boxes, however far out
+  point_shader_ = GetShaderLibrary().Load("fleet_point_shader.vs", "simple_shader.fs");
+  density_shader_ = GetShaderLibrary().Load("fleet_point_shader.vs", "density_shader.fs");
+  heatmap_shader_ = GetShaderLibrary().Load("heatmap_shader.vs", "heatmap_shader.fs");
+  LookUpUniforms();
+
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glGenBuffers(1, &ebo_);
+  glGenBuffers(1, &instance_vbo_);
+  glBindVertexArray(vao_);
+  UploadRobotMesh(vbo_, ebo_);
+
+  // Per instance attributes, advance once per robot instead of once per vertex
+  glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+  glVertexAttribPointer(kRobotAttributePose, 3, GL_FLOAT, GL_FALSE, sizeof(RobotInstance),
+                        (void*)offsetof(RobotInstance, pose));
+  glVertexAttribPointer(kRobotAttributeSize, 2, GL_FLOAT, GL_FALSE, sizeof(RobotInstance),
+                        (void*)offsetof(RobotInstance, size));
+  glVertexAttribPointer(kRobotAttributeColor, 4, GL_FLOAT, GL_FALSE, sizeof(RobotInstance),
+                        (void*)offsetof(RobotInstance, color));
+  const RobotAttribute instance_attributes[] = {kRobotAttributePose, kRobotAttributeSize, kRobotAttributeColor};
+  for (RobotAttribute attribute : instance_attributes) {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+
+  // Same instance buffer, one GL_POINTS vertex per robot
+  glGenVertexArrays(1, &point_vao_);
+  glBindVertexArray(point_vao_);
+  glVertexAttribPointer(kRobotAttributePose, 3, GL_FLOAT, GL_FALSE, sizeof(RobotInstance),
+                        (void*)offsetof(RobotInstance, pose));
+  glVertexAttribPointer(kRobotAttributeColor, 4, GL_FLOAT, GL_FALSE, sizeof(RobotInstance),
+                        (void*)offsetof(RobotInstance, color));
+  glEnableVertexAttribArray(kRobotAttributePose);
+  glEnableVertexAttribArray(kRobotAttributeColor);
+  glGenVertexArrays(1, &heatmap_vao_);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void FleetRenderer::Update(const FleetState &fleet,
+                           float width,
+                           float length,
+                           const glm::vec4 &color) {
+  Update(fleet, fleet, 1.0, width, length, color);
+}
+
+void FleetRenderer::Update(const FleetState &previous,
+                           const FleetState &fleet,
+                           double alpha,
+                           float width,
+                           float length,
+                           const glm::vec4 &color) {
+  // Robots were added/removed in between, nothing to interpolate against
+  const FleetState &from = previous.Size() == fleet.Size() ? previous : fleet;
+  instance_count_ = fleet.Size();
+  if (instance_count_ == 0) {
+    return;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+  if (instance_count_ > instance_capacity_) {
+    // Grow by 1.5x so a slowly growing fleet doesn't reallocate every frame
+    instance_capacity_ = instance_count_ + instance_count_ / 2;
+  }
+  // Orphan the old storage, any draw still reading it keeps its own copy
+  glBufferData(GL_ARRAY_BUFFER, instance_capacity_ * sizeof(RobotInstance), nullptr, GL_STREAM_DRAW);
+  auto *instances = static_cast<RobotInstance*>(
+      glMapBufferRange(GL_ARRAY_BUFFER, 0, instance_count_ * sizeof(RobotInstance),
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+  if (instances == nullptr) {
+    std::cout << "ERROR (FleetRenderer): Failed to map instance buffer" << std::endl;
+    instance_count_ = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  // Write straight from the structure of arrays into the mapped buffer, no staging copy
+  for (size_t i = 0; i < instance_count_; ++i) {
+    RobotInstance &instance = instances[i];
+    // Theta goes the short way around, it wraps at 2pi
+    double dtheta = fleet.theta_[i] - from.theta_[i];
+    if (dtheta > M_PI) {
+      dtheta -= 2 * M_PI;
+    }
+    else if (dtheta < -M_PI) {
+      dtheta += 2 * M_PI;
+    }
+    instance.pose[0] = (float)(from.x_[i] + alpha * (fleet.x_[i] - from.x_[i]));
+    instance.pose[1] = (float)(from.y_[i] + alpha * (fleet.y_[i] - from.y_[i]));
+    instance.pose[2] = (float)(from.theta_[i] + alpha * dtheta);
+    instance.size[0] = width;
+    instance.size[1] = length;
+    instance.color[0] = color[0];
+    instance.color[1] = color[1];
+    instance.color[2] = color[2];
+    instance.color[3] = color[3];
+  }
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void FleetRenderer::SelectLod(float meters_per_pixel,
+                              float length) {
+  robot_pixels_ = meters_per_pixel > 0 ? length / meters_per_pixel : box_min_pixels_;
+  if (robot_pixels_ >= box_min_pixels_) {
+    lod_ = FleetLod::kBoxes;
+  }
+  else if (robot_pixels_ >= point_min_pixels_) {
+    lod_ = FleetLod::kPoints;
+  }
+  else {
+    lod_ = FleetLod::kDensity;
+  }
+}
+
+void FleetRenderer::Draw() {
+  if (instance_count_ == 0 || shader_ == nullptr) {
+    return;
+  }
+  if ((point_shader_ != nullptr && point_shader_->generation_ != point_generation_) ||
+      (density_shader_ != nullptr && density_shader_->generation_ != density_generation_) ||
+      (heatmap_shader_ != nullptr && heatmap_shader_->generation_ != heatmap_generation_)) {
+    LookUpUniforms();
+  }
+  if (lod_ == FleetLod::kDensity && density_shader_ != nullptr && heatmap_shader_ != nullptr) {
+    DrawDensity();
+    return;
+  }
+  if (lod_ != FleetLod::kBoxes && point_shader_ != nullptr) {
+    point_shader_->Use();
+    point_shader_->SetFloat(point_size_uniform_, std::max(1.0f, robot_pixels_));
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(point_vao_);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)instance_count_);
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    return;
+  }
+  shader_->Use();
+  glBindVertexArray(vao_);
+  glDrawElementsInstanced(GL_TRIANGLES, kRobotMeshIndexCount, GL_UNSIGNED_SHORT, (void*)0,
+                          (GLsizei)instance_count_);
+  glBindVertexArray(0);
+}
+
+void FleetRenderer::LookUpUniforms() {
+  if (point_shader_ != nullptr) {
+    point_size_uniform_ = point_shader_->GetUniform("pointSize");
+    point_generation_ = point_shader_->generation_;
+  }
+  if (density_shader_ != nullptr) {
+    density_point_size_uniform_ = density_shader_->GetUniform("pointSize");
+    density_generation_ = density_shader_->generation_;
+  }
+  if (heatmap_shader_ != nullptr) {
+    density_uniform_ = heatmap_shader_->GetUniform("density");
+    max_density_uniform_ = heatmap_shader_->GetUniform("maxDensity");
+    heatmap_generation_ = heatmap_shader_->generation_;
+  }
+}
+
+void FleetRenderer::DrawDensity() {
+  // Whatever the scene is being drawn into, to go back to after the density pass
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+  const int width = std::max(1, viewport[2] / density_downsample_);
+  const int height = std::max(1, viewport[3] / density_downsample_);
+  if (!ResizeDensity(width, height)) {
+    // Points from now on
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    density_shader_ = nullptr;
+    return;
+  }
+
+  // Count: every robot adds 1 to its pixel. Same camera, so the texture lines up with the viewport
+  glBindFramebuffer(GL_FRAMEBUFFER, density_fbo_);
+  glViewport(0, 0, width, height);
+  const float zero[4] = {0, 0, 0, 0};
+  glClearBufferfv(GL_COLOR, 0, zero);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  density_shader_->Use();
+  density_shader_->SetFloat(density_point_size_uniform_, 1.0f);
+  glBindVertexArray(point_vao_);
+  glDrawArrays(GL_POINTS, 0, (GLsizei)instance_count_);
+
+  // Heatmap over the scene
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  heatmap_shader_->Use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, density_texture_);
+  heatmap_shader_->SetInt(density_uniform_, 0);
+  heatmap_shader_->SetFloat(max_density_uniform_, max_density_);
+  glBindVertexArray(heatmap_vao_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDisable(GL_BLEND);
+}
+
+bool FleetRenderer::ResizeDensity(int width,
+                                  int height) {
+  if (density_fbo_ != 0 && width == density_width_ && height == density_height_) {
+    return true;
+  }
+  if (density_texture_ == 0) {
+    glGenTextures(1, &density_texture_);
+  }
+  glBindTexture(GL_TEXTURE_2D, density_texture_);
+  // Float so counts don't saturate, blending into GL_R32F is core in GL 3.3
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (density_fbo_ == 0) {
+    glGenFramebuffers(1, &density_fbo_);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, density_fbo_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, density_texture_, 0);
+  const uint32_t status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    printf("ERROR (FleetRenderer): Density framebuffer incomplete (0x%x), drawing points instead\n", status);
+    return false;
+  }
+  density_width_ = width;
+  density_height_ = height;
+  return true;
+}
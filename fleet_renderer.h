@@ -0,0 +1,137 @@
+#ifndef SEPT2023__FLEET_RENDERER_H_
+#define SEPT2023__FLEET_RENDERER_H_
+
+#include <cstddef>
+#include "fleet_state.h"
+#include "shader.h"
+
+/**
+ * Per robot data streamed to the GPU every frame, matches the per instance attributes
+ * in shaders/simple_shader.vs
+ */
+struct RobotInstance {
+  float pose[3];
+  float size[2];
+  float color[4];
+};
+
+/**
+ * How the fleet is drawn, picked from how big a robot is on screen
+ */
+enum class FleetLod {
+  // Instanced boxes, the real footprint
+  kBoxes,
+  // One point sprite per robot, a few pixels across
+  kPoints,
+  // Robots are under a pixel: counted per pixel on the GPU and drawn as a heatmap
+  kDensity
+};
+
+const char *FleetLodName(FleetLod lod);
+
+/**
+ * Draws every robot in a FleetState with a single draw call. All robots share the indexed cube
+ * mesh, the only per robot data is a RobotInstance. Zoomed out the same instance buffer is drawn
+ * as points instead, and once robots are smaller than a pixel as a density heatmap.
+ */
+struct FleetRenderer {
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
+  Shader *point_shader_ = nullptr;
+  Shader *density_shader_ = nullptr;
+  Shader *heatmap_shader_ = nullptr;
+  // Program generations the uniform handles were looked up in, a hot reload invalidates them
+  uint32_t point_generation_ = 0;
+  uint32_t density_generation_ = 0;
+  uint32_t heatmap_generation_ = 0;
+  UniformHandle point_size_uniform_;
+  UniformHandle density_point_size_uniform_;
+  UniformHandle density_uniform_;
+  UniformHandle max_density_uniform_;
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  uint32_t ebo_ = 0;
+  uint32_t instance_vbo_ = 0;
+  // Number of RobotInstance the instance buffer can hold before it needs to grow
+  size_t instance_capacity_ = 0;
+  size_t instance_count_ = 0;
+
+  // The instance buffer read per vertex for kPoints/kDensity
+  uint32_t point_vao_ = 0;
+  // Nothing bound, the heatmap triangle comes from gl_VertexID
+  uint32_t heatmap_vao_ = 0;
+  // Robots per pixel, GL_R32F at 1 / density_downsample_ of the viewport
+  uint32_t density_fbo_ = 0;
+  uint32_t density_texture_ = 0;
+  int density_width_ = 0;
+  int density_height_ = 0;
+  int density_downsample_ = 2;
+  // Robots in one density pixel for the hottest colour
+  float max_density_ = 16;
+
+  // Robots at least box_min_pixels_ long on screen are boxes, at least point_min_pixels_ points
+  // and anything smaller goes in the heatmap
+  float box_min_pixels_ = 4;
+  float point_min_pixels_ = 0.75f;
+  FleetLod lod_ = FleetLod::kBoxes;
+  // Robot length on screen at the last SelectLod, sizes the points
+  float robot_pixels_ = 0;
+
+  /**
+   * \return false if the shader failed to load
+   */
+  bool Init();
+
+  /**
+   * Stream the fleet poses into the instance buffer. The buffer is orphaned each call so the
+   * driver can hand us fresh memory instead of waiting for last frame's draw to finish.
+   * \param width robot width (m), same for the whole fleet
+   * \param length robot length (m), same for the whole fleet
+   */
+  void Update(const FleetState &fleet,
+              float width,
+              float length,
+              const glm::vec4 &color);
+
+  /**
+   * Same as above but draws each robot in between its pose in previous and fleet
+   * \param alpha 0 for the previous poses, 1 for the current poses
+   */
+  void Update(const FleetState &previous,
+              const FleetState &fleet,
+              double alpha,
+              float width,
+              float length,
+              const glm::vec4 &color);
+
+  /**
+   * Pick lod_ for robots of length (m) seen at meters_per_pixel, see Camera::MetersPerPixel
+   */
+  void SelectLod(float meters_per_pixel,
+                 float length);
+
+  /**
+   * Draw everything from the last Update at lod_, the camera comes from the FrameUniformBuffer
+   */
+  void Draw();
+
+  /**
+   * Find the uniforms in the current version of each shader
+   */
+  void LookUpUniforms();
+
+  /**
+   * Count the robots into the density texture, then draw it over the viewport as a heatmap
+   */
+  void DrawDensity();
+
+  /**
+   * (Re)make the density texture and framebuffer at width x height if they aren't already, leaves
+   * the density framebuffer bound if it had to
+   * \return false if the driver can't render to a float texture
+   */
+  bool ResizeDensity(int width,
+                     int height);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "fleet_state.h"
+#include <cmath>
+#include <random>
+
+size_t FleetState::Size() const {
+  return x_.size();
+}
+
+void FleetState::Resize(size_t count) {
+  x_.resize(count, 0);
+  y_.resize(count, 0);
+  theta_.resize(count, 0);
+  v_.resize(count, 0);
+  w_.resize(count, 0);
+}
+
+void FleetState::Clear() {
+  Resize(0);
+}
+
+size_t FleetState::Add(const Pose2D &pose,
+                       double linear_velocity,
+                       double angular_velocity) {
+  x_.push_back(pose.x);
+  y_.push_back(pose.y);
+  theta_.push_back(pose.theta);
+  v_.push_back(linear_velocity);
+  w_.push_back(angular_velocity);
+  return x_.size() - 1;
+}
+
+Pose2D FleetState::GetPose(size_t index) const {
+  Pose2D pose;
+  pose.x = x_[index];
+  pose.y = y_[index];
+  pose.theta = theta_[index];
+  return pose;
+}
+
+void FleetState::SetPose(size_t index,
+                         const Pose2D &pose) {
+  x_[index] = pose.x;
+  y_[index] = pose.y;
+  theta_[index] = pose.theta;
+}
+
+void SpawnRandomFleet(FleetState &fleet,
+                      size_t count,
+                      uint32_t seed) {
+  fleet.Clear();
+  const double half_extent = std::sqrt((double)count);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> position(-half_extent, half_extent);
+  std::uniform_real_distribution<double> heading(0, 2 * M_PI);
+  std::uniform_real_distribution<double> linear(0, 1);
+  std::uniform_real_distribution<double> angular(-30 * M_PI / 180, 30 * M_PI / 180);
+  for (size_t i = 0; i < count; ++i) {
+    Pose2D pose;
+    pose.x = position(rng);
+    pose.y = position(rng);
+    pose.theta = heading(rng);
+    fleet.Add(pose, linear(rng), angular(rng));
+  }
+}
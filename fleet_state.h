@@ -0,0 +1,51 @@
+#ifndef SEPT2023__FLEET_STATE_H_
+#define SEPT2023__FLEET_STATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "unicycle.h"
+
+/**
+ * State of many robots stored as a structure of arrays, so the step kernels can stream
+ * through contiguous memory and load several robots into one SIMD register.
+ * Robot i is made up of element i of every array, all arrays always have the same size.
+ */
+struct FleetState {
+  // Pose, theta follows the same convention as Pose2D
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> theta_;
+  // Commanded velocities, m/s and rad/s
+  std::vector<double> v_;
+  std::vector<double> w_;
+
+  size_t Size() const;
+
+  /**
+   * Grow/shrink the fleet, new robots are at the origin with zero velocity
+   */
+  void Resize(size_t count);
+
+  void Clear();
+
+  /**
+   * \return the index of the new robot
+   */
+  size_t Add(const Pose2D &pose,
+             double linear_velocity,
+             double angular_velocity);
+
+  Pose2D GetPose(size_t index) const;
+  void SetPose(size_t index, const Pose2D &pose);
+};
+
+/**
+ * Replace the fleet with count robots at random poses with random commands. The area they
+ * are spread over grows with the count so the density stays about the same.
+ */
+void SpawnRandomFleet(FleetState &fleet,
+                      size_t count,
+                      uint32_t seed);
+
+#endif
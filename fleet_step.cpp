@@ -0,0 +1,96 @@
+#include "fleet_step.h"
+#include "fleet_step_kernels.h"
+
+void StepFleetScalar(const FleetSpan &span,
+                     size_t begin,
+                     size_t end,
+                     double dt) {
+  for (size_t i = begin; i < end; ++i) {
+    Pose2D pose;
+    pose.x = span.x[i];
+    pose.y = span.y[i];
+    pose.theta = span.theta[i];
+    StepUnicycle(pose, span.v[i], span.w[i], dt);
+    span.x[i] = pose.x;
+    span.y[i] = pose.y;
+    span.theta[i] = WrapAngle(pose.theta);
+  }
+}
+
+static FleetKernel DetectFleetKernel() {
+#if defined(SEPT2023_X86_KERNELS) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return FleetKernel::kAvx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return FleetKernel::kSse2;
+  }
+#elif defined(SEPT2023_X86_KERNELS)
+  // SSE2 is part of the x86-64 baseline
+  return FleetKernel::kSse2;
+#endif
+  return FleetKernel::kScalar;
+}
+
+FleetKernel BestFleetKernel() {
+  static const FleetKernel best = DetectFleetKernel();
+  return best;
+}
+
+bool FleetKernelSupported(FleetKernel kernel) {
+  // The kernels are ordered from least to most capable
+  return static_cast<int>(kernel) <= static_cast<int>(BestFleetKernel());
+}
+
+const char *FleetKernelName(FleetKernel kernel) {
+  switch (kernel) {
+    case FleetKernel::kScalar:
+      return "scalar";
+    case FleetKernel::kSse2:
+      return "sse2";
+    case FleetKernel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+void StepFleet(FleetState &fleet,
+               double dt) {
+  StepFleetRange(fleet, 0, fleet.Size(), dt, BestFleetKernel());
+}
+
+void StepFleet(FleetState &fleet,
+               double dt,
+               FleetKernel kernel) {
+  StepFleetRange(fleet, 0, fleet.Size(), dt, kernel);
+}
+
+void StepFleetRange(FleetState &fleet,
+                    size_t begin,
+                    size_t end,
+                    double dt,
+                    FleetKernel kernel) {
+  FleetSpan span;
+  span.x = fleet.x_.data();
+  span.y = fleet.y_.data();
+  span.theta = fleet.theta_.data();
+  span.v = fleet.v_.data();
+  span.w = fleet.w_.data();
+  if (!FleetKernelSupported(kernel)) {
+    kernel = FleetKernel::kScalar;
+  }
+  switch (kernel) {
+#if defined(SEPT2023_X86_KERNELS)
+    case FleetKernel::kAvx2:
+      StepFleetAvx2(span, begin, end, dt);
+      return;
+    case FleetKernel::kSse2:
+      StepFleetSse2(span, begin, end, dt);
+      return;
+#endif
+    default:
+      StepFleetScalar(span, begin, end, dt);
+      return;
+  }
+}
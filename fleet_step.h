@@ -0,0 +1,52 @@
+#ifndef SEPT2023__FLEET_STEP_H_
+#define SEPT2023__FLEET_STEP_H_
+
+#include <cstddef>
+#include "fleet_state.h"
+
+/**
+ * The different implementations of the fleet step. They all integrate the same unicycle
+ * model as StepUnicycle, the SIMD ones use their own sin/cos so results can differ from
+ * the scalar kernel in the last few bits.
+ */
+enum class FleetKernel {
+  kScalar,
+  kSse2,
+  kAvx2
+};
+
+/**
+ * \return the fastest kernel this CPU (and build) supports, checked once at runtime
+ */
+FleetKernel BestFleetKernel();
+
+bool FleetKernelSupported(FleetKernel kernel);
+
+const char *FleetKernelName(FleetKernel kernel);
+
+/**
+ * Step every robot in the fleet by dt seconds using the best kernel for this CPU.
+ * Theta is kept between [0, 2pi), this assumes each robot turns less than a full
+ * revolution per step (|w * dt| < 2pi).
+ */
+void StepFleet(FleetState &fleet,
+               double dt);
+
+/**
+ * Same as above but with a specific kernel, falls back to the scalar kernel if the
+ * requested one is not supported
+ */
+void StepFleet(FleetState &fleet,
+               double dt,
+               FleetKernel kernel);
+
+/**
+ * Step robots [begin, end) only, so a fleet can be split up across threads
+ */
+void StepFleetRange(FleetState &fleet,
+                    size_t begin,
+                    size_t end,
+                    double dt,
+                    FleetKernel kernel);
+
+#endif
@@ -0,0 +1,75 @@
+#include <immintrin.h>
+#include <cmath>
+#include "fleet_step_kernels.h"
+#include "simd_math_avx2.h"
+#include "unicycle.h"
+
+/* This file is compiled with -mavx2, nothing in here may run unless the CPU supports it */
+
+void StepFleetAvx2(const FleetSpan &span,
+                   size_t begin,
+                   size_t end,
+                   double dt) {
+  const __m256d dt_v = _mm256_set1_pd(dt);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d quarter_pi = _mm256_set1_pd(M_PI / 4);
+  const __m256d two_pi = _mm256_set1_pd(2 * M_PI);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d straight_threshold = _mm256_set1_pd(kStraightLineThreshold);
+  const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256d x = _mm256_loadu_pd(span.x + i);
+    __m256d y = _mm256_loadu_pd(span.y + i);
+    __m256d theta = _mm256_loadu_pd(span.theta + i);
+    __m256d d = _mm256_mul_pd(_mm256_loadu_pd(span.v + i), dt_v);
+    __m256d w = _mm256_mul_pd(_mm256_loadu_pd(span.w + i), dt_v);
+
+    /*
+     * The arc update is
+     *   y += (d / w) * (sin(theta + w) - sin(theta))
+     *   x -= (d / w) * (cos(theta + w) - cos(theta))
+     * expanding sin/cos(theta + w) this becomes
+     *   x += d * (sin(theta) * a + cos(theta) * b)
+     *   y += d * (cos(theta) * a - sin(theta) * b)
+     * with a = sin(w) / w and b = (1 - cos(w)) / w. For |w| <= pi/4 (every sane time step) we get
+     * a and b straight from the polynomials with no division, larger heading changes fall back to
+     * the division. Below kStraightLineThreshold we blend in the straight line case (a = 1, b = 0 and
+     * no heading change) so the results match StepUnicycle.
+     */
+    __m256d z = _mm256_mul_pd(w, w);
+    __m256d a = _mm256_add_pd(one, _mm256_mul_pd(z, Polynomial(z, kSinCoefficients)));
+    __m256d b = _mm256_mul_pd(w, _mm256_sub_pd(half, _mm256_mul_pd(z, Polynomial(z, kCosCoefficients))));
+    __m256d large = _mm256_cmp_pd(_mm256_and_pd(w, abs_mask), quarter_pi, _CMP_GT_OQ);
+    if (_mm256_movemask_pd(large)) {
+      __m256d sin_w, cos_w;
+      SinCos(w, sin_w, cos_w);
+      __m256d safe_w = _mm256_blendv_pd(one, w, large);
+      a = _mm256_blendv_pd(a, _mm256_div_pd(sin_w, safe_w), large);
+      b = _mm256_blendv_pd(b, _mm256_div_pd(_mm256_sub_pd(one, cos_w), safe_w), large);
+    }
+    __m256d straight = _mm256_cmp_pd(_mm256_and_pd(w, abs_mask), straight_threshold, _CMP_LT_OQ);
+    a = _mm256_blendv_pd(a, one, straight);
+    b = _mm256_andnot_pd(straight, b);
+    w = _mm256_andnot_pd(straight, w);
+
+    __m256d sin_theta, cos_theta;
+    SinCos(theta, sin_theta, cos_theta);
+    x = _mm256_add_pd(x, _mm256_mul_pd(d, _mm256_add_pd(_mm256_mul_pd(sin_theta, a),
+                                                        _mm256_mul_pd(cos_theta, b))));
+    y = _mm256_add_pd(y, _mm256_mul_pd(d, _mm256_sub_pd(_mm256_mul_pd(cos_theta, a),
+                                                        _mm256_mul_pd(sin_theta, b))));
+
+    // Keep theta between [0, 2pi)
+    theta = _mm256_add_pd(theta, w);
+    theta = _mm256_sub_pd(theta, _mm256_and_pd(_mm256_cmp_pd(theta, two_pi, _CMP_GE_OQ), two_pi));
+    theta = _mm256_add_pd(theta, _mm256_and_pd(_mm256_cmp_pd(theta, zero, _CMP_LT_OQ), two_pi));
+
+    _mm256_storeu_pd(span.x + i, x);
+    _mm256_storeu_pd(span.y + i, y);
+    _mm256_storeu_pd(span.theta + i, theta);
+  }
+  StepFleetScalar(span, i, end, dt);
+}
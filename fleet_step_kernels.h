@@ -0,0 +1,33 @@
+#ifndef SEPT2023__FLEET_STEP_KERNELS_H_
+#define SEPT2023__FLEET_STEP_KERNELS_H_
+
+#include <cstddef>
+
+/**
+ * Internal to the fleet step, shared between fleet_step.cpp and the SIMD translation units
+ * which are compiled with different instruction set flags.
+ */
+struct FleetSpan {
+  double *x;
+  double *y;
+  double *theta;
+  const double *v;
+  const double *w;
+};
+
+void StepFleetScalar(const FleetSpan &span,
+                     size_t begin,
+                     size_t end,
+                     double dt);
+
+// Only built on x86, and must only be called if the CPU supports the instruction set
+void StepFleetSse2(const FleetSpan &span,
+                   size_t begin,
+                   size_t end,
+                   double dt);
+void StepFleetAvx2(const FleetSpan &span,
+                   size_t begin,
+                   size_t end,
+                   double dt);
+
+#endif
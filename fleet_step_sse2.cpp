@@ -0,0 +1,108 @@
+#include <emmintrin.h>
+#include <cmath>
+#include "fleet_step_kernels.h"
+#include "simd_math.h"
+#include "unicycle.h"
+
+/*
+ * Same algorithm as fleet_step_avx2.cpp (see the comments there), two robots at a time.
+ * SSE2 has no blendv or 64 bit compares so those are done with and/andnot/or.
+ */
+
+static inline __m128d Polynomial(__m128d z,
+                                 const double *coefficients) {
+  __m128d result = _mm_set1_pd(coefficients[0]);
+  for (int i = 1; i < 6; ++i) {
+    result = _mm_add_pd(_mm_mul_pd(result, z), _mm_set1_pd(coefficients[i]));
+  }
+  return result;
+}
+
+static inline __m128d Select(__m128d mask,
+                             __m128d if_true,
+                             __m128d if_false) {
+  return _mm_or_pd(_mm_and_pd(mask, if_true), _mm_andnot_pd(mask, if_false));
+}
+
+static inline void SinCos(__m128d x,
+                          __m128d &sin_out,
+                          __m128d &cos_out) {
+  const __m128d magic = _mm_set1_pd(kRoundMagic);
+  __m128d t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(kTwoOverPi)), magic);
+  __m128d k = _mm_sub_pd(t, magic);
+  __m128i quadrant = _mm_castpd_si128(t);
+
+  __m128d r = _mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(kPiOver2Hi)));
+  r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(kPiOver2Mid)));
+  r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(kPiOver2Lo)));
+  __m128d z = _mm_mul_pd(r, r);
+
+  __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), Polynomial(z, kSinCoefficients)));
+  __m128d c = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, _mm_set1_pd(0.5)));
+  c = _mm_add_pd(c, _mm_mul_pd(_mm_mul_pd(z, z), Polynomial(z, kCosCoefficients)));
+
+  // 0 - (k & 1) is all ones for odd quadrants, which is our swap mask
+  const __m128i one = _mm_set1_epi64x(1);
+  const __m128i two = _mm_set1_epi64x(2);
+  __m128d swap = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(quadrant, one)));
+  __m128d sin_value = Select(swap, c, s);
+  __m128d cos_value = Select(swap, s, c);
+
+  __m128i sin_sign = _mm_slli_epi64(_mm_and_si128(quadrant, two), 62);
+  __m128i cos_sign = _mm_slli_epi64(_mm_and_si128(_mm_add_epi64(quadrant, one), two), 62);
+  sin_out = _mm_xor_pd(sin_value, _mm_castsi128_pd(sin_sign));
+  cos_out = _mm_xor_pd(cos_value, _mm_castsi128_pd(cos_sign));
+}
+
+void StepFleetSse2(const FleetSpan &span,
+                   size_t begin,
+                   size_t end,
+                   double dt) {
+  const __m128d dt_v = _mm_set1_pd(dt);
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128d quarter_pi = _mm_set1_pd(M_PI / 4);
+  const __m128d two_pi = _mm_set1_pd(2 * M_PI);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d straight_threshold = _mm_set1_pd(kStraightLineThreshold);
+  const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+
+  size_t i = begin;
+  for (; i + 2 <= end; i += 2) {
+    __m128d x = _mm_loadu_pd(span.x + i);
+    __m128d y = _mm_loadu_pd(span.y + i);
+    __m128d theta = _mm_loadu_pd(span.theta + i);
+    __m128d d = _mm_mul_pd(_mm_loadu_pd(span.v + i), dt_v);
+    __m128d w = _mm_mul_pd(_mm_loadu_pd(span.w + i), dt_v);
+
+    __m128d z = _mm_mul_pd(w, w);
+    __m128d a = _mm_add_pd(one, _mm_mul_pd(z, Polynomial(z, kSinCoefficients)));
+    __m128d b = _mm_mul_pd(w, _mm_sub_pd(half, _mm_mul_pd(z, Polynomial(z, kCosCoefficients))));
+    __m128d large = _mm_cmpgt_pd(_mm_and_pd(w, abs_mask), quarter_pi);
+    if (_mm_movemask_pd(large)) {
+      __m128d sin_w, cos_w;
+      SinCos(w, sin_w, cos_w);
+      __m128d safe_w = Select(large, w, one);
+      a = Select(large, _mm_div_pd(sin_w, safe_w), a);
+      b = Select(large, _mm_div_pd(_mm_sub_pd(one, cos_w), safe_w), b);
+    }
+    __m128d straight = _mm_cmplt_pd(_mm_and_pd(w, abs_mask), straight_threshold);
+    a = Select(straight, one, a);
+    b = _mm_andnot_pd(straight, b);
+    w = _mm_andnot_pd(straight, w);
+
+    __m128d sin_theta, cos_theta;
+    SinCos(theta, sin_theta, cos_theta);
+    x = _mm_add_pd(x, _mm_mul_pd(d, _mm_add_pd(_mm_mul_pd(sin_theta, a), _mm_mul_pd(cos_theta, b))));
+    y = _mm_add_pd(y, _mm_mul_pd(d, _mm_sub_pd(_mm_mul_pd(cos_theta, a), _mm_mul_pd(sin_theta, b))));
+
+    theta = _mm_add_pd(theta, w);
+    theta = _mm_sub_pd(theta, _mm_and_pd(_mm_cmpge_pd(theta, two_pi), two_pi));
+    theta = _mm_add_pd(theta, _mm_and_pd(_mm_cmplt_pd(theta, zero), two_pi));
+
+    _mm_storeu_pd(span.x + i, x);
+    _mm_storeu_pd(span.y + i, y);
+    _mm_storeu_pd(span.theta + i, theta);
+  }
+  StepFleetScalar(span, i, end, dt);
+}
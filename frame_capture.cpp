@@ -0,0 +1,132 @@
+#include "frame_capture.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <glad/glad.h>
+
+bool FrameCapture::Open(const std::string &path,
+                        int width,
+                        int height,
+                        double fps) {
+  Close();
+  if (!writer_.Open(path, width, height, fps)) {
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  next_ = 0;
+  next_index_ = 0;
+  captured_ = 0;
+  dropped_ = 0;
+  gpu_waits_ = 0;
+  writer_waits_ = 0;
+  capture_nanoseconds_ = 0;
+  glGenBuffers(kPboCount, pbos_);
+  for (uint32_t pbo : pbos_) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    // Read by the CPU, written by GL
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
+
+bool FrameCapture::IsOpen() const {
+  return writer_.IsOpen();
+}
+
+void FrameCapture::Capture(uint32_t framebuffer) {
+  if (!IsOpen()) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  // Every buffer is in flight, the oldest has to be read before it is reused
+  if (fences_[next_] != nullptr) {
+    ++gpu_waits_;
+    Collect(next_, true);
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[next_]);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // With a pack buffer bound the pointer is an offset into it, and this returns straight away
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  fences_[next_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  frame_indices_[next_] = next_index_++;
+  next_ = (next_ + 1) % kPboCount;
+  // Pass on whatever is done, oldest first so frames reach the writer in order
+  for (int i = 0; i < kPboCount; ++i) {
+    const int slot = (next_ + i) % kPboCount;
+    if (fences_[slot] != nullptr && !Collect(slot, false)) {
+      break;
+    }
+  }
+  capture_nanoseconds_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameCapture::Close() {
+  if (!IsOpen()) {
+    return;
+  }
+  for (int i = 0; i < kPboCount; ++i) {
+    const int slot = (next_ + i) % kPboCount;
+    if (fences_[slot] != nullptr) {
+      Collect(slot, true);
+    }
+  }
+  writer_.Close();
+  glDeleteBuffers(kPboCount, pbos_);
+  for (uint32_t &pbo : pbos_) {
+    pbo = 0;
+  }
+}
+
+bool FrameCapture::Collect(int slot,
+                           bool wait) {
+  GLsync fence = (GLsync)fences_[slot];
+  // Flush so the fence gets to the GPU at all, otherwise waiting on it can hang
+  const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+  if (status == GL_TIMEOUT_EXPIRED && !wait) {
+    return false;
+  }
+  glDeleteSync(fence);
+  fences_[slot] = nullptr;
+  if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+    printf("ERROR (FrameCapture): Frame %llu never finished on the GPU\n",
+           (unsigned long long)frame_indices_[slot]);
+    ++dropped_;
+    return true;
+  }
+
+  const size_t size = (size_t)width_ * height_ * 4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[slot]);
+  const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+  if (pixels == nullptr) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    printf("ERROR (FrameCapture): Could not map frame %llu\n", (unsigned long long)frame_indices_[slot]);
+    ++dropped_;
+    return true;
+  }
+  CapturedFrame *frame = writer_.AcquireFrame();
+  if (frame == nullptr && !drop_when_behind_) {
+    ++writer_waits_;
+    while (frame == nullptr) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      frame = writer_.AcquireFrame();
+    }
+  }
+  if (frame != nullptr) {
+    memcpy(frame->rgba_.data(), pixels, size);
+    frame->index_ = frame_indices_[slot];
+    writer_.SubmitFrame(frame);
+    ++captured_;
+  }
+  else {
+    ++dropped_;
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  return true;
+}
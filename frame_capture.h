@@ -0,0 +1,76 @@
+#ifndef SEPT2023__FRAME_CAPTURE_H_
+#define SEPT2023__FRAME_CAPTURE_H_
+
+#include <cstdint>
+#include <string>
+#include "frame_writer.h"
+
+/**
+ * Reads rendered frames back from the GPU without stalling the render thread and hands them to a
+ * FrameWriter.
+ *
+ * A plain glReadPixels into memory waits for the GPU to finish the frame. Instead each frame is
+ * read into the next of kPboCount pixel buffer objects, which only queues the copy, and a fence
+ * is put after it. The buffer is mapped a frame or two later once its fence has signalled, by
+ * which time the copy is done and mapping costs a memcpy. Only if all the buffers are still in
+ * flight does Capture wait for the oldest one.
+ *
+ * Render thread only, with the GL context current.
+ */
+struct FrameCapture {
+  static constexpr int kPboCount = 3;
+
+  uint32_t pbos_[kPboCount] = {0, 0, 0};
+  // GLsync of the read into each buffer, null if the buffer is free
+  void *fences_[kPboCount] = {nullptr, nullptr, nullptr};
+  uint64_t frame_indices_[kPboCount] = {0, 0, 0};
+  // Buffer the next frame is read into, the oldest one in flight
+  int next_ = 0;
+  uint64_t next_index_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  FrameWriter writer_;
+
+  // Drop frames if the writer falls behind instead of waiting for it, for live recording where
+  // the frame rate matters more than every frame being there
+  bool drop_when_behind_ = false;
+  uint64_t captured_ = 0;
+  uint64_t dropped_ = 0;
+  // Times a buffer had to be waited for, the GPU or the writer was behind
+  uint64_t gpu_waits_ = 0;
+  uint64_t writer_waits_ = 0;
+  // Render thread time spent in Capture, ns
+  uint64_t capture_nanoseconds_ = 0;
+
+  /**
+   * Make the buffers and start the writer, see FrameWriter::Open for path
+   * \return false if the writer can't open path
+   */
+  bool Open(const std::string &path,
+            int width,
+            int height,
+            double fps);
+
+  bool IsOpen() const;
+
+  /**
+   * Queue a copy of framebuffer (width x height from Open) and pass on any earlier frames that
+   * have arrived
+   */
+  void Capture(uint32_t framebuffer);
+
+  /**
+   * Wait for the frames in flight, write them all out and delete the buffers
+   */
+  void Close();
+
+  /**
+   * Map slot's buffer and submit it to the writer
+   * \param wait block until the copy is done, otherwise give up if it isn't
+   * \return false if it wasn't done
+   */
+  bool Collect(int slot,
+               bool wait);
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "frame_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(SEPT2023_HAS_ZLIB)
+#include <zlib.h>
+#endif
+
+static uint32_t Crc32(const uint8_t *data,
+                      size_t size,
+                      uint32_t crc = 0) {
+  static uint32_t table[256];
+  static bool table_ready = false;
+  if (!table_ready) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+      }
+      table[i] = value;
+    }
+    table_ready = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static void PutBigEndian(std::vector<uint8_t> &out,
+                         uint32_t value) {
+  out.push_back((uint8_t)(value >> 24));
+  out.push_back((uint8_t)(value >> 16));
+  out.push_back((uint8_t)(value >> 8));
+  out.push_back((uint8_t)value);
+}
+
+/**
+ * Append a PNG chunk, data may point into out
+ */
+static void PutPngChunk(std::vector<uint8_t> &out,
+                        const char type[4],
+                        const uint8_t *data,
+                        size_t size) {
+  PutBigEndian(out, (uint32_t)size);
+  const size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  PutBigEndian(out, Crc32(out.data() + start, size + 4));
+}
+
+#if !defined(SEPT2023_HAS_ZLIB)
+/**
+ * A zlib stream of data without compressing it, for builds without zlib
+ */
+static void StoreZlib(const std::vector<uint8_t> &data,
+                      std::vector<uint8_t> &out) {
+  out.clear();
+  out.push_back(0x78);
+  out.push_back(0x01);
+  size_t offset = 0;
+  do {
+    const size_t size = std::min<size_t>(65535, data.size() - offset);
+    out.push_back(offset + size == data.size() ? 1 : 0);
+    out.push_back((uint8_t)size);
+    out.push_back((uint8_t)(size >> 8));
+    out.push_back((uint8_t)~size);
+    out.push_back((uint8_t)(~size >> 8));
+    out.insert(out.end(), data.begin() + offset, data.begin() + offset + size);
+    offset += size;
+  } while (offset < data.size());
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (uint8_t byte : data) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  PutBigEndian(out, (b << 16) | a);
+}
+#endif
+
+FrameWriter::FrameWriter(size_t frame_count)
+    : pending_(frame_count),
+      free_(frame_count) {
+  for (size_t i = 0; i < frame_count; ++i) {
+    frames_.push_back(std::make_unique<CapturedFrame>());
+  }
+}
+
+FrameWriter::~FrameWriter() {
+  Close();
+}
+
+/**
+ * Check a PNG path pattern and turn it into a printf format for an unsigned long long frame number
+ * \param path exactly one %d, optionally zero padded to a width (%06d), %% for a literal %
+ * \return false for no conversion, more than one or any other %
+ */
+static bool FramePathFormat(const std::string &path,
+                            std::string &format) {
+  format.clear();
+  int conversions = 0;
+  for (size_t i = 0; i < path.size(); ++i) {
+    format += path[i];
+    if (path[i] != '%') {
+      continue;
+    }
+    if (i + 1 < path.size() && path[i + 1] == '%') {
+      format += path[++i];
+      continue;
+    }
+    size_t end = i + 1;
+    while (end < path.size() && path[end] >= '0' && path[end] <= '9') {
+      end++;
+    }
+    if (end >= path.size() || path[end] != 'd' || ++conversions > 1) {
+      return false;
+    }
+    format.append(path, i + 1, end - i - 1);
+    format += "llu";
+    i = end;
+  }
+  return conversions == 1;
+}
+
+bool FrameWriter::Open(const std::string &path,
+                       uint32_t width,
+                       uint32_t height,
+                       double fps) {
+  if (IsOpen()) {
+    return false;
+  }
+  const bool y4m = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+  format_ = y4m ? FrameFormat::kY4m : FrameFormat::kPng;
+  if (y4m && (width % 2 != 0 || height % 2 != 0)) {
+    printf("ERROR (FrameWriter): Y4M needs an even width and height, not %ux%u\n", width, height);
+    return false;
+  }
+  if (!y4m && !FramePathFormat(path, png_format_)) {
+    printf("ERROR (FrameWriter): %s needs exactly one frame number like %%06d (and %%%% for a %%)\n",
+           path.c_str());
+    return false;
+  }
+  if (y4m) {
+    video_ = fopen(path.c_str(), "wb");
+    if (video_ == nullptr) {
+      printf("ERROR (FrameWriter): Could not create %s\n", path.c_str());
+      return false;
+    }
+    // Frame rate as a fraction, C420jpeg is full range BT.601 with centred chroma
+    fprintf(video_, "YUV4MPEG2 W%u H%u F%u:1000 Ip A1:1 C420jpeg\n", width, height,
+            (unsigned)(fps * 1000 + 0.5));
+  }
+  path_ = path;
+  width_ = width;
+  height_ = height;
+  fps_ = fps;
+  written_ = 0;
+  failed_ = 0;
+  write_nanoseconds_ = 0;
+  CapturedFrame *frame = nullptr;
+  while (free_.TryPop(frame)) {
+  }
+  for (auto &owned : frames_) {
+    owned->width_ = width;
+    owned->height_ = height;
+    owned->rgba_.resize((size_t)width * height * 4);
+    free_.TryPush(owned.get());
+  }
+  stop_ = false;
+  writer_ = std::thread(&FrameWriter::WriterLoop, this);
+  return true;
+}
+
+bool FrameWriter::IsOpen() const {
+  return writer_.joinable();
+}
+
+CapturedFrame *FrameWriter::AcquireFrame() {
+  CapturedFrame *frame = nullptr;
+  return free_.TryPop(frame) ? frame : nullptr;
+}
+
+void FrameWriter::SubmitFrame(CapturedFrame *frame) {
+  // Never fails, there are only as many frames as either queue holds
+  pending_.TryPush(frame);
+}
+
+void FrameWriter::Close() {
+  if (!IsOpen()) {
+    return;
+  }
+  stop_.store(true, std::memory_order_release);
+  writer_.join();
+  if (video_ != nullptr) {
+    fclose(video_);
+    video_ = nullptr;
+  }
+}
+
+void FrameWriter::WriterLoop() {
+  CapturedFrame *frame = nullptr;
+  while (true) {
+    // Read stop before draining so nothing submitted before Close() is missed
+    const bool stopping = stop_.load(std::memory_order_acquire);
+    bool got_any = false;
+    while (pending_.TryPop(frame)) {
+      got_any = true;
+      const auto start = std::chrono::steady_clock::now();
+      if (Write(*frame)) {
+        written_.fetch_add(1, std::memory_order_relaxed);
+      }
+      else {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+      }
+      write_nanoseconds_.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+          std::memory_order_relaxed);
+      free_.TryPush(frame);
+    }
+    if (stopping) {
+      break;
+    }
+    if (!got_any) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+bool FrameWriter::Write(const CapturedFrame &frame) {
+  return format_ == FrameFormat::kY4m ? WriteY4m(frame) : WritePng(frame);
+}
+
+bool FrameWriter::WritePng(const CapturedFrame &frame) {
+  const size_t row_bytes = (size_t)frame.width_ * 3;
+  // Filter type 2 (up) on every row: each byte minus the one above it, screenshots are mostly
+  // flat colour so this is mostly zeros. Rows flipped to top first
+  scratch_.resize((row_bytes + 1) * frame.height_);
+  for (uint32_t y = 0; y < frame.height_; ++y) {
+    const uint8_t *row = frame.rgba_.data() + (size_t)(frame.height_ - 1 - y) * frame.width_ * 4;
+    const uint8_t *above = y > 0 ? row + (size_t)frame.width_ * 4 : nullptr;
+    uint8_t *out = scratch_.data() + y * (row_bytes + 1);
+    *out++ = 2;
+    for (uint32_t x = 0; x < frame.width_; ++x) {
+      for (int channel = 0; channel < 3; ++channel) {
+        const uint8_t value = row[x * 4 + channel];
+        *out++ = (uint8_t)(value - (above != nullptr ? above[x * 4 + channel] : 0));
+      }
+    }
+  }
+
+#if defined(SEPT2023_HAS_ZLIB)
+  uLongf compressed_size = compressBound(scratch_.size());
+  deflated_.resize(compressed_size);
+  if (compress2(deflated_.data(), &compressed_size, scratch_.data(), scratch_.size(), png_level_) != Z_OK) {
+    return false;
+  }
+  deflated_.resize(compressed_size);
+#else
+  StoreZlib(scratch_, deflated_);
+#endif
+
+  encoded_.clear();
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  encoded_.insert(encoded_.end(), kSignature, kSignature + 8);
+  // Size, then 8 bit RGB, deflate, adaptive filtering, not interlaced
+  const uint8_t header[13] = {(uint8_t)(frame.width_ >> 24), (uint8_t)(frame.width_ >> 16),
+                              (uint8_t)(frame.width_ >> 8), (uint8_t)frame.width_,
+                              (uint8_t)(frame.height_ >> 24), (uint8_t)(frame.height_ >> 16),
+                              (uint8_t)(frame.height_ >> 8), (uint8_t)frame.height_,
+                              8, 2, 0, 0, 0};
+  PutPngChunk(encoded_, "IHDR", header, sizeof(header));
+  PutPngChunk(encoded_, "IDAT", deflated_.data(), deflated_.size());
+  PutPngChunk(encoded_, "IEND", nullptr, 0);
+
+  char path[1024];
+  if (snprintf(path, sizeof(path), png_format_.c_str(), (unsigned long long)frame.index_) >= (int)sizeof(path)) {
+    printf("ERROR (FrameWriter): Path too long: %s\n", path_.c_str());
+    return false;
+  }
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr) {
+    printf("ERROR (FrameWriter): Could not create %s\n", path);
+    return false;
+  }
+  const bool written = fwrite(encoded_.data(), 1, encoded_.size(), file) == encoded_.size();
+  return fclose(file) == 0 && written;
+}
+
+bool FrameWriter::WriteY4m(const CapturedFrame &frame) {
+  const uint32_t width = frame.width_;
+  const uint32_t height = frame.height_;
+  const size_t luma_size = (size_t)width * height;
+  const size_t chroma_size = luma_size / 4;
+  encoded_.resize(luma_size + 2 * chroma_size);
+  uint8_t *luma = encoded_.data();
+  uint8_t *cb = luma + luma_size;
+  uint8_t *cr = cb + chroma_size;
+  // Full range BT.601 in 16 bit fixed point, one chroma sample from the average of each 2x2 block.
+  // Rows are flipped to top first
+  for (uint32_t y = 0; y < height; y += 2) {
+    const uint8_t *rows[2] = {frame.rgba_.data() + (size_t)(height - 1 - y) * width * 4,
+                              frame.rgba_.data() + (size_t)(height - 2 - y) * width * 4};
+    for (uint32_t x = 0; x < width; x += 2) {
+      int32_t r = 0;
+      int32_t g = 0;
+      int32_t b = 0;
+      for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+          const uint8_t *pixel = rows[dy] + (x + dx) * 4;
+          luma[(size_t)(y + dy) * width + x + dx] =
+              (uint8_t)((19595 * pixel[0] + 38470 * pixel[1] + 7471 * pixel[2] + 32768) >> 16);
+          r += pixel[0];
+          g += pixel[1];
+          b += pixel[2];
+        }
+      }
+      // Sums of 4 pixels, so a quarter of the usual coefficients
+      const size_t chroma = (size_t)(y / 2) * (width / 2) + x / 2;
+      cb[chroma] = (uint8_t)((-2765 * r - 5427 * g + 8192 * b + (128 << 16) + 32768) >> 16);
+      cr[chroma] = (uint8_t)((8192 * r - 6860 * g - 1332 * b + (128 << 16) + 32768) >> 16);
+    }
+  }
+  return fwrite("FRAME\n", 1, 6, video_) == 6 && fwrite(encoded_.data(), 1, encoded_.size(), video_) == encoded_.size();
+}
@@ -0,0 +1,109 @@
+#ifndef SEPT2023__FRAME_WRITER_H_
+#define SEPT2023__FRAME_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+/**
+ * One captured image, RGBA8 with the bottom row first (the order glReadPixels gives)
+ */
+struct CapturedFrame {
+  std::vector<uint8_t> rgba_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  // Counts from 0 for the first frame of the file
+  uint64_t index_ = 0;
+};
+
+enum class FrameFormat {
+  // One file per frame, the path has the frame number as its only printf conversion, %d with an
+  // optional zero padded width, e.g. frames/%06d.png
+  kPng,
+  // One uncompressed YUV 4:2:0 video (readable by ffmpeg, mpv, ...), picked by a .y4m extension
+  kY4m
+};
+
+/**
+ * Encodes and writes captured frames on its own thread, so the render thread only ever copies
+ * pixels. The frames go round between two lock free queues: the render thread takes an empty one
+ * from free_ (AcquireFrame), fills it and pushes it on pending_ (SubmitFrame), the writer thread
+ * writes it and hands it back on free_. Nothing is allocated once the frames exist.
+ *
+ * PNGs are deflated with zlib when the build has it (SEPT2023_HAS_ZLIB), otherwise stored
+ * uncompressed, still valid PNGs but about 3 bytes a pixel.
+ */
+struct FrameWriter {
+  /**
+   * \param frame_count frames in flight between the threads, more absorbs slow disk writes
+   */
+  explicit FrameWriter(size_t frame_count = 8);
+  ~FrameWriter();
+
+  /**
+   * Start the writer thread. Format from the path, see FrameFormat
+   * \param fps only written into Y4M headers
+   * \return false if the file can't be created, or Y4M with an odd width/height (4:2:0 needs
+   *         them even)
+   */
+  bool Open(const std::string &path,
+            uint32_t width,
+            uint32_t height,
+            double fps);
+
+  /**
+   * Render thread only
+   * \return an empty frame sized for the file, null if every frame is still queued for writing
+   */
+  CapturedFrame *AcquireFrame();
+
+  /**
+   * Render thread only, frame must come from AcquireFrame. Frames are written in submit order
+   */
+  void SubmitFrame(CapturedFrame *frame);
+
+  /**
+   * Write out everything submitted and stop the thread
+   */
+  void Close();
+
+  bool IsOpen() const;
+
+  FrameFormat format_ = FrameFormat::kPng;
+  std::string path_;
+  // kPng: path_ checked and with the conversion made %llu, for the frame index
+  std::string png_format_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  double fps_ = 30;
+  // zlib level for PNGs, 1 keeps up with capture, 9 is a third smaller and many times slower
+  int png_level_ = 1;
+
+  std::vector<std::unique_ptr<CapturedFrame>> frames_;
+  SpscQueue<CapturedFrame *> pending_;
+  SpscQueue<CapturedFrame *> free_;
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> failed_{0};
+  // Writer thread time spent encoding + writing, ns
+  std::atomic<uint64_t> write_nanoseconds_{0};
+
+  // Writer thread state
+  std::thread writer_;
+  std::atomic<bool> stop_{false};
+  FILE *video_ = nullptr;
+  std::vector<uint8_t> encoded_;
+  std::vector<uint8_t> scratch_;
+  std::vector<uint8_t> deflated_;
+
+  void WriterLoop();
+  bool Write(const CapturedFrame &frame);
+  bool WritePng(const CapturedFrame &frame);
+  bool WriteY4m(const CapturedFrame &frame);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "gpu_profiler.h"
+#include <glad/glad.h>
+
+void GpuProfiler::Init() {
+#ifdef SEPT2023_PROFILING
+  if (buffer_ == nullptr) {
+    buffer_ = &ProfilerCreateBuffer("GPU");
+  }
+#endif
+}
+
+void GpuProfiler::Begin(const char *name) {
+#ifdef SEPT2023_PROFILING
+  std::vector<GpuProfileQuery> &queries = queries_[frame_];
+  if (used_[frame_] == queries.size()) {
+    GpuProfileQuery query;
+    glGenQueries(1, &query.query_);
+    queries.push_back(query);
+  }
+  GpuProfileQuery &query = queries[used_[frame_]++];
+  query.name_ = name;
+  query.cpu_start_ = ProfilerNow();
+  glBeginQuery(GL_TIME_ELAPSED, query.query_);
+#else
+  (void)name;
+#endif
+}
+
+void GpuProfiler::End() {
+#ifdef SEPT2023_PROFILING
+  glEndQuery(GL_TIME_ELAPSED);
+#endif
+}
+
+void GpuProfiler::EndFrame() {
+#ifdef SEPT2023_PROFILING
+  frame_ = (frame_ + 1) % kFrames;
+  // The set we are about to reuse was recorded kFrames - 1 frames ago, by now it should be done.
+  // If it isn't we drop it rather than wait for the GPU
+  std::vector<GpuProfileQuery> &queries = queries_[frame_];
+  const size_t used = used_[frame_];
+  used_[frame_] = 0;
+  if (used == 0 || buffer_ == nullptr) {
+    return;
+  }
+  GLint available = 0;
+  glGetQueryObjectiv(queries[used - 1].query_, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    skipped_ += used;
+    return;
+  }
+  for (size_t i = 0; i < used; ++i) {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[i].query_, GL_QUERY_RESULT, &elapsed);
+    buffer_->Push(queries[i].name_, queries[i].cpu_start_, queries[i].cpu_start_ + (int64_t)elapsed, 0);
+  }
+#endif
+}
+
+GpuProfileScope::GpuProfileScope(GpuProfiler &profiler,
+                                 const char *name) : profiler_(profiler) {
+  profiler_.Begin(name);
+}
+
+GpuProfileScope::~GpuProfileScope() {
+  profiler_.End();
+}
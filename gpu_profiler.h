@@ -0,0 +1,73 @@
+#ifndef SEPT2023__GPU_PROFILER_H_
+#define SEPT2023__GPU_PROFILER_H_
+
+#include <cstdint>
+#include <vector>
+#include "profiler.h"
+
+#ifdef SEPT2023_PROFILING
+// Time the GL commands issued in the enclosing block, scopes must not nest (GL limitation)
+#define SEPT2023_GPU_PROFILE_SCOPE(profiler, name) \
+  GpuProfileScope SEPT2023_PROFILE_CONCAT(gpu_profile_scope_, __LINE__)(profiler, name)
+#else
+#define SEPT2023_GPU_PROFILE_SCOPE(profiler, name)
+#endif
+
+/**
+ * A timed block of GL commands in the frame being recorded
+ */
+struct GpuProfileQuery {
+  const char *name_ = nullptr;
+  uint32_t query_ = 0;
+  // ProfilerNow() when the scope was opened, the GPU time is drawn starting from here
+  int64_t cpu_start_ = 0;
+};
+
+/**
+ * GPU side scoped timers using GL_TIME_ELAPSED queries. Reading a query result straight away
+ * would stall until the GPU catches up, so there are two sets of queries: one being recorded
+ * this frame and one from the previous frame that is read back in EndFrame. Results go into a
+ * "GPU" ProfileBuffer so they show up next to the CPU scopes.
+ *
+ * Render thread only. Everything is a no-op when built without SEPT2023_PROFILING.
+ */
+struct GpuProfiler {
+  static constexpr int kFrames = 2;
+
+  std::vector<GpuProfileQuery> queries_[kFrames];
+  // Queries used so far in each frame
+  size_t used_[kFrames] = {0, 0};
+  int frame_ = 0;
+  // Scopes of the last frame that were read back but weren't ready yet, so were skipped
+  uint64_t skipped_ = 0;
+  ProfileBuffer *buffer_ = nullptr;
+
+  /**
+   * Call once there is a GL context
+   */
+  void Init();
+
+  void Begin(const char *name);
+  void End();
+
+  /**
+   * Call once per frame after the last scope, reads back last frame's queries
+   */
+  void EndFrame();
+};
+
+/**
+ * Times its own lifetime on the GPU, use SEPT2023_GPU_PROFILE_SCOPE
+ */
+struct GpuProfileScope {
+  GpuProfileScope(GpuProfiler &profiler,
+                  const char *name);
+  ~GpuProfileScope();
+
+  GpuProfileScope(const GpuProfileScope &) = delete;
+  GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+
+  GpuProfiler &profiler_;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "grid_renderer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include "shader_library.h"
+
+bool GridRenderer::Init() {
+  shader_ = GetShaderLibrary().Load("grid_shader.vs", "grid_shader.fs");
+  if (shader_ == nullptr) {
+    return false;
+  }
+  LookUpUniforms();
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(float), nullptr, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+bool GridRenderer::Update(const OccupancyGrid &grid) {
+  uploads_ = 0;
+  const uint32_t version = grid.version_.load(std::memory_order_acquire);
+  const uint32_t generation = grid.attach_generation_.load(std::memory_order_acquire);
+  if (&grid == grid_ && version == grid_version_ && all_uploaded_) {
+    return texture_ != 0;
+  }
+  if (!grid.IsOpen()) {
+    return false;
+  }
+  // The whole padded grid is one texture, tile (x, y) at texel (x, y) * kOccupancyTileSize
+  const int texture_width = (int)(grid.tiles_x_ * kOccupancyTileSize);
+  const int texture_height = (int)(grid.tiles_y_ * kOccupancyTileSize);
+  // A new or reopened map (maybe with another origin) starts over, an edit only bumps the versions
+  // of its own tiles and the loop below picks those up
+  if (&grid != grid_ || generation != grid_generation_ || uploaded_versions_.size() != grid.TileCount()) {
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (texture_width > max_size || texture_height > max_size) {
+      printf("ERROR (GridRenderer): %dx%d grid is bigger than the max texture size %d\n",
+             texture_width, texture_height, max_size);
+      return false;
+    }
+    if (texture_ == 0) {
+      glGenTextures(1, &texture_);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, texture_width, texture_height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Versions start at 0, so UINT32_MAX means never uploaded
+    uploaded_versions_.assign(grid.TileCount(), UINT32_MAX);
+    next_tile_ = 0;
+
+    const float min_x = (float)grid.origin_x_;
+    const float min_y = (float)grid.origin_y_;
+    const float max_x = (float)(grid.origin_x_ + texture_width * grid.resolution_);
+    const float max_y = (float)(grid.origin_y_ + texture_height * grid.resolution_);
+    const float vertices[16] = {
+        min_x, min_y, 0, 0,
+        max_x, min_y, 1, 0,
+        min_x, max_y, 0, 1,
+        max_x, max_y, 1, 1};
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  grid_ = &grid;
+  grid_version_ = version;
+  grid_generation_ = generation;
+
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  // Tile rows are 64 bytes, no padding
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const size_t tiles = grid.TileCount();
+  size_t scanned = 0;
+  bool busy = false;
+  for (; scanned < tiles && uploads_ < max_tile_uploads_; ++scanned) {
+    const size_t tile = (next_tile_ + scanned) % tiles;
+    const uint32_t tile_version = grid.tile_versions_[tile].load(std::memory_order_acquire);
+    if (tile_version == uploaded_versions_[tile]) {
+      continue;
+    }
+    // The sim thread may be changing the tile: copy it under its seqlock and only upload a copy
+    // no change overlapped, otherwise try again next frame
+    if (tile_version % 2 != 0) {
+      busy = true;
+      continue;
+    }
+    memcpy(staging_, grid.tiles_ + tile * kOccupancyTileCells, kOccupancyTileCells);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (grid.tile_versions_[tile].load(std::memory_order_relaxed) != tile_version) {
+      busy = true;
+      continue;
+    }
+    const int x = (int)((tile % grid.tiles_x_) * kOccupancyTileSize);
+    const int y = (int)((tile / grid.tiles_x_) * kOccupancyTileSize);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, kOccupancyTileSize, kOccupancyTileSize, GL_RED, GL_UNSIGNED_BYTE,
+                    staging_);
+    uploaded_versions_[tile] = tile_version;
+    uploads_++;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  next_tile_ = (next_tile_ + scanned) % tiles;
+  // Stopped early because of the cap or skipped a tile being changed, there is more to go
+  all_uploaded_ = scanned == tiles && !busy;
+  return true;
+}
+
+void GridRenderer::Draw() {
+  if (texture_ == 0 || grid_ == nullptr || shader_ == nullptr) {
+    return;
+  }
+  if (shader_->generation_ != shader_generation_) {
+    LookUpUniforms();
+  }
+  shader_->Use();
+  shader_->SetVec4(occupied_color_uniform_, occupied_color_);
+  shader_->SetInt(cells_uniform_, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glBindVertexArray(vao_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GridRenderer::LookUpUniforms() {
+  occupied_color_uniform_ = shader_->GetUniform("occupiedColor");
+  cells_uniform_ = shader_->GetUniform("cells");
+  shader_generation_ = shader_->generation_;
+}
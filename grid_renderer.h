@@ -0,0 +1,61 @@
+#ifndef SEPT2023__GRID_RENDERER_H_
+#define SEPT2023__GRID_RENDERER_H_
+
+#include <vector>
+#include "occupancy_grid.h"
+#include "shader.h"
+
+/**
+ * Draws an OccupancyGrid as one quad with the cells in a single GL_R8 texture the size of the
+ * (tile padded) grid. The texture is streamed: each Update uploads only the tiles whose version
+ * changed since they were last uploaded, at most max_tile_uploads_ of them, so loading a huge map
+ * fills in over a few frames instead of stalling one.
+ */
+struct GridRenderer {
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
+  // Program generation the uniform handles were looked up in, a hot reload invalidates them
+  uint32_t shader_generation_ = 0;
+  UniformHandle occupied_color_uniform_;
+  UniformHandle cells_uniform_;
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  uint32_t texture_ = 0;
+  glm::vec4 occupied_color_ = glm::vec4(0.25, 0.25, 0.3, 1);
+  size_t max_tile_uploads_ = 512;
+
+  // Grid the texture was made for, and the tile versions that are on the GPU
+  const OccupancyGrid *grid_ = nullptr;
+  uint32_t grid_version_ = 0;
+  // OccupancyGrid::attach_generation_ of the map the tile versions below belong to
+  uint32_t grid_generation_ = 0;
+  // One tile copied out of the grid under its seqlock, glTexSubImage2D copies it before returning
+  uint8_t staging_[kOccupancyTileCells];
+  std::vector<uint32_t> uploaded_versions_;
+  bool all_uploaded_ = false;
+  // Tile the next scan for dirty tiles starts at, so a capped upload carries on where it stopped
+  size_t next_tile_ = 0;
+  // Tiles uploaded by the last Update
+  size_t uploads_ = 0;
+
+  /**
+   * \return false if the shader failed to load
+   */
+  bool Init();
+
+  /**
+   * Upload the tiles of grid that changed. A different grid (or the same one reopened) gets a new
+   * texture
+   * \return false if the grid is too big for a texture on this GPU
+   */
+  bool Update(const OccupancyGrid &grid);
+
+  void Draw();
+
+  /**
+   * Find the uniforms in the current version of the shader
+   */
+  void LookUpUniforms();
+};
+
+#endif
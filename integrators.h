@@ -0,0 +1,190 @@
+#ifndef SEPT2023__INTEGRATORS_H_
+#define SEPT2023__INTEGRATORS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "dynamics.h"
+#include "unicycle.h"
+
+/**
+ * Integrators for the models in dynamics.h. Every integrator has
+ *   template <typename Model>
+ *   void Step(const Model &model, typename Model::State &state, double t, double dt);
+ * which advances state from t to t + dt. They are templated on the model (and so on its fixed
+ * size state) so the derivative and the vector maths inline into one loop with no allocations
+ * or virtual calls. Pick one at compile time, e.g. IntegrateFor<Rk4Integrator>(...)
+ */
+
+/**
+ * Forward Euler, first order. Only here as the cheapest baseline
+ */
+struct EulerIntegrator {
+  uint64_t evaluations_ = 0;
+
+  template <typename Model>
+  void Step(const Model &model,
+            typename Model::State &state,
+            double t,
+            double dt) {
+    state += dt * model.Derivative(state, t);
+    evaluations_++;
+  }
+};
+
+/**
+ * Classic 4th order Runge-Kutta, 4 derivative evaluations per step
+ */
+struct Rk4Integrator {
+  uint64_t evaluations_ = 0;
+
+  template <typename Model>
+  void Step(const Model &model,
+            typename Model::State &state,
+            double t,
+            double dt) {
+    using State = typename Model::State;
+    const State k1 = model.Derivative(state, t);
+    const State k2 = model.Derivative(state + 0.5 * dt * k1, t + 0.5 * dt);
+    const State k3 = model.Derivative(state + 0.5 * dt * k2, t + 0.5 * dt);
+    const State k4 = model.Derivative(state + dt * k3, t + dt);
+    state += dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+    evaluations_ += 4;
+  }
+};
+
+/**
+ * The closed form arc solution (StepUnicycle), exact for the kinematic unicycle whatever the step.
+ * Only defined for UnicycleModel, other models have no closed form
+ */
+struct ExactArcIntegrator {
+  uint64_t evaluations_ = 0;
+
+  void Step(const UnicycleModel &model,
+            UnicycleModel::State &state,
+            double t,
+            double dt) {
+    (void)t;
+    Pose2D pose;
+    pose.x = state[0];
+    pose.y = state[1];
+    pose.theta = state[2];
+    StepUnicycle(pose, model.linear_velocity_, model.angular_velocity_, dt);
+    state = UnicycleModel::State(pose.x, pose.y, pose.theta);
+    evaluations_++;
+  }
+};
+
+/**
+ * Dormand-Prince 5(4) with adaptive step size. Each call to Step covers dt with as many internal
+ * steps as it takes to keep the local error estimate below the tolerance, so a caller can keep
+ * its fixed dt and the integrator only works hard where the dynamics need it. The internal step
+ * size carries over between calls.
+ */
+struct DormandPrinceIntegrator {
+  // Error tolerance per state element: absolute + relative * |value|
+  double absolute_tolerance_ = 1e-6;
+  double relative_tolerance_ = 1e-6;
+  // Internal step size limits, seconds
+  double min_step_ = 1e-6;
+  double max_step_ = 1;
+  // Current internal step size, 0 starts from dt
+  double step_ = 0;
+  uint64_t evaluations_ = 0;
+  uint64_t accepted_ = 0;
+  uint64_t rejected_ = 0;
+
+  template <typename Model>
+  void Step(const Model &model,
+            typename Model::State &state,
+            double t,
+            double dt) {
+    using State = typename Model::State;
+    // Butcher tableau
+    constexpr double a21 = 1.0 / 5;
+    constexpr double a31 = 3.0 / 40, a32 = 9.0 / 40;
+    constexpr double a41 = 44.0 / 45, a42 = -56.0 / 15, a43 = 32.0 / 9;
+    constexpr double a51 = 19372.0 / 6561, a52 = -25360.0 / 2187, a53 = 64448.0 / 6561, a54 = -212.0 / 729;
+    constexpr double a61 = 9017.0 / 3168, a62 = -355.0 / 33, a63 = 46732.0 / 5247, a64 = 49.0 / 176,
+        a65 = -5103.0 / 18656;
+    // 5th order weights, also the last row (first same as last)
+    constexpr double b1 = 35.0 / 384, b3 = 500.0 / 1113, b4 = 125.0 / 192, b5 = -2187.0 / 6784, b6 = 11.0 / 84;
+    // 5th order minus 4th order weights, gives the error estimate directly
+    constexpr double e1 = 71.0 / 57600, e3 = -71.0 / 16695, e4 = 71.0 / 1920, e5 = -17253.0 / 339200,
+        e6 = 22.0 / 525, e7 = -1.0 / 40;
+
+    const double end = t + dt;
+    double h = step_ > 0 ? std::min(step_, dt) : dt;
+    State k1 = model.Derivative(state, t);
+    evaluations_++;
+    while (t < end) {
+      // Don't step past the end, and don't leave a sliver for the next step either
+      const double remaining = end - t;
+      const bool last = h >= remaining * (1 - 1e-12);
+      const double step = last ? remaining : h;
+
+      const State k2 = model.Derivative(state + step * (a21 * k1), t + step / 5);
+      const State k3 = model.Derivative(state + step * (a31 * k1 + a32 * k2), t + step * 3 / 10);
+      const State k4 = model.Derivative(state + step * (a41 * k1 + a42 * k2 + a43 * k3), t + step * 4 / 5);
+      const State k5 = model.Derivative(state + step * (a51 * k1 + a52 * k2 + a53 * k3 + a54 * k4),
+                                        t + step * 8 / 9);
+      const State k6 = model.Derivative(state + step * (a61 * k1 + a62 * k2 + a63 * k3 + a64 * k4 + a65 * k5),
+                                        t + step);
+      const State next = state + step * (b1 * k1 + b3 * k3 + b4 * k4 + b5 * k5 + b6 * k6);
+      const State k7 = model.Derivative(next, t + step);
+      evaluations_ += 6;
+
+      const State error = step * (e1 * k1 + e3 * k3 + e4 * k4 + e5 * k5 + e6 * k6 + e7 * k7);
+      const State scale = (absolute_tolerance_
+          + relative_tolerance_ * state.cwiseAbs().cwiseMax(next.cwiseAbs()).array()).matrix();
+      const double error_norm = error.cwiseQuotient(scale).cwiseAbs().maxCoeff();
+
+      // Standard controller, 0.9 safety factor and the step can't change by more than 5x at once
+      const double factor = error_norm > 0 ? std::clamp(0.9 * std::pow(error_norm, -0.2), 0.2, 5.0) : 5.0;
+      if (error_norm <= 1 || step <= min_step_) {
+        t = last ? end : t + step;
+        state = next;
+        k1 = k7;
+        accepted_++;
+        // A shortened last step says nothing about the step size we could use
+        if (!last || factor < 1) {
+          h = step * factor;
+        }
+      }
+      else {
+        rejected_++;
+        h = step * factor;
+      }
+      h = std::clamp(h, min_step_, max_step_);
+    }
+    step_ = h;
+  }
+};
+
+/**
+ * Integrate from t to t + duration in fixed steps of dt (the last one shortened to land on the end)
+ * \return the number of steps taken
+ */
+template <typename Integrator, typename Model>
+uint64_t IntegrateFor(Integrator &integrator,
+                      const Model &model,
+                      typename Model::State &state,
+                      double t,
+                      double duration,
+                      double dt) {
+  const double end = t + duration;
+  uint64_t steps = 0;
+  while (t < end) {
+    const double step = std::min(dt, end - t);
+    integrator.Step(model, state, t, step);
+    t += step;
+    steps++;
+    // Avoid a tiny extra step from round off
+    if (end - t < dt * 1e-9) {
+      break;
+    }
+  }
+  return steps;
+}
+
+#endif
@@ -0,0 +1,355 @@
+#include "json.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <locale>
+#include <sstream>
+
+const char *JsonTypeName(JsonType type) {
+  switch (type) {
+    case JsonType::kNull:
+      return "null";
+    case JsonType::kBool:
+      return "a bool";
+    case JsonType::kNumber:
+      return "a number";
+    case JsonType::kString:
+      return "a string";
+    case JsonType::kArray:
+      return "an array";
+    case JsonType::kObject:
+      return "an object";
+  }
+  return "unknown";
+}
+
+const JsonValue *JsonValue::Find(const std::string &key) const {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    if (keys_[i] == key) {
+      return &items_[i];
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Recursive descent over the text, stops at the first error
+ */
+struct JsonParser {
+  const std::string &text_;
+  size_t offset_ = 0;
+  int line_ = 1;
+  int depth_ = 0;
+  std::string error_;
+
+  explicit JsonParser(const std::string &text)
+      : text_(text) {}
+
+  bool Fail(const char *message) {
+    if (error_.empty()) {
+      error_ = "line " + std::to_string(line_) + ": " + message;
+    }
+    return false;
+  }
+
+  void SkipWhitespace() {
+    while (offset_ < text_.size()) {
+      const char c = text_[offset_];
+      if (c == '\n') {
+        line_++;
+        offset_++;
+      }
+      else if (c == ' ' || c == '\t' || c == '\r') {
+        offset_++;
+      }
+      else if (c == '/' && offset_ + 1 < text_.size() && text_[offset_ + 1] == '/') {
+        while (offset_ < text_.size() && text_[offset_] != '\n') {
+          offset_++;
+        }
+      }
+      else {
+        break;
+      }
+    }
+  }
+
+  bool Consume(const char *literal) {
+    const size_t length = strlen(literal);
+    if (text_.compare(offset_, length, literal) != 0) {
+      return false;
+    }
+    offset_ += length;
+    return true;
+  }
+
+  bool ParseString(std::string &out) {
+    // Past the opening quote
+    offset_++;
+    out.clear();
+    while (offset_ < text_.size()) {
+      const char c = text_[offset_++];
+      if (c == '"') {
+        return true;
+      }
+      if (c == '\n') {
+        return Fail("newline in a string");
+      }
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+      if (offset_ >= text_.size()) {
+        break;
+      }
+      const char escape = text_[offset_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out.push_back(escape);
+          break;
+        case 'b':
+          out.push_back('\b');
+          break;
+        case 'f':
+          out.push_back('\f');
+          break;
+        case 'n':
+          out.push_back('\n');
+          break;
+        case 'r':
+          out.push_back('\r');
+          break;
+        case 't':
+          out.push_back('\t');
+          break;
+        case 'u': {
+          if (offset_ + 4 > text_.size()) {
+            return Fail("truncated \\u escape");
+          }
+          char *end = nullptr;
+          const std::string hex = text_.substr(offset_, 4);
+          const unsigned long code = strtoul(hex.c_str(), &end, 16);
+          if (end != hex.c_str() + 4) {
+            return Fail("bad \\u escape");
+          }
+          offset_ += 4;
+          // UTF-8, surrogate pairs aren't combined
+          if (code < 0x80) {
+            out.push_back((char)code);
+          }
+          else if (code < 0x800) {
+            out.push_back((char)(0xC0 | (code >> 6)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+          }
+          else {
+            out.push_back((char)(0xE0 | (code >> 12)));
+            out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (code & 0x3F)));
+          }
+          break;
+        }
+        default:
+          return Fail("unknown escape in a string");
+      }
+    }
+    return Fail("unterminated string");
+  }
+
+  bool ParseValue(JsonValue &value) {
+    SkipWhitespace();
+    value.line_ = line_;
+    if (offset_ >= text_.size()) {
+      return Fail("unexpected end of the document");
+    }
+    const char c = text_[offset_];
+    if (c == '{' || c == '[') {
+      // Deeply nested garbage shouldn't blow the stack
+      if (++depth_ > 256) {
+        return Fail("nested too deep");
+      }
+      const bool parsed = c == '{' ? ParseObject(value) : ParseArray(value);
+      depth_--;
+      return parsed;
+    }
+    if (c == '"') {
+      value.type_ = JsonType::kString;
+      return ParseString(value.string_);
+    }
+    if (Consume("true") || Consume("false")) {
+      value.type_ = JsonType::kBool;
+      value.bool_ = c == 't';
+      return true;
+    }
+    if (Consume("null")) {
+      value.type_ = JsonType::kNull;
+      return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+      value.type_ = JsonType::kNumber;
+      return ParseNumber(value.number_);
+    }
+    return Fail("expected a value");
+  }
+
+  bool IsDigit(size_t offset) const {
+    return offset < text_.size() && text_[offset] >= '0' && text_[offset] <= '9';
+  }
+
+  /**
+   * Only the JSON grammar -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, strtod alone would also
+   * take inf, nan, hex and a lone - and depends on the locale's decimal point
+   */
+  bool ParseNumber(double &number) {
+    const size_t start = offset_;
+    size_t end = offset_;
+    if (end < text_.size() && text_[end] == '-') {
+      end++;
+    }
+    if (!IsDigit(end)) {
+      return Fail("bad number");
+    }
+    if (text_[end] == '0') {
+      end++;
+    }
+    else {
+      while (IsDigit(end)) {
+        end++;
+      }
+    }
+    if (end < text_.size() && text_[end] == '.') {
+      if (!IsDigit(++end)) {
+        return Fail("bad number");
+      }
+      while (IsDigit(end)) {
+        end++;
+      }
+    }
+    if (end < text_.size() && (text_[end] == 'e' || text_[end] == 'E')) {
+      end++;
+      if (end < text_.size() && (text_[end] == '+' || text_[end] == '-')) {
+        end++;
+      }
+      if (!IsDigit(end)) {
+        return Fail("bad number");
+      }
+      while (IsDigit(end)) {
+        end++;
+      }
+    }
+    std::istringstream stream(text_.substr(start, end - start));
+    stream.imbue(std::locale::classic());
+    stream >> number;
+    if (stream.fail()) {
+      // Out of range, e.g. 1e999
+      return Fail("bad number");
+    }
+    offset_ = end;
+    return true;
+  }
+
+  bool ParseArray(JsonValue &value) {
+    value.type_ = JsonType::kArray;
+    offset_++;
+    SkipWhitespace();
+    if (offset_ < text_.size() && text_[offset_] == ']') {
+      offset_++;
+      return true;
+    }
+    while (true) {
+      value.items_.emplace_back();
+      if (!ParseValue(value.items_.back())) {
+        return false;
+      }
+      SkipWhitespace();
+      if (offset_ < text_.size() && text_[offset_] == ',') {
+        offset_++;
+        continue;
+      }
+      if (offset_ < text_.size() && text_[offset_] == ']') {
+        offset_++;
+        return true;
+      }
+      return Fail("expected , or ] in an array");
+    }
+  }
+
+  bool ParseObject(JsonValue &value) {
+    value.type_ = JsonType::kObject;
+    offset_++;
+    SkipWhitespace();
+    if (offset_ < text_.size() && text_[offset_] == '}') {
+      offset_++;
+      return true;
+    }
+    while (true) {
+      SkipWhitespace();
+      if (offset_ >= text_.size() || text_[offset_] != '"') {
+        return Fail("expected a quoted key");
+      }
+      std::string key;
+      if (!ParseString(key)) {
+        return false;
+      }
+      if (value.Find(key) != nullptr) {
+        return Fail(("duplicate key " + key).c_str());
+      }
+      SkipWhitespace();
+      if (offset_ >= text_.size() || text_[offset_] != ':') {
+        return Fail("expected : after a key");
+      }
+      offset_++;
+      value.keys_.push_back(key);
+      value.items_.emplace_back();
+      if (!ParseValue(value.items_.back())) {
+        return false;
+      }
+      SkipWhitespace();
+      if (offset_ < text_.size() && text_[offset_] == ',') {
+        offset_++;
+        continue;
+      }
+      if (offset_ < text_.size() && text_[offset_] == '}') {
+        offset_++;
+        return true;
+      }
+      return Fail("expected , or } in an object");
+    }
+  }
+};
+
+bool ParseJson(const std::string &text,
+               JsonValue &value,
+               std::string &error) {
+  JsonParser parser(text);
+  value = JsonValue();
+  if (!parser.ParseValue(value)) {
+    error = parser.error_;
+    return false;
+  }
+  parser.SkipWhitespace();
+  if (parser.offset_ != text.size()) {
+    parser.Fail("unexpected text after the document");
+    error = parser.error_;
+    return false;
+  }
+  return true;
+}
+
+bool LoadJsonFile(const std::string &path,
+                  JsonValue &value) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    printf("ERROR (Json): Unable to open %s\n", path.c_str());
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  std::string error;
+  if (!ParseJson(text.str(), value, error)) {
+    printf("ERROR (Json): %s %s\n", path.c_str(), error.c_str());
+    return false;
+  }
+  return true;
+}
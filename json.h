@@ -0,0 +1,58 @@
+#ifndef SEPT2023__JSON_H_
+#define SEPT2023__JSON_H_
+
+#include <string>
+#include <vector>
+
+enum class JsonType {
+  kNull,
+  kBool,
+  kNumber,
+  kString,
+  kArray,
+  kObject
+};
+
+const char *JsonTypeName(JsonType type);
+
+/**
+ * A parsed JSON value. Just enough for config files: the whole document is a tree of these, objects
+ * keep their keys in file order (duplicates are an error) and every value remembers its line for
+ * error messages.
+ */
+struct JsonValue {
+  JsonType type_ = JsonType::kNull;
+  bool bool_ = false;
+  double number_ = 0;
+  std::string string_;
+  // Elements of an array, or the values of an object with their keys in keys_
+  std::vector<JsonValue> items_;
+  std::vector<std::string> keys_;
+  int line_ = 0;
+
+  /**
+   * \return the value of key if this is an object that has it, otherwise nullptr
+   */
+  const JsonValue *Find(const std::string &key) const;
+
+  bool IsNumber() const {
+    return type_ == JsonType::kNumber;
+  }
+};
+
+/**
+ * Parse a JSON document. // line comments are allowed as well, scenario files want them
+ * \param error return variable, "line N: what went wrong" when parsing fails
+ * \return false on a syntax error
+ */
+bool ParseJson(const std::string &text,
+               JsonValue &value,
+               std::string &error);
+
+/**
+ * Read and parse a JSON file, errors are printed with the path
+ */
+bool LoadJsonFile(const std::string &path,
+                  JsonValue &value);
+
+#endif
@@ -0,0 +1,362 @@
+#include "lidar.h"
+#include <algorithm>
+#include <cmath>
+#include "fleet_step.h"
+#include "thread_pool.h"
+
+void SegmentBvh::Build(const std::vector<LineSegment> &segments) {
+  segments_ = segments;
+  nodes_.clear();
+  if (segments_.empty()) {
+    return;
+  }
+  struct BuildItem {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+  };
+  std::vector<BuildItem> stack;
+  nodes_.push_back(SegmentBvhNode());
+  stack.push_back({0, 0, (uint32_t)segments_.size()});
+  while (!stack.empty()) {
+    const BuildItem item = stack.back();
+    stack.pop_back();
+    SegmentBvhNode node;
+    node.min_x = node.min_y = INFINITY;
+    node.max_x = node.max_y = -INFINITY;
+    float centroid_min_x = INFINITY, centroid_min_y = INFINITY;
+    float centroid_max_x = -INFINITY, centroid_max_y = -INFINITY;
+    for (uint32_t i = item.begin; i < item.end; ++i) {
+      const LineSegment &segment = segments_[i];
+      node.min_x = std::min({node.min_x, segment.x0, segment.x1});
+      node.min_y = std::min({node.min_y, segment.y0, segment.y1});
+      node.max_x = std::max({node.max_x, segment.x0, segment.x1});
+      node.max_y = std::max({node.max_y, segment.y0, segment.y1});
+      const float centroid_x = 0.5f * (segment.x0 + segment.x1);
+      const float centroid_y = 0.5f * (segment.y0 + segment.y1);
+      centroid_min_x = std::min(centroid_min_x, centroid_x);
+      centroid_min_y = std::min(centroid_min_y, centroid_y);
+      centroid_max_x = std::max(centroid_max_x, centroid_x);
+      centroid_max_y = std::max(centroid_max_y, centroid_y);
+    }
+    if (item.end - item.begin <= max_leaf_segments_) {
+      node.first = item.begin;
+      node.count = item.end - item.begin;
+      nodes_[item.node] = node;
+      continue;
+    }
+    // Median split along the longer side of the centroids' box
+    const bool split_x = centroid_max_x - centroid_min_x > centroid_max_y - centroid_min_y;
+    const uint32_t middle = (item.begin + item.end) / 2;
+    std::nth_element(segments_.begin() + item.begin, segments_.begin() + middle, segments_.begin() + item.end,
+                     [split_x](const LineSegment &a, const LineSegment &b) {
+                       return split_x ? a.x0 + a.x1 < b.x0 + b.x1 : a.y0 + a.y1 < b.y0 + b.y1;
+                     });
+    node.first = (uint32_t)nodes_.size();
+    node.count = 0;
+    nodes_[item.node] = node;
+    nodes_.push_back(SegmentBvhNode());
+    nodes_.push_back(SegmentBvhNode());
+    stack.push_back({node.first, item.begin, middle});
+    stack.push_back({node.first + 1, middle, item.end});
+  }
+}
+
+bool SegmentBvh::Empty() const {
+  return nodes_.empty();
+}
+
+void RandomSegments(std::vector<LineSegment> &segments,
+                    size_t count,
+                    double half_extent,
+                    double max_length,
+                    uint64_t seed) {
+  Rng rng(seed, 4);
+  segments.clear();
+  for (size_t i = 0; i < count; ++i) {
+    const double x = rng.Uniform(-half_extent, half_extent);
+    const double y = rng.Uniform(-half_extent, half_extent);
+    const double angle = rng.Uniform(0, M_PI);
+    const double length = rng.Uniform(1, std::max(1.0, max_length));
+    segments.push_back({(float)x, (float)y,
+                        (float)(x + length * std::sin(angle)), (float)(y + length * std::cos(angle))});
+  }
+}
+
+/**
+ * \return how far along the ray it enters [min, max] (0 if it starts inside), INFINITY if it misses
+ */
+static inline float RayBoxEntry(float origin_x,
+                                float origin_y,
+                                float inverse_x,
+                                float inverse_y,
+                                const SegmentBvhNode &node) {
+  const float tx0 = (node.min_x - origin_x) * inverse_x;
+  const float tx1 = (node.max_x - origin_x) * inverse_x;
+  const float ty0 = (node.min_y - origin_y) * inverse_y;
+  const float ty1 = (node.max_y - origin_y) * inverse_y;
+  const float enter = std::max({std::min(tx0, tx1), std::min(ty0, ty1), 0.0f});
+  const float exit = std::min(std::max(tx0, tx1), std::max(ty0, ty1));
+  return enter <= exit ? enter : INFINITY;
+}
+
+void CastSegmentsScalar(const SegmentBvhNode *nodes,
+                        const LineSegment *segments,
+                        const BeamPacketSpan &span,
+                        size_t begin,
+                        size_t end) {
+  uint32_t stack[64];
+  for (size_t beam = begin; beam < end; ++beam) {
+    const float dx = span.direction_x[beam];
+    const float dy = span.direction_y[beam];
+    // An exactly axis aligned beam gets a huge inverse rather than inf, so 0 * inf never makes a NaN
+    const float inverse_x = 1 / (dx != 0 ? dx : 1e-30f);
+    const float inverse_y = 1 / (dy != 0 ? dy : 1e-30f);
+    float range = span.ranges[beam];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0) {
+      const SegmentBvhNode &node = nodes[stack[--size]];
+      if (RayBoxEntry(span.origin_x, span.origin_y, inverse_x, inverse_y, node) >= range) {
+        continue;
+      }
+      if (node.count == 0) {
+        stack[size++] = node.first;
+        stack[size++] = node.first + 1;
+        continue;
+      }
+      for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+        // origin + t * d = p0 + u * (p1 - p0), solved with cross products
+        const LineSegment &segment = segments[i];
+        const float ex = segment.x1 - segment.x0;
+        const float ey = segment.y1 - segment.y0;
+        const float wx = segment.x0 - span.origin_x;
+        const float wy = segment.y0 - span.origin_y;
+        const float denominator = dx * ey - dy * ex;
+        if (denominator == 0) {
+          continue;
+        }
+        const float t = (wx * ey - wy * ex) / denominator;
+        const float u = (wx * dy - wy * dx) / denominator;
+        if (t >= 0 && t < range && u >= 0 && u <= 1) {
+          range = t;
+        }
+      }
+    }
+    span.ranges[beam] = range;
+  }
+}
+
+LidarKernel BestLidarKernel() {
+  // Same instruction set as the fleet kernel, so reuse its detection
+  static const LidarKernel best = BestFleetKernel() == FleetKernel::kAvx2
+      ? LidarKernel::kAvx2 : LidarKernel::kScalar;
+  return best;
+}
+
+const char *LidarKernelName(LidarKernel kernel) {
+  switch (kernel) {
+    case LidarKernel::kScalar:
+      return "scalar";
+    case LidarKernel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+void Lidar::Configure() {
+  sin_angles_.resize(beam_count_);
+  cos_angles_.resize(beam_count_);
+  for (size_t i = 0; i < beam_count_; ++i) {
+    sin_angles_[i] = (float)std::sin(BeamAngle(i));
+    cos_angles_[i] = (float)std::cos(BeamAngle(i));
+  }
+}
+
+double Lidar::BeamAngle(size_t beam) const {
+  // A full circle doesn't repeat the first beam at the end
+  const bool full_circle = fov_ >= 2 * M_PI - 1e-9;
+  const size_t gaps = full_circle ? beam_count_ : std::max<size_t>(1, beam_count_ - 1);
+  return -0.5 * fov_ + fov_ * beam / gaps;
+}
+
+void LidarScans::Resize(size_t robot_count,
+                        size_t beam_count) {
+  robot_count_ = robot_count;
+  beam_count_ = beam_count;
+  ranges_.resize(robot_count * beam_count);
+  poses_.resize(robot_count);
+  const size_t chunks = (robot_count + kLidarChunk - 1) / kLidarChunk;
+  direction_x_.resize(chunks * beam_count);
+  direction_y_.resize(chunks * beam_count);
+}
+
+double CastGridRay(const OccupancyGrid &grid,
+                   double origin_x,
+                   double origin_y,
+                   double direction_x,
+                   double direction_y,
+                   double max_range) {
+  if (!grid.IsOpen()) {
+    return max_range;
+  }
+  // Work in cell units, cell (i, j) is [i, i + 1) x [j, j + 1)
+  const double x = (origin_x - grid.origin_x_) / grid.resolution_;
+  const double y = (origin_y - grid.origin_y_) / grid.resolution_;
+  const double inverse_x = 1 / (direction_x != 0 ? direction_x : 1e-30);
+  const double inverse_y = 1 / (direction_y != 0 ? direction_y : 1e-30);
+  // Where the ray is inside the map
+  const double tx0 = -x * inverse_x;
+  const double tx1 = (grid.width_ - x) * inverse_x;
+  const double ty0 = -y * inverse_y;
+  const double ty1 = (grid.height_ - y) * inverse_y;
+  const double map_enter = std::max(std::min(tx0, tx1), std::min(ty0, ty1));
+  const double map_exit = std::min(std::max(tx0, tx1), std::max(ty0, ty1));
+  const double max_t = max_range / grid.resolution_;
+  const bool outside = map_enter > 0 || map_exit < 0;
+  if (outside && grid.outside_occupied_) {
+    return 0;
+  }
+  if (map_enter > map_exit || map_exit < 0) {
+    return max_range;
+  }
+  const double end = std::min(max_t, map_exit);
+  const int step_x = direction_x >= 0 ? 1 : -1;
+  const int step_y = direction_y >= 0 ? 1 : -1;
+  const double delta_x = std::abs(inverse_x);
+  const double delta_y = std::abs(inverse_y);
+
+  double t = std::max(0.0, map_enter);
+  while (t < end) {
+    // (Re)start the DDA at t, nudged into the cell the ray is entering
+    const double px = x + (t + 1e-9) * direction_x;
+    const double py = y + (t + 1e-9) * direction_y;
+    int64_t cell_x = std::min<int64_t>(std::max<int64_t>((int64_t)std::floor(px), 0), grid.width_ - 1);
+    int64_t cell_y = std::min<int64_t>(std::max<int64_t>((int64_t)std::floor(py), 0), grid.height_ - 1);
+    const int64_t tile_x = cell_x / kOccupancyTileSize;
+    const int64_t tile_y = cell_y / kOccupancyTileSize;
+    const size_t tile = (size_t)tile_y * grid.tiles_x_ + (size_t)tile_x;
+    const double tile_min_x = (double)(tile_x * kOccupancyTileSize);
+    const double tile_min_y = (double)(tile_y * kOccupancyTileSize);
+    if (grid.tile_occupied_[tile] == 0) {
+      // Nothing to hit in this tile, jump to where the ray leaves it
+      const double exit_x = ((step_x > 0 ? tile_min_x + kOccupancyTileSize : tile_min_x) - x) * inverse_x;
+      const double exit_y = ((step_y > 0 ? tile_min_y + kOccupancyTileSize : tile_min_y) - y) * inverse_y;
+      t = std::max(t + 1e-9, std::min(exit_x, exit_y));
+      continue;
+    }
+    // Cell by cell until the ray hits something or leaves the tile
+    const uint8_t *cells = grid.tiles_ + tile * kOccupancyTileCells;
+    double next_x = ((double)(cell_x + (step_x > 0 ? 1 : 0)) - x) * inverse_x;
+    double next_y = ((double)(cell_y + (step_y > 0 ? 1 : 0)) - y) * inverse_y;
+    while (true) {
+      if (cells[(cell_y - tile_y * kOccupancyTileSize) * kOccupancyTileSize + (cell_x - tile_x * kOccupancyTileSize)]
+          >= kOccupiedThreshold) {
+        return t * grid.resolution_;
+      }
+      if (next_x < next_y) {
+        t = next_x;
+        next_x += delta_x;
+        cell_x += step_x;
+      }
+      else {
+        t = next_y;
+        next_y += delta_y;
+        cell_y += step_y;
+      }
+      if (t >= end || cell_x / kOccupancyTileSize != tile_x || cell_y / kOccupancyTileSize != tile_y ||
+          cell_x < 0 || cell_y < 0) {
+        break;
+      }
+    }
+  }
+  // Ran out of range, or off the edge of the map
+  if (max_t > map_exit && grid.outside_occupied_) {
+    return map_exit * grid.resolution_;
+  }
+  return max_range;
+}
+
+void CastScan(const Lidar &lidar,
+              const LidarWorld &world,
+              const Pose2D &pose,
+              float *ranges,
+              float *direction_x,
+              float *direction_y,
+              Rng *rng) {
+  const size_t beams = std::min(lidar.beam_count_, lidar.sin_angles_.size());
+  // Rotate the precomputed beam directions by the heading, no trig per beam
+  const float sin_theta = (float)std::sin(pose.theta);
+  const float cos_theta = (float)std::cos(pose.theta);
+  for (size_t i = 0; i < beams; ++i) {
+    direction_x[i] = sin_theta * lidar.cos_angles_[i] + cos_theta * lidar.sin_angles_[i];
+    direction_y[i] = cos_theta * lidar.cos_angles_[i] - sin_theta * lidar.sin_angles_[i];
+  }
+  const float max_range = (float)lidar.max_range_;
+  for (size_t i = 0; i < beams; ++i) {
+    ranges[i] = world.grid_ != nullptr
+        ? (float)CastGridRay(*world.grid_, pose.x, pose.y, direction_x[i], direction_y[i], max_range)
+        : max_range;
+  }
+  if (world.segments_ != nullptr && !world.segments_->Empty()) {
+    // The grid hits are the starting ranges, so segments further away are never tested
+    BeamPacketSpan span;
+    span.origin_x = (float)pose.x;
+    span.origin_y = (float)pose.y;
+    span.direction_x = direction_x;
+    span.direction_y = direction_y;
+    span.ranges = ranges;
+    const SegmentBvhNode *nodes = world.segments_->nodes_.data();
+    const LineSegment *segments = world.segments_->segments_.data();
+#if defined(SEPT2023_X86_KERNELS)
+    if (lidar.kernel_ == LidarKernel::kAvx2 && BestLidarKernel() == LidarKernel::kAvx2) {
+      CastSegmentsAvx2(nodes, segments, span, 0, beams);
+    }
+    else
+#endif
+    {
+      CastSegmentsScalar(nodes, segments, span, 0, beams);
+    }
+  }
+  if (rng != nullptr && lidar.range_noise_ > 0) {
+    for (size_t i = 0; i < beams; ++i) {
+      if (ranges[i] < max_range) {
+        ranges[i] = std::max(0.0f, ranges[i] + (float)rng->Normal(0, lidar.range_noise_));
+      }
+    }
+  }
+}
+
+void CastFleetScans(const Lidar &lidar,
+                    const LidarWorld &world,
+                    const FleetState &fleet,
+                    LidarScans &scans,
+                    ThreadPool *pool,
+                    uint64_t seed) {
+  if (scans.robot_count_ != fleet.Size() || scans.beam_count_ != lidar.beam_count_) {
+    scans.Resize(fleet.Size(), lidar.beam_count_);
+  }
+  const size_t beams = scans.beam_count_;
+  const uint64_t stream = scans.scan_count_ * scans.robot_count_;
+  auto cast = [&](size_t begin, size_t end) {
+    const size_t chunk = begin / LidarScans::kLidarChunk;
+    float *direction_x = scans.direction_x_.data() + chunk * beams;
+    float *direction_y = scans.direction_y_.data() + chunk * beams;
+    for (size_t robot = begin; robot < end; ++robot) {
+      const Pose2D pose = fleet.GetPose(robot);
+      Rng rng(seed, stream + robot);
+      scans.poses_[robot] = pose;
+      CastScan(lidar, world, pose, scans.ranges_.data() + robot * beams, direction_x, direction_y, &rng);
+    }
+  };
+  if (pool != nullptr) {
+    // With the grain equal to the chunk size the pool's chunks are exactly ours
+    pool->ParallelFor(fleet.Size(), LidarScans::kLidarChunk, cast);
+  }
+  else {
+    for (size_t begin = 0; begin < fleet.Size(); begin += LidarScans::kLidarChunk) {
+      cast(begin, std::min(fleet.Size(), begin + LidarScans::kLidarChunk));
+    }
+  }
+  scans.scan_count_++;
+}
@@ -0,0 +1,150 @@
+#ifndef SEPT2023__LIDAR_H_
+#define SEPT2023__LIDAR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "fleet_state.h"
+#include "lidar_kernels.h"
+#include "occupancy_grid.h"
+#include "random.h"
+#include "unicycle.h"
+
+struct ThreadPool;
+
+/**
+ * Line segment obstacles (walls) in a bounding volume hierarchy, so a beam only tests the
+ * segments in boxes it passes through. Built once, segments are reordered into leaf order.
+ */
+struct SegmentBvh {
+  std::vector<LineSegment> segments_;
+  std::vector<SegmentBvhNode> nodes_;
+  // Leaves are split until they have at most this many segments
+  uint32_t max_leaf_segments_ = 4;
+
+  void Build(const std::vector<LineSegment> &segments);
+  bool Empty() const;
+};
+
+/**
+ * Random straight walls of 1 - max_length m inside the square +-half_extent
+ */
+void RandomSegments(std::vector<LineSegment> &segments,
+                    size_t count,
+                    double half_extent,
+                    double max_length,
+                    uint64_t seed);
+
+enum class LidarKernel {
+  kScalar,
+  kAvx2
+};
+
+/**
+ * \return the fastest segment kernel this CPU (and build) supports, checked once at runtime
+ */
+LidarKernel BestLidarKernel();
+
+const char *LidarKernelName(LidarKernel kernel);
+
+/**
+ * A planar lidar: beam_count_ beams evenly spread over fov_ radians, centred on the heading.
+ * Angles follow Pose2D (clockwise from the heading). A beam that hits nothing reads max_range_.
+ */
+struct Lidar {
+  size_t beam_count_ = 360;
+  double fov_ = 2 * M_PI;
+  double max_range_ = 20;
+  // Scans per second
+  double rate_ = 10;
+  // Std dev added to every hit, m
+  double range_noise_ = 0.01;
+  LidarKernel kernel_ = BestLidarKernel();
+
+  // Beam directions relative to the heading, from Configure
+  std::vector<float> sin_angles_;
+  std::vector<float> cos_angles_;
+
+  /**
+   * Call after changing beam_count_ or fov_
+   */
+  void Configure();
+
+  /**
+   * \return angle of beam i relative to the heading
+   */
+  double BeamAngle(size_t beam) const;
+};
+
+/**
+ * What the beams are cast against, either or both can be null
+ */
+struct LidarWorld {
+  const OccupancyGrid *grid_ = nullptr;
+  const SegmentBvh *segments_ = nullptr;
+};
+
+/**
+ * Scans of many robots, robot r's ranges are ranges_[r * beam_count_, (r + 1) * beam_count_).
+ * Sized once by Resize, casting never allocates.
+ */
+struct LidarScans {
+  // Robots are cast in chunks of this many, one chunk per pool task
+  static constexpr size_t kLidarChunk = 64;
+
+  size_t beam_count_ = 0;
+  size_t robot_count_ = 0;
+  std::vector<float> ranges_;
+  std::vector<Pose2D> poses_;
+  // Scratch beam directions, one set per chunk so chunks can be cast in parallel
+  std::vector<float> direction_x_;
+  std::vector<float> direction_y_;
+  uint64_t scan_count_ = 0;
+
+  void Resize(size_t robot_count,
+              size_t beam_count);
+
+  const float *Ranges(size_t robot) const {
+    return ranges_.data() + robot * beam_count_;
+  }
+};
+
+/**
+ * Distance along a ray to the first occupied cell, at most max_range. Steps cell by cell (DDA)
+ * through tiles that have occupied cells, and jumps straight across tiles that have none. Leaving
+ * the map counts as a hit if the grid's outside is occupied.
+ * \param direction_x, direction_y unit direction
+ */
+double CastGridRay(const OccupancyGrid &grid,
+                   double origin_x,
+                   double origin_y,
+                   double direction_x,
+                   double direction_y,
+                   double max_range);
+
+/**
+ * One scan from pose into ranges (lidar.beam_count_ of them)
+ * \param direction_x, direction_y scratch space for beam_count_ world space directions
+ * \param rng for the range noise, null for none
+ */
+void CastScan(const Lidar &lidar,
+              const LidarWorld &world,
+              const Pose2D &pose,
+              float *ranges,
+              float *direction_x,
+              float *direction_y,
+              Rng *rng);
+
+/**
+ * Scan from every pose of the fleet into scans (resized if the fleet size changed), robots split
+ * across the pool if there is one
+ * \param seed the noise of robot r comes from Rng(seed, scan_count * robots + r)
+ */
+void CastFleetScans(const Lidar &lidar,
+                    const LidarWorld &world,
+                    const FleetState &fleet,
+                    LidarScans &scans,
+                    ThreadPool *pool,
+                    uint64_t seed);
+
+#endif
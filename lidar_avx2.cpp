@@ -0,0 +1,70 @@
+#include <immintrin.h>
+#include <cmath>
+#include "lidar_kernels.h"
+
+/* This file is compiled with -mavx2, nothing in here may run unless the CPU supports it */
+
+void CastSegmentsAvx2(const SegmentBvhNode *nodes,
+                      const LineSegment *segments,
+                      const BeamPacketSpan &span,
+                      size_t begin,
+                      size_t end) {
+  const __m256 origin_x = _mm256_set1_ps(span.origin_x);
+  const __m256 origin_y = _mm256_set1_ps(span.origin_y);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 tiny = _mm256_set1_ps(1e-30f);
+  uint32_t stack[64];
+
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 dx = _mm256_loadu_ps(span.direction_x + i);
+    const __m256 dy = _mm256_loadu_ps(span.direction_y + i);
+    // Same trick as the scalar kernel, exact zeros become tiny so the slabs never make a NaN
+    const __m256 inverse_x = _mm256_div_ps(one, _mm256_blendv_ps(dx, tiny, _mm256_cmp_ps(dx, zero, _CMP_EQ_OQ)));
+    const __m256 inverse_y = _mm256_div_ps(one, _mm256_blendv_ps(dy, tiny, _mm256_cmp_ps(dy, zero, _CMP_EQ_OQ)));
+    __m256 range = _mm256_loadu_ps(span.ranges + i);
+
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0) {
+      const SegmentBvhNode &node = nodes[stack[--size]];
+      // Slab test of all 8 beams against the node's box, enter the node if any of them hit it
+      // closer than their current range
+      __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min_x), origin_x), inverse_x);
+      __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max_x), origin_x), inverse_x);
+      __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.min_y), origin_y), inverse_y);
+      __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.max_y), origin_y), inverse_y);
+      __m256 enter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)), zero);
+      __m256 exit = _mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1));
+      __m256 hit = _mm256_and_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ), _mm256_cmp_ps(enter, range, _CMP_LT_OQ));
+      if (_mm256_movemask_ps(hit) == 0) {
+        continue;
+      }
+      if (node.count == 0) {
+        stack[size++] = node.first;
+        stack[size++] = node.first + 1;
+        continue;
+      }
+      for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+        // origin + t * d = p0 + u * (p1 - p0), see CastSegmentsScalar
+        const LineSegment &segment = segments[j];
+        const __m256 ex = _mm256_set1_ps(segment.x1 - segment.x0);
+        const __m256 ey = _mm256_set1_ps(segment.y1 - segment.y0);
+        const __m256 wx = _mm256_set1_ps(segment.x0 - span.origin_x);
+        const __m256 wy = _mm256_set1_ps(segment.y0 - span.origin_y);
+        const __m256 denominator = _mm256_sub_ps(_mm256_mul_ps(dx, ey), _mm256_mul_ps(dy, ex));
+        // A parallel beam divides by 0, the inf/NaN it makes fails the compares below
+        const __m256 inverse = _mm256_div_ps(one, denominator);
+        const __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(wx, ey), _mm256_mul_ps(wy, ex)), inverse);
+        const __m256 u = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(wx, dy), _mm256_mul_ps(wy, dx)), inverse);
+        __m256 closer = _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, range, _CMP_LT_OQ));
+        closer = _mm256_and_ps(closer, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+        closer = _mm256_and_ps(closer, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+        range = _mm256_blendv_ps(range, t, closer);
+      }
+    }
+    _mm256_storeu_ps(span.ranges + i, range);
+  }
+  CastSegmentsScalar(nodes, segments, span, i, end);
+}
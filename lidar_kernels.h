@@ -0,0 +1,59 @@
+#ifndef SEPT2023__LIDAR_KERNELS_H_
+#define SEPT2023__LIDAR_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Internal to the lidar, shared between lidar.cpp and the SIMD translation units which are
+ * compiled with different instruction set flags.
+ */
+
+struct LineSegment {
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+};
+
+/**
+ * Node of SegmentBvh. A leaf has count > 0 segments starting at first, an inner node count == 0
+ * and its children at first and first + 1
+ */
+struct SegmentBvhNode {
+  float min_x;
+  float min_y;
+  float max_x;
+  float max_y;
+  uint32_t first;
+  uint32_t count;
+};
+
+/**
+ * Beams that all start at the same point (one lidar), cast against the BVH
+ */
+struct BeamPacketSpan {
+  float origin_x;
+  float origin_y;
+  // Unit directions, beam_count of each
+  const float *direction_x;
+  const float *direction_y;
+  // In: the range to give up at (max range or an earlier hit), out: the nearest hit if closer
+  float *ranges;
+};
+
+void CastSegmentsScalar(const SegmentBvhNode *nodes,
+                        const LineSegment *segments,
+                        const BeamPacketSpan &span,
+                        size_t begin,
+                        size_t end);
+
+// Only built on x86, and must only be called if the CPU supports the instruction set.
+// 8 beams per packet walk the tree together, a node is entered if any of them hits it
+void CastSegmentsAvx2(const SegmentBvhNode *nodes,
+                      const LineSegment *segments,
+                      const BeamPacketSpan &span,
+                      size_t begin,
+                      size_t end);
+
+#endif
@@ -0,0 +1,88 @@
+#include "line_renderer.h"
+#include <cmath>
+#include "shader_library.h"
+
+bool LineRenderer::Init() {
+  shader_ = GetShaderLibrary().Load("line_shader.vs", "simple_shader.fs");
+  if (shader_ == nullptr) {
+    return false;
+  }
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, color));
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void LineRenderer::Clear() {
+  vertices_.clear();
+}
+
+void LineRenderer::AddLine(const glm::vec2 &from,
+                           const glm::vec2 &to,
+                           const glm::vec4 &color) {
+  vertices_.push_back({{from.x, from.y, 0}, {color[0], color[1], color[2], color[3]}});
+  vertices_.push_back({{to.x, to.y, 0}, {color[0], color[1], color[2], color[3]}});
+}
+
+void LineRenderer::AddCross(const glm::vec2 &center,
+                            float size,
+                            const glm::vec4 &color) {
+  const float half = 0.5f * size;
+  AddLine(center + glm::vec2(-half, -half), center + glm::vec2(half, half), color);
+  AddLine(center + glm::vec2(-half, half), center + glm::vec2(half, -half), color);
+}
+
+void LineRenderer::AddCovarianceEllipse(const glm::vec2 &center,
+                                        double xx,
+                                        double xy,
+                                        double yy,
+                                        double sigma,
+                                        const glm::vec4 &color,
+                                        int segments) {
+  // Eigen decomposition of the symmetric 2x2 covariance in closed form, the axes of the ellipse
+  // are the eigenvectors scaled by sigma * sqrt(eigenvalue)
+  const double mean = 0.5 * (xx + yy);
+  const double spread = std::sqrt(0.25 * (xx - yy) * (xx - yy) + xy * xy);
+  const double major = sigma * std::sqrt(std::max(0.0, mean + spread));
+  const double minor = sigma * std::sqrt(std::max(0.0, mean - spread));
+  const double angle = 0.5 * std::atan2(2 * xy, xx - yy);
+  const double c = std::cos(angle);
+  const double s = std::sin(angle);
+  glm::vec2 previous;
+  for (int i = 0; i <= segments; ++i) {
+    const double t = 2 * M_PI * i / segments;
+    const double a = major * std::cos(t);
+    const double b = minor * std::sin(t);
+    const glm::vec2 point = center + glm::vec2(a * c - b * s, a * s + b * c);
+    if (i > 0) {
+      AddLine(previous, point, color);
+    }
+    previous = point;
+  }
+}
+
+void LineRenderer::Draw() {
+  if (vertices_.empty() || shader_ == nullptr) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  if (vertices_.size() > capacity_) {
+    capacity_ = vertices_.size() + vertices_.size() / 2;
+  }
+  // Orphan then fill, same as the fleet instance buffer
+  glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(LineVertex), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_.size() * sizeof(LineVertex), vertices_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  shader_->Use();
+  glBindVertexArray(vao_);
+  glDrawArrays(GL_LINES, 0, (GLsizei)vertices_.size());
+  glBindVertexArray(0);
+}
@@ -0,0 +1,66 @@
+#ifndef SEPT2023__LINE_RENDERER_H_
+#define SEPT2023__LINE_RENDERER_H_
+
+#include <vector>
+#include "shader.h"
+
+/**
+ * One end of a line segment, matches the attributes in shaders/line_shader.vs
+ */
+struct LineVertex {
+  float position[3];
+  float color[4];
+};
+
+/**
+ * Immediate mode style debug lines (covariance ellipses, landmarks, ...). Add lines every frame
+ * between Clear and Draw, they are all uploaded and drawn in one GL_LINES call.
+ */
+struct LineRenderer {
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  // Number of LineVertex the buffer can hold before it needs to grow
+  size_t capacity_ = 0;
+  // CPU copy of this frame's lines, keeps its capacity between frames
+  std::vector<LineVertex> vertices_;
+
+  /**
+   * \return false if the shader failed to load
+   */
+  bool Init();
+
+  void Clear();
+
+  void AddLine(const glm::vec2 &from,
+               const glm::vec2 &to,
+               const glm::vec4 &color);
+
+  /**
+   * An x shaped marker
+   * \param size length of each arm, m
+   */
+  void AddCross(const glm::vec2 &center,
+                float size,
+                const glm::vec4 &color);
+
+  /**
+   * The sigma contour of a 2D gaussian, e.g. 2 for the ~86% confidence ellipse
+   * \param xx, xy, yy the position covariance
+   */
+  void AddCovarianceEllipse(const glm::vec2 &center,
+                            double xx,
+                            double xy,
+                            double yy,
+                            double sigma,
+                            const glm::vec4 &color,
+                            int segments = 48);
+
+  /**
+   * Upload and draw everything added since Clear, the camera comes from the FrameUniformBuffer
+   */
+  void Draw();
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "localization.h"
+
+void Localization::Reset(const Pose2D &pose,
+                         uint64_t seed) {
+  PoseCovariance covariance = PoseCovariance::Zero();
+  covariance.diagonal() << 0.01, 0.01, 0.001;
+  ekf_.Reset(pose, covariance);
+  ukf_.Reset(pose, covariance);
+  particle_seed_ = seed;
+  if (estimator_ == EstimatorType::kParticle) {
+    particles_.Reset(particle_count_, pose, covariance, seed);
+    particles_.Estimate(particle_estimate_, particle_covariance_);
+  }
+  rng_.Seed(seed, 0);
+  landmark_timer_ = 0;
+  gnss_timer_ = 0;
+}
+
+void Localization::SetEstimator(EstimatorType estimator) {
+  if (estimator == estimator_) {
+    return;
+  }
+  // Nothing has been tracked while off, the caller should Reset
+  if (estimator_ != EstimatorType::kNone) {
+    const Pose2D pose = Estimate();
+    const PoseCovariance covariance = Covariance();
+    if (estimator == EstimatorType::kEkf) {
+      ekf_.Reset(pose, covariance);
+    }
+    else if (estimator == EstimatorType::kUkf) {
+      ukf_.Reset(pose, covariance);
+    }
+  }
+  if (estimator == EstimatorType::kParticle) {
+    particles_.Reset(particle_count_, Estimate(), Covariance(), particle_seed_);
+    particles_.Estimate(particle_estimate_, particle_covariance_);
+  }
+  estimator_ = estimator;
+}
+
+void Localization::PlaceLandmarks(size_t count,
+                                  double half_extent,
+                                  uint64_t seed) {
+  Rng rng(seed, 1);
+  landmarks_.clear();
+  for (size_t i = 0; i < count; ++i) {
+    landmarks_.emplace_back(rng.Uniform(-half_extent, half_extent), rng.Uniform(-half_extent, half_extent));
+  }
+}
+
+void Localization::Step(const Pose2D &true_pose,
+                        double linear_velocity,
+                        double angular_velocity,
+                        double dt) {
+  if (estimator_ == EstimatorType::kNone) {
+    return;
+  }
+  // The robot only knows its wheel odometry, which is off by some noise every step
+  const double measured_v = linear_velocity + rng_.Normal(0, linear_noise_);
+  const double measured_w = angular_velocity + rng_.Normal(0, angular_noise_);
+  if (estimator_ == EstimatorType::kEkf) {
+    ekf_.Predict(measured_v, measured_w, dt, linear_noise_, angular_noise_);
+  }
+  else if (estimator_ == EstimatorType::kUkf) {
+    ukf_.Predict(measured_v, measured_w, dt, linear_noise_, angular_noise_);
+  }
+  else {
+    particles_.Predict(measured_v, measured_w, dt, linear_noise_, angular_noise_);
+  }
+
+  const PoseVector truth(true_pose.x, true_pose.y, true_pose.theta);
+  landmark_timer_ -= dt;
+  if (landmark_timer_ <= 0) {
+    landmark_timer_ += landmark_period_;
+    seen_measurements_.clear();
+    seen_landmarks_.clear();
+    for (const Eigen::Vector2d &landmark : landmarks_) {
+      Eigen::Vector2d measurement = PredictRangeBearing(truth, landmark);
+      if (measurement[0] > landmark_range_) {
+        continue;
+      }
+      measurement[0] += rng_.Normal(0, range_noise_);
+      measurement[1] += rng_.Normal(0, bearing_noise_);
+      if (estimator_ == EstimatorType::kParticle) {
+        // Outliers just get a low weight, there is no gate
+        seen_measurements_.push_back(measurement);
+        seen_landmarks_.push_back(landmark);
+        updates_++;
+        continue;
+      }
+      bool accepted = estimator_ == EstimatorType::kEkf
+          ? ekf_.UpdateRangeBearing(measurement, landmark, range_noise_, bearing_noise_)
+          : ukf_.UpdateRangeBearing(measurement, landmark, range_noise_, bearing_noise_);
+      updates_++;
+      rejected_ += accepted ? 0 : 1;
+    }
+    if (estimator_ == EstimatorType::kParticle) {
+      particles_.UpdateRangeBearing(seen_measurements_.data(), seen_landmarks_.data(), seen_measurements_.size(),
+                                    range_noise_, bearing_noise_);
+    }
+  }
+
+  if (gnss_period_ > 0) {
+    gnss_timer_ -= dt;
+    if (gnss_timer_ <= 0) {
+      gnss_timer_ += gnss_period_;
+      const Eigen::Vector2d measurement(true_pose.x + rng_.Normal(0, gnss_noise_),
+                                        true_pose.y + rng_.Normal(0, gnss_noise_));
+      if (estimator_ == EstimatorType::kParticle) {
+        particles_.UpdatePosition(measurement, gnss_noise_);
+        updates_++;
+      }
+      else {
+        bool accepted = estimator_ == EstimatorType::kEkf
+            ? ekf_.UpdatePosition(measurement, gnss_noise_)
+            : ukf_.UpdatePosition(measurement, gnss_noise_);
+        updates_++;
+        rejected_ += accepted ? 0 : 1;
+      }
+    }
+  }
+  if (estimator_ == EstimatorType::kParticle) {
+    particles_.Estimate(particle_estimate_, particle_covariance_);
+  }
+}
+
+Pose2D Localization::Estimate() const {
+  switch (estimator_) {
+    case EstimatorType::kUkf:
+      return ukf_.Pose();
+    case EstimatorType::kParticle:
+      return particle_estimate_;
+    default:
+      return ekf_.Pose();
+  }
+}
+
+const PoseCovariance &Localization::Covariance() const {
+  switch (estimator_) {
+    case EstimatorType::kUkf:
+      return ukf_.covariance_;
+    case EstimatorType::kParticle:
+      return particle_covariance_;
+    default:
+      return ekf_.covariance_;
+  }
+}
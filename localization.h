@@ -0,0 +1,93 @@
+#ifndef SEPT2023__LOCALIZATION_H_
+#define SEPT2023__LOCALIZATION_H_
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include "ekf.h"
+#include "particle_filter.h"
+#include "random.h"
+
+enum class EstimatorType {
+  // Don't run a filter at all, saves the time when only the true motion matters
+  kNone,
+  kEkf,
+  kUkf,
+  kParticle
+};
+
+/**
+ * Runs a pose estimator next to the simulator. Each step the true motion is turned into noisy
+ * odometry for the prediction, and at fixed rates into noisy range/bearing measurements of the
+ * landmarks in range and noisy GNSS fixes. Nothing allocates once the landmarks are placed.
+ * Angles are radians, noise values are std devs.
+ */
+struct Localization {
+  EstimatorType estimator_ = EstimatorType::kEkf;
+  Ekf ekf_;
+  Ukf ukf_;
+  ParticleFilter particles_;
+  // Set before switching to the particle filter, its pool_ can be set to spread it over threads
+  size_t particle_count_ = 20000;
+  // Kept up to date every step, the particle filter has no closed form mean/covariance
+  Pose2D particle_estimate_;
+  PoseCovariance particle_covariance_ = PoseCovariance::Zero();
+  uint64_t particle_seed_ = 0;
+  Rng rng_;
+
+  // Odometry noise, m/s and rad/s
+  double linear_noise_ = 0.05;
+  double angular_noise_ = 2 * M_PI / 180;
+  // Landmarks at known positions, seen up to landmark_range_ away every landmark_period_ seconds
+  std::vector<Eigen::Vector2d> landmarks_;
+  double landmark_range_ = 8;
+  double landmark_period_ = 0.1;
+  double range_noise_ = 0.1;
+  double bearing_noise_ = 2 * M_PI / 180;
+  // GNSS position fix every gnss_period_ seconds, 0 for none
+  double gnss_period_ = 1;
+  double gnss_noise_ = 0.5;
+
+  // Time until the next measurement of each kind
+  double landmark_timer_ = 0;
+  double gnss_timer_ = 0;
+  uint64_t updates_ = 0;
+  // Measurements thrown out by the gate
+  uint64_t rejected_ = 0;
+  // Landmarks seen this step, all applied to the particle filter in one pass
+  std::vector<Eigen::Vector2d> seen_measurements_;
+  std::vector<Eigen::Vector2d> seen_landmarks_;
+
+  /**
+   * Start every filter at pose with a small covariance
+   */
+  void Reset(const Pose2D &pose,
+             uint64_t seed);
+
+  /**
+   * Switch filters, the new one carries on from the old one's estimate
+   */
+  void SetEstimator(EstimatorType estimator);
+
+  /**
+   * Random landmarks in the square +-half_extent around the origin
+   */
+  void PlaceLandmarks(size_t count,
+                      double half_extent,
+                      uint64_t seed);
+
+  /**
+   * Advance the estimate by one sim step
+   * \param true_pose the simulator's pose after the step
+   * \param linear_velocity, angular_velocity the true (commanded) velocities during the step
+   */
+  void Step(const Pose2D &true_pose,
+            double linear_velocity,
+            double angular_velocity,
+            double dt);
+
+  Pose2D Estimate() const;
+  const PoseCovariance &Covariance() const;
+};
+
+#endif
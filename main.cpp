@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
@@ -6,36 +8,327 @@
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 #include "camera.h"
+#include "fleet_renderer.h"
+#include "fleet_step.h"
+#include "frame_capture.h"
+#include "gpu_profiler.h"
+#include "grid_renderer.h"
+#include "line_renderer.h"
+#include "offscreen_target.h"
+#include "planner.h"
+#include "point_renderer.h"
+#include "profiler_panel.h"
 #include "robot.h"
+#include "shader_library.h"
+#include "sim_thread.h"
+#include "static_batch.h"
+#include "telemetry_panel.h"
+#include "trail_renderer.h"
 
 static GLFWwindow *window;
 static Camera camera;
 void ScrollCallback(GLFWwindow *win,
                     double xoffset,
                     double yoffset);
-static void SetupWindow();
+static bool SetupWindow(int headless_api);
 
-int main() {
-  SetupWindow();
+/**
+ * Usage: sept2023 [--fleet N] [--time-scale X|max] [--render-hz X] [--no-render]
+ *                 [--record file] [--replay file] [--map file] [--walls N]
+ *                 [--offscreen WxH] [--headless egl|osmesa] [--capture path] [--frames N]
+ *   --time-scale  sim seconds per wall second, max runs the sim as fast as possible
+ *   --render-hz   only draw this many frames per second (default every vsync)
+ *   --no-render   don't draw the robots at all, just the UI at a low rate
+ *   --record      record every sim step to file (compressed)
+ *   --replay      open a recorded file for playback
+ *   --map         occupancy grid to drive around in (see make_map), default is a random 100 m
+ *                 square. Opened read only
+ *   --walls       add N random walls the lidar sees, drawn as static geometry (default 0)
+ *   --offscreen   draw the scene into a WxH framebuffer, shown scaled to fit the window
+ *   --headless    no window at all, a GL context from EGL or OSMesa (servers without a display).
+ *                 Draws offscreen, 1200x800 unless --offscreen says otherwise
+ *   --capture     write every frame of the scene (no UI) to path: PNGs if it has one %d for the
+ *                 frame number, e.g. frames/%06d.png, or one video if it ends in .y4m. Draws offscreen
+ *   --frames      quit after N frames, e.g. to capture a fixed length clip headless
+ */
+int main(int argc, char **argv) {
+  int fleet_size = 0;
+  double time_scale = 1;
+  // 0 renders every vsync
+  double render_hz = 0;
+  bool draw_scene = true;
+  char record_path[256] = "trajectory.bin";
+  char state_path[256] = "sim_state.bin";
+  bool record_on_start = false;
+  bool replay_on_start = false;
+  const char *map_path = nullptr;
+  size_t wall_count = 0;
+  // 0 draws straight into the window
+  int offscreen_width = 0;
+  int offscreen_height = 0;
+  // 0 for a window, otherwise the GLFW context API of the hidden context
+  int headless_api = 0;
+  const char *capture_path = nullptr;
+  // 0 runs until the window is closed
+  uint64_t frame_limit = 0;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--fleet") == 0) {
+      fleet_size = atoi(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--time-scale") == 0) {
+      ++i;
+      time_scale = strcmp(argv[i], "max") == 0 ? 0 : atof(argv[i]);
+    }
+    else if (has_value && strcmp(argv[i], "--render-hz") == 0) {
+      render_hz = atof(argv[++i]);
+    }
+    else if (has_value && (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0)) {
+      record_on_start = strcmp(argv[i], "--record") == 0;
+      replay_on_start = !record_on_start;
+      snprintf(record_path, sizeof(record_path), "%s", argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--map") == 0) {
+      map_path = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--walls") == 0) {
+      wall_count = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--offscreen") == 0) {
+      if (sscanf(argv[++i], "%dx%d", &offscreen_width, &offscreen_height) != 2) {
+        printf("ERROR: --offscreen wants WIDTHxHEIGHT, not %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (has_value && strcmp(argv[i], "--headless") == 0) {
+      ++i;
+      if (strcmp(argv[i], "egl") == 0) {
+        headless_api = GLFW_EGL_CONTEXT_API;
+      }
+      else if (strcmp(argv[i], "osmesa") == 0) {
+        headless_api = GLFW_OSMESA_CONTEXT_API;
+      }
+      else {
+        printf("Usage: %s [--fleet N] [--time-scale X|max] [--render-hz X] [--no-render]\n"
+               "       [--record file] [--replay file] [--map file] [--walls N]\n"
+               "       [--offscreen WxH] [--headless egl|osmesa] [--capture path] [--frames N]\n", argv[0]);
+        return 1;
+      }
+    }
+    else if (has_value && strcmp(argv[i], "--capture") == 0) {
+      capture_path = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--frames") == 0) {
+      frame_limit = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--no-render") == 0) {
+      draw_scene = false;
+      if (render_hz <= 0) {
+        render_hz = 10;
+      }
+    }
+  }
+
+  if ((headless_api != 0 || capture_path != nullptr) && offscreen_width <= 0) {
+    offscreen_width = 1200;
+    offscreen_height = 800;
+  }
+
+  if (!SetupWindow(headless_api)) {
+    return 1;
+  }
+  OffscreenTarget offscreen;
+  if (offscreen_width > 0 && !offscreen.Init(offscreen_width, offscreen_height)) {
+    return 1;
+  }
+  // Frames go GPU -> pixel buffers -> capture writer thread -> disk, the render thread only
+  // queues the read back and copies out finished frames
+  FrameCapture capture;
+  if (capture_path != nullptr &&
+      !capture.Open(capture_path, offscreen.width_, offscreen.height_, render_hz > 0 ? render_hz : 60)) {
+    return 1;
+  }
   camera.position_ = glm::vec3(0, 0, 10);
   camera.Update();
+  // Camera matrices, shared by all the shaders
+  FrameUniformBuffer frame_uniforms;
+  frame_uniforms.Init();
 
   Robot robot;
   robot.length_ = 1;
   robot.width_ = 0.5;
   robot.Init();
 
+  // Where the robot thinks it is (from the sim thread's pose filter), its uncertainty and the
+  // landmarks it measures
+  Robot estimated_robot;
+  estimated_robot.length_ = robot.length_;
+  estimated_robot.width_ = robot.width_;
+  estimated_robot.color_ = glm::vec4(0, 0.7, 0, 1);
+  estimated_robot.Init();
+  LineRenderer lines;
+  lines.Init();
+  PointRenderer particle_points;
+  particle_points.Init();
+  const char *estimator_names[] = {"None", "EKF", "UKF", "Particle"};
+  int estimator_index = (int)EstimatorType::kEkf;
+  bool lidar_enabled = true;
+  bool fleet_lidar = false;
+  bool fleet_collisions = true;
+
+  // Extra robots driving around on their own, drawn with one instanced draw call
+  FleetRenderer fleet_renderer;
+  fleet_renderer.Init();
+  // Auto picks boxes, points or the density heatmap from how big a robot is on screen
+  const char *fleet_lod_names[] = {"Auto", "Boxes", "Points", "Density"};
+  int fleet_lod_index = 0;
+  // The recent path of every fleet robot, simplified to what the zoom can show and drawn as one
+  // streamed batch of line strips
+  bool draw_trails = false;
+  int trail_length = 512;
+  float trail_tolerance = 0.5f;
+  TrailBuffer trails;
+  trails.Resize(0, trail_length);
+  TrailStrips trail_strips;
+  TrailRenderer trail_renderer;
+  trail_renderer.Init();
+  ThreadPool trail_pool(std::max(1u, std::thread::hardware_concurrency() / 2));
+  // Sim time of the poses last added to the trails, they only grow when the sim moves
+  double trail_time = -1;
+
+  // The world the main robot drives around in
+  OccupancyGrid grid;
+  if (map_path == nullptr || !grid.Open(map_path, false)) {
+    grid.Create(2000, 2000, 0.05, -50, -50);
+    AddRandomObstacles(grid, 150, 2023, 0, 0, 3);
+  }
+  GridRenderer grid_renderer;
+  grid_renderer.Init();
+  // Paths to goals, searched on the planner's own threads against a distance field of the grid
+  // that is rebuilt whenever the grid changes
+  PlannerService planner(std::max(1u, std::thread::hardware_concurrency() / 2));
+  planner.BuildField(grid);
+  const char *planner_names[] = {"Grid A*", "Hybrid A*"};
+  int planner_index = (int)PlannerType::kHybrid;
+  double plan_goal[3] = {10, 10, 0};
+  bool plan_requested = false;
+  uint64_t plan_id = 0;
+  PlanResult plan;
+  // The sim thread drives the robot along each plan that is found, until a key is pressed
+  const char *controller_names[] = {"Pure pursuit", "MPPI"};
+  int controller_index = (int)TrackingController::kPurePursuit;
+  bool follow_plans = true;
+  // Walls on top of the grid, only the lidar sees them (the robot drives through). Drawn as one
+  // static batch, culled to what the camera sees
+  std::vector<LineSegment> walls;
+  RandomSegments(walls, wall_count, 45, 8, 2023);
+  SegmentBvh wall_bvh;
+  wall_bvh.Build(walls);
+  StaticBatch world_batch;
+  const uint32_t wall_material = world_batch.AddMaterial(
+      GetShaderLibrary().Load("static_shader.vs", "simple_shader.fs"), GL_TRIANGLES, false);
+  for (const LineSegment &wall : walls) {
+    world_batch.AddWall(wall_material, wall.x0, wall.y0, wall.x1, wall.y1, 0.15f, glm::vec4(0.4, 0.3, 0.2, 1));
+  }
+  world_batch.Upload();
+
+  // The simulation runs on its own thread at a fixed rate, we only send it commands and
+  // draw the latest state it has published
+  SimThread sim_thread;
+  sim_thread.dt_ = 0.01;
+  sim_thread.grid_ = &grid;
+  sim_thread.planner_ = &planner;
+  sim_thread.segments_ = wall_bvh.Empty() ? nullptr : &wall_bvh;
+  sim_thread.state_.sim_.length_ = robot.length_;
+  sim_thread.state_.sim_.width_ = robot.width_;
+  sim_thread.Start();
+  SimCommand command;
+  command.type_ = SimCommandType::kSpawnFleet;
+  command.fleet_size_ = fleet_size > 0 ? fleet_size : 0;
+  sim_thread.PushCommand(command);
+  command.type_ = SimCommandType::kSetTimeScale;
+  command.time_scale_ = time_scale;
+  sim_thread.PushCommand(command);
+
+  // Presets for the time scale combo, 0 is as fast as possible
+  const char *time_scale_names[] = {"1x", "10x", "100x", "Max"};
+  const double time_scale_values[] = {1, 10, 100, 0};
+  int time_scale_index = -1;
+  for (int i = 0; i < 4; ++i) {
+    if (time_scale_values[i] == time_scale) {
+      time_scale_index = i;
+    }
+  }
+  double last_frame_time = glfwGetTime();
+
+  // Recording goes sim thread -> recorder ring buffer -> recorder writer thread -> file.
+  // Replay overrides what is drawn with the recorded poses at replay_time
+  TrajectoryRecorder recorder(1 << 18);
+  bool record_compress = true;
+  bool stop_recording_pending = false;
+  if (record_on_start && recorder.Open(record_path, record_compress)) {
+    command.type_ = SimCommandType::kSetRecorder;
+    command.recorder_ = &recorder;
+    sim_thread.PushCommand(command);
+  }
+  TrajectoryReplay replay;
+  if (replay_on_start) {
+    replay.Open(record_path);
+  }
+  double replay_time = replay.StartTime();
+  bool replay_playing = false;
+  std::vector<TrajectoryRecord> replay_records;
+  FleetState replay_fleet;
+
+  // Frame times for the telemetry window, the sim thread keeps its own history
+  TelemetryRing frame_telemetry(1 << 16, kFrameTelemetryChannelCount);
+  TelemetryPanel telemetry_panel;
+  double previous_frame_start = glfwGetTime();
+  // Where the frame time goes, CPU scopes on each thread and GL timer queries on the GPU
+  SEPT2023_PROFILE_THREAD_NAME("render");
+  GpuProfiler gpu_profiler;
+  gpu_profiler.Init();
+  ProfilerPanel profiler_panel;
+
+  uint64_t frame_count = 0;
   bool simulation_running = false;
   double linear_velocity = 0;
   double angular_velocity = 0;
   const double linear_velocity_step = 0.1;
   const double angular_velocity_step = 0.5;
-  const double simulation_dt = 0.01;
   while (!glfwWindowShouldClose(window)) {
     // Start of frame
-    glfwPollEvents();
+    SEPT2023_PROFILE_SCOPE("frame");
+    if (render_hz > 0) {
+      SEPT2023_PROFILE_SCOPE("wait events");
+      // Decimated rendering, keep handling window events until the next frame is due
+      const double next_frame_time = last_frame_time + 1.0 / render_hz;
+      double time = glfwGetTime();
+      while (time < next_frame_time && !glfwWindowShouldClose(window)) {
+        glfwWaitEventsTimeout(next_frame_time - time);
+        time = glfwGetTime();
+      }
+      last_frame_time = time;
+    }
+    else {
+      SEPT2023_PROFILE_SCOPE("poll events");
+      glfwPollEvents();
+    }
+    double frame_sample[kFrameTelemetryChannelCount];
+    frame_sample[kFrameTelemetryTime] = glfwGetTime();
+    frame_sample[kFrameTelemetryFrameTime] = (frame_sample[kFrameTelemetryTime] - previous_frame_start) * 1000;
+    previous_frame_start = frame_sample[kFrameTelemetryTime];
+    frame_telemetry.Push(frame_sample);
+    if (offscreen.fbo_ != 0) {
+      offscreen.Bind();
+    }
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
+    {
+      SEPT2023_PROFILE_SCOPE("shader reload");
+      // Relinks any shader whose file was saved since last frame
+      GetShaderLibrary().Update();
+    }
 
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -55,32 +348,166 @@ int main() {
       ImGui::InputDouble("Linear Velocity", &linear_velocity, 0, 0, "%.2f m/s");
       ImGui::InputDouble("Angular Velocity", &angular_velocity, 0, 0, "%.2f deg/s");
       ImGui::EndDisabled();
+
+      ImGui::Separator();
+      ImGui::InputInt("Fleet size", &fleet_size, 1000, 10000);
+      if (ImGui::Button("Spawn fleet")) {
+        command.type_ = SimCommandType::kSpawnFleet;
+        command.fleet_size_ = fleet_size > 0 ? fleet_size : 0;
+        sim_thread.PushCommand(command);
+      }
+      if (ImGui::Checkbox("Fleet collisions", &fleet_collisions)) {
+        command.type_ = SimCommandType::kSetFleetCollisions;
+        command.fleet_collisions_ = fleet_collisions;
+        sim_thread.PushCommand(command);
+      }
+      ImGui::Text("Fleet kernel: %s", FleetKernelName(BestFleetKernel()));
+      const ShaderLibrary &shaders = GetShaderLibrary();
+      ImGui::Text("Shaders: %zu programs, %llu compiled, %llu cached, %llu shared, %llu reloads",
+                  shaders.programs_.size(), (unsigned long long)shaders.compiles_,
+                  (unsigned long long)shaders.binary_loads_, (unsigned long long)shaders.shared_,
+                  (unsigned long long)shaders.reloads_);
+
+      ImGui::Separator();
+      ImGui::BeginDisabled(!grid.writable_);
+      if (ImGui::Button("Add obstacles")) {
+        command.type_ = SimCommandType::kAddObstacles;
+        command.obstacle_count_ = 50;
+        sim_thread.PushCommand(command);
+      }
+      ImGui::EndDisabled();
+      ImGui::Text("Map: %ux%u cells, %.2f m, %u tiles uploaded", grid.width_, grid.height_, grid.resolution_,
+                  (unsigned)grid_renderer.uploads_);
+
+      ImGui::Separator();
+      bool lidar_changed = ImGui::Checkbox("Lidar", &lidar_enabled);
+      lidar_changed |= ImGui::Checkbox("Fleet lidar", &fleet_lidar);
+      if (lidar_changed) {
+        command.type_ = SimCommandType::kSetLidar;
+        command.lidar_ = lidar_enabled;
+        command.fleet_lidar_ = fleet_lidar;
+        sim_thread.PushCommand(command);
+      }
+      ImGui::Text("Lidar: %zu beams at %.0f Hz, %s", sim_thread.lidar_.beam_count_, sim_thread.lidar_.rate_,
+                  LidarKernelName(sim_thread.lidar_.kernel_));
+
+      ImGui::Separator();
+      ImGui::Combo("Planner", &planner_index, planner_names, 2);
+      ImGui::InputScalarN("Goal (x, y, deg)", ImGuiDataType_Double, plan_goal, 3, nullptr, nullptr, "%.1f");
+      ImGui::Checkbox("Follow plans", &follow_plans);
+      ImGui::SameLine();
+      ImGui::Combo("Controller", &controller_index, controller_names, 2);
+      plan_requested = ImGui::Button("Plan to goal");
+      if (plan.id_ != 0) {
+        ImGui::SameLine();
+        if (plan.found_) {
+          ImGui::Text("%.1f m, %zu expanded in %.1f ms", plan.length_, plan.expanded_, plan.seconds_ * 1e3);
+        }
+        else {
+          ImGui::Text("No path (%zu expanded)", plan.expanded_);
+        }
+      }
+
+      ImGui::Separator();
+      if (ImGui::Combo("Estimator", &estimator_index, estimator_names, 4)) {
+        command.type_ = SimCommandType::kSetEstimator;
+        command.estimator_ = (EstimatorType)estimator_index;
+        sim_thread.PushCommand(command);
+      }
+
+      ImGui::Separator();
+      if (ImGui::Combo("Time scale", &time_scale_index, time_scale_names, 4)) {
+        command.type_ = SimCommandType::kSetTimeScale;
+        command.time_scale_ = time_scale_values[time_scale_index];
+        sim_thread.PushCommand(command);
+      }
+      ImGui::InputDouble("Render rate (0 = vsync)", &render_hz, 0, 0, "%.1f Hz");
+      ImGui::Checkbox("Draw robots", &draw_scene);
+      ImGui::Combo("Fleet detail", &fleet_lod_index, fleet_lod_names, 4);
+      ImGui::Checkbox("Fleet trails", &draw_trails);
+      if (ImGui::InputInt("Trail points", &trail_length, 64, 512)) {
+        trail_length = std::max(trail_length, 2);
+        trails.Resize(trails.robot_count_, trail_length);
+      }
+      ImGui::SliderFloat("Trail tolerance", &trail_tolerance, 0.1f, 4.0f, "%.1f px");
+
+      ImGui::Separator();
+      ImGui::InputText("Trajectory file", record_path, sizeof(record_path));
+      if (!recorder.IsOpen()) {
+        ImGui::Checkbox("Compress", &record_compress);
+        ImGui::SameLine();
+        ImGui::Checkbox("Record fleet", &recorder.record_fleet_);
+        if (ImGui::Button("Start recording") && recorder.Open(record_path, record_compress)) {
+          command.type_ = SimCommandType::kSetRecorder;
+          command.recorder_ = &recorder;
+          sim_thread.PushCommand(command);
+        }
+      }
+      else {
+        if (!stop_recording_pending && ImGui::Button("Stop recording")) {
+          command.type_ = SimCommandType::kSetRecorder;
+          command.recorder_ = nullptr;
+          sim_thread.PushCommand(command);
+          stop_recording_pending = true;
+        }
+        ImGui::Text("Records written: %llu dropped: %llu",
+                    (unsigned long long)recorder.written_.load(),
+                    (unsigned long long)recorder.dropped_.load());
+      }
+      if (!replay.IsOpen()) {
+        if (ImGui::Button("Open replay") && replay.Open(record_path)) {
+          replay_time = replay.StartTime();
+        }
+      }
+      else {
+        double start_time = replay.StartTime();
+        double end_time = replay.EndTime();
+        ImGui::SliderScalar("Replay time", ImGuiDataType_Double, &replay_time, &start_time, &end_time, "%.2f s");
+        ImGui::Checkbox("Play", &replay_playing);
+        ImGui::SameLine();
+        if (ImGui::Button("Close replay")) {
+          replay.Close();
+        }
+      }
+
+      ImGui::Separator();
+      ImGui::InputText("State file", state_path, sizeof(state_path));
+      if (ImGui::Button("Save state")) {
+        command.type_ = SimCommandType::kSaveState;
+        snprintf(command.state_path_, sizeof(command.state_path_), "%s", state_path);
+        sim_thread.PushCommand(command);
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Load state")) {
+        command.type_ = SimCommandType::kLoadState;
+        snprintf(command.state_path_, sizeof(command.state_path_), "%s", state_path);
+        sim_thread.PushCommand(command);
+      }
     }
     if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Space))) {
       simulation_running = !simulation_running;
+      command.type_ = SimCommandType::kSetRunning;
+      command.running_ = simulation_running;
+      sim_thread.PushCommand(command);
     }
 
+    const float aspect = offscreen.fbo_ != 0 ? (float)offscreen.width_ / (float)offscreen.height_
+                                             : (float)1200 / (float)800;
     glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_),
-                                            (float)1200 / (float)800,
+                                            aspect,
                                             0.1f,
                                             100.0f);
-    robot.shader_.SetMat4("projection", projection);
-    robot.shader_.SetMat4("view", camera.GetViewMatrix());
-
-    // Keep theta between [0, 360)
-    if (robot.position_[2] >= 360 * M_PI / 180) {
-      robot.position_[2] -= 360 * M_PI / 180;
-    }
-    else if (robot.position_[2] < 0) {
-      robot.position_[2] += 360 * M_PI / 180;
-    }
+    frame_uniforms.Update(projection, camera.GetViewMatrix());
+    const Frustum frustum = camera.GetFrustum(projection);
 
     // TODO: Add limits on each linear/angular velocities
+    const double last_linear_velocity = linear_velocity;
+    const double last_angular_velocity = angular_velocity;
     if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_R))) {
       linear_velocity = 0;
       angular_velocity = 0;
-      robot.position_ = glm::vec3(0, 0, 0);
-      robot.UpdateModelMatrix();
+      command.type_ = SimCommandType::kReset;
+      sim_thread.PushCommand(command);
     }
     if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_W))) {
       linear_velocity += linear_velocity_step;
@@ -102,48 +529,228 @@ int main() {
       angular_velocity = 0;
     }
 
-    if (simulation_running) {
-      /*
-       * We want theta to be:
-       * 1. Positive rotation means clockwise (not counter clockwise)
-       * 2. With respect to the Y axis (up/down on the screen, X is left/right)
-       * This way it is the same as heading in geodetic/gnss/ins navigation. Heading angle
-       * is the angle with respect to North axis (up/down) and positive heading rotation means going clockwise
-       * This is why the calculations below for X and Y position and swapped (cosine instead of sine, and vice
-       * versa).
-       */
-      double w = angular_velocity * M_PI / 180 * simulation_dt;
-      double v = linear_velocity * simulation_dt;
-      // Near 0, so assume driving in a straight line
-      if (abs(w) < 1.0e-5 ) {
-        double y = robot.position_[1] += v * cos(robot.position_[2]);
-        double x = robot.position_[0] += v * sin(robot.position_[2]);
-        robot.position_ = glm::vec3(x, y, robot.position_[2]);
+    if (linear_velocity != last_linear_velocity || angular_velocity != last_angular_velocity) {
+      // The UI works in deg/s, the simulator in rad/s
+      command.type_ = SimCommandType::kSetVelocity;
+      command.linear_velocity_ = linear_velocity;
+      command.angular_velocity_ = angular_velocity * M_PI / 180;
+      sim_thread.PushCommand(command);
+    }
+
+    // Draw one sim step behind, in between the last two states the sim thread gave us
+    const SimSnapshot &snapshot = sim_thread.LatestSnapshot();
+    const double now = SteadyClockSeconds();
+    Pose2D pose = InterpolateSnapshot(snapshot, now);
+    if (stop_recording_pending && !snapshot.recording_) {
+      // The sim thread has let go of the recorder, safe to finish the file
+      recorder.Close();
+      stop_recording_pending = false;
+    }
+
+    // Plans start from where the robot is now, the result shows up a few frames later
+    if (plan_requested) {
+      PlanRequest request;
+      request.type_ = (PlannerType)planner_index;
+      request.start_ = snapshot.pose_;
+      request.goal_.x = plan_goal[0];
+      request.goal_.y = plan_goal[1];
+      request.goal_.theta = WrapAngle(plan_goal[2] * M_PI / 180);
+      request.radius_ = 0.5 * std::hypot(robot.length_, robot.width_);
+      plan_id = planner.Request(request);
+    }
+    {
+      PlanResult result;
+      while (planner.PopResult(result)) {
+        if (result.id_ != plan_id) {
+          continue;
+        }
+        plan = std::move(result);
+        if (plan.found_ && follow_plans) {
+          sim_thread.PushPath(plan.path_, (TrackingController)controller_index);
+        }
       }
-      else {
-        double theta_old = robot.position_[2];
-        double r = v / w;
-        robot.position_[2] += w;
-        robot.position_[1] += r * (sin(robot.position_[2]) - sin(theta_old));
-        robot.position_[0] += -r * (cos(robot.position_[2]) - cos(theta_old));
+    }
+
+    const bool replaying = replay.IsOpen();
+    if (replaying) {
+      if (replay_playing) {
+        replay_time = std::min(replay_time + ImGui::GetIO().DeltaTime, replay.EndTime());
+      }
+      replay.Seek(replay_time, replay_records);
+      replay_fleet.Clear();
+      for (const TrajectoryRecord &record : replay_records) {
+        Pose2D record_pose;
+        record_pose.x = record.x;
+        record_pose.y = record.y;
+        record_pose.theta = record.theta;
+        if (record.robot == 0) {
+          pose = record_pose;
+        }
+        else {
+          if (record.robot > replay_fleet.Size()) {
+            replay_fleet.Resize(record.robot);
+          }
+          replay_fleet.SetPose(record.robot - 1, record_pose);
+        }
       }
-      robot.UpdateModelMatrix();
     }
+    robot.position_ = glm::vec3(pose.x, pose.y, pose.theta);
+    robot.UpdateModelMatrix();
 
     ImGui::Text("Robot X: %.3f", robot.position_[0]);
     ImGui::Text("Robot Y: %.3f", robot.position_[1]);
     ImGui::Text("Robot T: %.3f", robot.position_[2] * 180 / M_PI);
+    ImGui::Text("Sim time: %.2f s", snapshot.time_);
+    ImGui::Text("Sim/wall: %.2fx (%.3e steps/s)", snapshot.real_time_factor_, snapshot.steps_per_second_);
+    if (snapshot.fleet_collision_time_ > 0) {
+      ImGui::Text("Fleet contacts: %zu (%.2f ms)", snapshot.fleet_contacts_, snapshot.fleet_collision_time_ * 1e3);
+    }
+    if (snapshot.fleet_scan_time_ > 0) {
+      ImGui::Text("Fleet scan: %.2f ms (%.3e rays/s)", snapshot.fleet_scan_time_ * 1e3, snapshot.fleet_rays_per_second_);
+    }
+    if (!world_batch.chunks_.empty()) {
+      ImGui::Text("Static: %zu/%zu chunks drawn in %zu calls (%s)", world_batch.visible_chunks_,
+                  world_batch.chunks_.size(), world_batch.draw_calls_,
+                  world_batch.indirect_ ? "multi draw indirect" : "draw elements");
+    }
+    if (capture.IsOpen()) {
+      ImGui::Text("Capture: %llu frames, %llu written, %llu dropped, %.2f ms/frame", (unsigned long long)capture.captured_,
+                  (unsigned long long)capture.writer_.written_.load(), (unsigned long long)capture.dropped_,
+                  capture.next_index_ > 0 ? capture.capture_nanoseconds_ * 1e-6 / capture.next_index_ : 0.0);
+    }
+    if (snapshot.following_) {
+      ImGui::Text("Following: %s, %.2f m off the path, %.2f ms/tick", TrackingControllerName(snapshot.controller_),
+                  snapshot.tracking_error_, snapshot.control_time_ * 1e3);
+    }
+    ImGui::Text("Collisions: %llu%s", (unsigned long long)snapshot.collisions_, snapshot.colliding_ ? " (blocked)" : "");
+    if (snapshot.estimator_ != EstimatorType::kNone) {
+      ImGui::Text("Estimate error: %.3f m, %.2f deg",
+                  std::hypot(snapshot.estimate_.x - snapshot.pose_.x, snapshot.estimate_.y - snapshot.pose_.y),
+                  std::remainder(snapshot.estimate_.theta - snapshot.pose_.theta, 2 * M_PI) * 180 / M_PI);
+    }
 
-    robot.Draw();
+    if (draw_scene) {
+      {
+        SEPT2023_PROFILE_SCOPE("map draw");
+        SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "map draw");
+        grid_renderer.Update(grid);
+        grid_renderer.Draw();
+      }
+      {
+        SEPT2023_PROFILE_SCOPE("static draw");
+        SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "static draw");
+        world_batch.Draw(frustum);
+      }
+      {
+        SEPT2023_PROFILE_SCOPE("robot draw");
+        SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "robot draw");
+        robot.Draw();
+      }
+      lines.Clear();
+      if (!replaying && !snapshot.scan_points_.empty()) {
+        SEPT2023_PROFILE_SCOPE("scan draw");
+        const glm::vec2 origin(snapshot.scan_pose_.x, snapshot.scan_pose_.y);
+        for (size_t i = 0; i + 1 < snapshot.scan_points_.size(); i += 2) {
+          lines.AddLine(origin, glm::vec2(snapshot.scan_points_[i], snapshot.scan_points_[i + 1]),
+                        glm::vec4(0.9, 0.2, 0.2, 0.25));
+        }
+      }
+      if (!replaying && snapshot.estimator_ != EstimatorType::kNone) {
+        SEPT2023_PROFILE_SCOPE("estimate draw");
+        const Pose2D &estimate = snapshot.estimate_;
+        if (!snapshot.particles_.empty()) {
+          particle_points.Upload(snapshot.particles_.data(), snapshot.particles_.size() / 2);
+          particle_points.Draw(glm::vec4(0.2, 0.6, 0.2, 0.5), 2);
+        }
+        estimated_robot.position_ = glm::vec3(estimate.x, estimate.y, estimate.theta);
+        estimated_robot.Draw();
+        for (const Eigen::Vector2d &landmark : snapshot.landmarks_) {
+          lines.AddCross(glm::vec2(landmark[0], landmark[1]), 0.3f, glm::vec4(0.5, 0.3, 0, 1));
+        }
+        // 2 sigma, the robot should be inside about 86% of the time
+        const PoseCovariance &covariance = snapshot.estimate_covariance_;
+        lines.AddCovarianceEllipse(glm::vec2(estimate.x, estimate.y),
+                                   covariance(0, 0), covariance(0, 1), covariance(1, 1),
+                                   2, glm::vec4(0, 0.5, 0, 1));
+      }
+      for (size_t i = 1; i < plan.path_.size(); ++i) {
+        lines.AddLine(glm::vec2(plan.path_[i - 1].x, plan.path_[i - 1].y),
+                      glm::vec2(plan.path_[i].x, plan.path_[i].y), glm::vec4(0.1, 0.4, 0.9, 1));
+      }
+      if (plan.id_ != 0) {
+        lines.AddCross(glm::vec2(plan_goal[0], plan_goal[1]), 0.4f, glm::vec4(0.1, 0.4, 0.9, 1));
+      }
+      lines.Draw();
+      // What a pixel covers on the ground decides how much detail is worth drawing
+      int framebuffer_width, framebuffer_height;
+      glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+      const float meters_per_pixel =
+          camera.MetersPerPixel(offscreen.fbo_ != 0 ? (float)offscreen.height_ : (float)framebuffer_height);
+      if (draw_trails) {
+        SEPT2023_PROFILE_SCOPE("trail draw");
+        SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "trail draw");
+        const double trail_stamp = replaying ? replay_time : snapshot.time_;
+        if (trail_stamp != trail_time) {
+          trails.Append(replaying ? replay_fleet : snapshot.fleet_);
+          trail_time = trail_stamp;
+        }
+        trails.Simplify(trail_tolerance * meters_per_pixel, &trail_pool, trail_strips);
+        trail_renderer.Upload(trail_strips);
+        trail_renderer.Draw(glm::vec4(0, 0, 1, 0.35));
+        ImGui::Text("Trails: %zu points, %zu drawn", trails.PointCount(), trail_strips.VertexCount());
+      }
+      SEPT2023_PROFILE_SCOPE("fleet draw");
+      SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "fleet draw");
+      fleet_renderer.SelectLod(meters_per_pixel, robot.length_);
+      if (fleet_lod_index > 0) {
+        fleet_renderer.lod_ = (FleetLod)(fleet_lod_index - 1);
+      }
+      if (replaying) {
+        fleet_renderer.Update(replay_fleet, robot.width_, robot.length_, glm::vec4(0, 0, 1, 1));
+      }
+      else {
+        fleet_renderer.Update(snapshot.previous_fleet_,
+                              snapshot.fleet_,
+                              SnapshotAlpha(snapshot, now),
+                              robot.width_,
+                              robot.length_,
+                              glm::vec4(0, 0, 1, 1));
+      }
+      fleet_renderer.Draw();
+      ImGui::Text("Fleet detail: %s (%.2f px per robot)", FleetLodName(fleet_renderer.lod_),
+                  fleet_renderer.robot_pixels_);
+    }
+    if (capture.IsOpen()) {
+      SEPT2023_PROFILE_SCOPE("capture");
+      capture.Capture(offscreen.fbo_);
+    }
 
     ImGui::End();
+    {
+      SEPT2023_PROFILE_SCOPE("panels");
+      telemetry_panel.Draw(sim_thread.telemetry_, frame_telemetry);
+      profiler_panel.Draw();
+    }
     // End of frame
     int display_w, display_h;
     glfwGetFramebufferSize(window, &display_w, &display_h);
-    glViewport(0, 0, display_w, display_h);
+    if (offscreen.fbo_ != 0 && headless_api == 0) {
+      SEPT2023_PROFILE_SCOPE("blit");
+      offscreen.BlitToWindow(display_w, display_h);
+    }
+    else {
+      glViewport(0, 0, display_w, display_h);
+    }
 
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+      SEPT2023_PROFILE_SCOPE("imgui render");
+      SEPT2023_GPU_PROFILE_SCOPE(gpu_profiler, "imgui render");
+      ImGui::Render();
+      // Headless there is nothing to draw the UI into
+      if (headless_api == 0) {
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
+    }
 
     ImGuiIO& io = ImGui::GetIO();
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
@@ -152,24 +759,58 @@ int main() {
       ImGui::RenderPlatformWindowsDefault();
       glfwMakeContextCurrent(backup_current_context);
     }
+    gpu_profiler.EndFrame();
+    SEPT2023_PROFILE_SCOPE("swap buffers");
     glfwSwapBuffers(window);
+    if (frame_limit > 0 && ++frame_count >= frame_limit) {
+      glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
   }
+  sim_thread.Stop();
+  // The sim thread is gone so nothing else can be writing to the recorder
+  recorder.Close();
+  if (capture.IsOpen()) {
+    const uint64_t frames = capture.next_index_;
+    capture.Close();
+    printf("Captured %llu frames to %s, %llu written, %llu dropped, %.3f ms/frame render thread, "
+           "%.3f ms/frame writer thread\n",
+           (unsigned long long)frames, capture_path, (unsigned long long)capture.writer_.written_.load(),
+           (unsigned long long)capture.dropped_, frames > 0 ? capture.capture_nanoseconds_ * 1e-6 / frames : 0.0,
+           frames > 0 ? capture.writer_.write_nanoseconds_.load() * 1e-6 / frames : 0.0);
+  }
+  // While the context is still around
+  offscreen.Destroy();
+  world_batch.Clear();
+  GetShaderLibrary().Clear();
   return 0;
 }
 
-void SetupWindow() {
+/**
+ * \param headless_api 0 for a normal window, GLFW_EGL_CONTEXT_API or GLFW_OSMESA_CONTEXT_API for
+ *        no display at all: GLFW's null platform with a hidden window and a context from EGL
+ *        (GPU, or Mesa's software rasterizer) or OSMesa (software, needs libOSMesa)
+ * \return false if there is no GL 3.3 context
+ */
+bool SetupWindow(int headless_api) {
   // OpenGL setup
 #if defined(__APPLE__)
   glfwInitHint(GLFW_COCOA_CHDIR_RESOURCES, GLFW_FALSE);
 #endif
+  if (headless_api != 0) {
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+  }
   if (!glfwInit()) {
     printf("GLFW ERROR: Failed to initialize\n");
-    return;
+    return false;
   }
   glfwDefaultWindowHints();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if (headless_api != 0) {
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, headless_api);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  }
 
 #if defined(__APPLE__)
   /* OSX Requires fordward compatibility */
@@ -183,7 +824,7 @@ void SetupWindow() {
                             nullptr);
   if (window == nullptr) {
     printf("GLFW ERROR: Failed to create window\n");
-    return;
+    return false;
   }
 
 //  glfwSetFramebufferSizeCallback(gui_state.glfw_window, WindowResizeCallback);
@@ -193,11 +834,11 @@ void SetupWindow() {
 
   glfwMakeContextCurrent(window);
   /* Enable vsync, when this is disabled was getting high cpu usage */
-  glfwSwapInterval(1);
+  glfwSwapInterval(headless_api != 0 ? 0 : 1);
 
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     printf("GLAD ERROR: Failed to initialize\n");
-    return;
+    return false;
   }
 
   // Imgui and implot setup
@@ -221,6 +862,7 @@ void SetupWindow() {
   ImGui_ImplGlfw_InitForOpenGL(window, true);
   const char* glsl_version = "#version 330";
   ImGui_ImplOpenGL3_Init(glsl_version);
+  return true;
 }
 
 void ScrollCallback(GLFWwindow *win,
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "occupancy_grid.h"
+#include "random.h"
+
+/**
+ * Writes a random occupancy grid map file for sept2023/sim_headless --map, centred on the origin
+ * with the area around the origin left free. Then maps it again and times random footprint
+ * collision checks against it.
+ * Usage: make_map file [--size cells] [--resolution m] [--obstacles N] [--seed N]
+ */
+int main(int argc, char **argv) {
+  if (argc < 2 || argv[1][0] == '-') {
+    printf("Usage: %s file [--size cells] [--resolution m] [--obstacles N] [--seed N]\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[1];
+  uint32_t size = 10000;
+  double resolution = 0.05;
+  size_t obstacles = 20000;
+  uint64_t seed = 2023;
+  for (int i = 2; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--size") == 0) {
+      size = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--resolution") == 0) {
+      resolution = atof(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--obstacles") == 0) {
+      obstacles = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--seed") == 0) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    }
+    else {
+      printf("Usage: %s file [--size cells] [--resolution m] [--obstacles N] [--seed N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    OccupancyGrid grid;
+    const double half_extent = 0.5 * size * resolution;
+    if (!grid.Create(size, size, resolution, -half_extent, -half_extent, path)) {
+      return 1;
+    }
+    AddRandomObstacles(grid, obstacles, seed, 0, 0, 3);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("Wrote %ux%u map with %zu obstacles to %s in %.3f s\n", size, size, obstacles, path, seconds);
+
+  start = std::chrono::steady_clock::now();
+  OccupancyGrid grid;
+  if (!grid.Open(path, false)) {
+    return 1;
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("Opened in %.3f ms\n", seconds * 1e3);
+
+  // Random 1 x 0.5 m footprints anywhere on the map
+  Rng rng(seed, 3);
+  const uint64_t checks = 1000000;
+  uint64_t collisions = 0;
+  const double extent = grid.width_ * grid.resolution_;
+  start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < checks; ++i) {
+    Pose2D pose;
+    pose.x = grid.origin_x_ + rng.Uniform(0, extent);
+    pose.y = grid.origin_y_ + rng.Uniform(0, extent);
+    pose.theta = rng.Uniform(0, 2 * M_PI);
+    collisions += grid.CollidesRectangle(pose, 1, 0.5) ? 1 : 0;
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%llu collision checks in %.3f s (%.3e checks/s), %.1f%% colliding\n",
+         (unsigned long long)checks, seconds, checks / seconds, 100.0 * collisions / checks);
+  return 0;
+}
@@ -0,0 +1,243 @@
+#include "monte_carlo.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include "random.h"
+#include "thread_pool.h"
+
+/**
+ * \return s without leading/trailing whitespace
+ */
+static std::string Trim(const std::string &s) {
+  const char *whitespace = " \t\r\n";
+  size_t begin = s.find_first_not_of(whitespace);
+  if (begin == std::string::npos) {
+    return "";
+  }
+  size_t end = s.find_last_not_of(whitespace);
+  return s.substr(begin, end - begin + 1);
+}
+
+/**
+ * \return false if text isn't entirely a number
+ */
+static bool ParseNumber(const std::string &text,
+                        double &value) {
+  char *end = nullptr;
+  value = strtod(text.c_str(), &end);
+  return !text.empty() && end == text.c_str() + text.size();
+}
+
+bool LoadMonteCarloScenario(const std::string &path,
+                            MonteCarloScenario &scenario) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    printf("ERROR (Scenario): Unable to open %s\n", path.c_str());
+    return false;
+  }
+  const double degrees = M_PI / 180;
+  // The double valued keys, angles are converted from degrees
+  struct ScenarioField {
+    const char *key_;
+    double *value_;
+    double scale_;
+  };
+  const ScenarioField fields[] = {
+      {"dt", &scenario.dt_, 1},
+      {"start_x", &scenario.start_.x, 1},
+      {"start_y", &scenario.start_.y, 1},
+      {"start_theta", &scenario.start_.theta, degrees},
+      {"start_x_std", &scenario.start_std_.x, 1},
+      {"start_y_std", &scenario.start_std_.y, 1},
+      {"start_theta_std", &scenario.start_std_.theta, degrees},
+      {"linear_velocity", &scenario.linear_velocity_, 1},
+      {"angular_velocity", &scenario.angular_velocity_, degrees},
+      {"linear_velocity_std", &scenario.linear_velocity_std_, 1},
+      {"angular_velocity_std", &scenario.angular_velocity_std_, degrees},
+      {"profile_period", &scenario.profile_period_, 1},
+      {"linear_noise", &scenario.linear_noise_, 1},
+      {"angular_noise", &scenario.angular_noise_, degrees},
+  };
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      printf("ERROR (Scenario): %s:%d expected key = value\n", path.c_str(), line_number);
+      return false;
+    }
+    const std::string key = Trim(line.substr(0, equals));
+    const std::string text = Trim(line.substr(equals + 1));
+
+    if (key == "profile") {
+      if (text == "constant") {
+        scenario.profile_ = VelocityProfile::kConstant;
+      }
+      else if (text == "sine") {
+        scenario.profile_ = VelocityProfile::kSine;
+      }
+      else if (text == "step") {
+        scenario.profile_ = VelocityProfile::kStep;
+      }
+      else {
+        printf("ERROR (Scenario): %s:%d unknown profile %s\n", path.c_str(), line_number, text.c_str());
+        return false;
+      }
+      continue;
+    }
+
+    double value;
+    if (!ParseNumber(text, value)) {
+      printf("ERROR (Scenario): %s:%d %s is not a number\n", path.c_str(), line_number, text.c_str());
+      return false;
+    }
+    if (key == "trials") {
+      scenario.trials_ = (uint64_t)value;
+      continue;
+    }
+    if (key == "seed") {
+      scenario.seed_ = (uint64_t)value;
+      continue;
+    }
+    if (key == "steps") {
+      scenario.steps_ = (uint64_t)value;
+      continue;
+    }
+    auto field = std::find_if(std::begin(fields), std::end(fields), [&](const ScenarioField &f) {
+      return key == f.key_;
+    });
+    if (field == std::end(fields)) {
+      printf("ERROR (Scenario): %s:%d unknown key %s\n", path.c_str(), line_number, key.c_str());
+      return false;
+    }
+    *field->value_ = value * field->scale_;
+  }
+  if (scenario.dt_ <= 0 || scenario.profile_period_ <= 0) {
+    printf("ERROR (Scenario): %s dt and profile_period must be > 0\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * \return commanded angular velocity at time t for a trial whose base command is w
+ */
+static double ProfileAngularVelocity(const MonteCarloScenario &scenario,
+                                     double w,
+                                     double t) {
+  switch (scenario.profile_) {
+    case VelocityProfile::kConstant:
+      return w;
+    case VelocityProfile::kSine:
+      return w * std::sin(2 * M_PI * t / scenario.profile_period_);
+    case VelocityProfile::kStep:
+      return std::fmod(t, scenario.profile_period_) < scenario.profile_period_ / 2 ? w : -w;
+  }
+  return w;
+}
+
+MonteCarloTrial RunMonteCarloTrial(const MonteCarloScenario &scenario,
+                                   uint64_t trial) {
+  Rng rng(scenario.seed_, trial);
+  Pose2D start;
+  start.x = rng.Normal(scenario.start_.x, scenario.start_std_.x);
+  start.y = rng.Normal(scenario.start_.y, scenario.start_std_.y);
+  start.theta = rng.Normal(scenario.start_.theta, scenario.start_std_.theta);
+  const double v = rng.Normal(scenario.linear_velocity_, scenario.linear_velocity_std_);
+  const double w = rng.Normal(scenario.angular_velocity_, scenario.angular_velocity_std_);
+
+  MonteCarloTrial result;
+  result.final_ = start;
+  result.nominal_ = start;
+  for (uint64_t step = 0; step < scenario.steps_; ++step) {
+    // Command at the start of the step, held for the whole step like the simulator does
+    const double t = step * scenario.dt_;
+    const double command_w = ProfileAngularVelocity(scenario, w, t);
+    StepUnicycle(result.nominal_, v, command_w, scenario.dt_);
+    StepUnicycle(result.final_,
+                 v + rng.Normal(0, scenario.linear_noise_),
+                 command_w + rng.Normal(0, scenario.angular_noise_),
+                 scenario.dt_);
+  }
+  result.final_.theta = WrapAngle(result.final_.theta);
+  result.nominal_.theta = WrapAngle(result.nominal_.theta);
+  result.drift_ = std::hypot(result.final_.x - result.nominal_.x, result.final_.y - result.nominal_.y);
+  result.heading_drift_ = std::remainder(result.final_.theta - result.nominal_.theta, 2 * M_PI);
+  return result;
+}
+
+void RunMonteCarlo(const MonteCarloScenario &scenario,
+                   ThreadPool &pool,
+                   std::vector<MonteCarloTrial> &trials) {
+  trials.resize(scenario.trials_);
+  // Each trial only writes its own slot, nothing is shared between tasks
+  pool.ParallelFor(trials.size(), 0, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      trials[i] = RunMonteCarloTrial(scenario, i);
+    }
+  });
+}
+
+MonteCarloSummary SummarizeMonteCarlo(const std::vector<MonteCarloTrial> &trials) {
+  MonteCarloSummary summary;
+  summary.trials_ = trials.size();
+  if (trials.empty()) {
+    return summary;
+  }
+  const double n = (double)trials.size();
+  double sum_sin = 0;
+  double sum_cos = 0;
+  double sum_heading_drift = 0;
+  for (const MonteCarloTrial &trial : trials) {
+    summary.mean_x_ += trial.final_.x;
+    summary.mean_y_ += trial.final_.y;
+    summary.mean_drift_ += trial.drift_;
+    summary.max_drift_ = std::max(summary.max_drift_, trial.drift_);
+    sum_sin += std::sin(trial.final_.theta);
+    sum_cos += std::cos(trial.final_.theta);
+    sum_heading_drift += trial.heading_drift_ * trial.heading_drift_;
+  }
+  summary.mean_x_ /= n;
+  summary.mean_y_ /= n;
+  summary.mean_drift_ /= n;
+  summary.rms_heading_drift_ = std::sqrt(sum_heading_drift / n);
+  summary.mean_theta_ = WrapAngle(std::atan2(sum_sin, sum_cos));
+  // Circular std dev from the mean resultant length
+  const double resultant = std::min(1.0, std::hypot(sum_sin, sum_cos) / n);
+  summary.std_theta_ = resultant > 0 ? std::sqrt(-2 * std::log(resultant)) : INFINITY;
+
+  // Second pass for the spread, more accurate than sum of squares
+  double var_x = 0;
+  double var_y = 0;
+  double var_drift = 0;
+  for (const MonteCarloTrial &trial : trials) {
+    const double dx = trial.final_.x - summary.mean_x_;
+    const double dy = trial.final_.y - summary.mean_y_;
+    const double dd = trial.drift_ - summary.mean_drift_;
+    var_x += dx * dx;
+    var_y += dy * dy;
+    summary.cov_xy_ += dx * dy;
+    var_drift += dd * dd;
+  }
+  const double dof = std::max(1.0, n - 1);
+  summary.std_x_ = std::sqrt(var_x / dof);
+  summary.std_y_ = std::sqrt(var_y / dof);
+  summary.cov_xy_ /= dof;
+  summary.std_drift_ = std::sqrt(var_drift / dof);
+
+  std::vector<double> drifts;
+  drifts.reserve(trials.size());
+  for (const MonteCarloTrial &trial : trials) {
+    drifts.push_back(trial.drift_);
+  }
+  std::sort(drifts.begin(), drifts.end());
+  summary.median_drift_ = drifts[(drifts.size() - 1) / 2];
+  summary.p95_drift_ = drifts[(size_t)std::ceil(0.95 * drifts.size()) - 1];
+  return summary;
+}
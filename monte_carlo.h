@@ -0,0 +1,111 @@
+#ifndef SEPT2023__MONTE_CARLO_H_
+#define SEPT2023__MONTE_CARLO_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "unicycle.h"
+
+struct ThreadPool;
+
+// How the commanded angular velocity changes over a trial
+enum class VelocityProfile {
+  // w the whole time
+  kConstant,
+  // w * sin(2 pi t / period)
+  kSine,
+  // +w for half a period then -w, repeating (a slalom)
+  kStep
+};
+
+/**
+ * A family of randomized trials of the unicycle model, read from a key = value text file.
+ * Every trial draws its own start pose and command around the nominal values, then drives with
+ * per step noise on the velocities it actually achieves. Angles are in degrees in the file and
+ * radians here.
+ */
+struct MonteCarloScenario {
+  uint64_t trials_ = 1000;
+  uint64_t seed_ = 1;
+  uint64_t steps_ = 1000;
+  double dt_ = 0.01;
+  // Start pose and its spread (std dev) across trials
+  Pose2D start_;
+  Pose2D start_std_;
+  // Commanded velocities (m/s, rad/s) and their spread across trials
+  double linear_velocity_ = 1;
+  double angular_velocity_ = 0;
+  double linear_velocity_std_ = 0;
+  double angular_velocity_std_ = 0;
+  VelocityProfile profile_ = VelocityProfile::kConstant;
+  // Seconds, for kSine and kStep
+  double profile_period_ = 10;
+  // Std dev of the achieved velocity around the command, drawn every step (m/s, rad/s)
+  double linear_noise_ = 0;
+  double angular_noise_ = 0;
+};
+
+/**
+ * Read a scenario file, one "key = value" per line, # starts a comment. Keys are the member
+ * names without the trailing underscore, with start poses split up (start_x, start_theta_std, ...)
+ * and profile one of constant/sine/step. Anything not given keeps its default.
+ * See scenarios/drift.txt.
+ * \return false if the file can't be read or has an unknown key/bad value (the error is printed)
+ */
+bool LoadMonteCarloScenario(const std::string &path,
+                            MonteCarloScenario &scenario);
+
+/**
+ * Outcome of one trial
+ */
+struct MonteCarloTrial {
+  // Where the robot ended up with the per step noise
+  Pose2D final_;
+  // Where the same trial (same start pose and command) ends up with no per step noise
+  Pose2D nominal_;
+  // Distance between final_ and nominal_ (m)
+  double drift_ = 0;
+  // final_.theta - nominal_.theta wrapped to [-pi, pi]
+  double heading_drift_ = 0;
+};
+
+/**
+ * Run one trial. Only depends on the scenario and the trial number (its random numbers come from
+ * Rng(seed_, trial)), never on what else is running
+ */
+MonteCarloTrial RunMonteCarloTrial(const MonteCarloScenario &scenario,
+                                   uint64_t trial);
+
+/**
+ * Run every trial on the pool, trial i is written to trials[i]
+ */
+void RunMonteCarlo(const MonteCarloScenario &scenario,
+                   ThreadPool &pool,
+                   std::vector<MonteCarloTrial> &trials);
+
+/**
+ * Statistics over all trials. Computed in trial order so they are bit for bit the same whatever
+ * the number of threads
+ */
+struct MonteCarloSummary {
+  uint64_t trials_ = 0;
+  double mean_x_ = 0;
+  double mean_y_ = 0;
+  double std_x_ = 0;
+  double std_y_ = 0;
+  double cov_xy_ = 0;
+  // Circular mean and std dev of the final heading, radians
+  double mean_theta_ = 0;
+  double std_theta_ = 0;
+  double mean_drift_ = 0;
+  double std_drift_ = 0;
+  double median_drift_ = 0;
+  double p95_drift_ = 0;
+  double max_drift_ = 0;
+  // Root mean square of the heading drift, radians
+  double rms_heading_drift_ = 0;
+};
+
+MonteCarloSummary SummarizeMonteCarlo(const std::vector<MonteCarloTrial> &trials);
+
+#endif
@@ -0,0 +1,398 @@
+#include "occupancy_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "random.h"
+
+constexpr size_t kPageSize = 4096;
+
+static size_t RoundUp(size_t value,
+                      size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+OccupancyGrid::~OccupancyGrid() {
+  Close();
+}
+
+bool OccupancyGrid::Create(uint32_t width,
+                           uint32_t height,
+                           double resolution,
+                           double origin_x,
+                           double origin_y,
+                           const std::string &path) {
+  Close();
+  if (width == 0 || height == 0 || resolution <= 0) {
+    printf("ERROR (OccupancyGrid): Invalid size %ux%u, resolution %f\n", width, height, resolution);
+    return false;
+  }
+  OccupancyGridHeader header = {};
+  memcpy(header.magic, kOccupancyGridMagic, sizeof(kOccupancyGridMagic));
+  header.version = kOccupancyGridVersion;
+  header.tile_size = kOccupancyTileSize;
+  header.width = width;
+  header.height = height;
+  header.tiles_x = (width + kOccupancyTileSize - 1) / kOccupancyTileSize;
+  header.tiles_y = (height + kOccupancyTileSize - 1) / kOccupancyTileSize;
+  header.resolution = resolution;
+  header.origin_x = origin_x;
+  header.origin_y = origin_y;
+  const size_t tiles = (size_t)header.tiles_x * header.tiles_y;
+  header.counts_offset = RoundUp(sizeof(header), 8);
+  header.tiles_offset = RoundUp(header.counts_offset + tiles * sizeof(uint32_t), kPageSize);
+  const size_t size = header.tiles_offset + tiles * kOccupancyTileCells;
+
+  void *mapped = MAP_FAILED;
+  if (path.empty()) {
+    // Anonymous pages are zero, every cell starts free
+    mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  else {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      printf("ERROR (OccupancyGrid): Could not create file: %s\n", path.c_str());
+      return false;
+    }
+    // Extending the file gives zeros without writing them, the file stays sparse until painted
+    if (ftruncate(fd, (off_t)size) == 0) {
+      mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+  }
+  if (mapped == MAP_FAILED) {
+    printf("ERROR (OccupancyGrid): Could not map %zu bytes for %s\n", size, path.empty() ? "memory" : path.c_str());
+    return false;
+  }
+  mapping_ = static_cast<uint8_t*>(mapped);
+  mapping_size_ = size;
+  memcpy(mapping_, &header, sizeof(header));
+  writable_ = true;
+  return Attach(path.empty() ? "memory" : path);
+}
+
+bool OccupancyGrid::Open(const std::string &path,
+                         bool writable) {
+  Close();
+  int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (fd < 0) {
+    printf("ERROR (OccupancyGrid): Could not open file: %s\n", path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(OccupancyGridHeader)) {
+    printf("ERROR (OccupancyGrid): Not a map file: %s\n", path.c_str());
+    close(fd);
+    return false;
+  }
+  const size_t size = (size_t)file_stat.st_size;
+  void *mapped = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after closing the file descriptor
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    printf("ERROR (OccupancyGrid): Could not map file: %s\n", path.c_str());
+    return false;
+  }
+  mapping_ = static_cast<uint8_t*>(mapped);
+  mapping_size_ = size;
+  writable_ = writable;
+  return Attach(path);
+}
+
+bool OccupancyGrid::CopyFrom(const OccupancyGrid &other) {
+  if (&other == this || !other.IsOpen() ||
+      !Create(other.width_, other.height_, other.resolution_, other.origin_x_, other.origin_y_)) {
+    return false;
+  }
+  outside_occupied_ = other.outside_occupied_;
+  static const uint8_t zero_tile[kOccupancyTileCells] = {};
+  for (size_t tile = 0; tile < TileCount(); ++tile) {
+    const uint8_t *source = other.tiles_ + tile * kOccupancyTileCells;
+    if (memcmp(source, zero_tile, kOccupancyTileCells) != 0) {
+      memcpy(tiles_ + tile * kOccupancyTileCells, source, kOccupancyTileCells);
+    }
+    tile_occupied_[tile] = other.tile_occupied_[tile];
+  }
+  return true;
+}
+
+bool OccupancyGrid::Attach(const std::string &name) {
+  OccupancyGridHeader header;
+  memcpy(&header, mapping_, sizeof(header));
+  const size_t tiles = (size_t)header.tiles_x * header.tiles_y;
+  bool valid = memcmp(header.magic, kOccupancyGridMagic, sizeof(kOccupancyGridMagic)) == 0 &&
+      header.version == kOccupancyGridVersion &&
+      header.tile_size == kOccupancyTileSize &&
+      header.tiles_x == (header.width + kOccupancyTileSize - 1) / kOccupancyTileSize &&
+      header.tiles_y == (header.height + kOccupancyTileSize - 1) / kOccupancyTileSize &&
+      header.resolution > 0 &&
+      header.counts_offset >= sizeof(header) &&
+      header.counts_offset % sizeof(uint32_t) == 0 &&
+      header.counts_offset + tiles * sizeof(uint32_t) <= header.tiles_offset &&
+      header.tiles_offset + tiles * kOccupancyTileCells <= mapping_size_;
+  if (!valid) {
+    printf("ERROR (OccupancyGrid): Invalid map file: %s\n", name.c_str());
+    Close();
+    return false;
+  }
+  width_ = header.width;
+  height_ = header.height;
+  tiles_x_ = header.tiles_x;
+  tiles_y_ = header.tiles_y;
+  resolution_ = header.resolution;
+  origin_x_ = header.origin_x;
+  origin_y_ = header.origin_y;
+  tile_occupied_ = reinterpret_cast<uint32_t*>(mapping_ + header.counts_offset);
+  tiles_ = mapping_ + header.tiles_offset;
+  tile_versions_.reset(new std::atomic<uint32_t>[tiles]);
+  for (size_t i = 0; i < tiles; ++i) {
+    tile_versions_[i].store(0, std::memory_order_relaxed);
+  }
+  // A renderer that drew the previous map must see every tile as changed
+  attach_generation_.fetch_add(1, std::memory_order_release);
+  version_.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void OccupancyGrid::Close() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+  }
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  tiles_ = nullptr;
+  tile_occupied_ = nullptr;
+  tile_versions_.reset();
+  writable_ = false;
+  width_ = 0;
+  height_ = 0;
+  tiles_x_ = 0;
+  tiles_y_ = 0;
+}
+
+bool OccupancyGrid::IsOpen() const {
+  return mapping_ != nullptr;
+}
+
+size_t OccupancyGrid::TileCount() const {
+  return (size_t)tiles_x_ * tiles_y_;
+}
+
+uint8_t OccupancyGrid::Get(int64_t x,
+                           int64_t y) const {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+    return outside_occupied_ ? 255 : 0;
+  }
+  return tiles_[CellOffset((uint32_t)x, (uint32_t)y)];
+}
+
+void OccupancyGrid::WriteCell(uint32_t x,
+                              uint32_t y,
+                              uint8_t value) {
+  uint8_t &cell = tiles_[CellOffset(x, y)];
+  const bool was_occupied = cell >= kOccupiedThreshold;
+  const bool occupied = value >= kOccupiedThreshold;
+  if (was_occupied != occupied) {
+    uint32_t &count = tile_occupied_[(size_t)(y / kOccupancyTileSize) * tiles_x_ + x / kOccupancyTileSize];
+    count += occupied ? 1 : -1;
+  }
+  cell = value;
+}
+
+void OccupancyGrid::BeginChange(uint32_t x0,
+                                uint32_t y0,
+                                uint32_t x1,
+                                uint32_t y1) {
+  for (uint32_t ty = y0 / kOccupancyTileSize; ty <= y1 / kOccupancyTileSize; ++ty) {
+    for (uint32_t tx = x0 / kOccupancyTileSize; tx <= x1 / kOccupancyTileSize; ++tx) {
+      tile_versions_[(size_t)ty * tiles_x_ + tx].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  // The odd versions are visible before any of the cell writes
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void OccupancyGrid::MarkDirty(uint32_t x0,
+                              uint32_t y0,
+                              uint32_t x1,
+                              uint32_t y1) {
+  for (uint32_t ty = y0 / kOccupancyTileSize; ty <= y1 / kOccupancyTileSize; ++ty) {
+    for (uint32_t tx = x0 / kOccupancyTileSize; tx <= x1 / kOccupancyTileSize; ++tx) {
+      tile_versions_[(size_t)ty * tiles_x_ + tx].fetch_add(1, std::memory_order_release);
+    }
+  }
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+void OccupancyGrid::Set(int64_t x,
+                        int64_t y,
+                        uint8_t value) {
+  if (!writable_ || x < 0 || y < 0 || x >= width_ || y >= height_) {
+    return;
+  }
+  BeginChange((uint32_t)x, (uint32_t)y, (uint32_t)x, (uint32_t)y);
+  WriteCell((uint32_t)x, (uint32_t)y, value);
+  MarkDirty((uint32_t)x, (uint32_t)y, (uint32_t)x, (uint32_t)y);
+}
+
+void OccupancyGrid::FillRectangle(double min_x,
+                                  double min_y,
+                                  double max_x,
+                                  double max_y,
+                                  uint8_t value) {
+  if (!writable_) {
+    return;
+  }
+  // Cells whose centre (origin + (i + 0.5) * resolution) is inside [min, max]
+  const int64_t x0 = std::max<int64_t>(0, (int64_t)std::ceil((min_x - origin_x_) / resolution_ - 0.5));
+  const int64_t y0 = std::max<int64_t>(0, (int64_t)std::ceil((min_y - origin_y_) / resolution_ - 0.5));
+  const int64_t x1 = std::min<int64_t>(width_ - 1, (int64_t)std::floor((max_x - origin_x_) / resolution_ - 0.5));
+  const int64_t y1 = std::min<int64_t>(height_ - 1, (int64_t)std::floor((max_y - origin_y_) / resolution_ - 0.5));
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  BeginChange((uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1);
+  for (int64_t y = y0; y <= y1; ++y) {
+    for (int64_t x = x0; x <= x1; ++x) {
+      WriteCell((uint32_t)x, (uint32_t)y, value);
+    }
+  }
+  MarkDirty((uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1);
+}
+
+void OccupancyGrid::FillDisc(double center_x,
+                             double center_y,
+                             double radius,
+                             uint8_t value) {
+  if (!writable_) {
+    return;
+  }
+  const int64_t x0 = std::max<int64_t>(0, (int64_t)std::ceil((center_x - radius - origin_x_) / resolution_ - 0.5));
+  const int64_t y0 = std::max<int64_t>(0, (int64_t)std::ceil((center_y - radius - origin_y_) / resolution_ - 0.5));
+  const int64_t x1 = std::min<int64_t>(width_ - 1, (int64_t)std::floor((center_x + radius - origin_x_) / resolution_ - 0.5));
+  const int64_t y1 = std::min<int64_t>(height_ - 1, (int64_t)std::floor((center_y + radius - origin_y_) / resolution_ - 0.5));
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  BeginChange((uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1);
+  for (int64_t y = y0; y <= y1; ++y) {
+    const double dy = origin_y_ + (y + 0.5) * resolution_ - center_y;
+    for (int64_t x = x0; x <= x1; ++x) {
+      const double dx = origin_x_ + (x + 0.5) * resolution_ - center_x;
+      if (dx * dx + dy * dy <= radius * radius) {
+        WriteCell((uint32_t)x, (uint32_t)y, value);
+      }
+    }
+  }
+  MarkDirty((uint32_t)x0, (uint32_t)y0, (uint32_t)x1, (uint32_t)y1);
+}
+
+bool OccupancyGrid::CollidesRectangle(const Pose2D &pose,
+                                      double length,
+                                      double width) const {
+  if (!IsOpen()) {
+    return false;
+  }
+  // Unit axes along and across the heading (theta is clockwise from +Y)
+  const double forward_x = std::sin(pose.theta);
+  const double forward_y = std::cos(pose.theta);
+  const double right_x = forward_y;
+  const double right_y = -forward_x;
+  const double half_length = 0.5 * length;
+  const double half_width = 0.5 * width;
+  const double extent_x = std::abs(forward_x) * half_length + std::abs(right_x) * half_width;
+  const double extent_y = std::abs(forward_y) * half_length + std::abs(right_y) * half_width;
+
+  if (outside_occupied_) {
+    // Both are convex, the footprint is inside the map if all its corners are
+    const double max_x = origin_x_ + width_ * resolution_;
+    const double max_y = origin_y_ + height_ * resolution_;
+    for (int corner = 0; corner < 4; ++corner) {
+      const double along = corner & 1 ? half_length : -half_length;
+      const double across = corner & 2 ? half_width : -half_width;
+      const double x = pose.x + along * forward_x + across * right_x;
+      const double y = pose.y + along * forward_y + across * right_y;
+      if (x < origin_x_ || y < origin_y_ || x > max_x || y > max_y) {
+        return true;
+      }
+    }
+  }
+
+  // Cells overlapping the footprint's bounding box, these already overlap it along x and y
+  const double x0 = std::floor((pose.x - extent_x - origin_x_) / resolution_);
+  const double y0 = std::floor((pose.y - extent_y - origin_y_) / resolution_);
+  const double x1 = std::floor((pose.x + extent_x - origin_x_) / resolution_);
+  const double y1 = std::floor((pose.y + extent_y - origin_y_) / resolution_);
+  if (x1 < 0 || y1 < 0 || x0 >= width_ || y0 >= height_) {
+    return false;
+  }
+  const uint32_t cell_x0 = (uint32_t)std::max(0.0, x0);
+  const uint32_t cell_y0 = (uint32_t)std::max(0.0, y0);
+  const uint32_t cell_x1 = (uint32_t)std::min<double>(width_ - 1, x1);
+  const uint32_t cell_y1 = (uint32_t)std::min<double>(height_ - 1, y1);
+
+  // The other 2 separating axes are the footprint's own. A cell (half size h) projects onto a unit
+  // axis a as its centre +- h * (|a.x| + |a.y|)
+  const double half_cell = 0.5 * resolution_;
+  const double reach_length = half_length + half_cell * (std::abs(forward_x) + std::abs(forward_y));
+  const double reach_width = half_width + half_cell * (std::abs(right_x) + std::abs(right_y));
+  for (uint32_t ty = cell_y0 / kOccupancyTileSize; ty <= cell_y1 / kOccupancyTileSize; ++ty) {
+    for (uint32_t tx = cell_x0 / kOccupancyTileSize; tx <= cell_x1 / kOccupancyTileSize; ++tx) {
+      const size_t tile = (size_t)ty * tiles_x_ + tx;
+      if (tile_occupied_[tile] == 0) {
+        continue;
+      }
+      const uint8_t *cells = tiles_ + tile * kOccupancyTileCells;
+      const uint32_t begin_x = std::max(cell_x0, tx * kOccupancyTileSize);
+      const uint32_t end_x = std::min(cell_x1, tx * kOccupancyTileSize + kOccupancyTileSize - 1);
+      const uint32_t begin_y = std::max(cell_y0, ty * kOccupancyTileSize);
+      const uint32_t end_y = std::min(cell_y1, ty * kOccupancyTileSize + kOccupancyTileSize - 1);
+      for (uint32_t y = begin_y; y <= end_y; ++y) {
+        const uint8_t *row = cells + (y % kOccupancyTileSize) * kOccupancyTileSize;
+        const double dy = origin_y_ + (y + 0.5) * resolution_ - pose.y;
+        for (uint32_t x = begin_x; x <= end_x; ++x) {
+          if (row[x % kOccupancyTileSize] < kOccupiedThreshold) {
+            continue;
+          }
+          const double dx = origin_x_ + (x + 0.5) * resolution_ - pose.x;
+          if (std::abs(dx * forward_x + dy * forward_y) <= reach_length &&
+              std::abs(dx * right_x + dy * right_y) <= reach_width) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void AddRandomObstacles(OccupancyGrid &grid,
+                        size_t count,
+                        uint64_t seed,
+                        double clear_x,
+                        double clear_y,
+                        double clear_radius) {
+  if (!grid.writable_) {
+    return;
+  }
+  Rng rng(seed, 2);
+  const double max_x = grid.origin_x_ + grid.width_ * grid.resolution_;
+  const double max_y = grid.origin_y_ + grid.height_ * grid.resolution_;
+  for (size_t i = 0; i < count; ++i) {
+    const double x = rng.Uniform(grid.origin_x_, max_x);
+    const double y = rng.Uniform(grid.origin_y_, max_y);
+    const double size = rng.Uniform(0.5, 3);
+    if (rng.Uniform() < 0.5) {
+      const double aspect = rng.Uniform(0.3, 1);
+      grid.FillRectangle(x - 0.5 * size, y - 0.5 * size * aspect, x + 0.5 * size, y + 0.5 * size * aspect, 255);
+    }
+    else {
+      grid.FillDisc(x, y, 0.5 * size, 255);
+    }
+  }
+  grid.FillDisc(clear_x, clear_y, clear_radius, 0);
+}
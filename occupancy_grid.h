@@ -0,0 +1,212 @@
+#ifndef SEPT2023__OCCUPANCY_GRID_H_
+#define SEPT2023__OCCUPANCY_GRID_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "unicycle.h"
+
+/*
+ * File layout, all little endian:
+ *   OccupancyGridHeader
+ *   uint32_t occupied cell count per tile (at header.counts_offset)
+ *   tiles (at header.tiles_offset, page aligned)
+ * The map is cut into kOccupancyTileSize x kOccupancyTileSize tiles of one byte per cell, stored
+ * row major by tile and row major within a tile. A tile is 4 KB, one page, so a collision check
+ * touches a handful of pages however big the map is, and a dirty tile is one contiguous upload.
+ * The grid is padded up to whole tiles, the padding is free space.
+ */
+constexpr char kOccupancyGridMagic[8] = {'S', '2', '3', 'G', 'R', 'I', 'D', 0};
+constexpr uint32_t kOccupancyGridVersion = 1;
+constexpr uint32_t kOccupancyTileSize = 64;
+constexpr size_t kOccupancyTileCells = kOccupancyTileSize * kOccupancyTileSize;
+// Cells at or above this are occupied. 0 is free, 255 certainly occupied
+constexpr uint8_t kOccupiedThreshold = 128;
+
+struct OccupancyGridHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_size;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+  // Meters per cell
+  double resolution;
+  // World position of the lower left corner of cell (0, 0)
+  double origin_x;
+  double origin_y;
+  uint64_t counts_offset;
+  uint64_t tiles_offset;
+};
+
+/**
+ * 2D occupancy grid of up to about 10k x 10k cells, memory mapped from a file (or anonymous memory)
+ * so opening a map is instant and only the tiles actually used are ever paged in. Cell (x, y)
+ * covers world [origin_x + x * resolution, origin_x + (x + 1) * resolution) and likewise in y.
+ *
+ * Every change bumps the version of its tile so a renderer can re-upload just those tiles. Cells
+ * are plain bytes and only one thread may change them. Each tile version is a seqlock: odd while
+ * the tile is being changed (BeginChange ... MarkDirty), so a reader on another thread copies a
+ * tile and only uses the copy if the version was even and the same before and after.
+ */
+struct OccupancyGrid {
+  OccupancyGrid() = default;
+  ~OccupancyGrid();
+
+  OccupancyGrid(const OccupancyGrid &) = delete;
+  OccupancyGrid &operator=(const OccupancyGrid &) = delete;
+
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t tiles_x_ = 0;
+  uint32_t tiles_y_ = 0;
+  double resolution_ = 0.05;
+  double origin_x_ = 0;
+  double origin_y_ = 0;
+  // Whether everything outside the map is a wall or open space
+  bool outside_occupied_ = true;
+  // False when opened read only, changing cells is then ignored
+  bool writable_ = false;
+
+  // Point into the mapping
+  uint8_t *tiles_ = nullptr;
+  uint32_t *tile_occupied_ = nullptr;
+  // Per tile seqlock, odd while the tile is being changed. version_ is bumped after every change at
+  // all
+  std::unique_ptr<std::atomic<uint32_t>[]> tile_versions_;
+  std::atomic<uint32_t> version_{0};
+  // Bumped each time a map is created/opened in this object (tile versions start again from 0),
+  // not by edits
+  std::atomic<uint32_t> attach_generation_{0};
+
+  uint8_t *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+
+  /**
+   * A new map with every cell free
+   * \param path file to create (overwriting it), changes go straight to the file. Empty for an
+   *             anonymous mapping that disappears on Close
+   * \return false if the file couldn't be created/mapped
+   */
+  bool Create(uint32_t width,
+              uint32_t height,
+              double resolution,
+              double origin_x,
+              double origin_y,
+              const std::string &path = "");
+
+  /**
+   * Map a file written by Create
+   * \param writable if false the map is mapped read only and changes are ignored, otherwise they go
+   *                 straight to the file
+   */
+  bool Open(const std::string &path,
+            bool writable);
+
+  /**
+   * A new map in anonymous memory with the same size and cells as other, for a copy on write fork
+   * of a map that is shared or read only. Only tiles with something in them are copied, the rest
+   * stay untouched zero pages
+   */
+  bool CopyFrom(const OccupancyGrid &other);
+
+  /**
+   * Flush changes to the file (if any) and unmap
+   */
+  void Close();
+
+  bool IsOpen() const;
+  size_t TileCount() const;
+
+  /**
+   * \return offset of cell (x, y) in tiles_, the cell must be inside the padded grid
+   */
+  size_t CellOffset(uint32_t x,
+                    uint32_t y) const {
+    const size_t tile = (size_t)(y / kOccupancyTileSize) * tiles_x_ + x / kOccupancyTileSize;
+    return tile * kOccupancyTileCells + (y % kOccupancyTileSize) * kOccupancyTileSize + x % kOccupancyTileSize;
+  }
+
+  /**
+   * \return the cell value, outside the map 255 or 0 depending on outside_occupied_
+   */
+  uint8_t Get(int64_t x,
+              int64_t y) const;
+
+  /**
+   * Cells outside the map are ignored
+   */
+  void Set(int64_t x,
+           int64_t y,
+           uint8_t value);
+
+  /**
+   * Set every cell whose centre is inside the world space rectangle/disc
+   */
+  void FillRectangle(double min_x,
+                     double min_y,
+                     double max_x,
+                     double max_y,
+                     uint8_t value);
+  void FillDisc(double center_x,
+                double center_y,
+                double radius,
+                uint8_t value);
+
+  /**
+   * Does a rectangle footprint at pose overlap any occupied cell (or leave the map if
+   * outside_occupied_). Exact separating axis test of the rectangle against each cell square,
+   * tiles with no occupied cells are skipped without looking at their cells.
+   * \param length size along the heading, m
+   * \param width size across the heading, m
+   */
+  bool CollidesRectangle(const Pose2D &pose,
+                         double length,
+                         double width) const;
+
+  /**
+   * Check the header at the start of mapping_ and point everything into the mapping
+   * \param name for error messages
+   */
+  bool Attach(const std::string &name);
+
+  /**
+   * Change one cell (inside the map) and keep the occupied count of its tile up to date, without
+   * bumping any versions. Only between BeginChange and MarkDirty
+   */
+  void WriteCell(uint32_t x,
+                 uint32_t y,
+                 uint8_t value);
+
+  /**
+   * Make the versions of every tile overlapping cells [x0, x1] x [y0, y1] odd before changing them
+   */
+  void BeginChange(uint32_t x0,
+                   uint32_t y0,
+                   uint32_t x1,
+                   uint32_t y1);
+
+  /**
+   * Bump the versions of the same tiles as BeginChange back to even after changing them
+   */
+  void MarkDirty(uint32_t x0,
+                 uint32_t y0,
+                 uint32_t x1,
+                 uint32_t y1);
+};
+
+/**
+ * Scatter count random boxes and discs of 0.5 - 3 m over the map, leaving a disc of clear_radius
+ * around (clear_x, clear_y) free so the robot has somewhere to start
+ */
+void AddRandomObstacles(OccupancyGrid &grid,
+                        size_t count,
+                        uint64_t seed,
+                        double clear_x,
+                        double clear_y,
+                        double clear_radius);
+
+#endif
@@ -0,0 +1,66 @@
+#include "offscreen_target.h"
+#include <algorithm>
+#include <cstdio>
+#include <glad/glad.h>
+
+bool OffscreenTarget::Init(int width,
+                           int height) {
+  Destroy();
+  int max_size = 0;
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+  if (width <= 0 || height <= 0 || width > max_size || height > max_size) {
+    printf("ERROR (OffscreenTarget): %dx%d is not a valid size, the GPU allows up to %d\n", width, height, max_size);
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  glGenRenderbuffers(1, &color_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glGenFramebuffers(1, &fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+  const uint32_t status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    printf("ERROR (OffscreenTarget): Framebuffer incomplete (0x%x)\n", status);
+    Destroy();
+    return false;
+  }
+  return true;
+}
+
+void OffscreenTarget::Bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+  glViewport(0, 0, width_, height_);
+}
+
+void OffscreenTarget::BlitToWindow(int window_width,
+                                   int window_height) const {
+  // Keep the aspect ratio, letterboxed in the middle of the window
+  const double scale = std::min((double)window_width / width_, (double)window_height / height_);
+  const int width = (int)(width_ * scale);
+  const int height = (int)(height_ * scale);
+  const int x = (window_width - width) / 2;
+  const int y = (window_height - height) / 2;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glBlitFramebuffer(0, 0, width_, height_, x, y, x + width, y + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, window_width, window_height);
+}
+
+void OffscreenTarget::Destroy() {
+  if (fbo_ != 0) {
+    glDeleteFramebuffers(1, &fbo_);
+  }
+  if (color_ != 0) {
+    glDeleteRenderbuffers(1, &color_);
+  }
+  fbo_ = 0;
+  color_ = 0;
+  width_ = 0;
+  height_ = 0;
+}
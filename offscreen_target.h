@@ -0,0 +1,37 @@
+#ifndef SEPT2023__OFFSCREEN_TARGET_H_
+#define SEPT2023__OFFSCREEN_TARGET_H_
+
+#include <cstdint>
+
+/**
+ * A framebuffer object to draw the scene into instead of the window, at a size that doesn't
+ * depend on the window (or on there being a window that is shown at all). Colour only, GL_RGBA8,
+ * the scene is 2D so there is no depth buffer.
+ */
+struct OffscreenTarget {
+  uint32_t fbo_ = 0;
+  uint32_t color_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+
+  /**
+   * \return false if the driver can't make a complete framebuffer of that size
+   */
+  bool Init(int width,
+            int height);
+
+  /**
+   * Draw into the target from now on, viewport set to cover it
+   */
+  void Bind() const;
+
+  /**
+   * Copy the target into the window's framebuffer, scaled to fit, and leave the window bound
+   */
+  void BlitToWindow(int window_width,
+                    int window_height) const;
+
+  void Destroy();
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "particle_filter.h"
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Cholesky>
+#include "random.h"
+#include "thread_pool.h"
+
+double WeightParticlesScalar(const ParticleWeightSpan &span,
+                             size_t begin,
+                             size_t end,
+                             const ParticleObservation *observations,
+                             size_t observation_count,
+                             double range_scale,
+                             double bearing_kappa) {
+  double max_value = -INFINITY;
+  for (size_t i = begin; i < end; ++i) {
+    const double sin_theta = std::sin(span.theta[i]);
+    const double cos_theta = std::cos(span.theta[i]);
+    double total = 0;
+    for (size_t j = 0; j < observation_count; ++j) {
+      const ParticleObservation &observation = observations[j];
+      const double dx = observation.landmark_x - span.x[i];
+      const double dy = observation.landmark_y - span.y[i];
+      const double range = std::sqrt(dx * dx + dy * dy);
+      const double range_error = range - observation.range;
+      // cos of the angle between where the landmark should be and where it was seen
+      const double sin_seen = sin_theta * observation.cos_bearing + cos_theta * observation.sin_bearing;
+      const double cos_seen = cos_theta * observation.cos_bearing - sin_theta * observation.sin_bearing;
+      const double cos_error = (dx * sin_seen + dy * cos_seen) / std::max(range, 1e-9);
+      total += range_scale * range_error * range_error + bearing_kappa * (cos_error - 1);
+    }
+    span.log_likelihood[i] = total;
+    max_value = std::max(max_value, total);
+  }
+  return max_value;
+}
+
+void ExpWeightsScalar(const double *log_likelihood,
+                      double *weights,
+                      size_t begin,
+                      size_t end,
+                      double offset,
+                      double &sum,
+                      double &sum_squares) {
+  sum = 0;
+  sum_squares = 0;
+  for (size_t i = begin; i < end; ++i) {
+    weights[i] *= std::exp(log_likelihood[i] - offset);
+    sum += weights[i];
+    sum_squares += weights[i] * weights[i];
+  }
+}
+
+/**
+ * Box-Muller gives two independent samples per log/sqrt, use both
+ */
+static void NormalPair(Rng &rng,
+                       double &first,
+                       double &second) {
+  const double radius = std::sqrt(-2 * std::log(1 - rng.Uniform()));
+  const double angle = 2 * M_PI * rng.Uniform();
+  first = radius * std::cos(angle);
+  second = radius * std::sin(angle);
+}
+
+void SampleVelocitiesScalar(Rng &rng,
+                            double *v,
+                            double *w,
+                            size_t begin,
+                            size_t end,
+                            double linear_velocity,
+                            double angular_velocity,
+                            double linear_noise,
+                            double angular_noise) {
+  for (size_t i = begin; i < end; ++i) {
+    double linear, angular;
+    NormalPair(rng, linear, angular);
+    v[i] = linear_velocity + linear_noise * linear;
+    w[i] = angular_velocity + angular_noise * angular;
+  }
+}
+
+ParticleKernel BestParticleKernel() {
+  // Same instruction set as the fleet kernel, so reuse its detection
+  static const ParticleKernel best = BestFleetKernel() == FleetKernel::kAvx2
+      ? ParticleKernel::kAvx2 : ParticleKernel::kScalar;
+  return best;
+}
+
+const char *ParticleKernelName(ParticleKernel kernel) {
+  switch (kernel) {
+    case ParticleKernel::kScalar:
+      return "scalar";
+    case ParticleKernel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+void ParticleFilter::Reset(size_t count,
+                           const Pose2D &pose,
+                           const PoseCovariance &covariance,
+                           uint64_t seed) {
+  Resize(count);
+  seed_ = seed;
+  draws_ = 0;
+  resamples_ = 0;
+
+  // Fall back to just the diagonal if the covariance isn't positive definite
+  Eigen::LLT<PoseCovariance> llt(covariance);
+  const PoseCovariance root = llt.info() == Eigen::Success
+      ? PoseCovariance(llt.matrixL()) : PoseCovariance(covariance.diagonal().cwiseMax(0).cwiseSqrt().asDiagonal());
+  const uint64_t stream = draws_++ * ChunkCount();
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    Rng rng(seed_, stream + chunk);
+    for (size_t i = begin; i < end; ++i) {
+      PoseVector noise;
+      double unused;
+      NormalPair(rng, noise[0], noise[1]);
+      NormalPair(rng, noise[2], unused);
+      const PoseVector sample = PoseVector(pose.x, pose.y, pose.theta) + root * noise;
+      particles_.x_[i] = sample[0];
+      particles_.y_[i] = sample[1];
+      particles_.theta_[i] = WrapAngle(sample[2]);
+    }
+  });
+}
+
+void ParticleFilter::Resize(size_t count) {
+  particles_.Resize(count);
+  resampled_.x_.resize(count);
+  resampled_.y_.resize(count);
+  resampled_.theta_.resize(count);
+  weights_.assign(count, 1.0 / count);
+  log_likelihood_.resize(count);
+  cumulative_.resize(count);
+  chunk_sums_.resize(ChunkCount());
+  chunk_moments_.resize(ChunkCount());
+  sum_squares_ = 1.0 / count;
+}
+
+size_t ParticleFilter::Size() const {
+  return particles_.Size();
+}
+
+size_t ParticleFilter::ChunkCount() const {
+  return (Size() + kParticleChunk - 1) / kParticleChunk;
+}
+
+void ParticleFilter::ForEachChunk(const std::function<void(size_t chunk, size_t begin, size_t end)> &fn) const {
+  if (pool_ == nullptr) {
+    for (size_t begin = 0; begin < Size(); begin += kParticleChunk) {
+      fn(begin / kParticleChunk, begin, std::min(Size(), begin + kParticleChunk));
+    }
+    return;
+  }
+  // With the grain equal to the chunk size the pool's chunks are exactly ours
+  pool_->ParallelFor(Size(), kParticleChunk, [&fn](size_t begin, size_t end) {
+    fn(begin / kParticleChunk, begin, end);
+  });
+}
+
+void ParticleFilter::Predict(double linear_velocity,
+                             double angular_velocity,
+                             double dt,
+                             double linear_noise,
+                             double angular_noise) {
+  const uint64_t stream = draws_++ * ChunkCount();
+  const bool avx2 = kernel_ == ParticleKernel::kAvx2 && BestParticleKernel() == ParticleKernel::kAvx2;
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    Rng rng(seed_, stream + chunk);
+#if defined(SEPT2023_X86_KERNELS)
+    if (avx2) {
+      SampleVelocitiesAvx2(rng, particles_.v_.data(), particles_.w_.data(), begin, end,
+                           linear_velocity, angular_velocity, linear_noise, angular_noise);
+    }
+    else
+#endif
+    {
+      (void)avx2;
+      SampleVelocitiesScalar(rng, particles_.v_.data(), particles_.w_.data(), begin, end,
+                             linear_velocity, angular_velocity, linear_noise, angular_noise);
+    }
+    // Every particle drives its own sample of the odometry, exactly what the fleet step does
+    StepFleetRange(particles_, begin, end, dt, fleet_kernel_);
+  });
+}
+
+void ParticleFilter::UpdateRangeBearing(const Eigen::Vector2d *measurements,
+                                        const Eigen::Vector2d *landmarks,
+                                        size_t count,
+                                        double range_noise,
+                                        double bearing_noise) {
+  if (count == 0 || Size() == 0) {
+    return;
+  }
+  observations_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    observations_[i].landmark_x = landmarks[i][0];
+    observations_[i].landmark_y = landmarks[i][1];
+    observations_[i].range = measurements[i][0];
+    observations_[i].sin_bearing = std::sin(measurements[i][1]);
+    observations_[i].cos_bearing = std::cos(measurements[i][1]);
+  }
+  // For small errors kappa * (cos(e) - 1) ~ -e^2 / (2 sigma^2), the same as the Gaussian the
+  // Kalman filters assume, but it stays right as the bearing wraps around
+  const double range_scale = -0.5 / (range_noise * range_noise);
+  const double bearing_kappa = 1 / (bearing_noise * bearing_noise);
+  ParticleWeightSpan span;
+  span.x = particles_.x_.data();
+  span.y = particles_.y_.data();
+  span.theta = particles_.theta_.data();
+  span.log_likelihood = log_likelihood_.data();
+  const bool avx2 = kernel_ == ParticleKernel::kAvx2 && BestParticleKernel() == ParticleKernel::kAvx2;
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+#if defined(SEPT2023_X86_KERNELS)
+    if (avx2) {
+      chunk_sums_[chunk].max = WeightParticlesAvx2(span, begin, end, observations_.data(), count,
+                                                   range_scale, bearing_kappa);
+      return;
+    }
+#endif
+    (void)avx2;
+    chunk_sums_[chunk].max = WeightParticlesScalar(span, begin, end, observations_.data(), count,
+                                                   range_scale, bearing_kappa);
+  });
+  double max_log_likelihood = -INFINITY;
+  for (const ChunkSums &sums : chunk_sums_) {
+    max_log_likelihood = std::max(max_log_likelihood, sums.max);
+  }
+  ApplyLikelihood(max_log_likelihood);
+}
+
+void ParticleFilter::UpdatePosition(const Eigen::Vector2d &measurement,
+                                    double noise) {
+  if (Size() == 0) {
+    return;
+  }
+  const double scale = -0.5 / (noise * noise);
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    double max_value = -INFINITY;
+    for (size_t i = begin; i < end; ++i) {
+      const double dx = particles_.x_[i] - measurement[0];
+      const double dy = particles_.y_[i] - measurement[1];
+      log_likelihood_[i] = scale * (dx * dx + dy * dy);
+      max_value = std::max(max_value, log_likelihood_[i]);
+    }
+    chunk_sums_[chunk].max = max_value;
+  });
+  double max_log_likelihood = -INFINITY;
+  for (const ChunkSums &sums : chunk_sums_) {
+    max_log_likelihood = std::max(max_log_likelihood, sums.max);
+  }
+  ApplyLikelihood(max_log_likelihood);
+}
+
+void ParticleFilter::ApplyLikelihood(double max_log_likelihood) {
+  const bool avx2 = kernel_ == ParticleKernel::kAvx2 && BestParticleKernel() == ParticleKernel::kAvx2;
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    ChunkSums &sums = chunk_sums_[chunk];
+#if defined(SEPT2023_X86_KERNELS)
+    if (avx2) {
+      ExpWeightsAvx2(log_likelihood_.data(), weights_.data(), begin, end, max_log_likelihood,
+                     sums.sum, sums.sum_squares);
+      return;
+    }
+#endif
+    (void)avx2;
+    ExpWeightsScalar(log_likelihood_.data(), weights_.data(), begin, end, max_log_likelihood,
+                     sums.sum, sums.sum_squares);
+  });
+  // Summed in chunk order so the result is the same for any number of threads
+  double total = 0;
+  double total_squares = 0;
+  for (const ChunkSums &sums : chunk_sums_) {
+    total += sums.sum;
+    total_squares += sums.sum_squares;
+  }
+  if (!(total > 0) || !std::isfinite(total)) {
+    // Every particle is incompatible with the measurements, nothing to learn from the weights
+    std::fill(weights_.begin(), weights_.end(), 1.0 / Size());
+    sum_squares_ = 1.0 / Size();
+    return;
+  }
+  const double scale = 1 / total;
+  ForEachChunk([&](size_t, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      weights_[i] *= scale;
+    }
+  });
+  sum_squares_ = total_squares * scale * scale;
+  if (EffectiveSampleSize() < resample_threshold_ * Size()) {
+    Resample();
+  }
+}
+
+double ParticleFilter::EffectiveSampleSize() const {
+  return 1 / sum_squares_;
+}
+
+void ParticleFilter::Resample() {
+  const size_t count = Size();
+  if (count == 0) {
+    return;
+  }
+  // Prefix sum in two passes: each chunk sums its own weights, the chunk offsets are a short
+  // serial scan, then each chunk writes its cumulative weights starting from its offset
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    double sum = 0;
+    for (size_t i = begin; i < end; ++i) {
+      sum += weights_[i];
+    }
+    chunk_sums_[chunk].sum = sum;
+  });
+  double offset = 0;
+  for (ChunkSums &sums : chunk_sums_) {
+    sums.offset = offset;
+    offset += sums.sum;
+  }
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    double running = chunk_sums_[chunk].offset;
+    for (size_t i = begin; i < end; ++i) {
+      running += weights_[i];
+      cumulative_[i] = running;
+    }
+  });
+
+  // Pick j sits at (start + j) * spacing. Each output chunk finds where its first pick lands with
+  // a binary search, and from there walks forward since the picks are sorted
+  const double spacing = offset / count;
+  const double start = Rng(seed_, draws_++ * ChunkCount()).Uniform();
+  ForEachChunk([&](size_t, size_t begin, size_t end) {
+    double position = (start + begin) * spacing;
+    size_t source = std::upper_bound(cumulative_.begin(), cumulative_.end(), position) - cumulative_.begin();
+    for (size_t i = begin; i < end; ++i) {
+      position = (start + i) * spacing;
+      while (source + 1 < count && cumulative_[source] <= position) {
+        source++;
+      }
+      source = std::min(source, count - 1);
+      resampled_.x_[i] = particles_.x_[source];
+      resampled_.y_[i] = particles_.y_[source];
+      resampled_.theta_[i] = particles_.theta_[source];
+    }
+  });
+  particles_.x_.swap(resampled_.x_);
+  particles_.y_.swap(resampled_.y_);
+  particles_.theta_.swap(resampled_.theta_);
+  std::fill(weights_.begin(), weights_.end(), 1.0 / count);
+  sum_squares_ = 1.0 / count;
+  resamples_++;
+}
+
+void ParticleFilter::Estimate(Pose2D &mean,
+                              PoseCovariance &covariance) {
+  if (Size() == 0) {
+    mean = Pose2D();
+    covariance = PoseCovariance::Zero();
+    return;
+  }
+  // Everything relative to the first particle, which keeps the sums of squares small
+  const double x0 = particles_.x_[0];
+  const double y0 = particles_.y_[0];
+  const double theta0 = particles_.theta_[0];
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    std::array<double, 10> moments = {};
+    for (size_t i = begin; i < end; ++i) {
+      const double weight = weights_[i];
+      const double dx = particles_.x_[i] - x0;
+      const double dy = particles_.y_[i] - y0;
+      // Both headings are in [0, 2pi) so one correction is enough
+      double dtheta = particles_.theta_[i] - theta0;
+      dtheta += dtheta > M_PI ? -2 * M_PI : (dtheta < -M_PI ? 2 * M_PI : 0);
+      moments[0] += weight;
+      moments[1] += weight * dx;
+      moments[2] += weight * dy;
+      moments[3] += weight * dtheta;
+      moments[4] += weight * dx * dx;
+      moments[5] += weight * dx * dy;
+      moments[6] += weight * dx * dtheta;
+      moments[7] += weight * dy * dy;
+      moments[8] += weight * dy * dtheta;
+      moments[9] += weight * dtheta * dtheta;
+    }
+    chunk_moments_[chunk] = moments;
+  });
+  std::array<double, 10> moments = {};
+  for (const std::array<double, 10> &chunk : chunk_moments_) {
+    for (size_t i = 0; i < moments.size(); ++i) {
+      moments[i] += chunk[i];
+    }
+  }
+  const Eigen::Vector3d offset = Eigen::Vector3d(moments[1], moments[2], moments[3]) / moments[0];
+  PoseCovariance second;
+  second << moments[4], moments[5], moments[6],
+            moments[5], moments[7], moments[8],
+            moments[6], moments[8], moments[9];
+  covariance = second / moments[0] - offset * offset.transpose();
+  mean.x = x0 + offset[0];
+  mean.y = y0 + offset[1];
+  mean.theta = WrapAngle(theta0 + offset[2]);
+}
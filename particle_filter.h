@@ -0,0 +1,153 @@
+#ifndef SEPT2023__PARTICLE_FILTER_H_
+#define SEPT2023__PARTICLE_FILTER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <Eigen/Core>
+#include "ekf.h"
+#include "fleet_state.h"
+#include "fleet_step.h"
+#include "particle_filter_kernels.h"
+
+struct ThreadPool;
+
+enum class ParticleKernel {
+  kScalar,
+  kAvx2
+};
+
+/**
+ * \return the fastest weighting kernel this CPU (and build) supports, checked once at runtime
+ */
+ParticleKernel BestParticleKernel();
+
+const char *ParticleKernelName(ParticleKernel kernel);
+
+/**
+ * Particle filter for the same pose/measurement models as Ekf/Ukf, meant for 10^5 - 10^6
+ * particles. The particles are a FleetState so the motion update is the vectorized fleet step,
+ * each particle driving its own noisy copy of the odometry. Weighting runs a SIMD kernel over the
+ * structure of arrays and resampling is systematic, with the cumulative weights built as a two pass
+ * parallel prefix sum.
+ *
+ * Everything is split into fixed chunks of kParticleChunk particles, and each chunk draws its
+ * noise from its own Rng stream and keeps its own partial sums, so results don't depend on the
+ * number of threads. Nothing allocates once Reset has sized the arrays.
+ */
+struct ParticleFilter {
+  static constexpr size_t kParticleChunk = 4096;
+
+  // x_, y_, theta_ are the particles, v_, w_ the noisy velocities of the last prediction
+  FleetState particles_;
+  // Normalized to sum to 1
+  std::vector<double> weights_;
+  // Resample once the effective sample size drops below this fraction of the particle count
+  double resample_threshold_ = 0.5;
+  // Runs the chunks in parallel if set, otherwise everything runs on the calling thread
+  ThreadPool *pool_ = nullptr;
+  FleetKernel fleet_kernel_ = BestFleetKernel();
+  ParticleKernel kernel_ = BestParticleKernel();
+
+  uint64_t seed_ = 0;
+  // Every call that draws random numbers bumps this, so each gets fresh Rng streams
+  uint64_t draws_ = 0;
+  uint64_t resamples_ = 0;
+
+  /**
+   * Draw count particles from a Gaussian around pose, all with the same weight
+   */
+  void Reset(size_t count,
+             const Pose2D &pose,
+             const PoseCovariance &covariance,
+             uint64_t seed);
+
+  /**
+   * Size the particles and scratch space for count particles with equal weights, without drawing
+   * them. For restoring saved particles
+   */
+  void Resize(size_t count);
+
+  size_t Size() const;
+
+  /**
+   * Move every particle with its own sample of the measured odometry velocities
+   * \param linear_noise std dev of the measured linear velocity, m/s
+   * \param angular_noise std dev of the measured angular velocity, rad/s
+   */
+  void Predict(double linear_velocity,
+               double angular_velocity,
+               double dt,
+               double linear_noise,
+               double angular_noise);
+
+  /**
+   * Weight by any number of range/bearing measurements in one pass over the particles, then
+   * resample if the weights have degenerated
+   * \param measurements [range, bearing] as in PredictRangeBearing, one per landmark
+   */
+  void UpdateRangeBearing(const Eigen::Vector2d *measurements,
+                          const Eigen::Vector2d *landmarks,
+                          size_t count,
+                          double range_noise,
+                          double bearing_noise);
+
+  /**
+   * Direct position fix (GNSS)
+   * \param noise std dev of each axis, m
+   */
+  void UpdatePosition(const Eigen::Vector2d &measurement,
+                      double noise);
+
+  /**
+   * \return 1 / sum(w^2), between 1 (one particle has all the weight) and Size()
+   */
+  double EffectiveSampleSize() const;
+
+  /**
+   * Systematic resampling, one random offset and Size() evenly spaced picks along the cumulative
+   * weights. Leaves every weight at 1 / Size()
+   */
+  void Resample();
+
+  /**
+   * Weighted mean and covariance. The heading is averaged as offsets from the first particle's
+   * heading wrapped to +-pi, which matches the circular mean as long as the cloud covers less than
+   * half the circle. Not const, the per chunk sums go in scratch space
+   */
+  void Estimate(Pose2D &mean,
+                PoseCovariance &covariance);
+
+  /**
+   * Run fn(chunk, begin, end) over every kParticleChunk chunk, on the pool if there is one
+   */
+  void ForEachChunk(const std::function<void(size_t chunk, size_t begin, size_t end)> &fn) const;
+  size_t ChunkCount() const;
+
+  /**
+   * Multiply the weights by exp(log_likelihood_ - max_log_likelihood), renormalize, and resample
+   * if the effective sample size got too small
+   */
+  void ApplyLikelihood(double max_log_likelihood);
+
+  // Scratch space, sized by Reset
+  std::vector<double> log_likelihood_;
+  std::vector<double> cumulative_;
+  FleetState resampled_;
+  std::vector<ParticleObservation> observations_;
+  struct ChunkSums {
+    double max = 0;
+    double sum = 0;
+    double sum_squares = 0;
+    // Cumulative weight of all earlier chunks
+    double offset = 0;
+  };
+  std::vector<ChunkSums> chunk_sums_;
+  // Weighted sums of x, y, heading offset and their products for the estimate
+  std::vector<std::array<double, 10>> chunk_moments_;
+  double sum_squares_ = 0;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "particle_filter_kernels.h"
+#include "simd_math_avx2.h"
+
+/* This file is compiled with -mavx2, nothing in here may run unless the CPU supports it */
+
+static inline double HorizontalMax(__m256d v) {
+  __m128d pair = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return std::max(_mm_cvtsd_f64(pair), _mm_cvtsd_f64(_mm_unpackhi_pd(pair, pair)));
+}
+
+static inline double HorizontalSum(__m256d v) {
+  __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(pair) + _mm_cvtsd_f64(_mm_unpackhi_pd(pair, pair));
+}
+
+double WeightParticlesAvx2(const ParticleWeightSpan &span,
+                           size_t begin,
+                           size_t end,
+                           const ParticleObservation *observations,
+                           size_t observation_count,
+                           double range_scale,
+                           double bearing_kappa) {
+  const __m256d range_scale_v = _mm256_set1_pd(range_scale);
+  const __m256d kappa = _mm256_set1_pd(bearing_kappa);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d min_range = _mm256_set1_pd(1e-9);
+  __m256d max_v = _mm256_set1_pd(-INFINITY);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256d x = _mm256_loadu_pd(span.x + i);
+    __m256d y = _mm256_loadu_pd(span.y + i);
+    // One sin/cos per particle however many landmarks are in view
+    __m256d sin_theta, cos_theta;
+    SinCos(_mm256_loadu_pd(span.theta + i), sin_theta, cos_theta);
+    __m256d total = _mm256_setzero_pd();
+    for (size_t j = 0; j < observation_count; ++j) {
+      const ParticleObservation &observation = observations[j];
+      __m256d dx = _mm256_sub_pd(_mm256_set1_pd(observation.landmark_x), x);
+      __m256d dy = _mm256_sub_pd(_mm256_set1_pd(observation.landmark_y), y);
+      __m256d range = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+      __m256d range_error = _mm256_sub_pd(range, _mm256_set1_pd(observation.range));
+
+      // World direction the landmark was seen in, theta + bearing
+      __m256d sin_b = _mm256_set1_pd(observation.sin_bearing);
+      __m256d cos_b = _mm256_set1_pd(observation.cos_bearing);
+      __m256d sin_seen = _mm256_add_pd(_mm256_mul_pd(sin_theta, cos_b), _mm256_mul_pd(cos_theta, sin_b));
+      __m256d cos_seen = _mm256_sub_pd(_mm256_mul_pd(cos_theta, cos_b), _mm256_mul_pd(sin_theta, sin_b));
+      __m256d cos_error = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(dx, sin_seen), _mm256_mul_pd(dy, cos_seen)),
+                                        _mm256_max_pd(range, min_range));
+
+      total = _mm256_add_pd(total, _mm256_mul_pd(range_scale_v, _mm256_mul_pd(range_error, range_error)));
+      total = _mm256_add_pd(total, _mm256_mul_pd(kappa, _mm256_sub_pd(cos_error, one)));
+    }
+    _mm256_storeu_pd(span.log_likelihood + i, total);
+    max_v = _mm256_max_pd(max_v, total);
+  }
+  double max_value = HorizontalMax(max_v);
+  if (i < end) {
+    max_value = std::max(max_value, WeightParticlesScalar(span, i, end, observations, observation_count,
+                                                          range_scale, bearing_kappa));
+  }
+  return max_value;
+}
+
+void ExpWeightsAvx2(const double *log_likelihood,
+                    double *weights,
+                    size_t begin,
+                    size_t end,
+                    double offset,
+                    double &sum,
+                    double &sum_squares) {
+  const __m256d offset_v = _mm256_set1_pd(offset);
+  __m256d sum_v = _mm256_setzero_pd();
+  __m256d sum_squares_v = _mm256_setzero_pd();
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256d weight = _mm256_mul_pd(_mm256_loadu_pd(weights + i),
+                                   Exp(_mm256_sub_pd(_mm256_loadu_pd(log_likelihood + i), offset_v)));
+    _mm256_storeu_pd(weights + i, weight);
+    sum_v = _mm256_add_pd(sum_v, weight);
+    sum_squares_v = _mm256_add_pd(sum_squares_v, _mm256_mul_pd(weight, weight));
+  }
+  double tail_sum = 0;
+  double tail_sum_squares = 0;
+  ExpWeightsScalar(log_likelihood, weights, i, end, offset, tail_sum, tail_sum_squares);
+  sum = HorizontalSum(sum_v) + tail_sum;
+  sum_squares = HorizontalSum(sum_squares_v) + tail_sum_squares;
+}
+
+/**
+ * 4 uniforms in [0, 1) from 4 draws: the top 52 bits under the exponent of 1.0 give [1, 2)
+ */
+static inline __m256d Uniforms(Rng &rng) {
+  alignas(32) uint64_t draws[4];
+  for (uint64_t &draw : draws) {
+    draw = rng.NextU64();
+  }
+  __m256i bits = _mm256_srli_epi64(_mm256_load_si256(reinterpret_cast<const __m256i *>(draws)), 12);
+  bits = _mm256_or_si256(bits, _mm256_set1_epi64x(0x3ff0000000000000LL));
+  return _mm256_sub_pd(_mm256_castsi256_pd(bits), _mm256_set1_pd(1.0));
+}
+
+void SampleVelocitiesAvx2(Rng &rng,
+                          double *v,
+                          double *w,
+                          size_t begin,
+                          size_t end,
+                          double linear_velocity,
+                          double angular_velocity,
+                          double linear_noise,
+                          double angular_noise) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    // 1 - u is in (0, 1] so the log is finite
+    __m256d radius = _mm256_sqrt_pd(_mm256_mul_pd(_mm256_set1_pd(-2.0), Log(_mm256_sub_pd(one, Uniforms(rng)))));
+    __m256d sin_angle, cos_angle;
+    SinCos(_mm256_mul_pd(_mm256_set1_pd(2 * M_PI), Uniforms(rng)), sin_angle, cos_angle);
+    _mm256_storeu_pd(v + i, _mm256_add_pd(_mm256_set1_pd(linear_velocity),
+                                          _mm256_mul_pd(_mm256_set1_pd(linear_noise), _mm256_mul_pd(radius, cos_angle))));
+    _mm256_storeu_pd(w + i, _mm256_add_pd(_mm256_set1_pd(angular_velocity),
+                                          _mm256_mul_pd(_mm256_set1_pd(angular_noise), _mm256_mul_pd(radius, sin_angle))));
+  }
+  SampleVelocitiesScalar(rng, v, w, i, end, linear_velocity, angular_velocity, linear_noise, angular_noise);
+}
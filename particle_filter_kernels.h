@@ -0,0 +1,97 @@
+#ifndef SEPT2023__PARTICLE_FILTER_KERNELS_H_
+#define SEPT2023__PARTICLE_FILTER_KERNELS_H_
+
+#include <cstddef>
+#include "random.h"
+
+/**
+ * Internal to the particle filter, shared between particle_filter.cpp and the SIMD translation
+ * units which are compiled with different instruction set flags.
+ */
+
+/**
+ * One range/bearing measurement, with the bearing already turned into sin/cos so the kernels can
+ * compare directions with dot products instead of atan2
+ */
+struct ParticleObservation {
+  double landmark_x;
+  double landmark_y;
+  double range;
+  double sin_bearing;
+  double cos_bearing;
+};
+
+struct ParticleWeightSpan {
+  const double *x;
+  const double *y;
+  const double *theta;
+  // Log likelihood of every observation is written (not added) here
+  double *log_likelihood;
+};
+
+/**
+ * Per particle: sum over the observations of a Gaussian range term and a von Mises bearing term,
+ *   range_scale * (r - range)^2 + bearing_kappa * (cos(predicted - measured) - 1)
+ * \return the largest log likelihood in [begin, end)
+ */
+double WeightParticlesScalar(const ParticleWeightSpan &span,
+                             size_t begin,
+                             size_t end,
+                             const ParticleObservation *observations,
+                             size_t observation_count,
+                             double range_scale,
+                             double bearing_kappa);
+
+/**
+ * weights[i] *= exp(log_likelihood[i] - offset) over [begin, end)
+ * \param sum, sum_squares return variables, sum of the new weights and of their squares
+ */
+void ExpWeightsScalar(const double *log_likelihood,
+                      double *weights,
+                      size_t begin,
+                      size_t end,
+                      double offset,
+                      double &sum,
+                      double &sum_squares);
+
+/**
+ * Noisy copies of the odometry for [begin, end): v[i] = linear_velocity + linear_noise * n1 and
+ * w[i] = angular_velocity + angular_noise * n2, with n1, n2 standard normals from rng (Box-Muller,
+ * both outputs used)
+ */
+void SampleVelocitiesScalar(Rng &rng,
+                            double *v,
+                            double *w,
+                            size_t begin,
+                            size_t end,
+                            double linear_velocity,
+                            double angular_velocity,
+                            double linear_noise,
+                            double angular_noise);
+
+// Only built on x86, and must only be called if the CPU supports the instruction set
+double WeightParticlesAvx2(const ParticleWeightSpan &span,
+                           size_t begin,
+                           size_t end,
+                           const ParticleObservation *observations,
+                           size_t observation_count,
+                           double range_scale,
+                           double bearing_kappa);
+void ExpWeightsAvx2(const double *log_likelihood,
+                    double *weights,
+                    size_t begin,
+                    size_t end,
+                    double offset,
+                    double &sum,
+                    double &sum_squares);
+void SampleVelocitiesAvx2(Rng &rng,
+                          double *v,
+                          double *w,
+                          size_t begin,
+                          size_t end,
+                          double linear_velocity,
+                          double angular_velocity,
+                          double linear_noise,
+                          double angular_noise);
+
+#endif
@@ -0,0 +1,306 @@
+#include "path_tracking.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "random.h"
+#include "thread_pool.h"
+
+const char *TrackingControllerName(TrackingController controller) {
+  switch (controller) {
+    case TrackingController::kPurePursuit:
+      return "Pure pursuit";
+    case TrackingController::kMppi:
+      return "MPPI";
+  }
+  return "?";
+}
+
+void TrackingPath::Set(const std::vector<Pose2D> &points) {
+  points_ = points;
+  distances_.resize(points_.size());
+  double distance = 0;
+  for (size_t i = 0; i < points_.size(); ++i) {
+    if (i > 0) {
+      distance += std::hypot(points_[i].x - points_[i - 1].x, points_[i].y - points_[i - 1].y);
+    }
+    distances_[i] = distance;
+  }
+}
+
+void TrackingPath::Clear() {
+  points_.clear();
+  distances_.clear();
+}
+
+bool TrackingPath::Empty() const {
+  return points_.empty();
+}
+
+double TrackingPath::Length() const {
+  return distances_.empty() ? 0 : distances_.back();
+}
+
+double TrackingPath::Project(double x,
+                             double y,
+                             double from,
+                             double window) const {
+  if (points_.size() < 2) {
+    return 0;
+  }
+  from = std::clamp(from, 0.0, Length());
+  size_t i = std::upper_bound(distances_.begin(), distances_.end(), from) - distances_.begin();
+  i = i > 0 ? i - 1 : 0;
+  double best = from;
+  double best_distance = std::numeric_limits<double>::infinity();
+  for (; i + 1 < points_.size() && distances_[i] <= from + window; ++i) {
+    const Pose2D &a = points_[i];
+    const Pose2D &b = points_[i + 1];
+    const double length = distances_[i + 1] - distances_[i];
+    if (length <= 0) {
+      continue;
+    }
+    const double t = std::clamp(((x - a.x) * (b.x - a.x) + (y - a.y) * (b.y - a.y)) / (length * length), 0.0, 1.0);
+    const double distance = std::hypot(a.x + (b.x - a.x) * t - x, a.y + (b.y - a.y) * t - y);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = distances_[i] + t * length;
+    }
+  }
+  // Never backwards
+  return std::clamp(best, from, from + window);
+}
+
+Pose2D TrackingPath::At(double s) const {
+  if (points_.empty()) {
+    return Pose2D();
+  }
+  if (points_.size() == 1 || s >= Length()) {
+    return points_.back();
+  }
+  s = std::max(s, 0.0);
+  size_t i = std::upper_bound(distances_.begin(), distances_.end(), s) - distances_.begin() - 1;
+  i = std::min(i, points_.size() - 2);
+  const Pose2D &a = points_[i];
+  const Pose2D &b = points_[i + 1];
+  const double length = distances_[i + 1] - distances_[i];
+  const double t = length > 0 ? (s - distances_[i]) / length : 0;
+  Pose2D pose;
+  pose.x = a.x + (b.x - a.x) * t;
+  pose.y = a.y + (b.y - a.y) * t;
+  // Heading is clockwise from +y, so atan2(x, y)
+  pose.theta = WrapAngle(std::atan2(b.x - a.x, b.y - a.y));
+  return pose;
+}
+
+/**
+ * The end of the path is close: stand there and turn in place to its heading
+ * \return true if that is what this tick does, false to keep tracking the path
+ */
+static bool ArriveAtEnd(const TrackingPath &path,
+                        const TrackingLimits &limits,
+                        const Pose2D &pose,
+                        double &linear,
+                        double &angular,
+                        bool &done) {
+  const Pose2D &end = path.points_.back();
+  if (std::hypot(end.x - pose.x, end.y - pose.y) > limits.goal_tolerance_) {
+    return false;
+  }
+  const double error = std::remainder(end.theta - pose.theta, 2 * M_PI);
+  linear = 0;
+  angular = std::clamp(2 * error, -limits.max_angular_, limits.max_angular_);
+  done = std::fabs(error) < limits.heading_tolerance_;
+  if (done) {
+    angular = 0;
+  }
+  return true;
+}
+
+void PurePursuit::Reset() {
+  progress_ = 0;
+}
+
+bool PurePursuit::Compute(const TrackingPath &path,
+                          const Pose2D &pose,
+                          double &linear,
+                          double &angular) {
+  linear = 0;
+  angular = 0;
+  if (path.Empty()) {
+    return false;
+  }
+  const double lookahead = lookahead_ + lookahead_gain_ * limits_.speed_;
+  progress_ = path.Project(pose.x, pose.y, progress_, 2 * lookahead);
+  bool done = false;
+  if (ArriveAtEnd(path, limits_, pose, linear, angular, done)) {
+    return !done;
+  }
+  const Pose2D target = path.At(progress_ + lookahead);
+  const double dx = target.x - pose.x;
+  const double dy = target.y - pose.y;
+  // Target in the robot's frame
+  const double forward = dx * std::sin(pose.theta) + dy * std::cos(pose.theta);
+  const double right = dx * std::cos(pose.theta) - dy * std::sin(pose.theta);
+  if (forward <= 0) {
+    // Behind or level with us, face it first
+    angular = right >= 0 ? limits_.max_angular_ : -limits_.max_angular_;
+    return true;
+  }
+  // Arc through the target tangent to the heading, positive curves clockwise
+  const double curvature = 2 * right / (dx * dx + dy * dy);
+  const double remaining = path.Length() - progress_;
+  linear = std::min(limits_.speed_, std::max(0.1, remaining));
+  if (std::fabs(curvature) * linear > limits_.max_angular_) {
+    linear = limits_.max_angular_ / std::fabs(curvature);
+  }
+  linear = std::min(linear, limits_.max_linear_);
+  angular = std::clamp(linear * curvature, -limits_.max_angular_, limits_.max_angular_);
+  return true;
+}
+
+void Mppi::Reset() {
+  plan_linear_.setZero(horizon_);
+  plan_angular_.setZero(horizon_);
+  progress_ = 0;
+}
+
+void Mppi::ForEachChunk(const std::function<void(size_t chunk, size_t begin, size_t end)> &fn) {
+  if (pool_ == nullptr) {
+    for (size_t begin = 0; begin < rollouts_; begin += kMppiChunk) {
+      fn(begin / kMppiChunk, begin, std::min(rollouts_, begin + kMppiChunk));
+    }
+    return;
+  }
+  // With the grain equal to the chunk size the pool's chunks are exactly ours
+  pool_->ParallelFor(rollouts_, kMppiChunk, [&fn](size_t begin, size_t end) {
+    fn(begin / kMppiChunk, begin, end);
+  });
+}
+
+bool Mppi::Compute(const TrackingPath &path,
+                   const Pose2D &pose,
+                   double &linear,
+                   double &angular) {
+  const auto start = std::chrono::steady_clock::now();
+  linear = 0;
+  angular = 0;
+  if (path.Empty() || rollouts_ == 0 || horizon_ <= 0) {
+    return false;
+  }
+  if (plan_linear_.size() != horizon_) {
+    Reset();
+  }
+  if ((size_t)linear_.rows() != rollouts_ || linear_.cols() != horizon_) {
+    linear_.resize(rollouts_, horizon_);
+    angular_.resize(rollouts_, horizon_);
+    x_.resize(rollouts_);
+    y_.resize(rollouts_);
+    theta_.resize(rollouts_);
+    costs_.resize(rollouts_);
+  }
+  progress_ = path.Project(pose.x, pose.y, progress_, 2 + limits_.speed_ * dt_ * horizon_);
+  bool done = false;
+  if (ArriveAtEnd(path, limits_, pose, linear, angular, done)) {
+    // Start the next path from rest
+    plan_linear_.setZero();
+    plan_angular_.setZero();
+    seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return !done;
+  }
+
+  // Follow the path at cruise speed from the closest point
+  reference_x_.resize(horizon_);
+  reference_y_.resize(horizon_);
+  reference_theta_.resize(horizon_);
+  for (int k = 0; k < horizon_; ++k) {
+    const Pose2D reference = path.At(progress_ + limits_.speed_ * dt_ * (k + 1));
+    reference_x_[k] = (float)(reference.x - pose.x);
+    reference_y_[k] = (float)(reference.y - pose.y);
+    reference_theta_[k] = (float)reference.theta;
+  }
+
+  ForEachChunk([&](size_t chunk, size_t begin, size_t end) {
+    Rollouts(chunk, begin, end, pose);
+  });
+
+  // Softmin of the costs, shifted by the best so the exponentials don't underflow
+  const float best = costs_.minCoeff();
+  weights_ = (-(costs_.array() - best) / (float)lambda_).exp().matrix();
+  weights_ /= weights_.sum();
+  plan_linear_.noalias() = linear_.transpose() * weights_;
+  plan_angular_.noalias() = angular_.transpose() * weights_;
+  best_cost_ = best;
+  effective_rollouts_ = 1 / weights_.squaredNorm();
+  linear = plan_linear_[0];
+  angular = plan_angular_[0];
+  // Warm start: what is left of the plan, holding the last control
+  for (int k = 0; k + 1 < horizon_; ++k) {
+    plan_linear_[k] = plan_linear_[k + 1];
+    plan_angular_[k] = plan_angular_[k + 1];
+  }
+  ++ticks_;
+  seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+void Mppi::Rollouts(size_t chunk,
+                    size_t begin,
+                    size_t end,
+                    const Pose2D &pose) {
+  const size_t chunk_count = (rollouts_ + kMppiChunk - 1) / kMppiChunk;
+  Rng rng(seed_, ticks_ * chunk_count + chunk);
+  const float max_linear = (float)limits_.max_linear_;
+  const float max_angular = (float)limits_.max_angular_;
+  // Box-Muller gives two normals, one for each control
+  for (int k = 0; k < horizon_; ++k) {
+    float *linear = linear_.col(k).data();
+    float *angular = angular_.col(k).data();
+    for (size_t i = begin; i < end; ++i) {
+      const double radius = std::sqrt(-2 * std::log(1 - rng.Uniform()));
+      const double angle = 2 * M_PI * rng.Uniform();
+      linear[i] = std::clamp(plan_linear_[k] + (float)(linear_noise_ * radius * std::cos(angle)), 0.0f, max_linear);
+      angular[i] = std::clamp(plan_angular_[k] + (float)(angular_noise_ * radius * std::sin(angle)),
+                              -max_angular, max_angular);
+    }
+    if (begin == 0) {
+      // Rollout 0 is the plan as it is, so a good plan is never lost to noise
+      linear[0] = std::clamp(plan_linear_[k], 0.0f, max_linear);
+      angular[0] = std::clamp(plan_angular_[k], -max_angular, max_angular);
+    }
+  }
+
+  const Eigen::Index count = (Eigen::Index)(end - begin);
+  auto x = x_.segment(begin, count).array();
+  auto y = y_.segment(begin, count).array();
+  auto theta = theta_.segment(begin, count).array();
+  auto cost = costs_.segment(begin, count).array();
+  x.setZero();
+  y.setZero();
+  theta.setConstant((float)pose.theta);
+  cost.setZero();
+  const float dt = (float)dt_;
+  for (int k = 0; k < horizon_; ++k) {
+    const auto v = linear_.col(k).segment(begin, count).array();
+    const auto w = angular_.col(k).segment(begin, count).array();
+    // Unicycle with the heading half way through the step, forward is (sin, cos)
+    x += dt * v * (theta + 0.5f * dt * w).sin();
+    y += dt * v * (theta + 0.5f * dt * w).cos();
+    theta += dt * w;
+    cost += (float)position_weight_ * ((x - reference_x_[k]).square() + (y - reference_y_[k]).square()) +
+            (float)heading_weight_ * (1 - (theta - reference_theta_[k]).cos()) +
+            (float)angular_weight_ * w.square();
+    if (field_ == nullptr) {
+      continue;
+    }
+    for (Eigen::Index i = 0; i < count; ++i) {
+      const double clearance = field_->Clearance(pose.x + x[i], pose.y + y[i]);
+      if (clearance < radius_) {
+        cost[i] += (float)obstacle_weight_;
+      }
+      else if (clearance < radius_ + margin_) {
+        cost[i] += (float)(obstacle_weight_ * 0.01 * (radius_ + margin_ - clearance) / margin_);
+      }
+    }
+  }
+}
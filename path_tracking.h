@@ -0,0 +1,174 @@
+#ifndef SEPT2023__PATH_TRACKING_H_
+#define SEPT2023__PATH_TRACKING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <Eigen/Core>
+#include "distance_field.h"
+#include "unicycle.h"
+
+struct ThreadPool;
+
+enum class TrackingController {
+  kPurePursuit,
+  kMppi
+};
+
+const char *TrackingControllerName(TrackingController controller);
+
+/**
+ * A path to follow (e.g. PlanResult::path_) as straight segments between its poses, measured by
+ * arc length from the first pose. The last pose's heading is where the robot should end up facing.
+ */
+struct TrackingPath {
+  std::vector<Pose2D> points_;
+  // Arc length at each point, distances_[0] is 0
+  std::vector<double> distances_;
+
+  void Set(const std::vector<Pose2D> &points);
+  void Clear();
+  bool Empty() const;
+  double Length() const;
+
+  /**
+   * \return arc length of the point on the path closest to (x, y), only looking between from and
+   *         from + window so a path that doubles back doesn't make the robot skip ahead
+   */
+  double Project(double x,
+                 double y,
+                 double from,
+                 double window) const;
+
+  /**
+   * \return the point at arc length s (clamped to the path), facing along its segment. Past the
+   *         end, the last pose
+   */
+  Pose2D At(double s) const;
+};
+
+/**
+ * How fast a controller may drive, shared by both
+ */
+struct TrackingLimits {
+  // Cruise speed along the path, m/s
+  double speed_ = 1.0;
+  double max_linear_ = 1.2;
+  // rad/s
+  double max_angular_ = 1.5;
+  // Done once this close to the end and within heading_tolerance_ of its heading
+  double goal_tolerance_ = 0.15;
+  double heading_tolerance_ = 0.05;
+};
+
+/**
+ * Geometric path tracker: steer on the arc through a point lookahead ahead on the path. Turns in
+ * place when that point is behind, slows down so the arc never needs more than max_angular_.
+ */
+struct PurePursuit {
+  TrackingLimits limits_;
+  // Lookahead is lookahead_ + lookahead_gain_ * speed, m and s
+  double lookahead_ = 0.5;
+  double lookahead_gain_ = 0.5;
+  // Arc length the robot has reached
+  double progress_ = 0;
+
+  void Reset();
+
+  /**
+   * \return false once the end is reached, then linear and angular are 0
+   */
+  bool Compute(const TrackingPath &path,
+               const Pose2D &pose,
+               double &linear,
+               double &angular);
+};
+
+/**
+ * Model predictive path integral control. Every tick rollouts_ control sequences, the previous
+ * tick's plan plus Gaussian noise, are driven horizon_ steps through the unicycle model and
+ * scored against the path (position, heading, turning effort, and the distance field if there is
+ * one). The new plan is the average of all of them weighted by exp(-cost / lambda_), its first
+ * control is the output and the rest warm starts the next tick.
+ *
+ * Rollouts are structure of arrays: one column per time step of the controls, one entry per
+ * rollout of the states, so each step is a handful of Eigen array expressions over a chunk of
+ * rollouts. Positions are float relative to the robot. Chunks of kMppiChunk rollouts go over the
+ * pool, each chunk draws its noise from its own Rng stream so the result doesn't depend on the
+ * thread count.
+ */
+struct Mppi {
+  static constexpr size_t kMppiChunk = 256;
+
+  TrackingLimits limits_;
+  size_t rollouts_ = 2048;
+  int horizon_ = 30;
+  // Rollout step, s. Horizon of 1.5 s by default
+  double dt_ = 0.05;
+  // Temperature, lower follows the best rollouts more closely
+  double lambda_ = 0.5;
+  // Std dev of the control noise, m/s and rad/s
+  double linear_noise_ = 0.3;
+  double angular_noise_ = 0.8;
+  // Cost per step of squared distance to the reference point, of 1 - cos(heading error) and of
+  // squared angular velocity
+  double position_weight_ = 4;
+  double heading_weight_ = 1;
+  double angular_weight_ = 0.05;
+  // Cost per step closer than radius_ to the map, and per step within margin_ beyond that. Only
+  // with a field_
+  const DistanceField *field_ = nullptr;
+  double radius_ = 0.6;
+  double margin_ = 0.3;
+  double obstacle_weight_ = 1000;
+  ThreadPool *pool_ = nullptr;
+  uint64_t seed_ = 2023;
+
+  // Warm started plan, horizon_ controls
+  Eigen::VectorXf plan_linear_;
+  Eigen::VectorXf plan_angular_;
+  // Sampled controls, rollouts_ x horizon_
+  Eigen::MatrixXf linear_;
+  Eigen::MatrixXf angular_;
+  // Rollout states, relative to the pose the tick starts from
+  Eigen::VectorXf x_;
+  Eigen::VectorXf y_;
+  Eigen::VectorXf theta_;
+  Eigen::VectorXf costs_;
+  Eigen::VectorXf weights_;
+  // Where the path says the robot should be after each step, relative like the states
+  Eigen::VectorXf reference_x_;
+  Eigen::VectorXf reference_y_;
+  Eigen::VectorXf reference_theta_;
+  double progress_ = 0;
+  uint64_t ticks_ = 0;
+
+  // From the last Compute: wall time, best cost and the effective number of rollouts that
+  // count (1 / sum of squared weights)
+  double seconds_ = 0;
+  double best_cost_ = 0;
+  double effective_rollouts_ = 0;
+
+  void Reset();
+
+  /**
+   * \return false once the end is reached, then linear and angular are 0
+   */
+  bool Compute(const TrackingPath &path,
+               const Pose2D &pose,
+               double &linear,
+               double &angular);
+
+  /**
+   * Sample and drive rollouts [begin, end), adding up their costs
+   */
+  void Rollouts(size_t chunk,
+                size_t begin,
+                size_t end,
+                const Pose2D &pose);
+
+  void ForEachChunk(const std::function<void(size_t chunk, size_t begin, size_t end)> &fn);
+};
+
+#endif
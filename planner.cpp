@@ -0,0 +1,566 @@
+#include "planner.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+const char *PlannerTypeName(PlannerType type) {
+  switch (type) {
+    case PlannerType::kGrid:
+      return "Grid A*";
+    case PlannerType::kHybrid:
+      return "Hybrid A*";
+  }
+  return "?";
+}
+
+void PlannerWorkspace::Reset() {
+  nodes_.clear();
+  open_.clear();
+  used_ = 0;
+  if (keys_.empty()) {
+    Grow();
+  }
+  if (++generation_ == 0) {
+    // Wrapped, every slot could look current
+    std::fill(generations_.begin(), generations_.end(), 0);
+    generation_ = 1;
+  }
+}
+
+static size_t HashSlot(uint64_t key,
+                       size_t mask) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return (size_t)key & mask;
+}
+
+uint32_t PlannerWorkspace::FindOrInsert(uint64_t key,
+                                        bool &inserted) {
+  // At most half full so probe runs stay short
+  if ((used_ + 1) * 2 > keys_.size()) {
+    Grow();
+  }
+  const size_t mask = keys_.size() - 1;
+  size_t slot = HashSlot(key, mask);
+  while (generations_[slot] == generation_) {
+    if (keys_[slot] == key) {
+      inserted = false;
+      return values_[slot];
+    }
+    slot = (slot + 1) & mask;
+  }
+  generations_[slot] = generation_;
+  keys_[slot] = key;
+  values_[slot] = (uint32_t)nodes_.size();
+  nodes_.emplace_back();
+  ++used_;
+  inserted = true;
+  return values_[slot];
+}
+
+void PlannerWorkspace::Grow() {
+  const size_t size = std::max<size_t>(1 << 16, keys_.size() * 2);
+  std::vector<uint64_t> keys(size);
+  std::vector<uint32_t> values(size);
+  std::vector<uint32_t> generations(size, 0);
+  const uint32_t generation = std::max<uint32_t>(generation_, 1);
+  const size_t mask = size - 1;
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    if (generations_[i] != generation_) {
+      continue;
+    }
+    size_t slot = HashSlot(keys_[i], mask);
+    while (generations[slot] == generation) {
+      slot = (slot + 1) & mask;
+    }
+    generations[slot] = generation;
+    keys[slot] = keys_[i];
+    values[slot] = values_[i];
+  }
+  keys_.swap(keys);
+  values_.swap(values);
+  generations_.swap(generations);
+  generation_ = generation;
+}
+
+static bool OpenGreater(const PlannerHeapEntry &a,
+                        const PlannerHeapEntry &b) {
+  // Equal f: the one further along (larger g) first. On open ground every cell between two
+  // equally short paths ties, without this the search floods all of them before the goal
+  if (a.f_ != b.f_) {
+    return a.f_ > b.f_;
+  }
+  return a.g_ < b.g_;
+}
+
+void PlannerWorkspace::Push(double f,
+                            double g,
+                            uint32_t node) {
+  // Rounded to a micrometre so paths that are equally long up to rounding (sums of different
+  // numbers of sqrt(2) steps) really tie, and the larger g goes first
+  open_.push_back({std::round(f * 1e6) * 1e-6, g, node});
+  std::push_heap(open_.begin(), open_.end(), OpenGreater);
+}
+
+bool PlannerWorkspace::Pop(PlannerHeapEntry &entry) {
+  if (open_.empty()) {
+    return false;
+  }
+  std::pop_heap(open_.begin(), open_.end(), OpenGreater);
+  entry = open_.back();
+  open_.pop_back();
+  return true;
+}
+
+/**
+ * \return how much more than its length moving through a spot clearance m from the map costs
+ */
+static double ClearanceCost(const PlannerSettings &settings,
+                            double radius,
+                            double clearance) {
+  const double spare = clearance - radius;
+  if (spare >= settings.comfort_clearance_ || settings.comfort_clearance_ <= 0) {
+    return 1;
+  }
+  return 1 + settings.clearance_weight_ * (settings.comfort_clearance_ - spare) / settings.comfort_clearance_;
+}
+
+/**
+ * Heading (clockwise from +y) of the direction (dx, dy)
+ */
+static double HeadingOf(double dx,
+                        double dy) {
+  return WrapAngle(std::atan2(dx, dy));
+}
+
+static void StartResult(const PlanRequest &request,
+                        PlanResult &result) {
+  result.id_ = request.id_;
+  result.robot_ = request.robot_;
+  result.type_ = request.type_;
+  result.found_ = false;
+  result.path_.clear();
+  result.length_ = 0;
+  result.expanded_ = 0;
+}
+
+static void FinishPath(PlanResult &result) {
+  result.length_ = 0;
+  for (size_t i = 1; i < result.path_.size(); ++i) {
+    result.length_ += std::hypot(result.path_[i].x - result.path_[i - 1].x, result.path_[i].y - result.path_[i - 1].y);
+  }
+  result.found_ = true;
+}
+
+/**
+ * Is the straight line from a to b clear by radius. Steps by the clearance to spare at each
+ * point (nothing within it can be hit), at least half a cell
+ */
+static bool SegmentClear(const DistanceField &field,
+                         double ax,
+                         double ay,
+                         double bx,
+                         double by,
+                         double radius) {
+  const double length = std::hypot(bx - ax, by - ay);
+  double along = 0;
+  while (true) {
+    const double t = length > 0 ? along / length : 1;
+    const double clearance = field.Clearance(ax + (bx - ax) * t, ay + (by - ay) * t);
+    if (clearance < radius) {
+      return false;
+    }
+    if (along >= length) {
+      return true;
+    }
+    along = std::min(length, along + std::max(clearance - radius, field.resolution_ * 0.5));
+  }
+}
+
+bool PlanGridAStar(const DistanceField &field,
+                   const PlannerSettings &settings,
+                   const PlanRequest &request,
+                   PlannerWorkspace &workspace,
+                   PlanResult &result) {
+  StartResult(request, result);
+  const double resolution = field.resolution_;
+  const int64_t start_x = (int64_t)std::floor((request.start_.x - field.origin_x_) / resolution);
+  const int64_t start_y = (int64_t)std::floor((request.start_.y - field.origin_y_) / resolution);
+  const int64_t goal_x = (int64_t)std::floor((request.goal_.x - field.origin_x_) / resolution);
+  const int64_t goal_y = (int64_t)std::floor((request.goal_.y - field.origin_y_) / resolution);
+  const int64_t width = field.width_;
+  const int64_t height = field.height_;
+  auto inside = [&](int64_t x, int64_t y) {
+    return x >= 0 && y >= 0 && x < width && y < height;
+  };
+  // Centre to the nearest point of the nearest occupied cell
+  auto clearance = [&](int64_t x, int64_t y) {
+    return field.Cell(x, y) - resolution * M_SQRT1_2;
+  };
+  if (!inside(start_x, start_y) || !inside(goal_x, goal_y) || clearance(goal_x, goal_y) < request.radius_) {
+    return false;
+  }
+  auto heuristic = [&](int64_t x, int64_t y) {
+    const double dx = (double)std::abs(x - goal_x);
+    const double dy = (double)std::abs(y - goal_y);
+    // Octile distance, exact on an empty 8 connected grid
+    return (std::max(dx, dy) + (M_SQRT2 - 1) * std::min(dx, dy)) * resolution * settings.heuristic_weight_;
+  };
+  static const int kNeighbourX[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+  static const int kNeighbourY[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+  workspace.Reset();
+  bool inserted = false;
+  const uint32_t start = workspace.FindOrInsert((uint64_t)(start_y * width + start_x), inserted);
+  workspace.nodes_[start].parent_ = start;
+  workspace.Push(heuristic(start_x, start_y), 0, start);
+  PlannerHeapEntry entry;
+  uint32_t goal = std::numeric_limits<uint32_t>::max();
+  // Cells are found back from their index, x and y are kept in the pose as cell numbers until the end
+  workspace.nodes_[start].pose_.x = (double)start_x;
+  workspace.nodes_[start].pose_.y = (double)start_y;
+  while (workspace.Pop(entry)) {
+    PlannerNode &node = workspace.nodes_[entry.node_];
+    if (node.closed_ || entry.g_ > node.g_) {
+      continue;
+    }
+    node.closed_ = true;
+    if (++result.expanded_ > request.max_expansions_) {
+      break;
+    }
+    const int64_t x = (int64_t)node.pose_.x;
+    const int64_t y = (int64_t)node.pose_.y;
+    const double g = node.g_;
+    if (x == goal_x && y == goal_y) {
+      goal = entry.node_;
+      break;
+    }
+    for (int i = 0; i < 8; ++i) {
+      const int64_t next_x = x + kNeighbourX[i];
+      const int64_t next_y = y + kNeighbourY[i];
+      if (!inside(next_x, next_y)) {
+        continue;
+      }
+      const double next_clearance = clearance(next_x, next_y);
+      if (next_clearance < request.radius_) {
+        continue;
+      }
+      const double step = (i < 4 ? resolution : resolution * M_SQRT2) *
+                          ClearanceCost(settings, request.radius_, next_clearance);
+      const uint32_t next = workspace.FindOrInsert((uint64_t)(next_y * width + next_x), inserted);
+      PlannerNode &next_node = workspace.nodes_[next];
+      if (inserted) {
+        next_node.g_ = std::numeric_limits<double>::infinity();
+        next_node.pose_.x = (double)next_x;
+        next_node.pose_.y = (double)next_y;
+      }
+      if (next_node.closed_ || g + step >= next_node.g_) {
+        continue;
+      }
+      next_node.g_ = g + step;
+      next_node.parent_ = entry.node_;
+      workspace.Push(next_node.g_ + heuristic(next_x, next_y), next_node.g_, next);
+    }
+  }
+  if (goal == std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  // Walk back keeping only the cells where the direction changes
+  std::vector<Pose2D> &path = result.path_;
+  path.push_back(request.goal_);
+  int64_t last_dx = 0;
+  int64_t last_dy = 0;
+  uint32_t index = goal;
+  while (workspace.nodes_[index].parent_ != index) {
+    const PlannerNode &node = workspace.nodes_[index];
+    const PlannerNode &parent = workspace.nodes_[node.parent_];
+    const int64_t dx = (int64_t)node.pose_.x - (int64_t)parent.pose_.x;
+    const int64_t dy = (int64_t)node.pose_.y - (int64_t)parent.pose_.y;
+    if ((dx != last_dx || dy != last_dy) && index != goal) {
+      Pose2D corner;
+      corner.x = field.origin_x_ + (node.pose_.x + 0.5) * resolution;
+      corner.y = field.origin_y_ + (node.pose_.y + 0.5) * resolution;
+      path.push_back(corner);
+    }
+    last_dx = dx;
+    last_dy = dy;
+    index = node.parent_;
+  }
+  path.push_back(request.start_);
+  std::reverse(path.begin(), path.end());
+  // Cut the staircase corners off: from each kept point straight to the furthest one in sight
+  size_t kept = 0;
+  for (size_t i = 0; i + 1 < path.size();) {
+    size_t next = path.size() - 1;
+    while (next > i + 1 && !SegmentClear(field, path[i].x, path[i].y, path[next].x, path[next].y, request.radius_)) {
+      --next;
+    }
+    path[++kept] = path[next];
+    i = next;
+  }
+  path.resize(std::min(path.size(), kept + 1));
+  // Face along the next leg
+  for (size_t i = 1; i + 1 < path.size(); ++i) {
+    path[i].theta = HeadingOf(path[i + 1].x - path[i].x, path[i + 1].y - path[i].y);
+  }
+  FinishPath(result);
+  return true;
+}
+
+/**
+ * Shortest angle from a to b, either way round
+ */
+static double AngleBetween(double a,
+                           double b) {
+  return std::fabs(std::remainder(b - a, 2 * M_PI));
+}
+
+bool PlanHybridAStar(const DistanceField &field,
+                     const PlannerSettings &settings,
+                     const PlanRequest &request,
+                     PlannerWorkspace &workspace,
+                     PlanResult &result) {
+  StartResult(request, result);
+  if (field.Clearance(request.goal_.x, request.goal_.y) < request.radius_) {
+    return false;
+  }
+  const double bin_angle = 2 * M_PI / settings.heading_bins_;
+  auto key_of = [&](const Pose2D &pose) {
+    const int64_t x = (int64_t)std::floor((pose.x - field.origin_x_) / settings.hybrid_cell_);
+    const int64_t y = (int64_t)std::floor((pose.y - field.origin_y_) / settings.hybrid_cell_);
+    const int64_t bin = (int64_t)std::floor(WrapAngle(pose.theta) / bin_angle + 0.5) % settings.heading_bins_;
+    return ((uint64_t)x & 0x1FFFFF) << 42 | ((uint64_t)y & 0x1FFFFF) << 21 | (uint64_t)bin;
+  };
+  auto heuristic = [&](const Pose2D &pose) {
+    // Straight there, every other cost only adds to the length
+    return std::hypot(request.goal_.x - pose.x, request.goal_.y - pose.y) * settings.heuristic_weight_;
+  };
+
+  // Forward arcs of the unicycle at a few curvatures, and turns in place (free for a disc robot)
+  struct Motion {
+    double curvature_;
+    double turn_;
+  };
+  const double turn = settings.turn_bins_ * bin_angle;
+  const std::array<Motion, 7> motions = {{{-settings.max_curvature_, 0},
+                                          {-settings.max_curvature_ * 0.5, 0},
+                                          {0, 0},
+                                          {settings.max_curvature_ * 0.5, 0},
+                                          {settings.max_curvature_, 0},
+                                          {0, -turn},
+                                          {0, turn}}};
+
+  workspace.Reset();
+  bool inserted = false;
+  const uint32_t start = workspace.FindOrInsert(key_of(request.start_), inserted);
+  workspace.nodes_[start].pose_ = request.start_;
+  workspace.nodes_[start].parent_ = start;
+  workspace.Push(heuristic(request.start_), 0, start);
+  PlannerHeapEntry entry;
+  uint32_t last = std::numeric_limits<uint32_t>::max();
+  // The goal pose goes on the end, straight from last (after turning to face it) if shot
+  bool shot = false;
+  while (workspace.Pop(entry)) {
+    PlannerNode &node = workspace.nodes_[entry.node_];
+    if (node.closed_ || entry.g_ > node.g_) {
+      continue;
+    }
+    node.closed_ = true;
+    if (++result.expanded_ > request.max_expansions_) {
+      break;
+    }
+    const Pose2D pose = node.pose_;
+    const double g = node.g_;
+    if (std::hypot(request.goal_.x - pose.x, request.goal_.y - pose.y) < settings.goal_tolerance_ &&
+        AngleBetween(pose.theta, request.goal_.theta) < settings.heading_tolerance_) {
+      last = entry.node_;
+      break;
+    }
+    if (settings.shot_interval_ > 0 && result.expanded_ % settings.shot_interval_ == 1 &&
+        SegmentClear(field, pose.x, pose.y, request.goal_.x, request.goal_.y, request.radius_)) {
+      last = entry.node_;
+      shot = true;
+      break;
+    }
+    for (const Motion &motion : motions) {
+      Pose2D next_pose = pose;
+      double cost = 0;
+      if (motion.turn_ != 0) {
+        next_pose.theta = WrapAngle(next_pose.theta + motion.turn_);
+        cost = settings.turn_cost_ * std::fabs(motion.turn_);
+      }
+      else {
+        // Along the arc in jumps of the clearance to spare, like SegmentClear. An arc of length s
+        // ends at most s away
+        double along = 0;
+        double clearance = field.Clearance(pose.x, pose.y);
+        while (clearance >= request.radius_ && along < settings.step_) {
+          along = std::min(settings.step_, along + std::max(clearance - request.radius_, field.resolution_ * 0.5));
+          next_pose = pose;
+          StepUnicycle(next_pose, 1, motion.curvature_, along);
+          clearance = field.Clearance(next_pose.x, next_pose.y);
+        }
+        if (clearance < request.radius_) {
+          continue;
+        }
+        next_pose.theta = WrapAngle(next_pose.theta);
+        cost = settings.step_ * ClearanceCost(settings, request.radius_, clearance);
+      }
+      const uint32_t next = workspace.FindOrInsert(key_of(next_pose), inserted);
+      PlannerNode &next_node = workspace.nodes_[next];
+      if (inserted) {
+        next_node.g_ = std::numeric_limits<double>::infinity();
+      }
+      if (next_node.closed_ || g + cost >= next_node.g_) {
+        continue;
+      }
+      next_node.pose_ = next_pose;
+      next_node.g_ = g + cost;
+      next_node.parent_ = entry.node_;
+      workspace.Push(next_node.g_ + heuristic(next_pose), next_node.g_, next);
+    }
+  }
+  if (last == std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  std::vector<Pose2D> &path = result.path_;
+  path.push_back(request.goal_);
+  if (shot) {
+    // Drive the last leg facing the goal, then turn to the goal heading there
+    Pose2D facing = workspace.nodes_[last].pose_;
+    facing.theta = HeadingOf(request.goal_.x - facing.x, request.goal_.y - facing.y);
+    path.push_back(facing);
+  }
+  for (uint32_t index = last;; index = workspace.nodes_[index].parent_) {
+    path.push_back(workspace.nodes_[index].pose_);
+    if (workspace.nodes_[index].parent_ == index) {
+      break;
+    }
+  }
+  std::reverse(path.begin(), path.end());
+  FinishPath(result);
+  return true;
+}
+
+bool Plan(const DistanceField &field,
+          const PlannerSettings &settings,
+          const PlanRequest &request,
+          PlannerWorkspace &workspace,
+          PlanResult &result) {
+  const auto start = std::chrono::steady_clock::now();
+  const bool found = request.type_ == PlannerType::kGrid
+                     ? PlanGridAStar(field, settings, request, workspace, result)
+                     : PlanHybridAStar(field, settings, request, workspace, result);
+  result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return found;
+}
+
+PlannerService::PlannerService(size_t threads)
+    : pool_(threads) {
+}
+
+PlannerService::~PlannerService() {
+  stopping_ = true;
+  Wait();
+}
+
+void PlannerService::BuildField(const OccupancyGrid &grid) {
+  auto field = std::make_shared<DistanceField>();
+  field->Build(grid, &pool_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  field_ = std::move(field);
+}
+
+void PlannerService::RebuildField(const OccupancyGrid &grid) {
+  const std::shared_ptr<const DistanceField> current = Field();
+  if (current != nullptr && current->grid_version_ == grid.version_.load(std::memory_order_acquire)) {
+    return;
+  }
+  if (rebuilding_.exchange(true)) {
+    return;
+  }
+  // The caller is the only one writing grid, so this copy is of one consistent version. The
+  // copy's own version_ starts over, the field is stamped with the original's
+  const uint32_t version = grid.version_.load(std::memory_order_acquire);
+  auto copy = std::make_shared<OccupancyGrid>();
+  if (!copy->CopyFrom(grid)) {
+    rebuilding_ = false;
+    return;
+  }
+  pool_.Submit([this, copy, version]() {
+    auto field = std::make_shared<DistanceField>();
+    field->Build(*copy, &pool_);
+    field->grid_version_ = version;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      field_ = std::move(field);
+    }
+    rebuilding_ = false;
+  });
+}
+
+std::shared_ptr<const DistanceField> PlannerService::Field() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return field_;
+}
+
+uint64_t PlannerService::Request(PlanRequest request) {
+  request.id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  pool_.Submit([this, request]() {
+    RunRequest(request);
+  });
+  return request.id_;
+}
+
+void PlannerService::RunRequest(const PlanRequest &request) {
+  std::unique_ptr<PlannerWorkspace> workspace;
+  std::shared_ptr<const DistanceField> field;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!workspaces_.empty()) {
+      workspace = std::move(workspaces_.back());
+      workspaces_.pop_back();
+    }
+    field = field_;
+  }
+  if (workspace == nullptr) {
+    workspace = std::make_unique<PlannerWorkspace>();
+  }
+  PlanResult result;
+  StartResult(request, result);
+  const bool found = field != nullptr && !stopping_ && Plan(*field, settings_, request, *workspace, result);
+  (found ? completed_ : failed_).fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    workspaces_.push_back(std::move(workspace));
+    results_.push_back(std::move(result));
+  }
+  pending_.fetch_sub(1, std::memory_order_release);
+}
+
+bool PlannerService::PopResult(PlanResult &result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (results_.empty()) {
+    return false;
+  }
+  result = std::move(results_.front());
+  results_.pop_front();
+  return true;
+}
+
+void PlannerService::Wait() {
+  while (pending_.load(std::memory_order_acquire) > 0 || rebuilding_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+size_t PlannerService::Pending() const {
+  return pending_.load(std::memory_order_acquire);
+}
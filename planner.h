@@ -0,0 +1,234 @@
+#ifndef SEPT2023__PLANNER_H_
+#define SEPT2023__PLANNER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "distance_field.h"
+#include "thread_pool.h"
+#include "unicycle.h"
+
+enum class PlannerType {
+  // 8 connected A* over the grid cells, any heading. Fast, the path has corners
+  kGrid,
+  // A* over (x, y, heading) with unicycle arcs and turns in place, the path can be driven as is
+  kHybrid
+};
+
+const char *PlannerTypeName(PlannerType type);
+
+struct PlanRequest {
+  // Set by PlannerService::Request
+  uint64_t id_ = 0;
+  // Whose plan it is, handed back in the result untouched
+  size_t robot_ = 0;
+  PlannerType type_ = PlannerType::kHybrid;
+  Pose2D start_;
+  Pose2D goal_;
+  // The robot is a disc of this radius that has to stay clear of the map, m
+  double radius_ = 0.6;
+  // Give up after expanding this many nodes
+  size_t max_expansions_ = 200000;
+};
+
+struct PlanResult {
+  uint64_t id_ = 0;
+  size_t robot_ = 0;
+  PlannerType type_ = PlannerType::kHybrid;
+  bool found_ = false;
+  // From the start to the goal pose. Grid paths only keep the corners
+  std::vector<Pose2D> path_;
+  // Path length, m
+  double length_ = 0;
+  size_t expanded_ = 0;
+  // Wall time the search took
+  double seconds_ = 0;
+};
+
+/**
+ * Tuning shared by every plan
+ */
+struct PlannerSettings {
+  // Hybrid A*: states closer than this in x/y and in the same heading bin count as one
+  double hybrid_cell_ = 0.25;
+  int heading_bins_ = 72;
+  // Arc length of each forward motion, m
+  double step_ = 0.5;
+  // Tightest forward turn, 1 / radius in 1/m
+  double max_curvature_ = 1.0;
+  // Turns in place go this many heading bins at a time, and cost this much per radian (m/rad)
+  int turn_bins_ = 6;
+  double turn_cost_ = 0.5;
+  // Reached when within this of the goal position and heading
+  double goal_tolerance_ = 0.25;
+  double heading_tolerance_ = 0.15;
+  // Every this many expansions hybrid A* tries turning to face the goal and driving straight there
+  int shot_interval_ = 8;
+  // Moving through cells with less than comfort_clearance_ m to spare (beyond the radius) costs up
+  // to 1 + clearance_weight_ times as much, so paths keep off walls when they can
+  double comfort_clearance_ = 0.5;
+  double clearance_weight_ = 1.0;
+  // Above 1 trades path length for fewer expansions
+  double heuristic_weight_ = 1.0;
+};
+
+struct PlannerNode {
+  Pose2D pose_;
+  double g_ = 0;
+  uint32_t parent_ = 0;
+  bool closed_ = false;
+};
+
+struct PlannerHeapEntry {
+  double f_;
+  double g_;
+  uint32_t node_;
+};
+
+/**
+ * Everything one search needs, reused from plan to plan so once it has grown to the size of the
+ * biggest search a plan allocates nothing but its result. One per thread planning.
+ *
+ * States are found by key in an open addressing table. Instead of clearing it each plan every
+ * slot carries the generation it was written in, slots of older generations are empty.
+ */
+struct PlannerWorkspace {
+  std::vector<PlannerNode> nodes_;
+  // Binary min heap on f_, then max on g_. Entries of a node whose g_ has since improved are skipped when popped
+  std::vector<PlannerHeapEntry> open_;
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> values_;
+  std::vector<uint32_t> generations_;
+  uint32_t generation_ = 0;
+  size_t used_ = 0;
+
+  /**
+   * Forget the last search
+   */
+  void Reset();
+
+  /**
+   * \return the node index stored for key, inserting a new node if there isn't one yet
+   * \param inserted set when the node is new
+   */
+  uint32_t FindOrInsert(uint64_t key,
+                        bool &inserted);
+
+  void Push(double f,
+            double g,
+            uint32_t node);
+
+  /**
+   * \return false when the open list is empty
+   */
+  bool Pop(PlannerHeapEntry &entry);
+
+  void Grow();
+};
+
+/**
+ * Search for a path on field, everything in world coordinates
+ * \return result.found_
+ */
+bool PlanGridAStar(const DistanceField &field,
+                   const PlannerSettings &settings,
+                   const PlanRequest &request,
+                   PlannerWorkspace &workspace,
+                   PlanResult &result);
+bool PlanHybridAStar(const DistanceField &field,
+                     const PlannerSettings &settings,
+                     const PlanRequest &request,
+                     PlannerWorkspace &workspace,
+                     PlanResult &result);
+
+/**
+ * Either of the above depending on request.type_, timed into result.seconds_
+ */
+bool Plan(const DistanceField &field,
+          const PlannerSettings &settings,
+          const PlanRequest &request,
+          PlannerWorkspace &workspace,
+          PlanResult &result);
+
+/**
+ * Plans on its own thread pool so any number of robots can ask for paths without the sim or
+ * render thread waiting on a search. Request from any thread, results come back in the order
+ * the searches finish.
+ *
+ * Searches run against the distance field current when they start. RebuildField makes a new
+ * one on the pool when the grid has changed, searches already running keep the old one until
+ * they finish (it is shared_ptr owned). The pool never reads the grid itself, so the thread
+ * changing the grid (SimThread) is the one calling RebuildField.
+ */
+struct PlannerService {
+  /**
+   * \param threads workers, 0 for one per hardware thread
+   */
+  explicit PlannerService(size_t threads = 0);
+  ~PlannerService();
+
+  PlannerService(const PlannerService &) = delete;
+  PlannerService &operator=(const PlannerService &) = delete;
+
+  /**
+   * Change before the first request
+   */
+  PlannerSettings settings_;
+
+  /**
+   * Build a distance field of grid now, on the calling thread helped by the pool. Nothing may be
+   * changing grid meanwhile
+   */
+  void BuildField(const OccupancyGrid &grid);
+
+  /**
+   * If grid has changed since the field was built, copy its cells now and queue building the field
+   * from the copy on the pool (one at a time). Call from the thread that changes grid, or while
+   * nothing does. Cheap when nothing changed, so it can be called every loop
+   */
+  void RebuildField(const OccupancyGrid &grid);
+
+  std::shared_ptr<const DistanceField> Field() const;
+
+  /**
+   * \return the id the result will carry
+   */
+  uint64_t Request(PlanRequest request);
+
+  /**
+   * \return false if no plan has finished since the last call
+   */
+  bool PopResult(PlanResult &result);
+
+  /**
+   * Block until every request so far has its result waiting
+   */
+  void Wait();
+
+  /**
+   * \return requests not finished yet
+   */
+  size_t Pending() const;
+
+  // Declared before pool_ so it is still there while the workers finish up
+  mutable std::mutex mutex_;
+  std::shared_ptr<const DistanceField> field_;
+  std::vector<std::unique_ptr<PlannerWorkspace>> workspaces_;
+  std::deque<PlanResult> results_;
+  std::atomic<uint64_t> next_id_{1};
+  std::atomic<size_t> pending_{0};
+  std::atomic<bool> rebuilding_{false};
+  // Set when shutting down, requests still queued finish straight away without a path
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> completed_{0};
+  std::atomic<uint64_t> failed_{0};
+  ThreadPool pool_;
+
+  void RunRequest(const PlanRequest &request);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "point_renderer.h"
+#include "shader_library.h"
+
+bool PointRenderer::Init() {
+  shader_ = GetShaderLibrary().Load("point_shader.vs", "simple_shader.fs");
+  if (shader_ == nullptr) {
+    return false;
+  }
+  LookUpUniforms();
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribDivisor(0, 1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void PointRenderer::Upload(const float *xy,
+                           size_t count) {
+  count_ = count;
+  if (count == 0) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  if (count > capacity_) {
+    capacity_ = count + count / 2;
+  }
+  // Orphan then fill, same as the fleet instance buffer
+  glBufferData(GL_ARRAY_BUFFER, capacity_ * 2 * sizeof(float), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, count * 2 * sizeof(float), xy);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PointRenderer::Draw(const glm::vec4 &color,
+                         float size) {
+  if (count_ == 0 || shader_ == nullptr) {
+    return;
+  }
+  if (shader_->generation_ != shader_generation_) {
+    LookUpUniforms();
+  }
+  shader_->Use();
+  shader_->SetVec4(color_uniform_, color);
+  shader_->SetFloat(point_size_uniform_, size);
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glBindVertexArray(vao_);
+  glDrawArraysInstanced(GL_POINTS, 0, 1, (GLsizei)count_);
+  glBindVertexArray(0);
+  glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+void PointRenderer::LookUpUniforms() {
+  color_uniform_ = shader_->GetUniform("color");
+  point_size_uniform_ = shader_->GetUniform("pointSize");
+  shader_generation_ = shader_->generation_;
+}
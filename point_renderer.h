@@ -0,0 +1,48 @@
+#ifndef SEPT2023__POINT_RENDERER_H_
+#define SEPT2023__POINT_RENDERER_H_
+
+#include "shader.h"
+
+/**
+ * Draws a big cloud of same coloured points (e.g. the particle filter's particles) in one
+ * instanced GL_POINTS call, each instance only uploads its x, y as 2 floats.
+ */
+struct PointRenderer {
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
+  // Program generation the uniform handles were looked up in, a hot reload invalidates them
+  uint32_t shader_generation_ = 0;
+  UniformHandle color_uniform_;
+  UniformHandle point_size_uniform_;
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  // Number of points the buffer can hold before it needs to grow
+  size_t capacity_ = 0;
+  size_t count_ = 0;
+
+  /**
+   * \return false if the shader failed to load
+   */
+  bool Init();
+
+  /**
+   * Replace the points
+   * \param xy count x, y pairs in world coordinates
+   */
+  void Upload(const float *xy,
+              size_t count);
+
+  /**
+   * Draw the last upload, the camera comes from the FrameUniformBuffer
+   * \param size point diameter in pixels
+   */
+  void Draw(const glm::vec4 &color,
+            float size);
+
+  /**
+   * Find the uniforms in the current version of the shader
+   */
+  void LookUpUniforms();
+};
+
+#endif
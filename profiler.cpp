@@ -0,0 +1,156 @@
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+// Events kept per buffer, about a second of history at a few hundred scopes per frame
+constexpr size_t kProfileBufferCapacity = 1 << 16;
+
+// Every buffer ever created, only locked when a buffer is added or listed
+static std::mutex buffers_mutex;
+static std::vector<std::unique_ptr<ProfileBuffer>> buffers;
+
+ProfileBuffer::ProfileBuffer(std::string name,
+                             size_t capacity) : name_(std::move(name)) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  events_ = std::vector<ProfileEvent>(size);
+  mask_ = size - 1;
+}
+
+void ProfileBuffer::Push(const char *name,
+                         int64_t start,
+                         int64_t end,
+                         int32_t depth) {
+  const uint64_t index = count_.load(std::memory_order_relaxed);
+  ProfileEvent &event = events_[index & mask_];
+  event.name_.store(name, std::memory_order_relaxed);
+  event.start_.store(start, std::memory_order_relaxed);
+  event.end_.store(end, std::memory_order_relaxed);
+  event.depth_.store(depth, std::memory_order_relaxed);
+  count_.store(index + 1, std::memory_order_release);
+}
+
+uint64_t ProfileBuffer::Count() const {
+  return count_.load(std::memory_order_acquire);
+}
+
+uint64_t ProfileBuffer::OldestReadable(uint64_t count) const {
+  const uint64_t usable = events_.size() - events_.size() / 8;
+  return count > usable ? count - usable : 0;
+}
+
+const ProfileEvent &ProfileBuffer::Get(uint64_t index) const {
+  return events_[index & mask_];
+}
+
+int64_t ProfilerNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * buffers_mutex must be held
+ */
+static ProfileBuffer &CreateBufferLocked(const std::string &name) {
+  buffers.push_back(std::make_unique<ProfileBuffer>(name, kProfileBufferCapacity));
+  return *buffers.back();
+}
+
+ProfileBuffer &ProfilerCreateBuffer(const std::string &name) {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  return CreateBufferLocked(name);
+}
+
+ProfileBuffer &ProfilerThreadBuffer() {
+  thread_local ProfileBuffer *buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffer = &CreateBufferLocked("thread " + std::to_string(buffers.size()));
+  }
+  return *buffer;
+}
+
+void ProfilerSetThreadName(const char *name) {
+  ProfileBuffer &buffer = ProfilerThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  buffer.name_ = name;
+}
+
+std::string ProfilerBufferName(const ProfileBuffer &buffer) {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  return buffer.name_;
+}
+
+std::vector<ProfileBuffer *> ProfilerBuffers() {
+  std::lock_guard<std::mutex> lock(buffers_mutex);
+  std::vector<ProfileBuffer *> result;
+  for (const std::unique_ptr<ProfileBuffer> &buffer : buffers) {
+    result.push_back(buffer.get());
+  }
+  return result;
+}
+
+/**
+ * \return name with anything that would break a JSON string replaced
+ */
+static std::string JsonEscape(const char *name) {
+  std::string escaped;
+  for (const char *c = name; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+    }
+    if ((unsigned char)*c >= 0x20) {
+      escaped += *c;
+    }
+  }
+  return escaped;
+}
+
+bool WriteChromeTrace(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    printf("ERROR (Profiler): Failed to open %s for writing\n", path.c_str());
+    return false;
+  }
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first_event = true;
+  std::vector<ProfileBuffer *> all_buffers = ProfilerBuffers();
+  for (size_t tid = 0; tid < all_buffers.size(); ++tid) {
+    const ProfileBuffer &buffer = *all_buffers[tid];
+    const std::string thread_name = ProfilerBufferName(buffer);
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+            first_event ? "" : ",\n", tid, JsonEscape(thread_name.c_str()).c_str());
+    first_event = false;
+    const uint64_t count = buffer.Count();
+    for (uint64_t i = buffer.OldestReadable(count); i < count; ++i) {
+      const ProfileEvent &event = buffer.Get(i);
+      const char *name = event.name_.load(std::memory_order_relaxed);
+      const int64_t start = event.start_.load(std::memory_order_relaxed);
+      const int64_t end = event.end_.load(std::memory_order_relaxed);
+      // Complete events, timestamps in microseconds
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+              JsonEscape(name != nullptr ? name : "?").c_str(), tid, start * 1e-3, (end - start) * 1e-3);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  const bool ok = fclose(file) == 0;
+  if (!ok) {
+    printf("ERROR (Profiler): Failed to write %s\n", path.c_str());
+  }
+  return ok;
+}
+
+ProfileScope::ProfileScope(const char *name) : buffer_(ProfilerThreadBuffer()), name_(name) {
+  buffer_.depth_++;
+  start_ = ProfilerNow();
+}
+
+ProfileScope::~ProfileScope() {
+  const int64_t end = ProfilerNow();
+  buffer_.depth_--;
+  buffer_.Push(name_, start_, end, buffer_.depth_);
+}
@@ -0,0 +1,119 @@
+#ifndef SEPT2023__PROFILER_H_
+#define SEPT2023__PROFILER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Lightweight scoped timers. Put SEPT2023_PROFILE_SCOPE("name") at the top of a block and the
+ * time spent in it is recorded into a buffer owned by the calling thread, no locks and no
+ * allocations after the thread's first scope. The viewer shows the recent history of every
+ * buffer (see profiler_panel.h) and WriteChromeTrace dumps it for chrome://tracing / Perfetto.
+ *
+ * Configure with -DSEPT2023_PROFILING=OFF and the macros compile to nothing.
+ */
+#ifdef SEPT2023_PROFILING
+#define SEPT2023_PROFILE_CONCAT_(a, b) a##b
+#define SEPT2023_PROFILE_CONCAT(a, b) SEPT2023_PROFILE_CONCAT_(a, b)
+// name must be a string literal (or live forever), only the pointer is stored
+#define SEPT2023_PROFILE_SCOPE(name) ProfileScope SEPT2023_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define SEPT2023_PROFILE_THREAD_NAME(name) ProfilerSetThreadName(name)
+#else
+#define SEPT2023_PROFILE_SCOPE(name)
+#define SEPT2023_PROFILE_THREAD_NAME(name)
+#endif
+
+/**
+ * One timed scope. Each field is a relaxed atomic so the panel can read while the owning thread
+ * writes, see ProfileBuffer
+ */
+struct ProfileEvent {
+  std::atomic<const char *> name_{nullptr};
+  // ProfilerNow() nanoseconds
+  std::atomic<int64_t> start_{0};
+  std::atomic<int64_t> end_{0};
+  // Nesting depth, 0 is outermost
+  std::atomic<int32_t> depth_{0};
+};
+
+/**
+ * Ring of the most recent events of one thread (or the GPU), single writer.
+ * Event i is readable while i >= Count() - capacity + margin, same idea as TelemetryRing.
+ */
+struct ProfileBuffer {
+  ProfileBuffer(std::string name,
+                size_t capacity);
+
+  /**
+   * Writer only
+   */
+  void Push(const char *name,
+            int64_t start,
+            int64_t end,
+            int32_t depth);
+
+  uint64_t Count() const;
+  uint64_t OldestReadable(uint64_t count) const;
+  const ProfileEvent &Get(uint64_t index) const;
+
+  // Can be renamed by ProfilerSetThreadName, read it with ProfilerBufferName from other threads
+  std::string name_;
+  std::vector<ProfileEvent> events_;
+  size_t mask_;
+  std::atomic<uint64_t> count_{0};
+  // Writer only, depth of the next scope to open
+  int32_t depth_ = 0;
+};
+
+/**
+ * \return steady clock nanoseconds, what every ProfileEvent is measured in
+ */
+int64_t ProfilerNow();
+
+/**
+ * The calling thread's buffer, created and registered on first use
+ */
+ProfileBuffer &ProfilerThreadBuffer();
+
+/**
+ * Name shown for the calling thread in the panel and trace, call once at thread start
+ */
+void ProfilerSetThreadName(const char *name);
+
+/**
+ * Register a buffer that isn't tied to a thread (e.g. GPU timings). Never freed
+ */
+ProfileBuffer &ProfilerCreateBuffer(const std::string &name);
+
+/**
+ * \return every buffer created so far. The buffers live for the rest of the program
+ */
+std::vector<ProfileBuffer *> ProfilerBuffers();
+
+std::string ProfilerBufferName(const ProfileBuffer &buffer);
+
+/**
+ * Write everything still in the buffers as a Chrome trace event JSON file
+ * \return false if the file couldn't be written
+ */
+bool WriteChromeTrace(const std::string &path);
+
+/**
+ * Times its own lifetime into the calling thread's ProfileBuffer, use SEPT2023_PROFILE_SCOPE
+ */
+struct ProfileScope {
+  explicit ProfileScope(const char *name);
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+  ProfileBuffer &buffer_;
+  const char *name_;
+  int64_t start_;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "profiler_panel.h"
+#include <algorithm>
+#include <cstdio>
+#include "imgui.h"
+#include "profiler.h"
+
+/**
+ * Colour for a scope, the same name always gets the same colour
+ */
+static ImU32 ScopeColor(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c != '\0'; ++c) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return IM_COL32(80 + hash % 150, 80 + (hash >> 8) % 150, 80 + (hash >> 16) % 150, 255);
+}
+
+void ProfilerPanel::Draw() {
+  if (!ImGui::Begin("Profiler")) {
+    ImGui::End();
+    return;
+  }
+#ifndef SEPT2023_PROFILING
+  ImGui::Text("Built without profiling (SEPT2023_PROFILING=OFF)");
+  ImGui::End();
+  return;
+#endif
+  ImGui::SliderFloat("Window", &window_ms_, 5, 1000, "%.0f ms");
+  ImGui::Checkbox("Pause", &paused_);
+  ImGui::SameLine();
+  if (ImGui::Button("Write trace")) {
+    if (WriteChromeTrace(trace_path_)) {
+      printf("Profiler trace written to %s\n", trace_path_);
+    }
+  }
+  ImGui::SameLine();
+  ImGui::InputText("##trace_path", trace_path_, sizeof(trace_path_));
+
+  if (!paused_) {
+    paused_end_ = ProfilerNow();
+  }
+  const int64_t window_end = paused_end_;
+  const int64_t window_start = window_end - (int64_t)(window_ms_ * 1e6);
+  totals_.clear();
+
+  ImDrawList *draw_list = ImGui::GetWindowDrawList();
+  const float row_height = ImGui::GetTextLineHeight() + 2;
+  for (ProfileBuffer *buffer : ProfilerBuffers()) {
+    const uint64_t count = buffer->Count();
+    const uint64_t oldest = buffer->OldestReadable(count);
+    // Work out how deep the scopes go in the window so we know how tall to make the row
+    int32_t max_depth = 0;
+    uint64_t first = count;
+    while (first > oldest) {
+      const ProfileEvent &event = buffer->Get(first - 1);
+      // Events are pushed when they end, anything starting a whole window earlier can't be visible
+      if (event.start_.load(std::memory_order_relaxed) < window_start - (window_end - window_start)) {
+        break;
+      }
+      max_depth = std::max(max_depth, event.depth_.load(std::memory_order_relaxed));
+      first--;
+    }
+
+    ImGui::Text("%s", ProfilerBufferName(*buffer).c_str());
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    const float height = row_height * (max_depth + 1);
+    ImGui::Dummy(ImVec2(width, height));
+    draw_list->PushClipRect(origin, ImVec2(origin.x + width, origin.y + height), true);
+    const double pixels_per_ns = width / (double)(window_end - window_start);
+    for (uint64_t i = first; i < count; ++i) {
+      const ProfileEvent &event = buffer->Get(i);
+      const char *name = event.name_.load(std::memory_order_relaxed);
+      const int64_t start = event.start_.load(std::memory_order_relaxed);
+      const int64_t end = event.end_.load(std::memory_order_relaxed);
+      const int32_t depth = event.depth_.load(std::memory_order_relaxed);
+      if (name == nullptr || end < window_start || start > window_end) {
+        continue;
+      }
+      // Totals only count the part inside the window
+      const int64_t clipped = std::min(end, window_end) - std::max(start, window_start);
+      auto total = std::find_if(totals_.begin(), totals_.end(), [&](const ScopeTotal &t) {
+        return t.name_ == name;
+      });
+      if (total == totals_.end()) {
+        totals_.push_back({name, 0, 0});
+        total = totals_.end() - 1;
+      }
+      total->total_ += clipped;
+      total->count_++;
+
+      const ImVec2 min(origin.x + (float)((start - window_start) * pixels_per_ns),
+                       origin.y + row_height * depth);
+      // At least a pixel wide so short scopes don't disappear
+      const ImVec2 max(std::max(min.x + 1, origin.x + (float)((end - window_start) * pixels_per_ns)),
+                       min.y + row_height - 1);
+      draw_list->AddRectFilled(min, max, ScopeColor(name));
+      if (max.x - min.x > ImGui::CalcTextSize(name).x + 4) {
+        draw_list->AddText(ImVec2(min.x + 2, min.y + 1), IM_COL32(0, 0, 0, 255), name);
+      }
+      if (ImGui::IsMouseHoveringRect(min, max)) {
+        ImGui::SetTooltip("%s: %.3f ms", name, (end - start) * 1e-6);
+      }
+    }
+    draw_list->PopClipRect();
+  }
+
+  ImGui::Separator();
+  std::sort(totals_.begin(), totals_.end(), [](const ScopeTotal &a, const ScopeTotal &b) {
+    return a.total_ > b.total_;
+  });
+  const double window_ns = (double)(window_end - window_start);
+  for (const ScopeTotal &total : totals_) {
+    char label[128];
+    snprintf(label, sizeof(label), "%s: %.3f ms (%d)", total.name_, total.total_ * 1e-6, total.count_);
+    ImGui::ProgressBar((float)(total.total_ / window_ns), ImVec2(-1, 0), label);
+  }
+  ImGui::End();
+}
@@ -0,0 +1,34 @@
+#ifndef SEPT2023__PROFILER_PANEL_H_
+#define SEPT2023__PROFILER_PANEL_H_
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * ImGui window showing the last window_ms_ of every profiler buffer (each thread and the GPU) as
+ * a timeline of nested bars, plus the total time per scope name over that window.
+ * Can dump the whole history as a Chrome trace.
+ */
+struct ProfilerPanel {
+  // Milliseconds of history shown
+  float window_ms_ = 50;
+  // Freeze the view to look at a spike
+  bool paused_ = false;
+  int64_t paused_end_ = 0;
+  char trace_path_[256] = "profile.json";
+
+  /**
+   * Draw the window, call between ImGui::NewFrame() and ImGui::Render()
+   */
+  void Draw();
+
+  // Scratch, total nanoseconds and count per scope name in the window
+  struct ScopeTotal {
+    const char *name_;
+    int64_t total_;
+    int count_;
+  };
+  std::vector<ScopeTotal> totals_;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef SEPT2023__RANDOM_H_
+#define SEPT2023__RANDOM_H_
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * SplitMix64, used to turn one seed into well mixed seeds for other generators.
+ * \param state advanced by every call
+ */
+inline uint64_t SplitMix64(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+/**
+ * xoshiro256** random number generator. Small (32 bytes of state), fast and good enough for
+ * Monte-Carlo. Unlike the std distributions every function here gives the same numbers on every
+ * platform/compiler, so results can be reproduced from a seed.
+ *
+ * Give every independent unit of work (a trial, a particle set, ...) its own Rng from
+ * Rng(seed, stream) instead of sharing one, then the results don't depend on which thread
+ * ran what or in which order.
+ */
+struct Rng {
+  uint64_t state_[4];
+
+  explicit Rng(uint64_t seed = 0) {
+    Seed(seed, 0);
+  }
+
+  /**
+   * \param seed base seed, e.g. from the command line
+   * \param stream which stream of that seed, e.g. the trial number
+   */
+  Rng(uint64_t seed,
+      uint64_t stream) {
+    Seed(seed, stream);
+  }
+
+  void Seed(uint64_t seed,
+            uint64_t stream) {
+    uint64_t mix = seed;
+    // Mix the stream in through its own SplitMix so streams of nearby seeds don't overlap
+    uint64_t stream_mix = stream;
+    mix ^= SplitMix64(stream_mix);
+    for (uint64_t &word : state_) {
+      word = SplitMix64(mix);
+    }
+  }
+
+  uint64_t NextU64() {
+    const uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+    const uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = Rotl(state_[3], 45);
+    return result;
+  }
+
+  /**
+   * \return uniform in [0, 1), 53 bits of randomness
+   */
+  double Uniform() {
+    return (NextU64() >> 11) * 0x1.0p-53;
+  }
+
+  /**
+   * \return uniform in [min, max)
+   */
+  double Uniform(double min,
+                 double max) {
+    return min + (max - min) * Uniform();
+  }
+
+  /**
+   * \return normally distributed (Box-Muller, one sample per call)
+   */
+  double Normal(double mean = 0,
+                double std_dev = 1) {
+    // 1 - Uniform() is in (0, 1] so the log is finite
+    const double radius = std::sqrt(-2 * std::log(1 - Uniform()));
+    return mean + std_dev * radius * std::cos(2 * M_PI * Uniform());
+  }
+
+  static uint64_t Rotl(uint64_t x,
+                       int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+#endif
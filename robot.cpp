@@ -1,64 +1,22 @@
 #include "robot.h"
 #include <glm/gtc/matrix_transform.hpp>
-
-/* TODO: Use an EBO here? */
-/* This creates a cube of 1x1x1 and we will scale it accordingly from the robot parameters */
-static float robot_default_vertices_[] = {
-    -0.5f,-0.5f,-0.5f,
-    -0.5f,-0.5f, 0.5f,
-    -0.5f, 0.5f, 0.5f,
-    0.5f, 0.5f,-0.5f,
-    -0.5f,-0.5f,-0.5f,
-    -0.5f, 0.5f,-0.5f,
-    0.5f,-0.5f, 0.5f,
-    -0.5f,-0.5f,-0.5f,
-    0.5f,-0.5f,-0.5f,
-    0.5f, 0.5f,-0.5f,
-    0.5f,-0.5f,-0.5f,
-    -0.5f,-0.5f,-0.5f,
-    -0.5f,-0.5f,-0.5f,
-    -0.5f, 0.5f, 0.5f,
-    -0.5f, 0.5f,-0.5f,
-    0.5f,-0.5f, 0.5f,
-    -0.5f,-0.5f, 0.5f,
-    -0.5f,-0.5f,-0.5f,
-    -0.5f, 0.5f, 0.5f,
-    -0.5f,-0.5f, 0.5f,
-    0.5f,-0.5f, 0.5f,
-    0.5f, 0.5f, 0.5f,
-    0.5f,-0.5f,-0.5f,
-    0.5f, 0.5f,-0.5f,
-    0.5f,-0.5f,-0.5f,
-    0.5f, 0.5f, 0.5f,
-    0.5f,-0.5f, 0.5f,
-    0.5f, 0.5f, 0.5f,
-    0.5f, 0.5f,-0.5f,
-    -0.5f, 0.5f,-0.5f,
-    0.5f, 0.5f, 0.5f,
-    -0.5f, 0.5f,-0.5f,
-    -0.5f, 0.5f, 0.5f,
-    0.5f, 0.5f, 0.5f,
-    -0.5f, 0.5f, 0.5f,
-    0.5f,-0.5f, 0.5f
-};
+#include "robot_mesh.h"
+#include "shader_library.h"
 
 void Robot::Init() {
-  if (!shader_.LoadShaderFromFile("/Users/adamclare/projects/sept2023/shaders/simple_shader.vs",
-                                  "/Users/adamclare/projects/sept2023/shaders/simple_shader.fs")) {
+  shader_ = GetShaderLibrary().Load("simple_shader.vs", "simple_shader.fs");
+  if (shader_ == nullptr) {
     return;
   }
-  shader_.Use();
+  shader_->Use();
 
   glGenVertexArrays(1, &vao_);
   glGenBuffers(1, &vbo_);
+  glGenBuffers(1, &ebo_);
   glBindVertexArray(vao_);
-
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(robot_default_vertices_), robot_default_vertices_, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  UploadRobotMesh(vbo_, ebo_);
   glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
   glUseProgram(0);
 
   UpdateModelMatrix();
@@ -86,16 +44,20 @@ void Robot::UpdateModelMatrix() {
    * This is because the default vertices, which are centered on 0, go from -0.5 to 0.5,
    * so by default half of the vertices are below 0 (all the -0.5) */
 //  Mat4f_SetValue(&robot_model_, 3, 2, 0.5f * (float)robot_height_);
-
-  shader_.Use();
-  shader_.SetMat4("model", model_);
 }
 
 void Robot::Draw() const {
-  shader_.Use();
-  shader_.SetVec4("color", 1, 0, 0, 1);
+  if (shader_ == nullptr) {
+    return;
+  }
+  shader_->Use();
+  // The shader takes the pose/size/color as per instance attributes. We only have one robot
+  // here so we don't have an instance buffer, the attribute arrays are disabled in our VAO and
+  // GL uses these constant values instead
+  glVertexAttrib3f(kRobotAttributePose, position_[0], position_[1], position_[2]);
+  glVertexAttrib2f(kRobotAttributeSize, width_, length_);
+  glVertexAttrib4f(kRobotAttributeColor, color_[0], color_[1], color_[2], color_[3]);
   glBindVertexArray(vao_);
-  glDrawArrays(GL_TRIANGLES, 0, 12*3);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glEnableVertexAttribArray(0);
+  glDrawElements(GL_TRIANGLES, kRobotMeshIndexCount, GL_UNSIGNED_SHORT, (void*)0);
+  glBindVertexArray(0);
 }
@@ -7,9 +7,11 @@
  * Helper struct for managing the drawing of a robot (a rectangle)
  */
 struct Robot {
-  Shader shader_;
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
   uint32_t vao_;
   uint32_t vbo_;
+  uint32_t ebo_;
 
   // [x, y, theta]
   glm::vec3 position_ = glm::vec3(0, 0, 0);
@@ -17,7 +19,9 @@ struct Robot {
   float width_;
   // For now we only need 2D, so force the height to be 0
   const float height_ = 0;
+  glm::vec4 color_ = glm::vec4(1, 0, 0, 1);
 
+  // CPU side copy of the model matrix, the shader builds the same matrix from the pose/size
   glm::mat4 model_;
   void Init();
 
@@ -0,0 +1,34 @@
+#include "robot_mesh.h"
+#include <glad/glad.h>
+
+const float kRobotMeshVertices[kRobotMeshVertexCount * 3] = {
+    -0.5f,-0.5f,-0.5f,
+    -0.5f,-0.5f, 0.5f,
+    -0.5f, 0.5f, 0.5f,
+    -0.5f, 0.5f,-0.5f,
+    0.5f,-0.5f,-0.5f,
+    0.5f,-0.5f, 0.5f,
+    0.5f, 0.5f, 0.5f,
+    0.5f, 0.5f,-0.5f
+};
+
+// Two triangles per face
+const uint16_t kRobotMeshIndices[kRobotMeshIndexCount] = {
+    0, 1, 2, 0, 2, 3,  // -X
+    4, 7, 6, 4, 6, 5,  // +X
+    0, 4, 5, 0, 5, 1,  // -Y
+    3, 2, 6, 3, 6, 7,  // +Y
+    0, 3, 7, 0, 7, 4,  // -Z
+    1, 5, 6, 1, 6, 2   // +Z
+};
+
+void UploadRobotMesh(uint32_t vbo,
+                     uint32_t ebo) {
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kRobotMeshVertices), kRobotMeshVertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(kRobotAttributePosition, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(kRobotAttributePosition);
+  // The element buffer binding is part of the VAO state, so don't unbind it
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(kRobotMeshIndices), kRobotMeshIndices, GL_STATIC_DRAW);
+}
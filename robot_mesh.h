@@ -0,0 +1,34 @@
+#ifndef SEPT2023__ROBOT_MESH_H_
+#define SEPT2023__ROBOT_MESH_H_
+
+#include <cstdint>
+
+/**
+ * Indexed geometry for a 1x1x1 cube centered on 0. Every robot shares this, the shader scales
+ * it to the robot width/length and places it at the robot pose.
+ */
+constexpr int kRobotMeshVertexCount = 8;
+constexpr int kRobotMeshIndexCount = 36;
+extern const float kRobotMeshVertices[kRobotMeshVertexCount * 3];
+extern const uint16_t kRobotMeshIndices[kRobotMeshIndexCount];
+
+/**
+ * Vertex attribute locations used by shaders/simple_shader.vs
+ */
+enum RobotAttribute {
+  kRobotAttributePosition = 0,
+  // Per instance [x, y, theta]
+  kRobotAttributePose = 1,
+  // Per instance [width, length]
+  kRobotAttributeSize = 2,
+  // Per instance rgba
+  kRobotAttributeColor = 3
+};
+
+/**
+ * Upload the cube into vbo/ebo and set up the per vertex attribute in the currently bound VAO
+ */
+void UploadRobotMesh(uint32_t vbo,
+                     uint32_t ebo);
+
+#endif
@@ -0,0 +1,677 @@
+#include "scenario.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include "json.h"
+#include "occupancy_grid.h"
+#include "simulator.h"
+
+static const double kDegrees = M_PI / 180;
+
+/**
+ * Reads the scenario out of the JSON tree, the first error is printed with the file and line
+ */
+struct ScenarioReader {
+  const std::string &path_;
+
+  bool Fail(const JsonValue &at,
+            const char *format,
+            ...) {
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    printf("ERROR (Scenario): %s:%d %s\n", path_.c_str(), at.line_, message);
+    return false;
+  }
+
+  /**
+   * Check value is an object with nothing but the given keys
+   */
+  bool Keys(const JsonValue &value,
+            const char *what,
+            std::initializer_list<const char*> keys) {
+    if (value.type_ != JsonType::kObject) {
+      return Fail(value, "%s should be an object, not %s", what, JsonTypeName(value.type_));
+    }
+    for (size_t i = 0; i < value.keys_.size(); ++i) {
+      const std::string &key = value.keys_[i];
+      if (std::none_of(keys.begin(), keys.end(), [&](const char *known) { return key == known; })) {
+        return Fail(value.items_[i], "unknown key \"%s\" in %s", key.c_str(), what);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Keys that aren't there keep their default, the same goes for every getter below
+   */
+  bool Number(const JsonValue &object,
+              const char *key,
+              double &out,
+              double scale = 1) {
+    const JsonValue *value = object.Find(key);
+    if (value == nullptr) {
+      return true;
+    }
+    if (!value->IsNumber()) {
+      return Fail(*value, "%s should be a number, not %s", key, JsonTypeName(value->type_));
+    }
+    out = value->number_ * scale;
+    return true;
+  }
+
+  template <typename T>
+  bool Count(const JsonValue &object,
+             const char *key,
+             T &out) {
+    double value = (double)out;
+    if (!Number(object, key, value)) {
+      return false;
+    }
+    if (value < 0 || value != std::floor(value)) {
+      return Fail(*object.Find(key), "%s should be a whole number >= 0", key);
+    }
+    out = (T)value;
+    return true;
+  }
+
+  bool Bool(const JsonValue &object,
+            const char *key,
+            bool &out) {
+    const JsonValue *value = object.Find(key);
+    if (value == nullptr) {
+      return true;
+    }
+    if (value->type_ != JsonType::kBool) {
+      return Fail(*value, "%s should be true or false", key);
+    }
+    out = value->bool_;
+    return true;
+  }
+
+  bool String(const JsonValue &object,
+              const char *key,
+              std::string &out) {
+    const JsonValue *value = object.Find(key);
+    if (value == nullptr) {
+      return true;
+    }
+    if (value->type_ != JsonType::kString) {
+      return Fail(*value, "%s should be a string, not %s", key, JsonTypeName(value->type_));
+    }
+    out = value->string_;
+    return true;
+  }
+
+  /**
+   * An array of min_count to max_count numbers
+   * \return how many there were through count
+   */
+  bool Numbers(const JsonValue &object,
+               const char *key,
+               double *out,
+               size_t min_count,
+               size_t max_count,
+               size_t *count = nullptr) {
+    const JsonValue *value = object.Find(key);
+    if (value == nullptr) {
+      return true;
+    }
+    bool valid = value->type_ == JsonType::kArray &&
+        value->items_.size() >= min_count && value->items_.size() <= max_count &&
+        std::all_of(value->items_.begin(), value->items_.end(), [](const JsonValue &item) { return item.IsNumber(); });
+    if (!valid) {
+      return min_count == max_count ? Fail(*value, "%s should be an array of %zu numbers", key, min_count)
+                                    : Fail(*value, "%s should be an array of %zu to %zu numbers", key, min_count, max_count);
+    }
+    for (size_t i = 0; i < value->items_.size(); ++i) {
+      out[i] = value->items_[i].number_;
+    }
+    if (count != nullptr) {
+      *count = value->items_.size();
+    }
+    return true;
+  }
+
+  bool Point(const JsonValue &object,
+             const char *key,
+             double &x,
+             double &y) {
+    double point[2] = {x, y};
+    if (!Numbers(object, key, point, 2, 2)) {
+      return false;
+    }
+    x = point[0];
+    y = point[1];
+    return true;
+  }
+
+  /**
+   * [x, y] or [x, y, theta in degrees]
+   * \param has_heading whether theta was given
+   */
+  bool Pose(const JsonValue &object,
+            const char *key,
+            Pose2D &pose,
+            bool *has_heading = nullptr) {
+    double values[3] = {pose.x, pose.y, pose.theta / kDegrees};
+    size_t count = 0;
+    if (!Numbers(object, key, values, 2, 3, &count)) {
+      return false;
+    }
+    pose.x = values[0];
+    pose.y = values[1];
+    pose.theta = WrapAngle(values[2] * kDegrees);
+    if (has_heading != nullptr) {
+      *has_heading = count == 3;
+    }
+    return true;
+  }
+
+  /**
+   * \return the index of the robot named by key (the first robot if it isn't given)
+   */
+  bool Robot(const JsonValue &object,
+             const char *key,
+             const Scenario &scenario,
+             size_t &index) {
+    std::string name;
+    if (object.Find(key) == nullptr) {
+      index = 0;
+      return true;
+    }
+    if (!String(object, key, name)) {
+      return false;
+    }
+    for (size_t i = 0; i < scenario.robots_.size(); ++i) {
+      if (scenario.robots_[i].name_ == name) {
+        index = i;
+        return true;
+      }
+    }
+    return Fail(*object.Find(key), "no robot called %s", name.c_str());
+  }
+
+  bool Array(const JsonValue &object,
+             const char *key,
+             const JsonValue *&array) {
+    array = object.Find(key);
+    if (array != nullptr && array->type_ != JsonType::kArray) {
+      return Fail(*array, "%s should be an array, not %s", key, JsonTypeName(array->type_));
+    }
+    return true;
+  }
+
+  bool ReadMap(const JsonValue &map,
+               Scenario &scenario) {
+    if (!Keys(map, "map", {"path", "width", "height", "resolution", "origin", "outside_occupied"}) ||
+        !String(map, "path", scenario.map_path_) ||
+        !Count(map, "width", scenario.map_width_) ||
+        !Count(map, "height", scenario.map_height_) ||
+        !Number(map, "resolution", scenario.map_resolution_) ||
+        !Point(map, "origin", scenario.map_origin_x_, scenario.map_origin_y_) ||
+        !Bool(map, "outside_occupied", scenario.outside_occupied_)) {
+      return false;
+    }
+    // Relative to the scenario file
+    const size_t slash = scenario.path_.find_last_of('/');
+    if (!scenario.map_path_.empty() && scenario.map_path_[0] != '/' && slash != std::string::npos) {
+      scenario.map_path_ = scenario.path_.substr(0, slash + 1) + scenario.map_path_;
+    }
+    if (scenario.map_width_ == 0 || scenario.map_height_ == 0 || scenario.map_resolution_ <= 0) {
+      return Fail(map, "map needs a width, height and resolution above 0");
+    }
+    return true;
+  }
+
+  bool ReadObstacle(const JsonValue &value,
+                    ScenarioObstacle &obstacle) {
+    std::string type;
+    if (value.type_ != JsonType::kObject || !String(value, "type", type)) {
+      return value.type_ == JsonType::kObject ? false : Fail(value, "obstacles should be objects");
+    }
+    if (type == "box") {
+      obstacle.type_ = ScenarioObstacleType::kBox;
+      return Keys(value, "box", {"type", "min", "max"}) &&
+          Point(value, "min", obstacle.min_x_, obstacle.min_y_) &&
+          Point(value, "max", obstacle.max_x_, obstacle.max_y_);
+    }
+    if (type == "disc") {
+      obstacle.type_ = ScenarioObstacleType::kDisc;
+      return Keys(value, "disc", {"type", "center", "radius"}) &&
+          Point(value, "center", obstacle.min_x_, obstacle.min_y_) &&
+          Number(value, "radius", obstacle.radius_);
+    }
+    if (type == "random") {
+      obstacle.type_ = ScenarioObstacleType::kRandom;
+      return Keys(value, "random obstacles", {"type", "count", "seed"}) &&
+          Count(value, "count", obstacle.count_) &&
+          Count(value, "seed", obstacle.seed_);
+    }
+    return Fail(value, "obstacle type should be box, disc or random, not \"%s\"", type.c_str());
+  }
+
+  bool ReadRobot(const JsonValue &value,
+                 ScenarioRobot &robot) {
+    const JsonValue *commands = nullptr;
+    if (!Keys(value, "robot", {"name", "length", "width", "position", "commands"}) ||
+        !String(value, "name", robot.name_) ||
+        !Number(value, "length", robot.length_) ||
+        !Number(value, "width", robot.width_) ||
+        !Pose(value, "position", robot.position_) ||
+        !Array(value, "commands", commands)) {
+      return false;
+    }
+    if (commands == nullptr) {
+      return true;
+    }
+    for (const JsonValue &item : commands->items_) {
+      ScenarioCommand command;
+      if (!Keys(item, "command", {"time", "linear_velocity", "angular_velocity"}) ||
+          !Number(item, "time", command.time_) ||
+          !Number(item, "linear_velocity", command.linear_velocity_) ||
+          !Number(item, "angular_velocity", command.angular_velocity_, kDegrees)) {
+        return false;
+      }
+      if (!robot.commands_.empty() && command.time_ < robot.commands_.back().time_) {
+        return Fail(item, "commands should be in time order");
+      }
+      robot.commands_.push_back(command);
+    }
+    return true;
+  }
+
+  bool ReadAssertion(const JsonValue &value,
+                     const Scenario &scenario,
+                     ScenarioAssertion &assertion) {
+    std::string type;
+    assertion.line_ = value.line_;
+    if (value.type_ != JsonType::kObject || !String(value, "type", type)) {
+      return value.type_ == JsonType::kObject ? false : Fail(value, "assertions should be objects");
+    }
+    if (!Robot(value, "robot", scenario, assertion.robot_)) {
+      return false;
+    }
+    if (type == "pose") {
+      assertion.type_ = ScenarioAssertionType::kPose;
+      if (value.Find("pose") == nullptr) {
+        return Fail(value, "a pose assertion needs a pose");
+      }
+      if (!Keys(value, "pose assertion", {"type", "robot", "time", "pose", "tolerance", "heading_tolerance"}) ||
+          !Number(value, "time", assertion.time_) ||
+          !Pose(value, "pose", assertion.pose_, &assertion.check_heading_) ||
+          !Number(value, "tolerance", assertion.tolerance_) ||
+          !Number(value, "heading_tolerance", assertion.heading_tolerance_, kDegrees)) {
+        return false;
+      }
+      // The run stops at duration, a later time would silently be checked at the end instead
+      if (assertion.time_ > scenario.duration_) {
+        return Fail(*value.Find("time"), "pose assertion time %g s is after the scenario duration %g s", assertion.time_,
+                    scenario.duration_);
+      }
+      return true;
+    }
+    if (type == "region") {
+      assertion.type_ = ScenarioAssertionType::kRegion;
+      return Keys(value, "region assertion", {"type", "robot", "min", "max"}) &&
+          Point(value, "min", assertion.min_x_, assertion.min_y_) &&
+          Point(value, "max", assertion.max_x_, assertion.max_y_);
+    }
+    if (type == "collisions") {
+      assertion.type_ = ScenarioAssertionType::kCollisions;
+      return Keys(value, "collisions assertion", {"type", "robot", "max_collisions"}) &&
+          Count(value, "max_collisions", assertion.max_collisions_);
+    }
+    if (type == "separation") {
+      assertion.type_ = ScenarioAssertionType::kSeparation;
+      if (value.Find("other") == nullptr) {
+        return Fail(value, "a separation assertion needs an other robot");
+      }
+      return Keys(value, "separation assertion", {"type", "robot", "other", "distance"}) &&
+          Robot(value, "other", scenario, assertion.other_) &&
+          Number(value, "distance", assertion.distance_);
+    }
+    return Fail(value, "assertion type should be pose, region, collisions or separation, not \"%s\"", type.c_str());
+  }
+};
+
+bool LoadScenario(const std::string &path,
+                  Scenario &scenario) {
+  JsonValue root;
+  if (!LoadJsonFile(path, root)) {
+    return false;
+  }
+  ScenarioReader reader{path};
+  scenario = Scenario();
+  scenario.path_ = path;
+  // The file name without directory and extension, unless the scenario names itself
+  scenario.name_ = path.substr(path.find_last_of('/') + 1);
+  scenario.name_ = scenario.name_.substr(0, scenario.name_.find_last_of('.'));
+  const JsonValue *obstacles = nullptr;
+  const JsonValue *robots = nullptr;
+  const JsonValue *assertions = nullptr;
+  if (!reader.Keys(root, "the scenario", {"name", "dt", "duration", "map", "obstacles", "robots", "assertions", "golden"}) ||
+      !reader.String(root, "name", scenario.name_) ||
+      !reader.Number(root, "dt", scenario.dt_) ||
+      !reader.Number(root, "duration", scenario.duration_) ||
+      !reader.Array(root, "obstacles", obstacles) ||
+      !reader.Array(root, "robots", robots) ||
+      !reader.Array(root, "assertions", assertions)) {
+    return false;
+  }
+  // The name is a golden trajectory file name, so nothing that could leave the golden directory
+  const bool name_valid = !scenario.name_.empty() &&
+      std::all_of(scenario.name_.begin(), scenario.name_.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+      });
+  if (!name_valid) {
+    const JsonValue *name = root.Find("name");
+    return reader.Fail(name != nullptr ? *name : root,
+                       "the scenario name \"%s\" should only have letters, digits, _ and -", scenario.name_.c_str());
+  }
+  if (scenario.dt_ <= 0 || scenario.duration_ < 0) {
+    return reader.Fail(root, "dt should be above 0 and duration at least 0");
+  }
+  if (const JsonValue *map = root.Find("map")) {
+    if (!reader.ReadMap(*map, scenario)) {
+      return false;
+    }
+  }
+  if (const JsonValue *golden = root.Find("golden")) {
+    if (!reader.Keys(*golden, "golden", {"period", "tolerance", "heading_tolerance"}) ||
+        !reader.Number(*golden, "period", scenario.golden_period_) ||
+        !reader.Number(*golden, "tolerance", scenario.golden_tolerance_) ||
+        !reader.Number(*golden, "heading_tolerance", scenario.golden_heading_tolerance_, kDegrees)) {
+      return false;
+    }
+  }
+  if (robots == nullptr || robots->items_.empty()) {
+    return reader.Fail(root, "a scenario needs at least one robot");
+  }
+  for (const JsonValue &item : robots->items_) {
+    scenario.robots_.emplace_back();
+    ScenarioRobot &robot = scenario.robots_.back();
+    robot.name_ = "robot" + std::to_string(scenario.robots_.size() - 1);
+    if (!reader.ReadRobot(item, robot)) {
+      return false;
+    }
+  }
+  if (obstacles != nullptr) {
+    for (const JsonValue &item : obstacles->items_) {
+      scenario.obstacles_.emplace_back();
+      if (!reader.ReadObstacle(item, scenario.obstacles_.back())) {
+        return false;
+      }
+    }
+  }
+  if (assertions != nullptr) {
+    for (const JsonValue &item : assertions->items_) {
+      scenario.assertions_.emplace_back();
+      if (!reader.ReadAssertion(item, scenario, scenario.assertions_.back())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * \return |a - b| as an angle, between [0, pi]
+ */
+static double HeadingError(double a,
+                           double b) {
+  const double difference = WrapAngle(a - b);
+  return std::min(difference, 2 * M_PI - difference);
+}
+
+static void AddFailure(ScenarioResult &result,
+                       const char *format,
+                       ...) {
+  char message[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  result.failures_.push_back(message);
+}
+
+/**
+ * The map with every obstacle drawn in
+ */
+static bool BuildScenarioMap(const Scenario &scenario,
+                             OccupancyGrid &grid) {
+  if (!scenario.map_path_.empty()) {
+    // A private copy, obstacles go on top without changing the file
+    OccupancyGrid file;
+    if (!file.Open(scenario.map_path_, false) || !grid.CopyFrom(file)) {
+      return false;
+    }
+  }
+  else if (!grid.Create(scenario.map_width_, scenario.map_height_, scenario.map_resolution_,
+                        scenario.map_origin_x_, scenario.map_origin_y_)) {
+    return false;
+  }
+  grid.outside_occupied_ = scenario.outside_occupied_;
+  const ScenarioRobot &first = scenario.robots_[0];
+  for (const ScenarioObstacle &obstacle : scenario.obstacles_) {
+    switch (obstacle.type_) {
+      case ScenarioObstacleType::kBox:
+        grid.FillRectangle(obstacle.min_x_, obstacle.min_y_, obstacle.max_x_, obstacle.max_y_, 255);
+        break;
+      case ScenarioObstacleType::kDisc:
+        grid.FillDisc(obstacle.min_x_, obstacle.min_y_, obstacle.radius_, 255);
+        break;
+      case ScenarioObstacleType::kRandom:
+        AddRandomObstacles(grid, obstacle.count_, obstacle.seed_, first.position_.x, first.position_.y,
+                           std::max(first.length_, first.width_));
+        break;
+    }
+  }
+  return true;
+}
+
+ScenarioResult RunScenario(const Scenario &scenario) {
+  ScenarioResult result;
+  const auto start = std::chrono::steady_clock::now();
+  OccupancyGrid grid;
+  if (scenario.robots_.empty() || !BuildScenarioMap(scenario, grid)) {
+    AddFailure(result, "could not set up the map and robots");
+    return result;
+  }
+  const size_t robot_count = scenario.robots_.size();
+  std::vector<Simulator> robots(robot_count);
+  std::vector<size_t> next_command(robot_count, 0);
+  for (size_t i = 0; i < robot_count; ++i) {
+    robots[i].grid_ = &grid;
+    robots[i].length_ = scenario.robots_[i].length_;
+    robots[i].width_ = scenario.robots_[i].width_;
+    robots[i].pose_ = scenario.robots_[i].position_;
+  }
+
+  // Everything is counted in whole steps so command/assertion/sample times don't depend on
+  // how the sim clock rounds
+  const uint64_t steps = (uint64_t)std::llround(scenario.duration_ / scenario.dt_);
+  const uint64_t sample_steps = std::max<int64_t>(1, std::llround(scenario.golden_period_ / scenario.dt_));
+  auto step_of = [&](double time) {
+    return time < 0 ? steps : std::min<uint64_t>(steps, (uint64_t)std::llround(time / scenario.dt_));
+  };
+  // Region/separation: the first time each one was broken, and the closest the robots got
+  std::vector<int64_t> broken_at(scenario.assertions_.size(), -1);
+  std::vector<Pose2D> broken_pose(scenario.assertions_.size());
+  std::vector<double> closest(scenario.assertions_.size(), INFINITY);
+  std::vector<double> closest_time(scenario.assertions_.size(), 0);
+
+  for (uint64_t step = 0;; ++step) {
+    const double time = step * scenario.dt_;
+    for (size_t i = 0; i < robot_count; ++i) {
+      const std::vector<ScenarioCommand> &commands = scenario.robots_[i].commands_;
+      while (next_command[i] < commands.size() && step_of(commands[next_command[i]].time_) <= step) {
+        const ScenarioCommand &command = commands[next_command[i]++];
+        robots[i].SetCommand(command.linear_velocity_, command.angular_velocity_);
+      }
+    }
+    if (step % sample_steps == 0) {
+      for (size_t i = 0; i < robot_count; ++i) {
+        TrajectoryRecord record;
+        record.time = time;
+        record.robot = (uint32_t)i;
+        record.x = robots[i].pose_.x;
+        record.y = robots[i].pose_.y;
+        record.theta = robots[i].pose_.theta;
+        record.v = robots[i].linear_velocity_;
+        record.w = robots[i].angular_velocity_;
+        result.trajectory_.push_back(record);
+      }
+    }
+
+    for (size_t a = 0; a < scenario.assertions_.size(); ++a) {
+      const ScenarioAssertion &assertion = scenario.assertions_[a];
+      const Simulator &robot = robots[assertion.robot_];
+      const char *name = scenario.robots_[assertion.robot_].name_.c_str();
+      if (assertion.type_ == ScenarioAssertionType::kPose && step == step_of(assertion.time_)) {
+        const double error = std::hypot(robot.pose_.x - assertion.pose_.x, robot.pose_.y - assertion.pose_.y);
+        const double heading_error = HeadingError(robot.pose_.theta, assertion.pose_.theta);
+        if (error > assertion.tolerance_) {
+          AddFailure(result, "line %d: %s at %.3f s is at (%.6f, %.6f), %.6f m from (%.6f, %.6f) (tolerance %g)",
+                     assertion.line_, name, time, robot.pose_.x, robot.pose_.y, error, assertion.pose_.x,
+                     assertion.pose_.y, assertion.tolerance_);
+        }
+        if (assertion.check_heading_ && heading_error > assertion.heading_tolerance_) {
+          AddFailure(result, "line %d: %s at %.3f s is heading %.4f deg, %.4f deg off %.4f (tolerance %g)",
+                     assertion.line_, name, time, robot.pose_.theta / kDegrees, heading_error / kDegrees,
+                     assertion.pose_.theta / kDegrees, assertion.heading_tolerance_ / kDegrees);
+        }
+      }
+      else if (assertion.type_ == ScenarioAssertionType::kRegion && broken_at[a] < 0 &&
+               (robot.pose_.x < assertion.min_x_ || robot.pose_.x > assertion.max_x_ ||
+                robot.pose_.y < assertion.min_y_ || robot.pose_.y > assertion.max_y_)) {
+        broken_at[a] = (int64_t)step;
+        broken_pose[a] = robot.pose_;
+      }
+      else if (assertion.type_ == ScenarioAssertionType::kSeparation) {
+        const Simulator &other = robots[assertion.other_];
+        const double distance = std::hypot(robot.pose_.x - other.pose_.x, robot.pose_.y - other.pose_.y);
+        if (distance < closest[a]) {
+          closest[a] = distance;
+          closest_time[a] = time;
+        }
+      }
+    }
+
+    if (step == steps) {
+      break;
+    }
+    for (Simulator &robot : robots) {
+      robot.Step(scenario.dt_);
+    }
+  }
+  result.steps_ = steps;
+
+  for (size_t a = 0; a < scenario.assertions_.size(); ++a) {
+    const ScenarioAssertion &assertion = scenario.assertions_[a];
+    const char *name = scenario.robots_[assertion.robot_].name_.c_str();
+    if (assertion.type_ == ScenarioAssertionType::kRegion && broken_at[a] >= 0) {
+      AddFailure(result, "line %d: %s left (%g, %g) - (%g, %g) at %.3f s, at (%.6f, %.6f)", assertion.line_, name,
+                 assertion.min_x_, assertion.min_y_, assertion.max_x_, assertion.max_y_,
+                 broken_at[a] * scenario.dt_, broken_pose[a].x, broken_pose[a].y);
+    }
+    else if (assertion.type_ == ScenarioAssertionType::kCollisions &&
+             robots[assertion.robot_].collisions_ > assertion.max_collisions_) {
+      AddFailure(result, "line %d: %s had %" PRIu64 " steps blocked by the map, at most %" PRIu64 " allowed",
+                 assertion.line_, name, robots[assertion.robot_].collisions_, assertion.max_collisions_);
+    }
+    else if (assertion.type_ == ScenarioAssertionType::kSeparation && closest[a] < assertion.distance_) {
+      AddFailure(result, "line %d: %s and %s came within %.6f m at %.3f s, at least %g needed", assertion.line_,
+                 name, scenario.robots_[assertion.other_].name_.c_str(), closest[a], closest_time[a],
+                 assertion.distance_);
+    }
+  }
+  result.wall_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.passed_ = result.failures_.empty();
+  return result;
+}
+
+bool WriteGoldenTrajectory(const std::string &path,
+                           const std::vector<TrajectoryRecord> &trajectory) {
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    printf("ERROR (Scenario): Unable to create %s\n", path.c_str());
+    return false;
+  }
+  fprintf(file, "time,robot,x,y,theta,v,w\n");
+  // 17 significant digits round trip every double exactly
+  for (const TrajectoryRecord &record : trajectory) {
+    fprintf(file, "%.17g,%u,%.17g,%.17g,%.17g,%.17g,%.17g\n", record.time, record.robot, record.x, record.y,
+            record.theta, record.v, record.w);
+  }
+  return fclose(file) == 0;
+}
+
+bool LoadGoldenTrajectory(const std::string &path,
+                          std::vector<TrajectoryRecord> &trajectory) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    printf("ERROR (Scenario): Unable to open %s\n", path.c_str());
+    return false;
+  }
+  trajectory.clear();
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line_number == 1 || line.empty()) {
+      continue;
+    }
+    TrajectoryRecord record;
+    if (sscanf(line.c_str(), "%lf,%u,%lf,%lf,%lf,%lf,%lf", &record.time, &record.robot, &record.x, &record.y,
+               &record.theta, &record.v, &record.w) != 7) {
+      printf("ERROR (Scenario): %s:%d expected time,robot,x,y,theta,v,w\n", path.c_str(), line_number);
+      return false;
+    }
+    trajectory.push_back(record);
+  }
+  return true;
+}
+
+void CompareGoldenTrajectory(const Scenario &scenario,
+                             const std::vector<TrajectoryRecord> &golden,
+                             ScenarioResult &result) {
+  const std::vector<TrajectoryRecord> &actual = result.trajectory_;
+  result.compared_golden_ = true;
+  if (golden.size() != actual.size()) {
+    AddFailure(result, "golden trajectory has %zu samples, the run %zu (duration, dt or robots changed?)",
+               golden.size(), actual.size());
+    result.passed_ = false;
+    return;
+  }
+  bool reported = false;
+  for (size_t i = 0; i < golden.size(); ++i) {
+    const TrajectoryRecord &expected = golden[i];
+    const TrajectoryRecord &record = actual[i];
+    if (expected.robot != record.robot || std::abs(expected.time - record.time) > scenario.dt_ / 2) {
+      AddFailure(result, "golden sample %zu is robot %u at %.3f s, the run's robot %u at %.3f s", i,
+                 expected.robot, expected.time, record.robot, record.time);
+      result.passed_ = false;
+      return;
+    }
+    const double error = std::hypot(record.x - expected.x, record.y - expected.y);
+    const double heading_error = HeadingError(record.theta, expected.theta);
+    result.golden_error_ = std::max(result.golden_error_, error);
+    result.golden_heading_error_ = std::max(result.golden_heading_error_, heading_error);
+    // Only the first divergence, everything after it is usually off too
+    if (!reported && (error > scenario.golden_tolerance_ || heading_error > scenario.golden_heading_tolerance_)) {
+      AddFailure(result, "%s at %.3f s is at (%.9f, %.9f, %.6f deg), golden (%.9f, %.9f, %.6f deg): off by %.3e m %.3e deg",
+                 scenario.robots_[record.robot].name_.c_str(), record.time, record.x, record.y,
+                 record.theta / kDegrees, expected.x, expected.y, expected.theta / kDegrees, error,
+                 heading_error / kDegrees);
+      reported = true;
+    }
+  }
+  result.passed_ = result.failures_.empty();
+}
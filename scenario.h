@@ -0,0 +1,163 @@
+#ifndef SEPT2023__SCENARIO_H_
+#define SEPT2023__SCENARIO_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "trajectory_log.h"
+#include "unicycle.h"
+
+/**
+ * The command of one robot from time_ on, until its next command
+ */
+struct ScenarioCommand {
+  // Seconds from the start
+  double time_ = 0;
+  // m/s and rad/s
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+};
+
+struct ScenarioRobot {
+  std::string name_;
+  // Footprint, m
+  double length_ = 1;
+  double width_ = 0.5;
+  Pose2D position_;
+  // In time order, the robot stands still before the first one
+  std::vector<ScenarioCommand> commands_;
+};
+
+enum class ScenarioObstacleType {
+  // Rectangle min_ - max_
+  kBox,
+  // Disc of radius_ around min_
+  kDisc,
+  // count_ random boxes/discs (AddRandomObstacles) from seed_, clear of the first robot's start
+  kRandom
+};
+
+struct ScenarioObstacle {
+  ScenarioObstacleType type_ = ScenarioObstacleType::kBox;
+  double min_x_ = 0;
+  double min_y_ = 0;
+  double max_x_ = 0;
+  double max_y_ = 0;
+  double radius_ = 0;
+  size_t count_ = 0;
+  uint64_t seed_ = 1;
+};
+
+enum class ScenarioAssertionType {
+  // robot_ is within tolerance_ of pose_ at time_, and within heading_tolerance_ of its heading if
+  // check_heading_
+  kPose,
+  // robot_ never leaves min_ - max_
+  kRegion,
+  // robot_ has at most max_collisions_ steps rejected by the map
+  kCollisions,
+  // The centres of robot_ and other_ never get closer than distance_
+  kSeparation
+};
+
+struct ScenarioAssertion {
+  ScenarioAssertionType type_ = ScenarioAssertionType::kPose;
+  // Index into Scenario::robots_
+  size_t robot_ = 0;
+  size_t other_ = 0;
+  // Seconds from the start, negative for the end of the run, at most the scenario duration
+  double time_ = -1;
+  Pose2D pose_;
+  bool check_heading_ = false;
+  double tolerance_ = 0.01;
+  double heading_tolerance_ = 1 * M_PI / 180;
+  double min_x_ = 0;
+  double min_y_ = 0;
+  double max_x_ = 0;
+  double max_y_ = 0;
+  uint64_t max_collisions_ = 0;
+  double distance_ = 0;
+  // Where it is in the file, for the failure message
+  int line_ = 0;
+};
+
+/**
+ * A scripted headless run: robots driving timed command sequences through a map with obstacles,
+ * checked by assertions and optionally against a golden trajectory. Read from a JSON file, see the
+ * ones in scenarios/. Every robot is a separate Simulator on the same map, robots don't collide with
+ * each other. Angles are in degrees in the file and radians here.
+ */
+struct Scenario {
+  // Only letters, digits, _ and -, it names the golden trajectory file
+  std::string name_;
+  std::string path_;
+  double dt_ = 0.01;
+  double duration_ = 10;
+  // Empty map of map_width_ x map_height_ cells, or the map file map_path_ if given
+  std::string map_path_;
+  uint32_t map_width_ = 400;
+  uint32_t map_height_ = 400;
+  double map_resolution_ = 0.05;
+  double map_origin_x_ = -10;
+  double map_origin_y_ = -10;
+  bool outside_occupied_ = true;
+  std::vector<ScenarioObstacle> obstacles_;
+  std::vector<ScenarioRobot> robots_;
+  std::vector<ScenarioAssertion> assertions_;
+  // Every robot's pose is sampled every golden_period_ seconds for the golden trajectory, and may
+  // be off it by golden_tolerance_ m and golden_heading_tolerance_ rad
+  double golden_period_ = 0.1;
+  double golden_tolerance_ = 1e-9;
+  double golden_heading_tolerance_ = 1e-9;
+};
+
+/**
+ * Read a scenario file. Keys are the member names without the trailing underscore, poses are
+ * [x, y, theta], points [x, y]. Unknown keys are errors so typos don't silently do nothing.
+ * \return false if the file can't be read or is invalid (the error is printed with its line)
+ */
+bool LoadScenario(const std::string &path,
+                  Scenario &scenario);
+
+struct ScenarioResult {
+  bool passed_ = false;
+  // One line per failed assertion or golden mismatch
+  std::vector<std::string> failures_;
+  uint64_t steps_ = 0;
+  // Wall time of the run alone, seconds
+  double wall_time_ = 0;
+  // Every robot every golden_period_, robot is the index into robots_
+  std::vector<TrajectoryRecord> trajectory_;
+  // Whether CompareGoldenTrajectory ran, and the largest difference from the golden trajectory
+  bool compared_golden_ = false;
+  double golden_error_ = 0;
+  double golden_heading_error_ = 0;
+};
+
+/**
+ * Run a scenario at full speed on the calling thread. Only depends on the scenario, so any
+ * number of them can run in parallel
+ */
+ScenarioResult RunScenario(const Scenario &scenario);
+
+/**
+ * Golden trajectories are CSV (time,robot,x,y,theta,v,w) with every digit, so a change to the
+ * kinematics shows up as a readable numeric diff
+ */
+bool WriteGoldenTrajectory(const std::string &path,
+                           const std::vector<TrajectoryRecord> &trajectory);
+bool LoadGoldenTrajectory(const std::string &path,
+                          std::vector<TrajectoryRecord> &trajectory);
+
+/**
+ * Compare a run to its golden trajectory sample by sample, a sample off by more than the
+ * scenario's tolerances (or a different number of samples) is added to the failures and fails the
+ * run
+ */
+void CompareGoldenTrajectory(const Scenario &scenario,
+                             const std::vector<TrajectoryRecord> &golden,
+                             ScenarioResult &result);
+
+#endif
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "scenario.h"
+#include "thread_pool.h"
+
+/**
+ * Runs scenario files (see scenario.h) in parallel, checks their assertions and golden
+ * trajectories and prints a pass/fail report. Exits with 1 if any scenario fails, so it can gate CI.
+ * Usage: scenario_runner scenario.json... [--threads N] [--golden dir] [--update-golden]
+ *   --threads        worker threads, default one per core
+ *   --golden         directory of golden trajectories, <dir>/<scenario name>.csv
+ *   --update-golden  write the golden trajectories from this run instead of comparing against them
+ */
+int main(int argc, char **argv) {
+  std::vector<std::string> paths;
+  size_t threads = 0;
+  std::string golden_dir;
+  bool update_golden = false;
+  bool valid = true;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--threads") == 0) {
+      threads = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--golden") == 0) {
+      golden_dir = argv[++i];
+    }
+    else if (strcmp(argv[i], "--update-golden") == 0) {
+      update_golden = true;
+    }
+    else if (argv[i][0] != '-') {
+      paths.push_back(argv[i]);
+    }
+    else {
+      valid = false;
+      break;
+    }
+  }
+  if (!valid || paths.empty() || (update_golden && golden_dir.empty())) {
+    printf("Usage: %s scenario.json... [--threads N] [--golden dir] [--update-golden]\n", argv[0]);
+    return 1;
+  }
+
+  // Load everything up front, a broken file fails the whole run before anything is simulated
+  std::vector<Scenario> scenarios(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!LoadScenario(paths[i], scenarios[i])) {
+      return 1;
+    }
+    // Two scenarios with one name would share a golden trajectory
+    for (size_t j = 0; j < i; ++j) {
+      if (scenarios[j].name_ == scenarios[i].name_) {
+        printf("ERROR (ScenarioRunner): %s and %s are both called %s\n", paths[j].c_str(), paths[i].c_str(),
+               scenarios[i].name_.c_str());
+        return 1;
+      }
+    }
+  }
+
+  ThreadPool pool(threads);
+  std::vector<ScenarioResult> results(scenarios.size());
+  auto start = std::chrono::steady_clock::now();
+  pool.ParallelFor(scenarios.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      results[i] = RunScenario(scenarios[i]);
+      if (golden_dir.empty()) {
+        continue;
+      }
+      const std::string golden_path = golden_dir + "/" + scenarios[i].name_ + ".csv";
+      if (update_golden) {
+        if (!WriteGoldenTrajectory(golden_path, results[i].trajectory_)) {
+          results[i].failures_.push_back("could not write " + golden_path);
+          results[i].passed_ = false;
+        }
+        continue;
+      }
+      std::vector<TrajectoryRecord> golden;
+      if (!LoadGoldenTrajectory(golden_path, golden)) {
+        results[i].failures_.push_back("no golden trajectory " + golden_path + ", run with --update-golden");
+        results[i].passed_ = false;
+        continue;
+      }
+      CompareGoldenTrajectory(scenarios[i], golden, results[i]);
+    }
+  });
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+
+  const double degrees = 180 / M_PI;
+  size_t failed = 0;
+  for (size_t i = 0; i < scenarios.size(); ++i) {
+    const ScenarioResult &result = results[i];
+    printf("%s %-24s %8llu steps %9.3f ms %.3e steps/s",
+           result.passed_ ? "PASS" : "FAIL", scenarios[i].name_.c_str(), (unsigned long long)result.steps_,
+           result.wall_time_ * 1e3,
+           result.wall_time_ > 0 ? result.steps_ * scenarios[i].robots_.size() / result.wall_time_ : 0.0);
+    if (result.compared_golden_) {
+      printf("  golden max %.3e m %.3e deg", result.golden_error_, result.golden_heading_error_ * degrees);
+    }
+    printf("\n");
+    for (const std::string &failure : result.failures_) {
+      printf("    %s: %s\n", paths[i].c_str(), failure.c_str());
+    }
+    failed += result.passed_ ? 0 : 1;
+  }
+  printf("%zu of %zu scenarios passed in %.3f s on %zu threads%s\n", scenarios.size() - failed, scenarios.size(),
+         seconds, pool.Size(), update_golden ? ", golden trajectories updated" : "");
+  return failed == 0 ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "shader.h"
+#include <algorithm>
 
 /**
  * This will print an error message if unable to open file
@@ -27,10 +28,91 @@ static bool LoadShaderFile(const std::string &file,
   return true;
 }
 
+/**
+ * Ask GL for every active uniform in a linked program, so we never have to call glGetUniformLocation
+ * while drawing
+ * \param program linked shader program
+ * \param uniforms return variable, filled with the uniforms sorted by name
+ */
+static void LoadActiveUniforms(std::uint32_t program,
+                               std::vector<ShaderUniform> &uniforms) {
+  uniforms.clear();
+  std::int32_t uniform_count = 0;
+  std::int32_t max_name_length = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+  std::string name(max_name_length, ' ');
+  for (std::int32_t i = 0; i < uniform_count; ++i) {
+    std::int32_t name_length = 0;
+    std::int32_t size = 0;
+    std::uint32_t type = 0;
+    glGetActiveUniform(program, i, max_name_length, &name_length, &size, &type, &name[0]);
+
+    ShaderUniform uniform;
+    uniform.name_ = name.substr(0, name_length);
+    // Arrays are reported as name[0], we want to look them up by just name
+    if (uniform.name_.size() > 3 && uniform.name_.compare(uniform.name_.size() - 3, 3, "[0]") == 0) {
+      uniform.name_.resize(uniform.name_.size() - 3);
+    }
+    uniform.location_ = glGetUniformLocation(program, uniform.name_.c_str());
+    uniform.type_ = type;
+    // Uniforms inside a uniform block don't have a location, they are set through the buffer
+    if (uniform.location_ >= 0) {
+      uniforms.push_back(uniform);
+    }
+  }
+  std::sort(uniforms.begin(), uniforms.end(), [](const ShaderUniform &a, const ShaderUniform &b) {
+    return a.name_ < b.name_;
+  });
+}
+
+/**
+ * Compile one stage, printing the log on failure
+ * \return the shader object, 0 if it failed to compile
+ */
+static std::uint32_t CompileStage(std::uint32_t type,
+                                  const std::string &source,
+                                  const std::string &name) {
+  // OpenGL requires a pointer to a const char*, so we need to break
+  // out the c_str() from the shader source string object
+  const char *shader_source = source.c_str();
+  std::uint32_t shader = glCreateShader(type);
+  glShaderSource(shader, 1, &shader_source, NULL);
+  glCompileShader(shader);
+  std::int32_t shader_success_flag = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &shader_success_flag);
+  if (!shader_success_flag) {
+    char shader_error_log[512];
+    glGetShaderInfoLog(shader, 512, NULL, shader_error_log);
+    std::cout << "ERROR (Shader): Failed compiling " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+              << " shader of " << name << " " << shader_error_log << std::endl;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+/**
+ * After a successful link: swap program in for the shader's current one, find the uniforms and
+ * bind the frame uniform block
+ */
+static void AdoptProgram(Shader &shader,
+                         std::uint32_t program) {
+  shader.Destroy();
+  shader.id_ = program;
+  shader.generation_++;
+  LoadActiveUniforms(program, shader.uniforms_);
+  std::uint32_t frame_block = glGetUniformBlockIndex(program, "FrameUniforms");
+  if (frame_block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program, frame_block, kFrameUniformsBinding);
+  }
+}
+
 bool Shader::LoadShaderFromFile(const std::string &vertexFile,
                                 const std::string &fragmentFile) {
   // Put the shader program in an invalid state
-  id_ = 0;
+  Destroy();
 
   std::string vertex_source, fragment_source;
   if (!LoadShaderFile(vertexFile, vertex_source)) {
@@ -39,100 +121,152 @@ bool Shader::LoadShaderFromFile(const std::string &vertexFile,
   if (!LoadShaderFile(fragmentFile, fragment_source)) {
     return false;
   }
+  return LoadShaderFromSource(vertex_source, fragment_source, vertexFile + " + " + fragmentFile, false);
+}
 
-  std::int32_t shader_success_flag = 0;
-  char shader_error_log[512];
-
-  // OpenGL requires a pointer to a const char*, so we need to break
-  // out the c_str() from the shader source string object, so we
-  // can later than use this (shader_source) to pass the pointer to OpenGL
-  const char *shader_source = vertex_source.c_str();
-
-  // Try and create the vertex shader
-  std::uint32_t vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader, 1, &shader_source, NULL);
-  glCompileShader(vertex_shader);
-  glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_success_flag);
-  if (!shader_success_flag) {
-    glGetShaderInfoLog(vertex_shader, 512, NULL, shader_error_log);
-    std::cout << "ERROR (Shader): Failed compiling vertex shader " << shader_error_log << std::endl;
+bool Shader::LoadShaderFromSource(const std::string &vertex_source,
+                                  const std::string &fragment_source,
+                                  const std::string &name,
+                                  bool retrievable) {
+  std::uint32_t vertex_shader = CompileStage(GL_VERTEX_SHADER, vertex_source, name);
+  if (vertex_shader == 0) {
     return false;
   }
-
-  shader_source = fragment_source.c_str();
-  // Try and create the vertex shader
-  std::uint32_t fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment_shader, 1, &shader_source, NULL);
-  glCompileShader(fragment_shader);
-  glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_success_flag);
-  if (!shader_success_flag) {
-    glGetShaderInfoLog(fragment_shader, 512, NULL, shader_error_log);
-    std::cout << "ERROR (Shader): Failed compiling fragment shader " << shader_error_log << std::endl;
+  std::uint32_t fragment_shader = CompileStage(GL_FRAGMENT_SHADER, fragment_source, name);
+  if (fragment_shader == 0) {
+    glDeleteShader(vertex_shader);
     return false;
   }
 
-  id_ = glCreateProgram();
-  glAttachShader(id_, vertex_shader);
-  glAttachShader(id_, fragment_shader);
-  glLinkProgram(id_);
-  glGetProgramiv(id_, GL_LINK_STATUS, &shader_success_flag);
-  if (!shader_success_flag) {
-    glGetProgramInfoLog(id_, 512, NULL, shader_error_log);
-    std::cout << "ERROR (Shader): Failed compiling shader progam " << shader_error_log << std::endl;
-    return false;
+  std::uint32_t program = glCreateProgram();
+  if (retrievable) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   }
-  // Once linked we can delete the vertex/fragment shaders
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glLinkProgram(program);
+  // Once linked (or not) we can delete the vertex/fragment shaders
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
+  std::int32_t link_success_flag = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_success_flag);
+  if (!link_success_flag) {
+    char program_error_log[512];
+    glGetProgramInfoLog(program, 512, NULL, program_error_log);
+    std::cout << "ERROR (Shader): Failed linking shader program " << name << " " << program_error_log << std::endl;
+    glDeleteProgram(program);
+    return false;
+  }
+  AdoptProgram(*this, program);
+  return true;
+}
+
+bool Shader::LoadProgramBinary(uint32_t format,
+                               const std::vector<uint8_t> &binary) {
+  if (glProgramBinary == nullptr || binary.empty()) {
+    return false;
+  }
+  std::uint32_t program = glCreateProgram();
+  glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+  std::int32_t link_success_flag = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_success_flag);
+  if (!link_success_flag) {
+    // Not an error, the driver is free to reject old binaries
+    glDeleteProgram(program);
+    return false;
+  }
+  AdoptProgram(*this, program);
   return true;
+}
+
+bool Shader::GetProgramBinary(uint32_t &format,
+                              std::vector<uint8_t> &binary) const {
+  if (id_ == 0 || glGetProgramBinary == nullptr) {
+    return false;
+  }
+  std::int32_t length = 0;
+  glGetProgramiv(id_, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+  binary.resize(length);
+  GLenum binary_format = 0;
+  GLsizei written = 0;
+  glGetProgramBinary(id_, length, &written, &binary_format, binary.data());
+  binary.resize(written);
+  format = binary_format;
+  return written > 0;
+}
+
+void Shader::Destroy() {
+  if (id_ != 0) {
+    glDeleteProgram(id_);
+  }
+  id_ = 0;
+  uniforms_.clear();
+}
 
+bool UniformHandle::IsValid() const {
+  return location_ >= 0;
 }
 
 void Shader::Use() const {
   glUseProgram(id_);
 }
 
+UniformHandle Shader::GetUniform(const std::string &name) const {
+  UniformHandle handle;
+  auto it = std::lower_bound(uniforms_.begin(), uniforms_.end(), name,
+                             [](const ShaderUniform &uniform, const std::string &value) {
+                               return uniform.name_ < value;
+                             });
+  if (it != uniforms_.end() && it->name_ == name) {
+    handle.location_ = it->location_;
+  }
+  return handle;
+}
+
 void Shader::SetBool(const std::string &name,
              bool value) const {
-  glUniform1i(glGetUniformLocation(id_, name.c_str()), (int)value);
+  glUniform1i(GetUniform(name).location_, (int)value);
 }
 
 void Shader::SetInt(const std::string &name,
                     int value) const {
-  glUniform1i(glGetUniformLocation(id_, name.c_str()), value);
+  glUniform1i(GetUniform(name).location_, value);
 }
 
 void Shader::SetFloat(const std::string &name,
                       float value) const {
-  glUniform1f(glGetUniformLocation(id_, name.c_str()), value);
+  glUniform1f(GetUniform(name).location_, value);
 }
 
 void Shader::SetVec2(const std::string &name,
                      const glm::vec2 &value) const {
-  glUniform2fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+  glUniform2fv(GetUniform(name).location_, 1, &value[0]);
 }
 
 void Shader::SetVec2(const std::string &name,
                      float x,
                      float y) const {
-  glUniform2f(glGetUniformLocation(id_, name.c_str()), x, y);
+  glUniform2f(GetUniform(name).location_, x, y);
 }
 
 void Shader::SetVec3(const std::string &name,
                      const glm::vec3 &value) const {
-  glUniform3fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+  glUniform3fv(GetUniform(name).location_, 1, &value[0]);
 }
 
 void Shader::SetVec3(const std::string &name,
                      float x,
                      float y,
                      float z) const {
-  glUniform3f(glGetUniformLocation(id_, name.c_str()), x, y, z);
+  glUniform3f(GetUniform(name).location_, x, y, z);
 }
 
 void Shader::SetVec4(const std::string &name,
                      const glm::vec4 &value) const {
-  glUniform4fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+  glUniform4fv(GetUniform(name).location_, 1, &value[0]);
 }
 
 void Shader::SetVec4(const std::string &name,
@@ -140,20 +274,90 @@ void Shader::SetVec4(const std::string &name,
                      float y,
                      float z,
                      float w) const {
-  glUniform4f(glGetUniformLocation(id_, name.c_str()), x, y, z, w);
+  glUniform4f(GetUniform(name).location_, x, y, z, w);
 }
 
 void Shader::SetMat2(const std::string &name,
                      const glm::mat2 &mat) const {
-  glUniformMatrix2fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  glUniformMatrix2fv(GetUniform(name).location_, 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::SetMat3(const std::string &name,
                      const glm::mat3 &mat) const {
-  glUniformMatrix3fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+  glUniformMatrix3fv(GetUniform(name).location_, 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::SetMat4(const std::string &name,
                      const glm::mat4 &mat) const {
-  glUniformMatrix4fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-}
\ No newline at end of file
+  glUniformMatrix4fv(GetUniform(name).location_, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::SetBool(UniformHandle handle,
+                     bool value) const {
+  glUniform1i(handle.location_, (int)value);
+}
+
+void Shader::SetInt(UniformHandle handle,
+                    int value) const {
+  glUniform1i(handle.location_, value);
+}
+
+void Shader::SetFloat(UniformHandle handle,
+                      float value) const {
+  glUniform1f(handle.location_, value);
+}
+
+void Shader::SetVec2(UniformHandle handle,
+                     const glm::vec2 &value) const {
+  glUniform2fv(handle.location_, 1, &value[0]);
+}
+
+void Shader::SetVec3(UniformHandle handle,
+                     const glm::vec3 &value) const {
+  glUniform3fv(handle.location_, 1, &value[0]);
+}
+
+void Shader::SetVec4(UniformHandle handle,
+                     const glm::vec4 &value) const {
+  glUniform4fv(handle.location_, 1, &value[0]);
+}
+
+void Shader::SetVec4(UniformHandle handle,
+                     float x,
+                     float y,
+                     float z,
+                     float w) const {
+  glUniform4f(handle.location_, x, y, z, w);
+}
+
+void Shader::SetMat2(UniformHandle handle,
+                     const glm::mat2 &mat) const {
+  glUniformMatrix2fv(handle.location_, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::SetMat3(UniformHandle handle,
+                     const glm::mat3 &mat) const {
+  glUniformMatrix3fv(handle.location_, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::SetMat4(UniformHandle handle,
+                     const glm::mat4 &mat) const {
+  glUniformMatrix4fv(handle.location_, 1, GL_FALSE, &mat[0][0]);
+}
+
+void FrameUniformBuffer::Init() {
+  glGenBuffers(1, &ubo_);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+  // std140 layout of two mat4 is just the 2 matrices back to back
+  glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kFrameUniformsBinding, ubo_);
+}
+
+void FrameUniformBuffer::Update(const glm::mat4 &projection,
+                                const glm::mat4 &view) const {
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection[0][0]);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &view[0][0]);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
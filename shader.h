@@ -4,13 +4,49 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+/**
+ * Uniform buffer binding point for the FrameUniforms block. Any shader that declares
+ *   layout (std140) uniform FrameUniforms { mat4 projection; mat4 view; };
+ * gets bound to it when loaded, so the camera matrices are uploaded once per frame
+ * and shared by every program.
+ */
+constexpr uint32_t kFrameUniformsBinding = 0;
+
+/**
+ * Location of a uniform in one specific shader program. Look it up once with Shader::GetUniform
+ * and then set it every frame without any string compares or calls into the driver to find it.
+ * Setting an invalid handle (uniform doesn't exist/was optimized out) does nothing, same as GL.
+ */
+struct UniformHandle {
+  int32_t location_ = -1;
+
+  bool IsValid() const;
+};
+
+/**
+ * An active uniform found when the program was linked
+ */
+struct ShaderUniform {
+  std::string name_;
+  int32_t location_;
+  // GL type enum, e.g. GL_FLOAT_MAT4
+  uint32_t type_;
+};
 
 struct Shader {
   uint32_t id_ = 0;
+  // Every active uniform of the linked program (excluding uniform blocks), sorted by name
+  std::vector<ShaderUniform> uniforms_;
+  // Bumped every time the program is (re)linked, uniform handles looked up before a change of
+  // generation may no longer be valid
+  uint32_t generation_ = 0;
 
   /**
    * \param vertexFile /path/to/some/vertex/file.vs
@@ -22,11 +58,46 @@ struct Shader {
   bool LoadShaderFromFile(const std::string &vertexFile,
                           const std::string &fragmentFile);
 
+  /**
+   * Compile and link a program from source, replacing (and deleting) the current one only if that
+   * succeeds
+   * \param name for error messages
+   * \param retrievable ask the driver to keep the linked binary around for GetProgramBinary
+   */
+  bool LoadShaderFromSource(const std::string &vertex_source,
+                            const std::string &fragment_source,
+                            const std::string &name,
+                            bool retrievable);
+
+  /**
+   * Replace the program with one from GetProgramBinary. Fails (leaving the program as it was) if
+   * the driver doesn't accept it, e.g. after a driver update
+   */
+  bool LoadProgramBinary(uint32_t format,
+                         const std::vector<uint8_t> &binary);
+
+  /**
+   * \param format return variable, driver specific binary format
+   * \return false if the driver can't give us the binary
+   */
+  bool GetProgramBinary(uint32_t &format,
+                        std::vector<uint8_t> &binary) const;
+
+  /**
+   * Delete the GL program, needs the context to still be current
+   */
+  void Destroy();
+
   /**
    * Set the shader to be the active open GL shader
    */
   void Use() const;
 
+  /**
+   * \param name uniform name as written in the shader, for arrays the name of the first element
+   * \return the handle for the uniform, invalid if the program has no active uniform called name
+   */
+  UniformHandle GetUniform(const std::string &name) const;
 
   void SetBool(const std::string &name,
                        bool value) const;
@@ -43,6 +114,37 @@ struct Shader {
   void SetMat2(const std::string &name, const glm::mat2 &mat) const;
   void SetMat3(const std::string &name, const glm::mat3 &mat) const;
   void SetMat4(const std::string &name, const glm::mat4 &mat) const;
+
+  // Same setters with a pre looked up handle, use these in anything that runs every frame.
+  // Like the string versions the shader needs to be the active one (Use())
+  void SetBool(UniformHandle handle, bool value) const;
+  void SetInt(UniformHandle handle, int value) const;
+  void SetFloat(UniformHandle handle, float value) const;
+  void SetVec2(UniformHandle handle, const glm::vec2 &value) const;
+  void SetVec3(UniformHandle handle, const glm::vec3 &value) const;
+  void SetVec4(UniformHandle handle, const glm::vec4 &value) const;
+  void SetVec4(UniformHandle handle, float x, float y, float z, float w) const;
+  void SetMat2(UniformHandle handle, const glm::mat2 &mat) const;
+  void SetMat3(UniformHandle handle, const glm::mat3 &mat) const;
+  void SetMat4(UniformHandle handle, const glm::mat4 &mat) const;
+};
+
+/**
+ * The uniform buffer behind the FrameUniforms block (see kFrameUniformsBinding)
+ */
+struct FrameUniformBuffer {
+  uint32_t ubo_ = 0;
+
+  /**
+   * Create the buffer and attach it to kFrameUniformsBinding
+   */
+  void Init();
+
+  /**
+   * Upload the camera matrices, call once per frame before drawing
+   */
+  void Update(const glm::mat4 &projection,
+              const glm::mat4 &view) const;
 };
 
 #endif
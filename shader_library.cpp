@@ -0,0 +1,424 @@
+#include "shader_library.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
+// Cached binary file layout: header then the driver's binary
+static constexpr char kCacheMagic[8] = {'S', '2', '3', 'P', 'B', 'I', 'N', '\0'};
+static constexpr uint32_t kCacheVersion = 1;
+
+struct CacheHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t format_;
+  uint64_t key_;
+  uint64_t length_;
+};
+
+// Without inotify, how often the modification times are checked, s
+static constexpr double kPollInterval = 0.5;
+
+/**
+ * FNV-1a, continuing from hash
+ */
+static uint64_t HashBytes(const void *data,
+                          size_t size,
+                          uint64_t hash = 14695981039346656037ull) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t HashSources(const std::string &vertex_source,
+                            const std::string &fragment_source) {
+  // The terminating zero keeps "ab" + "c" and "a" + "bc" apart
+  uint64_t hash = HashBytes(vertex_source.c_str(), vertex_source.size() + 1);
+  return HashBytes(fragment_source.c_str(), fragment_source.size() + 1, hash);
+}
+
+static double SecondsNow() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * \return modification time of path, 0 if it doesn't exist
+ */
+static int64_t ModificationTime(const std::string &path) {
+  struct stat info;
+  if (path.empty() || stat(path.c_str(), &info) != 0) {
+    return 0;
+  }
+  return (int64_t)info.st_mtime;
+}
+
+static bool ReadFile(const std::string &path,
+                     std::string &contents) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  contents.clear();
+  char buffer[4096];
+  size_t read = 0;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, read);
+  }
+  const bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+static std::string DirectoryOf(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+std::string ExecutableDirectory() {
+  char path[PATH_MAX];
+#if defined(__linux__)
+  const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (length <= 0) {
+    return "";
+  }
+  path[length] = '\0';
+#elif defined(__APPLE__)
+  uint32_t size = sizeof(path);
+  if (_NSGetExecutablePath(path, &size) != 0) {
+    return "";
+  }
+#else
+  return "";
+#endif
+  return DirectoryOf(path);
+}
+
+ShaderLibrary::ShaderLibrary() {
+  const std::string executable_directory = ExecutableDirectory();
+  if (const char *directory = getenv("SEPT2023_SHADER_DIR")) {
+    search_directories_.push_back(directory);
+  }
+  if (!executable_directory.empty()) {
+    search_directories_.push_back(executable_directory + "/shaders");
+  }
+#if defined(SEPT2023_SHADER_SOURCE_DIR)
+  search_directories_.push_back(SEPT2023_SHADER_SOURCE_DIR);
+#endif
+
+  if (const char *directory = getenv("SEPT2023_SHADER_CACHE")) {
+    cache_directory_ = directory;
+  }
+  else if (!executable_directory.empty()) {
+    cache_directory_ = executable_directory + "/shader_cache";
+  }
+
+#if defined(__linux__)
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    printf("ERROR (ShaderLibrary): inotify unavailable (%s), polling shader files instead\n", strerror(errno));
+  }
+#endif
+}
+
+ShaderLibrary::~ShaderLibrary() {
+  // The programs are left alone, the context is usually gone by now (see Clear)
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+}
+
+ShaderLibrary &GetShaderLibrary() {
+  static ShaderLibrary library;
+  return library;
+}
+
+bool ShaderLibrary::ReadSource(const std::string &name,
+                               std::string &path,
+                               std::string &source) const {
+  for (const std::string &directory : search_directories_) {
+    path = directory + "/" + name;
+    if (ReadFile(path, source)) {
+      return true;
+    }
+  }
+  path.clear();
+  for (size_t i = 0; i < kEmbeddedShaderCount; ++i) {
+    if (name == kEmbeddedShaders[i].name_) {
+      source = kEmbeddedShaders[i].source_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShaderLibrary::CheckDriver() {
+  if (driver_checked_) {
+    return;
+  }
+  driver_checked_ = true;
+  driver_hash_ = 0;
+  if (cache_directory_.empty() || glGetProgramBinary == nullptr || glProgramBinary == nullptr) {
+    return;
+  }
+  // Drivers may support the call but no formats at all
+  int32_t formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats <= 0) {
+    return;
+  }
+  uint64_t hash = HashBytes(&kCacheVersion, sizeof(kCacheVersion));
+  for (uint32_t property : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const char *value = (const char *)glGetString(property);
+    if (value != nullptr) {
+      hash = HashBytes(value, strlen(value) + 1, hash);
+    }
+  }
+  if (mkdir(cache_directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    printf("ERROR (ShaderLibrary): Can't create shader cache %s: %s\n", cache_directory_.c_str(), strerror(errno));
+    return;
+  }
+  driver_hash_ = hash == 0 ? 1 : hash;
+}
+
+bool ShaderLibrary::Link(ShaderProgram &program,
+                         const std::string &vertex_source,
+                         const std::string &fragment_source) {
+  CheckDriver();
+  const uint64_t source_hash = HashSources(vertex_source, fragment_source);
+  const std::string name = program.vertex_name_ + " + " + program.fragment_name_;
+  if (driver_hash_ == 0) {
+    if (!program.shader_.LoadShaderFromSource(vertex_source, fragment_source, name, false)) {
+      return false;
+    }
+    program.source_hash_ = source_hash;
+    compiles_++;
+    return true;
+  }
+
+  const uint64_t key = HashBytes(&source_hash, sizeof(source_hash), driver_hash_);
+  char file_name[32];
+  snprintf(file_name, sizeof(file_name), "/%016llx.bin", (unsigned long long)key);
+  const std::string cache_path = cache_directory_ + file_name;
+
+  // A cached binary, if it is ours and the driver still takes it
+  std::string cached;
+  if (ReadFile(cache_path, cached) && cached.size() >= sizeof(CacheHeader)) {
+    CacheHeader header;
+    memcpy(&header, cached.data(), sizeof(header));
+    if (memcmp(header.magic_, kCacheMagic, sizeof(kCacheMagic)) == 0 && header.version_ == kCacheVersion &&
+        header.key_ == key && header.length_ == cached.size() - sizeof(header)) {
+      const std::vector<uint8_t> binary(cached.begin() + sizeof(header), cached.end());
+      if (program.shader_.LoadProgramBinary(header.format_, binary)) {
+        program.source_hash_ = source_hash;
+        binary_loads_++;
+        return true;
+      }
+    }
+  }
+
+  if (!program.shader_.LoadShaderFromSource(vertex_source, fragment_source, name, true)) {
+    return false;
+  }
+  program.source_hash_ = source_hash;
+  compiles_++;
+
+  // Write to a temporary file and rename it over, so a crash never leaves half a binary behind
+  uint32_t format = 0;
+  std::vector<uint8_t> binary;
+  if (!program.shader_.GetProgramBinary(format, binary)) {
+    return true;
+  }
+  CacheHeader header;
+  memcpy(header.magic_, kCacheMagic, sizeof(kCacheMagic));
+  header.version_ = kCacheVersion;
+  header.format_ = format;
+  header.key_ = key;
+  header.length_ = binary.size();
+  const std::string temporary_path = cache_path + ".tmp";
+  FILE *file = fopen(temporary_path.c_str(), "wb");
+  if (file == nullptr) {
+    printf("ERROR (ShaderLibrary): Can't write %s: %s\n", temporary_path.c_str(), strerror(errno));
+    return true;
+  }
+  const bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+  if (fclose(file) != 0 || !written || rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+    printf("ERROR (ShaderLibrary): Failed writing %s\n", cache_path.c_str());
+    remove(temporary_path.c_str());
+  }
+  return true;
+}
+
+void ShaderLibrary::Watch(const std::string &path) {
+  if (!hot_reload_ || path.empty()) {
+    return;
+  }
+#if defined(__linux__)
+  if (inotify_fd_ < 0) {
+    return;
+  }
+  const std::string directory = DirectoryOf(path);
+  for (const auto &watch : watches_) {
+    if (watch.second == directory) {
+      return;
+    }
+  }
+  // Watching the directory rather than the file also catches editors that save by writing a new
+  // file and renaming it over the old one
+  const int watch = inotify_add_watch(inotify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (watch < 0) {
+    printf("ERROR (ShaderLibrary): Can't watch %s: %s\n", directory.c_str(), strerror(errno));
+    return;
+  }
+  watches_.emplace_back(watch, directory);
+#endif
+}
+
+Shader *ShaderLibrary::Load(const std::string &vertex_name,
+                            const std::string &fragment_name) {
+  for (const auto &program : programs_) {
+    if (program->vertex_name_ == vertex_name && program->fragment_name_ == fragment_name) {
+      shared_++;
+      return &program->shader_;
+    }
+  }
+
+  auto program = std::make_unique<ShaderProgram>();
+  program->vertex_name_ = vertex_name;
+  program->fragment_name_ = fragment_name;
+  std::string vertex_source, fragment_source;
+  if (!ReadSource(vertex_name, program->vertex_path_, vertex_source)) {
+    printf("ERROR (ShaderLibrary): Could not find shader %s\n", vertex_name.c_str());
+    return nullptr;
+  }
+  if (!ReadSource(fragment_name, program->fragment_path_, fragment_source)) {
+    printf("ERROR (ShaderLibrary): Could not find shader %s\n", fragment_name.c_str());
+    return nullptr;
+  }
+
+  if (!Link(*program, vertex_source, fragment_source)) {
+    return nullptr;
+  }
+  program->vertex_time_ = ModificationTime(program->vertex_path_);
+  program->fragment_time_ = ModificationTime(program->fragment_path_);
+  Watch(program->vertex_path_);
+  Watch(program->fragment_path_);
+  programs_.push_back(std::move(program));
+  return &programs_.back()->shader_;
+}
+
+/**
+ * Source of one stage of a loaded program, from the file it came from, or embedded if it wasn't
+ * from a file
+ */
+static bool ReadProgramSource(const std::string &path,
+                              const std::string &name,
+                              std::string &source) {
+  if (!path.empty()) {
+    return ReadFile(path, source);
+  }
+  for (size_t i = 0; i < kEmbeddedShaderCount; ++i) {
+    if (name == kEmbeddedShaders[i].name_) {
+      source = kEmbeddedShaders[i].source_;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ShaderLibrary::Update() {
+  if (!hot_reload_ || programs_.empty()) {
+    return 0;
+  }
+#if defined(__linux__)
+  if (inotify_fd_ >= 0) {
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length = 0;
+    while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t offset = 0; offset < length;) {
+        const inotify_event *event = (const inotify_event *)(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        if (event->len == 0) {
+          continue;
+        }
+        for (const auto &watch : watches_) {
+          if (watch.first != event->wd) {
+            continue;
+          }
+          const std::string path = watch.second + "/" + event->name;
+          for (const auto &program : programs_) {
+            if (program->vertex_path_ == path || program->fragment_path_ == path) {
+              program->stale_ = true;
+            }
+          }
+        }
+      }
+    }
+  }
+  else
+#endif
+  {
+    const double now = SecondsNow();
+    if (now - last_poll_time_ < kPollInterval) {
+      return 0;
+    }
+    last_poll_time_ = now;
+    for (const auto &program : programs_) {
+      const int64_t vertex_time = ModificationTime(program->vertex_path_);
+      const int64_t fragment_time = ModificationTime(program->fragment_path_);
+      if (vertex_time != program->vertex_time_ || fragment_time != program->fragment_time_) {
+        program->vertex_time_ = vertex_time;
+        program->fragment_time_ = fragment_time;
+        program->stale_ = true;
+      }
+    }
+  }
+
+  size_t relinked = 0;
+  for (const auto &program : programs_) {
+    if (!program->stale_) {
+      continue;
+    }
+    program->stale_ = false;
+    std::string vertex_source, fragment_source;
+    // A file half way through being saved fails here or fails to compile, the next save triggers
+    // another try
+    if (!ReadProgramSource(program->vertex_path_, program->vertex_name_, vertex_source) ||
+        !ReadProgramSource(program->fragment_path_, program->fragment_name_, fragment_source)) {
+      continue;
+    }
+    if (HashSources(vertex_source, fragment_source) == program->source_hash_) {
+      continue;
+    }
+    if (!Link(*program, vertex_source, fragment_source)) {
+      printf("ERROR (ShaderLibrary): Keeping the previous %s + %s\n", program->vertex_name_.c_str(),
+             program->fragment_name_.c_str());
+      continue;
+    }
+    reloads_++;
+    relinked++;
+    printf("Reloaded shader %s + %s\n", program->vertex_name_.c_str(), program->fragment_name_.c_str());
+  }
+  return relinked;
+}
+
+void ShaderLibrary::Clear() {
+  for (const auto &program : programs_) {
+    program->shader_.Destroy();
+  }
+  programs_.clear();
+}
@@ -0,0 +1,149 @@
+#ifndef SEPT2023__SHADER_LIBRARY_H_
+#define SEPT2023__SHADER_LIBRARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "shader.h"
+
+/**
+ * A shader file built into the executable (see cmake/embed_shaders.cmake), the last place a
+ * shader is looked for so the viewer still runs when copied somewhere without its shaders
+ */
+struct EmbeddedShader {
+  const char *name_;
+  const char *source_;
+};
+
+extern const EmbeddedShader kEmbeddedShaders[];
+extern const size_t kEmbeddedShaderCount;
+
+/**
+ * One linked program in the library, shared by everything that loaded the same pair of names
+ */
+struct ShaderProgram {
+  Shader shader_;
+  std::string vertex_name_;
+  std::string fragment_name_;
+  // Files the sources came from, empty when embedded (those are never reloaded)
+  std::string vertex_path_;
+  std::string fragment_path_;
+  uint64_t source_hash_ = 0;
+  // Modification times when last read, for watching without inotify
+  int64_t vertex_time_ = 0;
+  int64_t fragment_time_ = 0;
+  // A source file changed, relinked by the next Update
+  bool stale_ = false;
+};
+
+/**
+ * Loads every shader program of the viewer, GL thread only.
+ *
+ * Shaders are asked for by file name (e.g. "simple_shader.vs") and found in the first of:
+ *   1. $SEPT2023_SHADER_DIR
+ *   2. shaders/ next to the executable
+ *   3. the source tree's shaders/ (SEPT2023_SHADER_SOURCE_DIR, set by CMake)
+ *   4. the copies embedded in the executable
+ * Programs are deduplicated by name, the same pair of names gives back the same Shader, so a
+ * hundred robots link one program. Different names for the same sources (e.g. a copied file) get
+ * programs of their own, each reloaded from its own files, though with a binary cache the second
+ * one skips compiling.
+ *
+ * Linked programs are cached as driver binaries (glGetProgramBinary) in cache_directory_, keyed by
+ * the sources and the driver, so the next start skips compiling entirely.
+ *
+ * Source files are watched (inotify on Linux, modification times elsewhere) and a program whose
+ * file changed is relinked by Update, in place: Shader pointers stay valid and only its
+ * generation_ changes. A program that fails to compile keeps running the old version.
+ */
+struct ShaderLibrary {
+  ShaderLibrary();
+  ~ShaderLibrary();
+
+  ShaderLibrary(const ShaderLibrary &) = delete;
+  ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+  // Searched in order, filled by the constructor
+  std::vector<std::string> search_directories_;
+  // Where linked binaries are kept, empty to never cache. $SEPT2023_SHADER_CACHE or
+  // shader_cache/ next to the executable
+  std::string cache_directory_;
+  bool hot_reload_ = true;
+  // Hash of the GL vendor/renderer/version mixed into every cache key, so a driver update never
+  // even tries the old binaries. 0 if the driver can't save binaries (or cache_directory_ is empty)
+  uint64_t driver_hash_ = 0;
+  bool driver_checked_ = false;
+
+  std::vector<std::unique_ptr<ShaderProgram>> programs_;
+
+  // Programs compiled from source, loaded from the binary cache, handed out again instead of
+  // linking a duplicate, and relinked because a file changed
+  uint64_t compiles_ = 0;
+  uint64_t binary_loads_ = 0;
+  uint64_t shared_ = 0;
+  uint64_t reloads_ = 0;
+
+  // inotify instance and one watch per directory holding a shader file, Linux only
+  int inotify_fd_ = -1;
+  std::vector<std::pair<int, std::string>> watches_;
+  // When the modification times were last checked, everywhere else
+  double last_poll_time_ = 0;
+
+  /**
+   * \param vertex_name, fragment_name file names, e.g. "simple_shader.vs"
+   * \return the program, owned by the library. Null if a file can't be found or the program
+   *         doesn't compile
+   */
+  Shader *Load(const std::string &vertex_name,
+               const std::string &fragment_name);
+
+  /**
+   * Relink the programs whose source files changed since the last call, call once a frame
+   * \return the number of programs relinked
+   */
+  size_t Update();
+
+  /**
+   * Delete every program, call before the GL context goes away
+   */
+  void Clear();
+
+  /**
+   * \param path return variable, the file the source came from, empty if embedded
+   * \return false if the shader isn't anywhere
+   */
+  bool ReadSource(const std::string &name,
+                  std::string &path,
+                  std::string &source) const;
+
+  /**
+   * Link program from its sources, through the binary cache if possible
+   */
+  bool Link(ShaderProgram &program,
+            const std::string &vertex_source,
+            const std::string &fragment_source);
+
+  /**
+   * Start watching the directory holding path (once per directory)
+   */
+  void Watch(const std::string &path);
+
+  /**
+   * Find out (once, needs the context current) if the driver can give us program binaries
+   */
+  void CheckDriver();
+};
+
+/**
+ * The library every renderer loads from
+ */
+ShaderLibrary &GetShaderLibrary();
+
+/**
+ * \return directory holding the running executable, empty if it can't be found
+ */
+std::string ExecutableDirectory();
+
+#endif
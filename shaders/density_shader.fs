@@ -0,0 +1,7 @@
+#version 330 core
+// Every robot adds 1 to the pixel it lands on, blended additively into a float texture
+out vec4 FragColor;
+void main()
+{
+  FragColor = vec4(1.0);
+}
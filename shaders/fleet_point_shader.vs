@@ -0,0 +1,19 @@
+#version 330 core
+// One GL_POINTS vertex per robot, from the same per robot attributes as simple_shader.vs (see
+// robot_mesh.h) but read per vertex
+layout (location = 1) in vec3 aPose;
+layout (location = 3) in vec4 aColor;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
+uniform float pointSize;
+
+out vec4 vertexColor;
+void main()
+{
+  vertexColor = aColor;
+  gl_PointSize = pointSize;
+  gl_Position = projection * view * vec4(aPose.xy, 0.0, 1.0);
+}
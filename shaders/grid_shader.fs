@@ -0,0 +1,15 @@
+#version 330 core
+in vec2 texCoord;
+// One byte per cell, see occupancy_grid.h
+uniform sampler2D cells;
+uniform vec4 occupiedColor;
+out vec4 FragColor;
+void main()
+{
+  float occupancy = texture(cells, texCoord).r;
+  // Free space shows the ground plane underneath
+  if (occupancy < 0.5) {
+    discard;
+  }
+  FragColor = occupiedColor;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// Corner of the map quad in world coordinates and the texture coordinate there
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
+
+out vec2 texCoord;
+void main()
+{
+  texCoord = aTexCoord;
+  gl_Position = projection * view * vec4(aPos, 0.0, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+in vec2 texCoord;
+// Robots per density pixel, see density_shader.fs
+uniform sampler2D density;
+// Count that gets the hottest colour
+uniform float maxDensity;
+out vec4 FragColor;
+void main()
+{
+  float count = texture(density, texCoord).r;
+  if (count <= 0.0) {
+    discard;
+  }
+  // Log scale, so a lone robot still shows up next to a traffic jam
+  float t = clamp(log(1.0 + count) / log(1.0 + maxDensity), 0.0, 1.0);
+  vec3 cold = vec3(0.1, 0.25, 0.9);
+  vec3 warm = vec3(0.95, 0.65, 0.1);
+  vec3 hot = vec3(0.85, 0.05, 0.05);
+  vec3 color = t < 0.5 ? mix(cold, warm, t * 2.0) : mix(warm, hot, t * 2.0 - 1.0);
+  FragColor = vec4(color, 0.4 + 0.6 * t);
+}
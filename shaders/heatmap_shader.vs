@@ -0,0 +1,9 @@
+#version 330 core
+// A triangle covering the whole viewport, made from gl_VertexID so it needs no vertex buffer
+out vec2 texCoord;
+void main()
+{
+  vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  texCoord = corner;
+  gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
+
+out vec4 vertexColor;
+void main()
+{
+  // Line vertices are already in world coordinates
+  vertexColor = aColor;
+  gl_Position = projection * view * vec4(aPos, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// One instance per point, drawn as a single GL_POINTS vertex
+layout (location = 0) in vec2 aOffset;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
+uniform vec4 color;
+uniform float pointSize;
+
+out vec4 vertexColor;
+void main()
+{
+  vertexColor = color;
+  gl_PointSize = pointSize;
+  gl_Position = projection * view * vec4(aOffset, 0.0, 1.0);
+}
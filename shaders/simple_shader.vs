@@ -1,13 +1,26 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec4 color;
+// Per instance attributes, see robot_mesh.h
+layout (location = 1) in vec3 aPose;
+layout (location = 2) in vec2 aSize;
+layout (location = 3) in vec4 aColor;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
 
 out vec4 vertexColor;
 void main()
 {
-  vertexColor = color;
+  // Same model matrix as Robot::UpdateModelMatrix: translate to [x, y, 0], rotate clockwise
+  // by theta around Z, then scale the unit cube by [width, length, 0] (robots are flat)
+  float s = sin(aPose.z);
+  float c = cos(aPose.z);
+  mat4 model = mat4(vec4( c * aSize.x, -s * aSize.x, 0.0, 0.0),
+                    vec4( s * aSize.y,  c * aSize.y, 0.0, 0.0),
+                    vec4(0.0, 0.0, 0.0, 0.0),
+                    vec4(aPose.x, aPose.y, 0.0, 1.0));
+  vertexColor = aColor;
   gl_Position = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// Trail vertices in world coordinates, see trail_buffer.h
+layout (location = 0) in vec2 aPos;
+// Shared by every program, see kFrameUniformsBinding in shader.h
+layout (std140) uniform FrameUniforms {
+  mat4 projection;
+  mat4 view;
+};
+uniform vec4 color;
+
+out vec4 vertexColor;
+void main()
+{
+  vertexColor = color;
+  gl_Position = projection * view * vec4(aPos, 0.0, 1.0);
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "monte_carlo.h"
+#include "thread_pool.h"
+
+/**
+ * Runs a Monte-Carlo scenario (see monte_carlo.h) over every core and prints the statistics.
+ * The results only depend on the scenario and seed, not on --threads.
+ * Usage: sim_batch scenario.txt [--threads N] [--trials N] [--seed N] [--csv file]
+ *   --threads  worker threads, default one per core
+ *   --trials   override the number of trials in the scenario
+ *   --seed     override the seed in the scenario
+ *   --csv      also write the final/nominal pose of every trial
+ */
+int main(int argc, char **argv) {
+  const char *scenario_path = nullptr;
+  size_t threads = 0;
+  long long trials = -1;
+  long long seed = -1;
+  const char *csv_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--threads") == 0) {
+      threads = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--trials") == 0) {
+      trials = strtoll(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--seed") == 0) {
+      seed = strtoll(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--csv") == 0) {
+      csv_path = argv[++i];
+    }
+    else if (argv[i][0] != '-' && scenario_path == nullptr) {
+      scenario_path = argv[i];
+    }
+    else {
+      scenario_path = nullptr;
+      break;
+    }
+  }
+  if (scenario_path == nullptr) {
+    printf("Usage: %s scenario.txt [--threads N] [--trials N] [--seed N] [--csv file]\n", argv[0]);
+    return 1;
+  }
+
+  MonteCarloScenario scenario;
+  if (!LoadMonteCarloScenario(scenario_path, scenario)) {
+    return 1;
+  }
+  if (trials >= 0) {
+    scenario.trials_ = (uint64_t)trials;
+  }
+  if (seed >= 0) {
+    scenario.seed_ = (uint64_t)seed;
+  }
+
+  ThreadPool pool(threads);
+  std::vector<MonteCarloTrial> results;
+  auto start = std::chrono::steady_clock::now();
+  RunMonteCarlo(scenario, pool, results);
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  MonteCarloSummary summary = SummarizeMonteCarlo(results);
+
+  const double degrees = 180 / M_PI;
+  printf("Trials:        %llu x %llu steps on %zu threads\n",
+         (unsigned long long)summary.trials_, (unsigned long long)scenario.steps_, pool.Size());
+  printf("Wall time:     %.3f s (%.3e steps/s)\n",
+         seconds, seconds > 0 ? summary.trials_ * scenario.steps_ / seconds : 0.0);
+  printf("Final x:       mean %.6f std %.6f m\n", summary.mean_x_, summary.std_x_);
+  printf("Final y:       mean %.6f std %.6f m (cov xy %.6f)\n", summary.mean_y_, summary.std_y_, summary.cov_xy_);
+  printf("Final theta:   mean %.4f std %.4f deg\n", summary.mean_theta_ * degrees, summary.std_theta_ * degrees);
+  printf("Drift:         mean %.6f std %.6f median %.6f p95 %.6f max %.6f m\n",
+         summary.mean_drift_, summary.std_drift_, summary.median_drift_, summary.p95_drift_, summary.max_drift_);
+  printf("Heading drift: rms %.4f deg\n", summary.rms_heading_drift_ * degrees);
+
+  if (csv_path != nullptr) {
+    FILE *csv = fopen(csv_path, "w");
+    if (csv == nullptr) {
+      printf("ERROR (sim_batch): Unable to open %s\n", csv_path);
+      return 1;
+    }
+    fprintf(csv, "trial,x,y,theta,nominal_x,nominal_y,nominal_theta,drift,heading_drift\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const MonteCarloTrial &trial = results[i];
+      fprintf(csv, "%zu,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n", i,
+              trial.final_.x, trial.final_.y, trial.final_.theta,
+              trial.nominal_.x, trial.nominal_.y, trial.nominal_.theta,
+              trial.drift_, trial.heading_drift_);
+    }
+    fclose(csv);
+  }
+  return 0;
+}
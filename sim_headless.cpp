@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "occupancy_grid.h"
+#include "sim_state.h"
+#include "trajectory_log.h"
+
+/**
+ * Runs the simulator with no window/GL context, as fast as possible.
+ * Usage: sim_headless [--steps N] [--dt seconds] [--v m/s] [--w deg/s] [--record file [--compress]]
+ *                     [--map file] [--load-state file] [--save-state file]
+ * With a map every step is collision checked, steps into obstacles are rejected and counted.
+ * --load-state carries on from a saved sim state (see sim_state.h) with its command unless --v/--w
+ * are given, on --map if given (the saved map is written into it) or else on the saved map.
+ * --save-state writes the state after the last step.
+ */
+int main(int argc, char **argv) {
+  uint64_t steps = 10000000;
+  double dt = 0.01;
+  double linear_velocity = 1.0;
+  double angular_velocity = 10.0;
+  const char *record_path = nullptr;
+  const char *map_path = nullptr;
+  const char *load_state_path = nullptr;
+  const char *save_state_path = nullptr;
+  bool command_given = false;
+  bool compress = false;
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (has_value && strcmp(argv[i], "--steps") == 0) {
+      steps = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (has_value && strcmp(argv[i], "--dt") == 0) {
+      dt = atof(argv[++i]);
+    }
+    else if (has_value && strcmp(argv[i], "--v") == 0) {
+      linear_velocity = atof(argv[++i]);
+      command_given = true;
+    }
+    else if (has_value && strcmp(argv[i], "--w") == 0) {
+      angular_velocity = atof(argv[++i]);
+      command_given = true;
+    }
+    else if (has_value && strcmp(argv[i], "--record") == 0) {
+      record_path = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--map") == 0) {
+      map_path = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--load-state") == 0) {
+      load_state_path = argv[++i];
+    }
+    else if (has_value && strcmp(argv[i], "--save-state") == 0) {
+      save_state_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--compress") == 0) {
+      compress = true;
+    }
+    else {
+      printf("Usage: %s [--steps N] [--dt seconds] [--v m/s] [--w deg/s] [--record file [--compress]] [--map file]"
+             " [--load-state file] [--save-state file]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  OccupancyGrid grid;
+  if (map_path != nullptr && !grid.Open(map_path, false)) {
+    return 1;
+  }
+  // Just the robot unless a saved state brings a fleet or pose estimator along
+  SimState state;
+  state.localization_.estimator_ = EstimatorType::kNone;
+  if (grid.IsOpen()) {
+    state.SetGrid(&grid);
+  }
+  if (load_state_path != nullptr && !ReadSimStateFile(load_state_path, state)) {
+    return 1;
+  }
+  Simulator &sim = state.sim_;
+  if (load_state_path == nullptr || command_given) {
+    sim.SetCommand(linear_velocity, angular_velocity * M_PI / 180);
+  }
+
+  TrajectoryRecorder recorder;
+  if (record_path != nullptr && !recorder.Open(record_path, compress)) {
+    return 1;
+  }
+  TrajectoryRecord record;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < steps; ++i) {
+    state.Step(dt);
+    if (record_path != nullptr) {
+      record.time = sim.time_;
+      record.x = sim.pose_.x;
+      record.y = sim.pose_.y;
+      record.theta = sim.pose_.theta;
+      record.v = sim.linear_velocity_;
+      record.w = sim.angular_velocity_;
+      recorder.Record(record);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  recorder.Close();
+  double seconds = std::chrono::duration<double>(end - start).count();
+
+  printf("Steps:      %llu\n", (unsigned long long)sim.step_count_);
+  printf("Sim time:   %.3f s\n", sim.time_);
+  printf("Wall time:  %.3f s\n", seconds);
+  printf("Steps/sec:  %.3e\n", seconds > 0 ? steps / seconds : 0.0);
+  printf("Final pose: x %.6f y %.6f theta %.6f deg\n",
+         sim.pose_.x, sim.pose_.y, sim.pose_.theta * 180 / M_PI);
+  if (save_state_path != nullptr && !WriteSimStateFile(save_state_path, state)) {
+    return 1;
+  }
+  if (state.Grid() != nullptr) {
+    printf("Collisions: %llu steps rejected\n", (unsigned long long)sim.collisions_);
+  }
+  if (record_path != nullptr) {
+    // The sim never waits on the recorder, so if it outran the writer some steps were dropped
+    printf("Recorded:   %llu records, %llu dropped\n",
+           (unsigned long long)recorder.written_.load(),
+           (unsigned long long)recorder.dropped_.load());
+  }
+  return 0;
+}
@@ -0,0 +1,676 @@
+#include "sim_state.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "fleet_step.h"
+
+static uint64_t Fnv1a64(const uint8_t *data,
+                        size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/**
+ * Appends raw little endian values to a buffer
+ */
+struct StateWriter {
+  std::vector<uint8_t> &out_;
+  uint32_t section_count_ = 0;
+
+  template <typename T>
+  void PutArray(const T *values,
+                size_t count) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(values);
+    out_.insert(out_.end(), bytes, bytes + count * sizeof(T));
+  }
+
+  template <typename T>
+  void Put(const T &value) {
+    PutArray(&value, 1);
+  }
+
+  template <typename T>
+  void PutVector(const std::vector<T> &values) {
+    Put((uint64_t)values.size());
+    PutArray(values.data(), values.size());
+  }
+
+  /**
+   * \return where the section starts, for EndSection
+   */
+  size_t BeginSection(SimStateSectionId id) {
+    const size_t start = out_.size();
+    SimStateSection section = {};
+    section.id = id;
+    Put(section);
+    section_count_++;
+    return start;
+  }
+
+  void EndSection(size_t start) {
+    const uint64_t size = out_.size() - start - sizeof(SimStateSection);
+    memcpy(out_.data() + start + offsetof(SimStateSection, size), &size, sizeof(size));
+  }
+};
+
+/**
+ * Reads raw values back, every read is bounds checked
+ */
+struct StateReader {
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+
+  template <typename T>
+  bool GetArray(T *values,
+                size_t count) {
+    if (count > (size_ - offset_) / sizeof(T)) {
+      return false;
+    }
+    memcpy(static_cast<void*>(values), data_ + offset_, count * sizeof(T));
+    offset_ += count * sizeof(T);
+    return true;
+  }
+
+  template <typename T>
+  bool Get(T &value) {
+    return GetArray(&value, 1);
+  }
+
+  template <typename T>
+  bool GetVector(std::vector<T> &values) {
+    uint64_t count = 0;
+    if (!Get(count) || count > (size_ - offset_) / sizeof(T)) {
+      return false;
+    }
+    values.resize(count);
+    return GetArray(values.data(), count);
+  }
+
+  bool AtEnd() const {
+    return offset_ == size_;
+  }
+};
+
+void SimState::SetGrid(OccupancyGrid *grid) {
+  // Not ours to delete
+  SetGrid(std::shared_ptr<OccupancyGrid>(grid, [](OccupancyGrid *) {}));
+}
+
+void SimState::SetGrid(std::shared_ptr<OccupancyGrid> grid) {
+  grid_ = std::move(grid);
+  sim_.grid_ = grid_.get();
+}
+
+const OccupancyGrid *SimState::Grid() const {
+  return grid_.get();
+}
+
+OccupancyGrid *SimState::MutableGrid() {
+  if (grid_ == nullptr) {
+    return nullptr;
+  }
+  // A count of 1 can't go up behind our back, nobody else has a copy of the pointer to copy
+  if (grid_.use_count() > 1 || !grid_->writable_) {
+    auto copy = std::make_shared<OccupancyGrid>();
+    if (!copy->CopyFrom(*grid_)) {
+      printf("ERROR (SimState): Could not copy the map\n");
+      return nullptr;
+    }
+    SetGrid(std::move(copy));
+  }
+  return grid_.get();
+}
+
+SimState SimState::Fork() const {
+  SimState fork = *this;
+  fork.localization_.particles_.pool_ = nullptr;
+  return fork;
+}
+
+void SimState::Step(double dt) {
+  sim_.Step(dt);
+  // Odometry of a blocked robot reads 0, the wheels don't slip in this sim
+  if (sim_.colliding_) {
+    localization_.Step(sim_.pose_, 0, 0, dt);
+  }
+  else {
+    localization_.Step(sim_.pose_, sim_.linear_velocity_, sim_.angular_velocity_, dt);
+  }
+  StepFleet(fleet_, dt);
+}
+
+static void PutSimulator(StateWriter &writer,
+                         const Simulator &sim) {
+  writer.Put(sim.pose_);
+  writer.Put(sim.linear_velocity_);
+  writer.Put(sim.angular_velocity_);
+  writer.Put(sim.time_);
+  writer.Put(sim.step_count_);
+  writer.Put(sim.length_);
+  writer.Put(sim.width_);
+  writer.Put((uint8_t)sim.colliding_);
+  writer.Put(sim.collisions_);
+}
+
+static bool GetSimulator(StateReader &reader,
+                         Simulator &sim) {
+  uint8_t colliding = 0;
+  bool valid = reader.Get(sim.pose_) &&
+      reader.Get(sim.linear_velocity_) &&
+      reader.Get(sim.angular_velocity_) &&
+      reader.Get(sim.time_) &&
+      reader.Get(sim.step_count_) &&
+      reader.Get(sim.length_) &&
+      reader.Get(sim.width_) &&
+      reader.Get(colliding) &&
+      reader.Get(sim.collisions_);
+  sim.colliding_ = colliding != 0;
+  return valid;
+}
+
+static void PutFleet(StateWriter &writer,
+                     const FleetState &fleet) {
+  writer.PutVector(fleet.x_);
+  writer.PutVector(fleet.y_);
+  writer.PutVector(fleet.theta_);
+  writer.PutVector(fleet.v_);
+  writer.PutVector(fleet.w_);
+}
+
+static bool GetFleet(StateReader &reader,
+                     FleetState &fleet) {
+  return reader.GetVector(fleet.x_) &&
+      reader.GetVector(fleet.y_) &&
+      reader.GetVector(fleet.theta_) &&
+      reader.GetVector(fleet.v_) &&
+      reader.GetVector(fleet.w_) &&
+      fleet.y_.size() == fleet.x_.size() &&
+      fleet.theta_.size() == fleet.x_.size() &&
+      fleet.v_.size() == fleet.x_.size() &&
+      fleet.w_.size() == fleet.x_.size();
+}
+
+template <typename Filter>
+static void PutKalman(StateWriter &writer,
+                      const Filter &filter) {
+  writer.PutArray(filter.mean_.data(), filter.mean_.size());
+  writer.PutArray(filter.covariance_.data(), filter.covariance_.size());
+  writer.Put(filter.gate_);
+}
+
+template <typename Filter>
+static bool GetKalman(StateReader &reader,
+                      Filter &filter) {
+  return reader.GetArray(filter.mean_.data(), filter.mean_.size()) &&
+      reader.GetArray(filter.covariance_.data(), filter.covariance_.size()) &&
+      reader.Get(filter.gate_);
+}
+
+static void PutLocalization(StateWriter &writer,
+                            const Localization &localization) {
+  writer.Put((uint32_t)localization.estimator_);
+  PutKalman(writer, localization.ekf_);
+  PutKalman(writer, localization.ukf_);
+  writer.Put(localization.ukf_.alpha_);
+  writer.Put(localization.ukf_.beta_);
+  writer.Put(localization.ukf_.kappa_);
+  writer.Put((uint64_t)localization.particle_count_);
+  writer.Put(localization.particle_estimate_);
+  writer.PutArray(localization.particle_covariance_.data(), localization.particle_covariance_.size());
+  writer.Put(localization.particle_seed_);
+  writer.Put(localization.rng_.state_);
+  writer.Put(localization.linear_noise_);
+  writer.Put(localization.angular_noise_);
+  writer.Put(localization.landmark_range_);
+  writer.Put(localization.landmark_period_);
+  writer.Put(localization.range_noise_);
+  writer.Put(localization.bearing_noise_);
+  writer.Put(localization.gnss_period_);
+  writer.Put(localization.gnss_noise_);
+  writer.Put(localization.landmark_timer_);
+  writer.Put(localization.gnss_timer_);
+  writer.Put(localization.updates_);
+  writer.Put(localization.rejected_);
+  writer.PutVector(localization.landmarks_);
+}
+
+static bool GetLocalization(StateReader &reader,
+                            Localization &localization) {
+  uint32_t estimator = 0;
+  uint64_t particle_count = 0;
+  bool valid = reader.Get(estimator) &&
+      GetKalman(reader, localization.ekf_) &&
+      GetKalman(reader, localization.ukf_) &&
+      reader.Get(localization.ukf_.alpha_) &&
+      reader.Get(localization.ukf_.beta_) &&
+      reader.Get(localization.ukf_.kappa_) &&
+      reader.Get(particle_count) &&
+      reader.Get(localization.particle_estimate_) &&
+      reader.GetArray(localization.particle_covariance_.data(), localization.particle_covariance_.size()) &&
+      reader.Get(localization.particle_seed_) &&
+      reader.Get(localization.rng_.state_) &&
+      reader.Get(localization.linear_noise_) &&
+      reader.Get(localization.angular_noise_) &&
+      reader.Get(localization.landmark_range_) &&
+      reader.Get(localization.landmark_period_) &&
+      reader.Get(localization.range_noise_) &&
+      reader.Get(localization.bearing_noise_) &&
+      reader.Get(localization.gnss_period_) &&
+      reader.Get(localization.gnss_noise_) &&
+      reader.Get(localization.landmark_timer_) &&
+      reader.Get(localization.gnss_timer_) &&
+      reader.Get(localization.updates_) &&
+      reader.Get(localization.rejected_) &&
+      reader.GetVector(localization.landmarks_) &&
+      estimator <= (uint32_t)EstimatorType::kParticle;
+  localization.estimator_ = (EstimatorType)estimator;
+  localization.particle_count_ = (size_t)particle_count;
+  return valid;
+}
+
+/**
+ * Only what carries over from one step to the next, the rest of the filter is scratch space
+ */
+static void PutParticles(StateWriter &writer,
+                         const ParticleFilter &filter) {
+  writer.Put(filter.seed_);
+  writer.Put(filter.draws_);
+  writer.Put(filter.resamples_);
+  writer.Put(filter.resample_threshold_);
+  writer.Put(filter.sum_squares_);
+  writer.PutVector(filter.particles_.x_);
+  writer.PutVector(filter.particles_.y_);
+  writer.PutVector(filter.particles_.theta_);
+  writer.PutVector(filter.weights_);
+}
+
+static bool GetParticles(StateReader &reader,
+                         ParticleFilter &filter) {
+  return reader.Get(filter.seed_) &&
+      reader.Get(filter.draws_) &&
+      reader.Get(filter.resamples_) &&
+      reader.Get(filter.resample_threshold_) &&
+      reader.Get(filter.sum_squares_) &&
+      reader.GetVector(filter.particles_.x_) &&
+      reader.GetVector(filter.particles_.y_) &&
+      reader.GetVector(filter.particles_.theta_) &&
+      reader.GetVector(filter.weights_) &&
+      filter.particles_.y_.size() == filter.particles_.x_.size() &&
+      filter.particles_.theta_.size() == filter.particles_.x_.size() &&
+      filter.weights_.size() == filter.particles_.x_.size();
+}
+
+static bool TileIsZero(const uint8_t *tile) {
+  static const uint8_t zero_tile[kOccupancyTileCells] = {};
+  return memcmp(tile, zero_tile, kOccupancyTileCells) == 0;
+}
+
+static void PutGrid(StateWriter &writer,
+                    const OccupancyGrid &grid) {
+  writer.Put(grid.width_);
+  writer.Put(grid.height_);
+  writer.Put(grid.resolution_);
+  writer.Put(grid.origin_x_);
+  writer.Put(grid.origin_y_);
+  writer.Put((uint8_t)grid.outside_occupied_);
+  uint64_t stored = 0;
+  for (size_t tile = 0; tile < grid.TileCount(); ++tile) {
+    stored += !TileIsZero(grid.tiles_ + tile * kOccupancyTileCells);
+  }
+  writer.Put(stored);
+  for (size_t tile = 0; tile < grid.TileCount(); ++tile) {
+    const uint8_t *cells = grid.tiles_ + tile * kOccupancyTileCells;
+    if (!TileIsZero(cells)) {
+      writer.Put((uint32_t)tile);
+      writer.PutArray(cells, kOccupancyTileCells);
+    }
+  }
+}
+
+/**
+ * A map section, checked but not applied yet. tiles_ points into the snapshot, one entry per tile
+ * of the map, nullptr where the tile is all zero
+ */
+struct StoredGrid {
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  double resolution_ = 0;
+  double origin_x_ = 0;
+  double origin_y_ = 0;
+  bool outside_occupied_ = true;
+  std::vector<const uint8_t*> tiles_;
+};
+
+static bool GetGrid(StateReader &reader,
+                    StoredGrid &grid) {
+  uint8_t outside_occupied = 1;
+  uint64_t stored = 0;
+  if (!reader.Get(grid.width_) ||
+      !reader.Get(grid.height_) ||
+      !reader.Get(grid.resolution_) ||
+      !reader.Get(grid.origin_x_) ||
+      !reader.Get(grid.origin_y_) ||
+      !reader.Get(outside_occupied) ||
+      !reader.Get(stored)) {
+    return false;
+  }
+  grid.outside_occupied_ = outside_occupied != 0;
+  const size_t tiles_x = (grid.width_ + kOccupancyTileSize - 1) / kOccupancyTileSize;
+  const size_t tiles_y = (grid.height_ + kOccupancyTileSize - 1) / kOccupancyTileSize;
+  grid.tiles_.assign(tiles_x * tiles_y, nullptr);
+  for (uint64_t i = 0; i < stored; ++i) {
+    uint32_t tile = 0;
+    if (!reader.Get(tile) || tile >= grid.tiles_.size() ||
+        reader.size_ - reader.offset_ < kOccupancyTileCells) {
+      return false;
+    }
+    grid.tiles_[tile] = reader.data_ + reader.offset_;
+    reader.offset_ += kOccupancyTileCells;
+  }
+  return true;
+}
+
+static bool SameGeometry(const OccupancyGrid &grid,
+                         const StoredGrid &stored) {
+  return grid.width_ == stored.width_ && grid.height_ == stored.height_ &&
+      grid.resolution_ == stored.resolution_ &&
+      grid.origin_x_ == stored.origin_x_ && grid.origin_y_ == stored.origin_y_;
+}
+
+/**
+ * \return whether grid already holds exactly the stored cells (same geometry assumed)
+ */
+static bool SameCells(const StoredGrid &stored,
+                      const OccupancyGrid &grid) {
+  static const uint8_t zero_tile[kOccupancyTileCells] = {};
+  if (grid.outside_occupied_ != stored.outside_occupied_) {
+    return false;
+  }
+  for (size_t tile = 0; tile < stored.tiles_.size(); ++tile) {
+    const uint8_t *cells = stored.tiles_[tile] != nullptr ? stored.tiles_[tile] : zero_tile;
+    if (memcmp(grid.tiles_ + tile * kOccupancyTileCells, cells, kOccupancyTileCells) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Make the state's map match the stored one, only touching (and only copying a shared map for)
+ * tiles that differ
+ * \return false if the map had to be copied and that failed, nothing has changed then
+ */
+static bool ApplyGrid(const StoredGrid &stored,
+                      SimState &state) {
+  static const uint8_t zero_tile[kOccupancyTileCells] = {};
+  OccupancyGrid *target = nullptr;
+  if (state.grid_->outside_occupied_ != stored.outside_occupied_) {
+    target = state.MutableGrid();
+    if (target == nullptr) {
+      return false;
+    }
+    target->outside_occupied_ = stored.outside_occupied_;
+  }
+  for (size_t tile = 0; tile < stored.tiles_.size(); ++tile) {
+    const uint8_t *cells = stored.tiles_[tile] != nullptr ? stored.tiles_[tile] : zero_tile;
+    if (memcmp(state.grid_->tiles_ + tile * kOccupancyTileCells, cells, kOccupancyTileCells) == 0) {
+      continue;
+    }
+    if (target == nullptr) {
+      target = state.MutableGrid();
+      if (target == nullptr) {
+        return false;
+      }
+    }
+    const uint32_t x = (uint32_t)(tile % target->tiles_x_) * kOccupancyTileSize;
+    const uint32_t y = (uint32_t)(tile / target->tiles_x_) * kOccupancyTileSize;
+    target->BeginChange(x, y, x, y);
+    memcpy(target->tiles_ + tile * kOccupancyTileCells, cells, kOccupancyTileCells);
+    uint32_t occupied = 0;
+    for (size_t i = 0; i < kOccupancyTileCells; ++i) {
+      occupied += cells[i] >= kOccupiedThreshold;
+    }
+    target->tile_occupied_[tile] = occupied;
+    target->MarkDirty(x, y, x, y);
+  }
+  return true;
+}
+
+void SaveSimState(const SimState &state,
+                  std::vector<uint8_t> &out,
+                  bool include_grid) {
+  out.clear();
+  StateWriter writer{out};
+  SimStateHeader header = {};
+  writer.Put(header);
+
+  size_t section = writer.BeginSection(kSimStateSimulator);
+  PutSimulator(writer, state.sim_);
+  writer.EndSection(section);
+
+  section = writer.BeginSection(kSimStateFleet);
+  PutFleet(writer, state.fleet_);
+  writer.EndSection(section);
+
+  section = writer.BeginSection(kSimStateLocalization);
+  PutLocalization(writer, state.localization_);
+  writer.EndSection(section);
+
+  if (state.localization_.estimator_ == EstimatorType::kParticle) {
+    section = writer.BeginSection(kSimStateParticles);
+    PutParticles(writer, state.localization_.particles_);
+    writer.EndSection(section);
+  }
+
+  section = writer.BeginSection(kSimStateRandom);
+  writer.Put(state.lidar_rng_.state_);
+  writer.Put(state.lidar_elapsed_);
+  writer.Put(state.obstacle_seed_);
+  writer.EndSection(section);
+
+  if (include_grid && state.Grid() != nullptr && state.Grid()->IsOpen()) {
+    section = writer.BeginSection(kSimStateGrid);
+    PutGrid(writer, *state.Grid());
+    writer.EndSection(section);
+  }
+
+  memcpy(header.magic, kSimStateMagic, sizeof(kSimStateMagic));
+  header.version = kSimStateVersion;
+  header.section_count = writer.section_count_;
+  header.payload_size = out.size() - sizeof(header);
+  header.checksum = Fnv1a64(out.data() + sizeof(header), header.payload_size);
+  memcpy(out.data(), &header, sizeof(header));
+}
+
+bool LoadSimState(const uint8_t *data,
+                  size_t size,
+                  SimState &state,
+                  bool copy_read_only_grid) {
+  SimStateHeader header;
+  if (size < sizeof(header)) {
+    printf("ERROR (SimState): Not a sim state snapshot\n");
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kSimStateMagic, sizeof(kSimStateMagic)) != 0 ||
+      header.version != kSimStateVersion ||
+      header.payload_size != size - sizeof(header)) {
+    printf("ERROR (SimState): Not a version %u sim state snapshot, or truncated\n", kSimStateVersion);
+    return false;
+  }
+  if (Fnv1a64(data + sizeof(header), header.payload_size) != header.checksum) {
+    printf("ERROR (SimState): Snapshot checksum mismatch, the data is corrupt\n");
+    return false;
+  }
+
+  // Read everything into temporaries first, so a bad snapshot leaves the state alone
+  Simulator sim = state.sim_;
+  FleetState fleet;
+  Localization localization;
+  ParticleFilter &particles = localization.particles_;
+  Rng lidar_rng = state.lidar_rng_;
+  double lidar_elapsed = state.lidar_elapsed_;
+  uint64_t obstacle_seed = state.obstacle_seed_;
+  StoredGrid stored_grid;
+  bool has_particles = false;
+  bool has_grid = false;
+  uint32_t required = 0;
+  StateReader reader{data, size, sizeof(header)};
+  for (uint32_t i = 0; i < header.section_count; ++i) {
+    SimStateSection section;
+    if (!reader.Get(section) || section.size > size - reader.offset_) {
+      printf("ERROR (SimState): Snapshot section %u is truncated\n", i);
+      return false;
+    }
+    StateReader payload{data + reader.offset_, (size_t)section.size};
+    reader.offset_ += section.size;
+    bool valid = true;
+    switch (section.id) {
+      case kSimStateSimulator:
+        valid = GetSimulator(payload, sim);
+        required |= 1;
+        break;
+      case kSimStateFleet:
+        valid = GetFleet(payload, fleet);
+        required |= 2;
+        break;
+      case kSimStateLocalization:
+        valid = GetLocalization(payload, localization);
+        required |= 4;
+        break;
+      case kSimStateParticles:
+        valid = GetParticles(payload, particles);
+        has_particles = true;
+        break;
+      case kSimStateRandom:
+        valid = payload.Get(lidar_rng.state_) && payload.Get(lidar_elapsed) && payload.Get(obstacle_seed);
+        break;
+      case kSimStateGrid:
+        valid = GetGrid(payload, stored_grid);
+        has_grid = true;
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    if (!valid || !payload.AtEnd()) {
+      printf("ERROR (SimState): Snapshot section %u (id %u) is invalid\n", i, section.id);
+      return false;
+    }
+  }
+  if (required != 7 || (localization.estimator_ == EstimatorType::kParticle && !has_particles)) {
+    printf("ERROR (SimState): Snapshot is missing sections\n");
+    return false;
+  }
+  if (has_grid && state.Grid() != nullptr && !SameGeometry(*state.Grid(), stored_grid)) {
+    printf("ERROR (SimState): Snapshot map is %ux%u cells of %g m at (%g, %g), the current one %ux%u of %g m at (%g, %g)\n",
+           stored_grid.width_, stored_grid.height_, stored_grid.resolution_, stored_grid.origin_x_,
+           stored_grid.origin_y_, state.Grid()->width_, state.Grid()->height_, state.Grid()->resolution_,
+           state.Grid()->origin_x_, state.Grid()->origin_y_);
+    return false;
+  }
+  if (has_grid && !copy_read_only_grid && state.Grid() != nullptr && !state.Grid()->writable_ &&
+      !SameCells(stored_grid, *state.Grid())) {
+    printf("ERROR (SimState): Snapshot map differs from the current one, which is read only\n");
+    return false;
+  }
+
+  // The map first, it is the only part that can still fail (copying it)
+  if (has_grid) {
+    if (state.Grid() == nullptr) {
+      auto grid = std::make_shared<OccupancyGrid>();
+      if (!grid->Create(stored_grid.width_, stored_grid.height_, stored_grid.resolution_,
+                        stored_grid.origin_x_, stored_grid.origin_y_)) {
+        return false;
+      }
+      state.SetGrid(std::move(grid));
+    }
+    if (!ApplyGrid(stored_grid, state)) {
+      return false;
+    }
+  }
+  sim.grid_ = state.Grid();
+  state.sim_ = sim;
+  state.fleet_ = std::move(fleet);
+  state.lidar_rng_ = lidar_rng;
+  state.lidar_elapsed_ = lidar_elapsed;
+  state.obstacle_seed_ = obstacle_seed;
+
+  // Field by field, the filter keeps its pool_ and kernels
+  Localization &target = state.localization_;
+  target.estimator_ = localization.estimator_;
+  target.ekf_ = localization.ekf_;
+  target.ukf_ = localization.ukf_;
+  target.particle_count_ = localization.particle_count_;
+  target.particle_estimate_ = localization.particle_estimate_;
+  target.particle_covariance_ = localization.particle_covariance_;
+  target.particle_seed_ = localization.particle_seed_;
+  target.rng_ = localization.rng_;
+  target.linear_noise_ = localization.linear_noise_;
+  target.angular_noise_ = localization.angular_noise_;
+  target.landmark_range_ = localization.landmark_range_;
+  target.landmark_period_ = localization.landmark_period_;
+  target.range_noise_ = localization.range_noise_;
+  target.bearing_noise_ = localization.bearing_noise_;
+  target.gnss_period_ = localization.gnss_period_;
+  target.gnss_noise_ = localization.gnss_noise_;
+  target.landmark_timer_ = localization.landmark_timer_;
+  target.gnss_timer_ = localization.gnss_timer_;
+  target.updates_ = localization.updates_;
+  target.rejected_ = localization.rejected_;
+  target.landmarks_.swap(localization.landmarks_);
+  if (has_particles) {
+    ParticleFilter &filter = target.particles_;
+    filter.Resize(particles.Size());
+    filter.particles_.x_.swap(particles.particles_.x_);
+    filter.particles_.y_.swap(particles.particles_.y_);
+    filter.particles_.theta_.swap(particles.particles_.theta_);
+    filter.weights_.swap(particles.weights_);
+    filter.seed_ = particles.seed_;
+    filter.draws_ = particles.draws_;
+    filter.resamples_ = particles.resamples_;
+    filter.resample_threshold_ = particles.resample_threshold_;
+    filter.sum_squares_ = particles.sum_squares_;
+  }
+  return true;
+}
+
+bool WriteSimStateFile(const std::string &path,
+                       const SimState &state,
+                       bool include_grid) {
+  std::vector<uint8_t> data;
+  SaveSimState(state, data, include_grid);
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    printf("ERROR (SimState): Could not create %s\n", path.c_str());
+    return false;
+  }
+  const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  if (fclose(file) != 0 || !written) {
+    printf("ERROR (SimState): Could not write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ReadSimStateFile(const std::string &path,
+                      SimState &state,
+                      bool copy_read_only_grid) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    printf("ERROR (SimState): Could not open %s\n", path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[1 << 16];
+  size_t count = 0;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.insert(data.end(), buffer, buffer + count);
+  }
+  fclose(file);
+  return LoadSimState(data.data(), data.size(), state, copy_read_only_grid);
+}
@@ -0,0 +1,138 @@
+#ifndef SEPT2023__SIM_STATE_H_
+#define SEPT2023__SIM_STATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "fleet_state.h"
+#include "localization.h"
+#include "occupancy_grid.h"
+#include "random.h"
+#include "simulator.h"
+
+/*
+ * File layout, all little endian:
+ *   SimStateHeader
+ *   section 0 ... section N-1   (each a SimStateSection followed by size bytes)
+ * The checksum (64 bit FNV-1a) covers everything after the header and is checked before the
+ * state is touched. Doubles and Rng states are stored as raw bits so a restored state carries on
+ * exactly as the saved one would have. The map is stored sparsely, as the index and cells of every
+ * tile that isn't all zero.
+ */
+constexpr char kSimStateMagic[8] = {'S', '2', '3', 'S', 'T', 'A', 'T', 0};
+constexpr uint32_t kSimStateVersion = 1;
+
+enum SimStateSectionId : uint32_t {
+  kSimStateSimulator = 1,
+  kSimStateFleet,
+  kSimStateLocalization,
+  // Only when the particle filter is the estimator
+  kSimStateParticles,
+  // Lidar noise and obstacle seeds
+  kSimStateRandom,
+  // Only if there is a map
+  kSimStateGrid
+};
+
+struct SimStateHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+  uint64_t payload_size;
+  uint64_t checksum;
+};
+
+struct SimStateSection {
+  uint32_t id;
+  uint32_t padding;
+  uint64_t size;
+};
+
+/**
+ * Everything that decides where a simulation goes next: the main robot, the fleet, the pose
+ * estimator, every Rng state and the map. Stepping two equal states with the same commands gives
+ * bit for bit the same results (on the same build and CPU, the SIMD kernels can differ in the last
+ * bits between machines).
+ *
+ * Copies are cheap forks for "what if" branches: the map is shared between the copies until one
+ * of them changes it through MutableGrid(), which then gets its own copy. Everything else is small
+ * or changes every step anyway, so it is copied.
+ */
+struct SimState {
+  Simulator sim_;
+  FleetState fleet_;
+  Localization localization_;
+  // Noise of the main robot's lidar and sim time since its last scan
+  Rng lidar_rng_{2023, 1};
+  double lidar_elapsed_ = 0;
+  // Seed of the next batch of random obstacles
+  uint64_t obstacle_seed_ = 1;
+  // Shared with forks, only change it through MutableGrid(). sim_.grid_ always points at it
+  std::shared_ptr<OccupancyGrid> grid_;
+
+  /**
+   * Use a map owned by someone else, it has to outlive this state and every fork of it. It is
+   * changed in place as long as it is writable and nothing else shares it
+   */
+  void SetGrid(OccupancyGrid *grid);
+
+  /**
+   * Use (and share) a map owned by the states using it
+   */
+  void SetGrid(std::shared_ptr<OccupancyGrid> grid);
+
+  const OccupancyGrid *Grid() const;
+
+  /**
+   * Copy on write access to the map, copies it first if a fork still shares it or it is read only
+   * \return nullptr if there is no map or it couldn't be copied
+   */
+  OccupancyGrid *MutableGrid();
+
+  /**
+   * \return a copy sharing the map, with the particle filter on the calling thread (pool_ cleared)
+   *         so forks can step side by side on a pool's threads
+   */
+  SimState Fork() const;
+
+  /**
+   * Advance the main robot (blocked by the map), its pose estimate and the fleet by dt seconds
+   * with their current commands
+   */
+  void Step(double dt);
+};
+
+/**
+ * Serialize the whole state, see the file layout above
+ * \param out return variable, cleared first
+ * \param include_grid leave the map out, e.g. when every snapshot of a run has the same one
+ */
+void SaveSimState(const SimState &state,
+                  std::vector<uint8_t> &out,
+                  bool include_grid = true);
+
+/**
+ * Restore a state written by SaveSimState. A map in the snapshot is written into the state's own
+ * map (copy on write, only the tiles that differ) or becomes a new map if the state has none, it
+ * has to be the same size as the state's map. Pointers the state was set up with (the particle
+ * filter's pool_) are kept.
+ * \param copy_read_only_grid false fails the load when the snapshot's map differs from a read only
+ *                            one instead of driving on a copy, for callers that keep showing or
+ *                            planning on the map they set
+ * \return false if the data is not a valid snapshot or its map doesn't fit, the state is unchanged
+ */
+bool LoadSimState(const uint8_t *data,
+                  size_t size,
+                  SimState &state,
+                  bool copy_read_only_grid = true);
+
+bool WriteSimStateFile(const std::string &path,
+                       const SimState &state,
+                       bool include_grid = true);
+bool ReadSimStateFile(const std::string &path,
+                      SimState &state,
+                      bool copy_read_only_grid = true);
+
+#endif
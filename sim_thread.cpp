@@ -0,0 +1,431 @@
+#include "sim_thread.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "fleet_step.h"
+#include "planner.h"
+#include "profiler.h"
+
+double SteadyClockSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SimThread::SimThread() : telemetry_(1 << 20, kSimTelemetryChannelCount), commands_(256), path_slots_(4) {
+  state_.localization_.particles_.pool_ = &pool_;
+  mppi_.pool_ = &pool_;
+  state_.localization_.PlaceLandmarks(40, 20, 2023);
+  state_.localization_.Reset(state_.sim_.pose_, 2023);
+  lidar_.Configure();
+}
+
+SimThread::~SimThread() {
+  Stop();
+}
+
+void SimThread::Start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  quit_ = false;
+  if (grid_ != nullptr) {
+    state_.SetGrid(grid_);
+  }
+  lidar_world_.grid_ = state_.Grid();
+  lidar_world_.segments_ = segments_;
+  scan_ranges_.resize(lidar_.beam_count_);
+  scan_direction_x_.resize(lidar_.beam_count_);
+  scan_direction_y_.resize(lidar_.beam_count_);
+  Scan();
+  // Make sure there is something to read before the first step
+  Publish(state_.sim_.pose_, state_.fleet_);
+  thread_ = std::thread(&SimThread::Run, this);
+}
+
+void SimThread::Stop() {
+  quit_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool SimThread::PushCommand(const SimCommand &command) {
+  return commands_.TryPush(command);
+}
+
+bool SimThread::PushPath(const std::vector<Pose2D> &path,
+                         TrackingController controller) {
+  if (paths_pushed_ - paths_applied_.load(std::memory_order_acquire) >= path_slots_.size()) {
+    return false;
+  }
+  SimCommand command;
+  command.type_ = SimCommandType::kFollowPath;
+  command.path_slot_ = paths_pushed_ % path_slots_.size();
+  command.controller_ = controller;
+  // Published to the sim thread by the queue's release
+  path_slots_[command.path_slot_] = path;
+  if (!commands_.TryPush(command)) {
+    return false;
+  }
+  paths_pushed_++;
+  return true;
+}
+
+const SimSnapshot &SimThread::LatestSnapshot() {
+  snapshots_.Update();
+  return snapshots_.ReadBuffer();
+}
+
+void SimThread::ApplyCommand(const SimCommand &command) {
+  switch (command.type_) {
+    case SimCommandType::kSetVelocity:
+      following_ = false;
+      state_.sim_.SetCommand(command.linear_velocity_, command.angular_velocity_);
+      break;
+    case SimCommandType::kSetRunning:
+      running_ = command.running_;
+      break;
+    case SimCommandType::kReset:
+      following_ = false;
+      state_.sim_.Reset();
+      state_.localization_.Reset(state_.sim_.pose_, 2023);
+      break;
+    case SimCommandType::kSpawnFleet:
+      SpawnRandomFleet(state_.fleet_, command.fleet_size_, 2023);
+      break;
+    case SimCommandType::kSetTimeScale:
+      time_scale_ = command.time_scale_;
+      break;
+    case SimCommandType::kSetRecorder:
+      recorder_ = command.recorder_;
+      break;
+    case SimCommandType::kSetEstimator:
+      if (state_.localization_.estimator_ == EstimatorType::kNone) {
+        // Wasn't tracking, start again from the truth
+        state_.localization_.Reset(state_.sim_.pose_, 2023);
+      }
+      state_.localization_.SetEstimator(command.estimator_);
+      break;
+    case SimCommandType::kAddObstacles:
+      if (OccupancyGrid *grid = state_.MutableGrid()) {
+        AddRandomObstacles(*grid, command.obstacle_count_, state_.obstacle_seed_++, state_.sim_.pose_.x,
+                           state_.sim_.pose_.y, std::max(state_.sim_.length_, state_.sim_.width_));
+      }
+      break;
+    case SimCommandType::kSetLidar:
+      lidar_enabled_ = command.lidar_;
+      fleet_lidar_ = command.fleet_lidar_;
+      fleet_scan_time_ = 0;
+      Scan();
+      break;
+    case SimCommandType::kSetFleetCollisions:
+      fleet_collisions_ = command.fleet_collisions_;
+      fleet_contacts_.clear();
+      fleet_collision_time_ = 0;
+      break;
+    case SimCommandType::kFollowPath:
+      path_.Set(path_slots_[command.path_slot_]);
+      paths_applied_.fetch_add(1, std::memory_order_release);
+      controller_ = command.controller_;
+      pure_pursuit_.Reset();
+      mppi_.Reset();
+      following_ = !path_.Empty();
+      tracking_error_ = 0;
+      // First tick on the next step
+      control_elapsed_ = control_period_;
+      if (!following_) {
+        state_.sim_.SetCommand(0, 0);
+      }
+      break;
+    case SimCommandType::kSaveState:
+      WriteSimStateFile(command.state_path_, state_);
+      break;
+    case SimCommandType::kLoadState:
+      // The renderer and planner keep using grid_, so a map that can't be written into it fails
+      // the load rather than leaving the robots on a copy nobody sees
+      if (!ReadSimStateFile(command.state_path_, state_, false)) {
+        break;
+      }
+      // The path and controllers aren't part of the state
+      following_ = false;
+      lidar_world_.grid_ = state_.Grid();
+      fleet_contacts_.clear();
+      Scan();
+      break;
+  }
+}
+
+void SimThread::Control() {
+  control_elapsed_ += dt_;
+  if (control_elapsed_ < control_period_) {
+    return;
+  }
+  control_elapsed_ = std::fmod(control_elapsed_, control_period_);
+  SEPT2023_PROFILE_SCOPE("control");
+  const OccupancyGrid *grid = state_.Grid();
+  if (controller_ == TrackingController::kMppi && grid != nullptr &&
+      (field_.Empty() || field_.grid_version_ != grid->version_.load(std::memory_order_acquire))) {
+    field_.Build(*grid, &pool_);
+  }
+  mppi_.field_ = field_.Empty() ? nullptr : &field_;
+  mppi_.radius_ = 0.5 * std::hypot(state_.sim_.length_, state_.sim_.width_);
+  const double start = SteadyClockSeconds();
+  double linear = 0;
+  double angular = 0;
+  // Steers from the true pose, as if localization were perfect
+  if (controller_ == TrackingController::kMppi) {
+    following_ = mppi_.Compute(path_, state_.sim_.pose_, linear, angular);
+  }
+  else {
+    following_ = pure_pursuit_.Compute(path_, state_.sim_.pose_, linear, angular);
+  }
+  control_time_ = SteadyClockSeconds() - start;
+  state_.sim_.SetCommand(linear, angular);
+  const Pose2D closest =
+      path_.At(controller_ == TrackingController::kMppi ? mppi_.progress_ : pure_pursuit_.progress_);
+  tracking_error_ = std::hypot(closest.x - state_.sim_.pose_.x, closest.y - state_.sim_.pose_.y);
+}
+
+void SimThread::Publish(const Pose2D &previous_pose,
+                        const FleetState &previous_fleet) {
+  SEPT2023_PROFILE_SCOPE("publish");
+  SimSnapshot &snapshot = snapshots_.WriteBuffer();
+  snapshot.previous_pose_ = previous_pose;
+  snapshot.pose_ = state_.sim_.pose_;
+  snapshot.linear_velocity_ = state_.sim_.linear_velocity_;
+  snapshot.angular_velocity_ = state_.sim_.angular_velocity_;
+  snapshot.time_ = state_.sim_.time_;
+  snapshot.step_count_ = state_.sim_.step_count_;
+  snapshot.running_ = running_;
+  snapshot.recording_ = recorder_ != nullptr;
+  snapshot.time_scale_ = time_scale_;
+  snapshot.real_time_factor_ = real_time_factor_;
+  snapshot.steps_per_second_ = steps_per_second_;
+  snapshot.step_period_ = time_scale_ > 0 ? dt_ / time_scale_ : 0;
+  snapshot.colliding_ = state_.sim_.colliding_;
+  snapshot.collisions_ = state_.sim_.collisions_;
+  // Copy assignment reuses the capacity the snapshot already has, so no allocations once warm
+  snapshot.previous_fleet_ = previous_fleet;
+  snapshot.fleet_ = state_.fleet_;
+  snapshot.estimator_ = state_.localization_.estimator_;
+  snapshot.estimate_ = state_.localization_.Estimate();
+  snapshot.estimate_covariance_ = state_.localization_.Covariance();
+  snapshot.landmarks_ = state_.localization_.landmarks_;
+  snapshot.particles_.clear();
+  if (state_.localization_.estimator_ == EstimatorType::kParticle) {
+    const FleetState &particles = state_.localization_.particles_.particles_;
+    const size_t stride = std::max<size_t>(1, (particles.Size() + max_snapshot_particles_ - 1) / max_snapshot_particles_);
+    for (size_t i = 0; i < particles.Size(); i += stride) {
+      snapshot.particles_.push_back(static_cast<float>(particles.x_[i]));
+      snapshot.particles_.push_back(static_cast<float>(particles.y_[i]));
+    }
+  }
+  snapshot.scan_points_.clear();
+  if (lidar_enabled_) {
+    snapshot.scan_pose_ = scan_pose_;
+    for (size_t i = 0; i < scan_ranges_.size(); ++i) {
+      snapshot.scan_points_.push_back((float)scan_pose_.x + scan_ranges_[i] * scan_direction_x_[i]);
+      snapshot.scan_points_.push_back((float)scan_pose_.y + scan_ranges_[i] * scan_direction_y_[i]);
+    }
+  }
+  snapshot.fleet_scan_time_ = fleet_scan_time_;
+  snapshot.fleet_contacts_ = fleet_contacts_.size();
+  snapshot.fleet_collision_time_ = fleet_collision_time_;
+  snapshot.following_ = following_;
+  snapshot.controller_ = controller_;
+  snapshot.tracking_error_ = tracking_error_;
+  snapshot.control_time_ = control_time_;
+  snapshot.fleet_rays_per_second_ =
+      fleet_scan_time_ > 0 ? fleet_scans_.robot_count_ * fleet_scans_.beam_count_ / fleet_scan_time_ : 0;
+  snapshot.publish_time_ = SteadyClockSeconds();
+  snapshots_.Publish();
+}
+
+void SimThread::RecordTelemetry(double step_time) {
+  double sample[kSimTelemetryChannelCount];
+  sample[kSimTelemetryTime] = telemetry_time_;
+  sample[kSimTelemetryX] = state_.sim_.pose_.x;
+  sample[kSimTelemetryY] = state_.sim_.pose_.y;
+  sample[kSimTelemetryTheta] = state_.sim_.pose_.theta;
+  sample[kSimTelemetryLinearVelocity] = state_.sim_.linear_velocity_;
+  sample[kSimTelemetryAngularVelocity] = state_.sim_.angular_velocity_;
+  sample[kSimTelemetryStepTime] = step_time * 1e6;
+  telemetry_.Push(sample);
+}
+
+void SimThread::Scan() {
+  SEPT2023_PROFILE_SCOPE("lidar");
+  if (lidar_enabled_) {
+    scan_pose_ = state_.sim_.pose_;
+    CastScan(lidar_, lidar_world_, scan_pose_, scan_ranges_.data(), scan_direction_x_.data(),
+             scan_direction_y_.data(), &state_.lidar_rng_);
+  }
+  if (fleet_lidar_ && state_.fleet_.Size() > 0) {
+    const double start = SteadyClockSeconds();
+    CastFleetScans(lidar_, lidar_world_, state_.fleet_, fleet_scans_, &pool_, 2023);
+    fleet_scan_time_ = SteadyClockSeconds() - start;
+  }
+}
+
+void SimThread::Step() {
+  if (following_) {
+    Control();
+  }
+  state_.Step(dt_);
+  if (fleet_collisions_) {
+    SEPT2023_PROFILE_SCOPE("fleet collisions");
+    const double start = SteadyClockSeconds();
+    fleet_hash_.Build(state_.fleet_, &pool_);
+    fleet_hash_.FindCollisions(state_.sim_.length_, state_.sim_.width_, fleet_contacts_, &pool_);
+    fleet_collision_time_ = SteadyClockSeconds() - start;
+  }
+  state_.lidar_elapsed_ += dt_;
+  if (lidar_.rate_ > 0 && state_.lidar_elapsed_ >= 1 / lidar_.rate_) {
+    Scan();
+    // Never more than one scan per step, however fast the lidar
+    state_.lidar_elapsed_ = std::fmod(state_.lidar_elapsed_, 1 / lidar_.rate_);
+  }
+  telemetry_time_ += dt_;
+  if (recorder_ == nullptr) {
+    return;
+  }
+  TrajectoryRecord record;
+  record.time = state_.sim_.time_;
+  record.robot = 0;
+  record.x = state_.sim_.pose_.x;
+  record.y = state_.sim_.pose_.y;
+  record.theta = state_.sim_.pose_.theta;
+  record.v = state_.sim_.linear_velocity_;
+  record.w = state_.sim_.angular_velocity_;
+  recorder_->Record(record);
+  if (!recorder_->record_fleet_) {
+    return;
+  }
+  for (size_t i = 0; i < state_.fleet_.Size(); ++i) {
+    record.robot = (uint32_t)(i + 1);
+    record.x = state_.fleet_.x_[i];
+    record.y = state_.fleet_.y_[i];
+    record.theta = state_.fleet_.theta_[i];
+    record.v = state_.fleet_.v_[i];
+    record.w = state_.fleet_.w_[i];
+    recorder_->Record(record);
+  }
+}
+
+void SimThread::Run() {
+  SEPT2023_PROFILE_THREAD_NAME("sim");
+  // How often we publish/check for commands when running as fast as possible
+  const double max_speed_publish_period = 1.0 / 240;
+  // How often the achieved rates are measured
+  const double rate_period = 0.5;
+
+  double previous_time = SteadyClockSeconds();
+  // Sim time we still owe, in seconds of sim time
+  double accumulator = 0;
+  FleetState previous_fleet;
+  double rate_start_time = previous_time;
+  double rate_start_sim_time = state_.sim_.time_;
+  uint64_t rate_start_steps = state_.sim_.step_count_;
+
+  while (!quit_.load(std::memory_order_relaxed)) {
+    SimCommand command;
+    bool changed = false;
+    while (commands_.TryPop(command)) {
+      ApplyCommand(command);
+      changed = true;
+    }
+    if (planner_ != nullptr && state_.Grid() != nullptr) {
+      planner_->RebuildField(*state_.Grid());
+    }
+
+    double now = SteadyClockSeconds();
+    bool stepped = false;
+    Pose2D previous_pose = state_.sim_.pose_;
+    if (!running_) {
+      accumulator = 0;
+    }
+    else if (time_scale_ <= 0) {
+      // Scopes around the whole batch, timing millions of tiny steps would cost more than the steps
+      SEPT2023_PROFILE_SCOPE("step batch");
+      // As fast as possible, no interpolation since the state moves a lot between frames anyway.
+      // Big fleets take long enough per step that we check the clock every step
+      const int steps_per_check = state_.fleet_.Size() > 0 ? 1 : 64;
+      const double batch_start = now;
+      const double batch_end = now + max_speed_publish_period;
+      int batch_steps = 0;
+      do {
+        for (int i = 0; i < steps_per_check; ++i) {
+          Step();
+        }
+        batch_steps += steps_per_check;
+        now = SteadyClockSeconds();
+      } while (now < batch_end);
+      // Millions of steps a second is too many to plot, one sample of the average per batch
+      RecordTelemetry((now - batch_start) / batch_steps);
+      accumulator = 0;
+      previous_pose = state_.sim_.pose_;
+      changed = true;
+    }
+    else {
+      SEPT2023_PROFILE_SCOPE("steps");
+      accumulator += (now - previous_time) * time_scale_;
+      const int max_steps = (int)(max_catch_up_steps_ * std::max(1.0, time_scale_));
+      int steps = 0;
+      while (accumulator >= dt_) {
+        if (steps == max_steps) {
+          // Too far behind, give up on the rest of the time instead of falling further behind
+          accumulator = 0;
+          break;
+        }
+        previous_pose = state_.sim_.pose_;
+        // Only the state before the last step of this batch is needed for interpolation
+        bool last_step = accumulator < 2 * dt_ || steps + 1 == max_steps;
+        if (last_step) {
+          previous_fleet = state_.fleet_;
+        }
+        const double step_start = SteadyClockSeconds();
+        Step();
+        RecordTelemetry(SteadyClockSeconds() - step_start);
+        stepped = true;
+        accumulator -= dt_;
+        steps++;
+      }
+    }
+    previous_time = now;
+
+    if (now - rate_start_time >= rate_period) {
+      real_time_factor_ = (state_.sim_.time_ - rate_start_sim_time) / (now - rate_start_time);
+      steps_per_second_ = (state_.sim_.step_count_ - rate_start_steps) / (now - rate_start_time);
+      rate_start_time = now;
+      rate_start_sim_time = state_.sim_.time_;
+      rate_start_steps = state_.sim_.step_count_;
+      changed = true;
+    }
+
+    if (stepped) {
+      Publish(previous_pose, previous_fleet);
+    }
+    else if (changed) {
+      Publish(state_.sim_.pose_, state_.fleet_);
+    }
+
+    if (running_ && time_scale_ <= 0) {
+      continue;
+    }
+    // Sleep until the next step is due, or just poll for commands at the step rate when paused
+    double sleep_time = running_ ? (dt_ - accumulator) / time_scale_ : dt_;
+    std::this_thread::sleep_for(std::chrono::duration<double>(sleep_time));
+  }
+}
+
+double SnapshotAlpha(const SimSnapshot &snapshot,
+                     double now) {
+  if (snapshot.step_period_ <= 0) {
+    return 1;
+  }
+  return std::clamp((now - snapshot.publish_time_) / snapshot.step_period_, 0.0, 1.0);
+}
+
+Pose2D InterpolateSnapshot(const SimSnapshot &snapshot,
+                           double now) {
+  return InterpolatePose(snapshot.previous_pose_, snapshot.pose_, SnapshotAlpha(snapshot, now));
+}
@@ -0,0 +1,282 @@
+#ifndef SEPT2023__SIM_THREAD_H_
+#define SEPT2023__SIM_THREAD_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "fleet_state.h"
+#include "lidar.h"
+#include "localization.h"
+#include "occupancy_grid.h"
+#include "path_tracking.h"
+#include "sim_state.h"
+#include "spatial_hash.h"
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+#include "trajectory_log.h"
+#include "triple_buffer.h"
+
+struct PlannerService;
+
+enum class SimCommandType {
+  // Set the commanded linear/angular velocity of the main robot, stops following a path
+  kSetVelocity,
+  // Pause/resume stepping, the clock keeps running but the sim doesn't advance
+  kSetRunning,
+  // Put the main robot back at the origin
+  kReset,
+  // Replace the fleet with fleet_size_ random robots
+  kSpawnFleet,
+  // Run at time_scale_ x real time, 0 is as fast as possible
+  kSetTimeScale,
+  // Start recording every step into recorder_ (already opened), or stop if nullptr.
+  // Wait for SimSnapshot::recording_ to go false before closing the recorder
+  kSetRecorder,
+  // Switch the main robot's pose estimator to estimator_
+  kSetEstimator,
+  // Scatter obstacle_count_ random obstacles over the map
+  kAddObstacles,
+  // Turn the main robot's lidar (lidar_) and scanning from every fleet robot (fleet_lidar_) on/off
+  kSetLidar,
+  // Turn finding overlapping fleet robots every step on/off (fleet_collisions_)
+  kSetFleetCollisions,
+  // Drive the main robot along the path in SimThread::path_slots_[path_slot_] with controller_, an
+  // empty path stops it. Pushed by SimThread::PushPath
+  kFollowPath,
+  // Write the whole sim state (SimThread::state_) to state_path_, or restore it from there.
+  // Restoring stops following a path
+  kSaveState,
+  kLoadState
+};
+
+// Channels of SimThread::telemetry_, one sample per sim step (one per batch when running as fast
+// as possible)
+enum SimTelemetryChannel {
+  // Seconds of sim time since the thread started, unlike Simulator::time_ not reset with the robot
+  kSimTelemetryTime = 0,
+  kSimTelemetryX,
+  kSimTelemetryY,
+  kSimTelemetryTheta,
+  kSimTelemetryLinearVelocity,
+  kSimTelemetryAngularVelocity,
+  // Wall time of one step (sim and fleet), microseconds
+  kSimTelemetryStepTime,
+  kSimTelemetryChannelCount
+};
+
+/**
+ * Sent from the render thread to the sim thread, only the fields for the type are used
+ */
+struct SimCommand {
+  SimCommandType type_ = SimCommandType::kSetVelocity;
+  // m/s and rad/s
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+  bool running_ = false;
+  size_t fleet_size_ = 0;
+  double time_scale_ = 1;
+  TrajectoryRecorder *recorder_ = nullptr;
+  EstimatorType estimator_ = EstimatorType::kEkf;
+  size_t obstacle_count_ = 0;
+  bool lidar_ = true;
+  bool fleet_lidar_ = false;
+  bool fleet_collisions_ = true;
+  size_t path_slot_ = 0;
+  TrackingController controller_ = TrackingController::kPurePursuit;
+  // A fixed buffer rather than a std::string, queueing a command never allocates
+  char state_path_[256] = {};
+};
+
+/**
+ * Everything the renderer needs from one sim step. Holds both the state before and after the
+ * step so the renderer can interpolate between them.
+ */
+struct SimSnapshot {
+  Pose2D previous_pose_;
+  Pose2D pose_;
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+  double time_ = 0;
+  uint64_t step_count_ = 0;
+  bool running_ = false;
+  bool recording_ = false;
+  // Requested and achieved sim seconds per wall second, and the achieved step rate
+  double time_scale_ = 1;
+  double real_time_factor_ = 0;
+  double steps_per_second_ = 0;
+  FleetState previous_fleet_;
+  FleetState fleet_;
+  // steady_clock time the snapshot was published, in seconds
+  double publish_time_ = 0;
+  // Wall time it takes the sim to go from the previous to the current state. 0 when running as
+  // fast as possible, then there is no point interpolating
+  double step_period_ = 0;
+  // The last step was rejected because the robot would have hit the map, and the count of those
+  bool colliding_ = false;
+  uint64_t collisions_ = 0;
+  // Where the main robot thinks it is, from its noisy sensors
+  EstimatorType estimator_ = EstimatorType::kEkf;
+  Pose2D estimate_;
+  PoseCovariance estimate_covariance_ = PoseCovariance::Zero();
+  std::vector<Eigen::Vector2d> landmarks_;
+  // x, y pairs of (up to SimThread::max_snapshot_particles_ of) the particles, when that filter is on
+  std::vector<float> particles_;
+  // World space x, y pairs of where each beam of the main robot's latest scan ended, from scan_pose_.
+  // Empty when the lidar is off
+  Pose2D scan_pose_;
+  std::vector<float> scan_points_;
+  // Wall time of the latest scan of the whole fleet and the rays it cast per second, 0 when off
+  double fleet_scan_time_ = 0;
+  double fleet_rays_per_second_ = 0;
+  // Pairs of fleet robots overlapping after the last step, and the wall time finding them took
+  size_t fleet_contacts_ = 0;
+  double fleet_collision_time_ = 0;
+  // Following a path (kFollowPath): how far off it the robot is and the wall time of the last
+  // control tick
+  bool following_ = false;
+  TrackingController controller_ = TrackingController::kPurePursuit;
+  double tracking_error_ = 0;
+  double control_time_ = 0;
+};
+
+/**
+ * Runs the Simulator (and fleet) on its own thread at a fixed time step, independent of how fast
+ * the window is rendering. Wall time (times the time scale) is accumulated and the sim takes as
+ * many dt_ steps as it needs to catch up, so sim time tracks real time even if a frame stalls.
+ * With a time scale of 0 the sim steps as fast as it can and publishes at a fixed wall rate.
+ *
+ * Commands go in through a lock free queue and state comes out through a triple buffer, the
+ * render thread never blocks on the sim thread and vice versa.
+ */
+struct SimThread {
+  SimThread();
+  ~SimThread();
+
+  // Fixed simulation step, seconds. Don't change while running
+  double dt_ = 0.01;
+  // If we fall further behind than this many steps we drop the time instead of trying to catch
+  // up, otherwise a long stall would make us spiral further and further behind
+  int max_catch_up_steps_ = 100;
+
+  void Start();
+  void Stop();
+
+  /**
+   * Render thread only
+   * \return false if the command queue is full (the command is dropped)
+   */
+  bool PushCommand(const SimCommand &command);
+
+  /**
+   * Render thread only. Push a kFollowPath command, path is copied into a free path slot so the
+   * command itself stays small and doesn't allocate when queued
+   * \param path empty stops following
+   * \return false if every slot is still waiting for the sim thread or the command queue is full
+   * (the path is dropped)
+   */
+  bool PushPath(const std::vector<Pose2D> &path,
+                TrackingController controller);
+
+  /**
+   * Render thread only. Pick up the latest snapshot if a new one was published
+   * \return the latest snapshot
+   */
+  const SimSnapshot &LatestSnapshot();
+
+  // The main robot, fleet, pose estimate and their Rngs. Owned by the sim thread once started,
+  // change with commands
+  SimState state_;
+  // Map the main robot collides with, set before Start. The sim thread is the only one changing
+  // its cells once started, the renderer just reads them
+  OccupancyGrid *grid_ = nullptr;
+  // Line segment obstacles the lidar sees on top of the grid, set before Start. Optional
+  const SegmentBvh *segments_ = nullptr;
+  // Scans at lidar_.rate_ of sim time, from the main robot and (if fleet_lidar_) every fleet robot
+  Lidar lidar_;
+  bool lidar_enabled_ = true;
+  bool fleet_lidar_ = false;
+  LidarWorld lidar_world_;
+  LidarScans fleet_scans_;
+  double fleet_scan_time_ = 0;
+  std::vector<float> scan_ranges_;
+  std::vector<float> scan_direction_x_;
+  std::vector<float> scan_direction_y_;
+  Pose2D scan_pose_;
+  // Fleet robots overlapping each other, found every step if fleet_collisions_. They drive through
+  // each other regardless, this is just counted
+  bool fleet_collisions_ = true;
+  SpatialHash fleet_hash_;
+  std::vector<CollisionPair> fleet_contacts_;
+  double fleet_collision_time_ = 0;
+  // Drives the main robot along path_ while following_, a control tick every control_period_ of
+  // sim time
+  TrackingPath path_;
+  bool following_ = false;
+  TrackingController controller_ = TrackingController::kPurePursuit;
+  PurePursuit pure_pursuit_;
+  Mppi mppi_;
+  double control_period_ = 0.05;
+  double control_elapsed_ = 0;
+  double tracking_error_ = 0;
+  double control_time_ = 0;
+  // Keeps MPPI's rollouts off the map, rebuilt when grid_ has changed
+  DistanceField field_;
+  // Optional, set before Start. Its distance field is rebuilt from here when the map changes, the
+  // sim thread being the only one writing the map
+  PlannerService *planner_ = nullptr;
+  // Spreads the particle filter over the cores
+  ThreadPool pool_;
+  // Drawing every particle is pointless, every n-th one is copied out so at most this many
+  size_t max_snapshot_particles_ = 20000;
+  bool running_ = false;
+  double time_scale_ = 1;
+  double real_time_factor_ = 0;
+  double steps_per_second_ = 0;
+  TrajectoryRecorder *recorder_ = nullptr;
+  double telemetry_time_ = 0;
+
+  // Written by the sim thread, read by the telemetry plots on the render thread
+  TelemetryRing telemetry_;
+  SpscQueue<SimCommand> commands_;
+  // Paths of queued kFollowPath commands. The render thread fills slot paths_pushed_ % size, the sim
+  // thread hands it back by bumping paths_applied_ once it has copied the path out. Reassigning a
+  // slot reuses its memory
+  std::vector<std::vector<Pose2D>> path_slots_;
+  size_t paths_pushed_ = 0;
+  std::atomic<size_t> paths_applied_{0};
+  TripleBuffer<SimSnapshot> snapshots_;
+  std::atomic<bool> quit_{false};
+  std::thread thread_;
+
+  // Sim thread internals
+  void Run();
+  void Step();
+  void RecordTelemetry(double step_time);
+  void Scan();
+  void Control();
+  void ApplyCommand(const SimCommand &command);
+  void Publish(const Pose2D &previous_pose,
+               const FleetState &previous_fleet);
+};
+
+/**
+ * \return seconds on the steady clock, what SimSnapshot::publish_time_ is measured in
+ */
+double SteadyClockSeconds();
+
+/**
+ * The main robot pose between the 2 states in the snapshot, for rendering at time now.
+ * We render one step behind the sim so there is always a state on either side to interpolate.
+ * \param now SteadyClockSeconds() when the frame is drawn
+ */
+Pose2D InterpolateSnapshot(const SimSnapshot &snapshot,
+                           double now);
+
+/**
+ * \return interpolation factor [0, 1] between previous_* and the current state of the snapshot
+ */
+double SnapshotAlpha(const SimSnapshot &snapshot,
+                     double now);
+
+#endif
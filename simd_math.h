@@ -0,0 +1,77 @@
+#ifndef SEPT2023__SIMD_MATH_H_
+#define SEPT2023__SIMD_MATH_H_
+
+/**
+ * Constants for the vectorized math functions (we can't call libm per SIMD lane).
+ * The polynomials are the Cephes double precision minimax fits, valid for |r| <= pi/4
+ * after range reduction, highest order coefficient first.
+ */
+
+// Adding and subtracting this rounds a double to the nearest integer (for |x| < 2^51),
+// and the low bits of the sum hold that integer in two's complement
+constexpr double kRoundMagic = 6755399441055744.0;  // 1.5 * 2^52
+
+constexpr double kTwoOverPi = 0.63661977236758134308;
+// pi/2 split into 3 parts so x - k * pi/2 can be done without losing precision
+constexpr double kPiOver2Hi  = 1.57079625129699707031e+00;
+constexpr double kPiOver2Mid = 7.54978941586159635335e-08;
+constexpr double kPiOver2Lo  = 5.39030285815811905290e-15;
+
+// sin(r) = r + r * z * P(z), z = r * r
+constexpr double kSinCoefficients[6] = {
+    1.58962301576546568060e-10,
+    -2.50507477628578072866e-8,
+    2.75573136213857245213e-6,
+    -1.98412698295895385996e-4,
+    8.33333333332211858878e-3,
+    -1.66666666666666307295e-1
+};
+
+// cos(r) = 1 - z / 2 + z * z * Q(z), z = r * r
+constexpr double kCosCoefficients[6] = {
+    -1.13585365213876817300e-11,
+    2.08757008419747316778e-9,
+    -2.75573141792967388112e-7,
+    2.48015872888517045348e-5,
+    -1.38888888888730564116e-3,
+    4.16666666666665929218e-2
+};
+
+constexpr double kLog2e = 1.44269504088896340736;
+// ln(2) split in 2 so x - n * ln(2) stays exact
+constexpr double kLn2Hi = 6.93145751953125e-1;
+constexpr double kLn2Lo = 1.42860682030941723212e-6;
+// Below this exp underflows to a denormal, vector exp clamps to it
+constexpr double kExpMin = -708.0;
+
+// exp(r) = 1 + r + r^2 * E(r) for |r| <= ln(2) / 2, Taylor series (1/k!), error below 1e-15
+constexpr double kExpCoefficients[10] = {
+    2.50521083854417187751e-8,
+    2.75573192239858906526e-7,
+    2.75573192239858906526e-6,
+    2.48015873015873015873e-5,
+    1.98412698412698412698e-4,
+    1.38888888888888888889e-3,
+    8.33333333333333333333e-3,
+    4.16666666666666666667e-2,
+    1.66666666666666666667e-1,
+    5.00000000000000000000e-1
+};
+
+constexpr double kSqrt2 = 1.41421356237309504880;
+// log(m) = 2 * s * L(s^2), s = (m - 1) / (m + 1), the atanh series (1 / (2k + 1)). For m in
+// [sqrt(1/2), sqrt(2)] |s| <= 0.172 and the error is below 1e-16
+constexpr double kLogCoefficients[10] = {
+    1.0 / 19,
+    1.0 / 17,
+    1.0 / 15,
+    1.0 / 13,
+    1.0 / 11,
+    1.0 / 9,
+    1.0 / 7,
+    1.0 / 5,
+    1.0 / 3,
+    1.0
+};
+
+#endif
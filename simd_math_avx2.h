@@ -0,0 +1,104 @@
+#ifndef SEPT2023__SIMD_MATH_AVX2_H_
+#define SEPT2023__SIMD_MATH_AVX2_H_
+
+#include <immintrin.h>
+#include "simd_math.h"
+
+/* Only include from translation units compiled with -mavx2, see fleet_step_avx2.cpp */
+
+/**
+ * Horner evaluation of a polynomial with count coefficients, highest order first
+ */
+template <int count>
+static inline __m256d Polynomial(__m256d z,
+                                 const double (&coefficients)[count]) {
+  __m256d result = _mm256_set1_pd(coefficients[0]);
+  for (int i = 1; i < count; ++i) {
+    result = _mm256_add_pd(_mm256_mul_pd(result, z), _mm256_set1_pd(coefficients[i]));
+  }
+  return result;
+}
+
+/**
+ * sin/cos of 4 angles at once. Reduces x to r in [-pi/4, pi/4] with x = r + k * pi/2,
+ * evaluates both polynomials on r and then swaps/negates them depending on the quadrant k
+ */
+static inline void SinCos(__m256d x,
+                          __m256d &sin_out,
+                          __m256d &cos_out) {
+  const __m256d magic = _mm256_set1_pd(kRoundMagic);
+  __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(kTwoOverPi)), magic);
+  __m256d k = _mm256_sub_pd(t, magic);
+  __m256i quadrant = _mm256_castpd_si256(t);
+
+  __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(kPiOver2Hi)));
+  r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(kPiOver2Mid)));
+  r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(kPiOver2Lo)));
+  __m256d z = _mm256_mul_pd(r, r);
+
+  __m256d s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), Polynomial(z, kSinCoefficients)));
+  __m256d c = _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(z, _mm256_set1_pd(0.5)));
+  c = _mm256_add_pd(c, _mm256_mul_pd(_mm256_mul_pd(z, z), Polynomial(z, kCosCoefficients)));
+
+  // Odd quadrants swap sin and cos
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i two = _mm256_set1_epi64x(2);
+  __m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one), one));
+  __m256d sin_value = _mm256_blendv_pd(s, c, swap);
+  __m256d cos_value = _mm256_blendv_pd(c, s, swap);
+
+  // sin is negative in quadrants 2/3, cos in quadrants 1/2. Shift that bit into the sign bit
+  __m256i sin_sign = _mm256_slli_epi64(_mm256_and_si256(quadrant, two), 62);
+  __m256i cos_sign = _mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(quadrant, one), two), 62);
+  sin_out = _mm256_xor_pd(sin_value, _mm256_castsi256_pd(sin_sign));
+  cos_out = _mm256_xor_pd(cos_value, _mm256_castsi256_pd(cos_sign));
+}
+
+/**
+ * exp of 4 values at once. x = n * ln(2) + r with |r| <= ln(2) / 2, exp(r) from the series and
+ * 2^n built straight into the exponent bits. Inputs below kExpMin are clamped (result ~1e-308),
+ * meant for likelihoods where x <= 0
+ */
+static inline __m256d Exp(__m256d x) {
+  const __m256d magic = _mm256_set1_pd(kRoundMagic);
+  x = _mm256_max_pd(x, _mm256_set1_pd(kExpMin));
+  __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(kLog2e)), magic);
+  __m256d n = _mm256_sub_pd(t, magic);
+  __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(kLn2Hi)));
+  r = _mm256_sub_pd(r, _mm256_mul_pd(n, _mm256_set1_pd(kLn2Lo)));
+
+  __m256d result = _mm256_mul_pd(_mm256_mul_pd(r, r), Polynomial(r, kExpCoefficients));
+  result = _mm256_add_pd(_mm256_add_pd(result, r), _mm256_set1_pd(1.0));
+
+  // The low bits of t hold n, shift n + 1023 into the exponent field to get 2^n
+  __m256i integer = _mm256_sub_epi64(_mm256_castpd_si256(t), _mm256_castpd_si256(magic));
+  __m256i exponent = _mm256_slli_epi64(_mm256_add_epi64(integer, _mm256_set1_epi64x(1023)), 52);
+  return _mm256_mul_pd(result, _mm256_castsi256_pd(exponent));
+}
+
+/**
+ * Natural log of 4 positive, finite, normal values at once. Splits x = 2^e * m with m in
+ * [sqrt(1/2), sqrt(2)], log(x) = e * ln(2) + log(m) with log(m) from the series
+ */
+static inline __m256d Log(__m256d x) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d magic = _mm256_set1_pd(kRoundMagic);
+  const __m256i mantissa_mask = _mm256_set1_epi64x(0x000fffffffffffffLL);
+  __m256i bits = _mm256_castpd_si256(x);
+  __m256i exponent = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(1023));
+  // Mantissa with the exponent of 1.0, in [1, 2)
+  __m256d m = _mm256_or_pd(_mm256_castsi256_pd(_mm256_and_si256(bits, mantissa_mask)), one);
+  __m256d large = _mm256_cmp_pd(m, _mm256_set1_pd(kSqrt2), _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), large);
+  // large is all ones (-1) where m was halved, subtracting it adds 1 to the exponent
+  exponent = _mm256_sub_epi64(exponent, _mm256_castpd_si256(large));
+  // Small integer to double through the round magic, see kRoundMagic
+  __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(exponent, _mm256_castpd_si256(magic))), magic);
+
+  __m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+  __m256d log_m = _mm256_mul_pd(_mm256_add_pd(s, s), Polynomial(_mm256_mul_pd(s, s), kLogCoefficients));
+  return _mm256_add_pd(log_m, _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(kLn2Hi)),
+                                            _mm256_mul_pd(e, _mm256_set1_pd(kLn2Lo))));
+}
+
+#endif
@@ -0,0 +1,33 @@
+#include "simulator.h"
+#include "occupancy_grid.h"
+
+void Simulator::SetCommand(double linear_velocity,
+                           double angular_velocity) {
+  linear_velocity_ = linear_velocity;
+  angular_velocity_ = angular_velocity;
+}
+
+void Simulator::Reset() {
+  pose_ = Pose2D();
+  linear_velocity_ = 0;
+  angular_velocity_ = 0;
+  time_ = 0;
+  step_count_ = 0;
+  colliding_ = false;
+  collisions_ = 0;
+}
+
+void Simulator::Step(double dt) {
+  Pose2D next = pose_;
+  StepUnicycle(next, linear_velocity_, angular_velocity_, dt);
+  next.theta = WrapAngle(next.theta);
+  colliding_ = grid_ != nullptr && grid_->CollidesRectangle(next, length_, width_);
+  if (colliding_) {
+    collisions_++;
+  }
+  else {
+    pose_ = next;
+  }
+  time_ += dt;
+  step_count_++;
+}
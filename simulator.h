@@ -0,0 +1,49 @@
+#ifndef SEPT2023__SIMULATOR_H_
+#define SEPT2023__SIMULATOR_H_
+
+#include <cstdint>
+#include "unicycle.h"
+
+struct OccupancyGrid;
+
+/**
+ * The simulation state for a single robot, with no dependency on OpenGL/GLFW/ImGui so it
+ * can be stepped from the viewer or from a headless program as fast as the CPU allows.
+ */
+struct Simulator {
+  Pose2D pose_;
+  // Commanded velocities, m/s and rad/s
+  double linear_velocity_ = 0;
+  double angular_velocity_ = 0;
+  // Simulation clock in seconds, only advanced by Step()
+  double time_ = 0;
+  uint64_t step_count_ = 0;
+  // Optional map, a step that would put the footprint (length_ along the heading, width_ across)
+  // into an occupied cell is rejected and the robot stays where it was
+  const OccupancyGrid *grid_ = nullptr;
+  double length_ = 1;
+  double width_ = 0.5;
+  // Whether the last step was rejected, and how many have been since the last Reset
+  bool colliding_ = false;
+  uint64_t collisions_ = 0;
+
+  /**
+   * \param linear_velocity m/s
+   * \param angular_velocity rad/s (positive is clockwise)
+   */
+  void SetCommand(double linear_velocity,
+                  double angular_velocity);
+
+  /**
+   * Put the robot back at the origin with zero velocity, the clock is also reset
+   */
+  void Reset();
+
+  /**
+   * Integrate the robot forward by dt seconds with the current command, unless that collides with
+   * the grid. Theta is kept between [0, 2pi)
+   */
+  void Step(double dt);
+};
+
+#endif
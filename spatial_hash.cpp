@@ -0,0 +1,226 @@
+#include "spatial_hash.h"
+#include <algorithm>
+#include <cmath>
+#include "fleet_step.h"
+#include "spatial_hash_kernels.h"
+
+// Separating axis test with both boxes given by their centre and unit heading
+static bool BoxesOverlap(double ax,
+                         double ay,
+                         double a_forward_x,
+                         double a_forward_y,
+                         double bx,
+                         double by,
+                         double b_forward_x,
+                         double b_forward_y,
+                         double half_length,
+                         double half_width) {
+  const double dx = bx - ax;
+  const double dy = by - ay;
+  // Right is the forward direction turned clockwise, (forward_y, -forward_x). Between the two
+  // boxes only the cosine and sine of the relative heading matter
+  const double cos_relative = a_forward_x * b_forward_x + a_forward_y * b_forward_y;
+  const double sin_relative = std::abs(a_forward_x * b_forward_y - a_forward_y * b_forward_x);
+  const double abs_cos = std::abs(cos_relative);
+  // Extent of one box along an axis of the other, along their forward and right axes
+  const double extent_forward = half_length + half_length * abs_cos + half_width * sin_relative;
+  const double extent_right = half_width + half_length * sin_relative + half_width * abs_cos;
+  if (std::abs(dx * a_forward_x + dy * a_forward_y) > extent_forward ||
+      std::abs(dx * a_forward_y - dy * a_forward_x) > extent_right ||
+      std::abs(dx * b_forward_x + dy * b_forward_y) > extent_forward ||
+      std::abs(dx * b_forward_y - dy * b_forward_x) > extent_right) {
+    return false;
+  }
+  return true;
+}
+
+bool BoxesOverlap(const Pose2D &a,
+                  const Pose2D &b,
+                  double length,
+                  double width) {
+  return BoxesOverlap(a.x, a.y, std::sin(a.theta), std::cos(a.theta),
+                      b.x, b.y, std::sin(b.theta), std::cos(b.theta),
+                      0.5 * length, 0.5 * width);
+}
+
+void GatherEntriesScalar(const SpatialHashGatherSpan &span,
+                         size_t begin,
+                         size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    const uint32_t robot = span.robots[i];
+    span.entry_x[i] = span.x[robot];
+    span.entry_y[i] = span.y[robot];
+    span.forward_x[i] = std::sin(span.theta[robot]);
+    span.forward_y[i] = std::cos(span.theta[robot]);
+  }
+}
+
+void SpatialHash::Build(const FleetState &fleet,
+                        ThreadPool *pool) {
+  const size_t count = fleet.Size();
+  uint32_t columns = 8;
+  uint32_t rows = 8;
+  while ((size_t)columns * rows < 2 * count) {
+    if (rows < columns) {
+      rows *= 2;
+    }
+    else {
+      columns *= 2;
+    }
+  }
+  // Same robots and no robot changed cell, the sorted order is still right
+  bool sorted = columns == bucket_columns_ && rows == bucket_rows_ && count == robots_.size();
+  robot_cell_x_.resize(count);
+  robot_cell_y_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    const int32_t cell_x = CellOf(fleet.x_[i]);
+    const int32_t cell_y = CellOf(fleet.y_[i]);
+    sorted = sorted && cell_x == robot_cell_x_[i] && cell_y == robot_cell_y_[i];
+    robot_cell_x_[i] = cell_x;
+    robot_cell_y_[i] = cell_y;
+  }
+
+  if (!sorted) {
+    sorts_++;
+    bucket_columns_ = columns;
+    bucket_rows_ = rows;
+    bucket_count_ = (size_t)columns * rows;
+    robots_.resize(count);
+    cell_x_.resize(count);
+    cell_y_.resize(count);
+    // Counting sort: count per bucket, prefix sum into starts, then place each robot.
+    // Placing walks the robots backwards filling each bucket from its end, so a bucket holds its
+    // robots in index order
+    bucket_starts_.assign(bucket_count_ + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+      bucket_starts_[BucketOf(robot_cell_x_[i], robot_cell_y_[i]) + 1]++;
+    }
+    for (size_t bucket = 0; bucket < bucket_count_; ++bucket) {
+      bucket_starts_[bucket + 1] += bucket_starts_[bucket];
+    }
+    // Each bucket's end, counted down while placing and back at its start afterwards
+    std::vector<uint32_t> &ends = bucket_ends_;
+    ends.assign(bucket_starts_.begin() + 1, bucket_starts_.end());
+    for (size_t i = count; i-- > 0;) {
+      const uint32_t entry = --ends[BucketOf(robot_cell_x_[i], robot_cell_y_[i])];
+      robots_[entry] = (uint32_t)i;
+      cell_x_[entry] = robot_cell_x_[i];
+      cell_y_[entry] = robot_cell_y_[i];
+    }
+  }
+  else {
+    refreshes_++;
+  }
+
+  x_.resize(count);
+  y_.resize(count);
+  forward_x_.resize(count);
+  forward_y_.resize(count);
+  SpatialHashGatherSpan span;
+  span.x = fleet.x_.data();
+  span.y = fleet.y_.data();
+  span.theta = fleet.theta_.data();
+  span.robots = robots_.data();
+  span.entry_x = x_.data();
+  span.entry_y = y_.data();
+  span.forward_x = forward_x_.data();
+  span.forward_y = forward_y_.data();
+  auto gather = [&span](size_t begin, size_t end) {
+#if defined(SEPT2023_X86_KERNELS)
+    if (BestFleetKernel() == FleetKernel::kAvx2) {
+      GatherEntriesAvx2(span, begin, end);
+      return;
+    }
+#endif
+    GatherEntriesScalar(span, begin, end);
+  };
+  if (pool != nullptr) {
+    pool->ParallelFor(count, kSpatialHashChunk, gather);
+  }
+  else {
+    gather(0, count);
+  }
+}
+
+void SpatialHash::QueryRadius(double x,
+                              double y,
+                              double radius,
+                              std::vector<uint32_t> &robots) const {
+  robots.clear();
+  ForEachNeighbor(x, y, radius, [&robots](uint32_t robot, double) {
+    robots.push_back(robot);
+  });
+}
+
+void SpatialHash::FindCollisions(double length,
+                                 double width,
+                                 std::vector<CollisionPair> &pairs,
+                                 ThreadPool *pool) {
+  pairs.clear();
+  const size_t count = robots_.size();
+  const size_t chunks = (count + kSpatialHashChunk - 1) / kSpatialHashChunk;
+  if (chunk_pairs_.size() < chunks) {
+    chunk_pairs_.resize(chunks);
+  }
+  const double half_length = 0.5 * length;
+  const double half_width = 0.5 * width;
+  // Centres further apart than the diagonal can't overlap, so only cells within that are looked at
+  const double reach_squared = length * length + width * width;
+  const int32_t ring = std::max(1, (int32_t)std::ceil(std::sqrt(reach_squared) / cell_size_));
+  auto find = [&](size_t begin, size_t end) {
+    std::vector<CollisionPair> &found = chunk_pairs_[begin / kSpatialHashChunk];
+    found.clear();
+    for (size_t entry = begin; entry < end; ++entry) {
+      const uint32_t robot = robots_[entry];
+      const double x = x_[entry];
+      const double y = y_[entry];
+      ForEachInCells(cell_x_[entry] - ring, cell_y_[entry] - ring, cell_x_[entry] + ring, cell_y_[entry] + ring,
+                     [&](uint32_t other) {
+                       // Each pair once, from its lower robot index
+                       if (robots_[other] <= robot) {
+                         return;
+                       }
+                       const double dx = x_[other] - x;
+                       const double dy = y_[other] - y;
+                       if (dx * dx + dy * dy > reach_squared) {
+                         return;
+                       }
+                       if (BoxesOverlap(x, y, forward_x_[entry], forward_y_[entry],
+                                        x_[other], y_[other], forward_x_[other], forward_y_[other],
+                                        half_length, half_width)) {
+                         found.push_back({robot, robots_[other]});
+                       }
+                     });
+    }
+  };
+  if (pool != nullptr) {
+    // With the grain equal to the chunk size the pool's chunks are exactly ours
+    pool->ParallelFor(count, kSpatialHashChunk, find);
+  }
+  else {
+    for (size_t begin = 0; begin < count; begin += kSpatialHashChunk) {
+      find(begin, std::min(count, begin + kSpatialHashChunk));
+    }
+  }
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    pairs.insert(pairs.end(), chunk_pairs_[chunk].begin(), chunk_pairs_[chunk].end());
+  }
+}
+
+void FindCollisionsBruteForce(const FleetState &fleet,
+                              double length,
+                              double width,
+                              std::vector<CollisionPair> &pairs) {
+  pairs.clear();
+  const double reach_squared = length * length + width * width;
+  for (size_t a = 0; a < fleet.Size(); ++a) {
+    const Pose2D pose_a = fleet.GetPose(a);
+    for (size_t b = a + 1; b < fleet.Size(); ++b) {
+      const double dx = fleet.x_[b] - pose_a.x;
+      const double dy = fleet.y_[b] - pose_a.y;
+      if (dx * dx + dy * dy <= reach_squared && BoxesOverlap(pose_a, fleet.GetPose(b), length, width)) {
+        pairs.push_back({(uint32_t)a, (uint32_t)b});
+      }
+    }
+  }
+}
@@ -0,0 +1,186 @@
+#ifndef SEPT2023__SPATIAL_HASH_H_
+#define SEPT2023__SPATIAL_HASH_H_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "fleet_state.h"
+#include "thread_pool.h"
+
+/**
+ * Two fleet robots whose footprints overlap, robot_a_ < robot_b_
+ */
+struct CollisionPair {
+  uint32_t robot_a_;
+  uint32_t robot_b_;
+};
+
+/**
+ * Do 2 length x width rectangles at the given poses overlap. Separating axis test on the 4 edge
+ * normals, touching counts as overlapping.
+ */
+bool BoxesOverlap(const Pose2D &a,
+                  const Pose2D &b,
+                  double length,
+                  double width);
+
+/**
+ * Uniform grid over the plane, wrapped onto a fixed number of buckets so the world needs no bounds.
+ * Robots are counting sorted by bucket into flat arrays: bucket b holds sorted entries
+ * [bucket_starts_[b], bucket_starts_[b + 1]), and the positions are copied into the same order so
+ * a query reads contiguous memory. Nothing is allocated once the arrays have grown to the fleet.
+ *
+ * Different cells can share a bucket, every entry keeps its cell so lookups skip the strangers.
+ */
+struct SpatialHash {
+  // Robots are checked for collisions in chunks of this many sorted entries, one chunk per pool task
+  static constexpr size_t kSpatialHashChunk = 4096;
+
+  // Side of a cell, m. FindCollisions is quickest with it just over the diagonal of the footprint
+  double cell_size_ = 1.2;
+  // Cells wrap around a bucket_columns_ x bucket_rows_ grid of buckets, powers of 2 picked by
+  // Build for at least twice as many buckets as robots
+  uint32_t bucket_columns_ = 0;
+  uint32_t bucket_rows_ = 0;
+  size_t bucket_count_ = 0;
+
+  // Per robot (by fleet index), the cell it was in at the last Build
+  std::vector<int32_t> robot_cell_x_;
+  std::vector<int32_t> robot_cell_y_;
+
+  // Per bucket, where its sorted entries start (bucket_count_ + 1 of them)
+  std::vector<uint32_t> bucket_starts_;
+  // Scratch for the sort
+  std::vector<uint32_t> bucket_ends_;
+  // Per sorted entry
+  std::vector<uint32_t> robots_;
+  std::vector<int32_t> cell_x_;
+  std::vector<int32_t> cell_y_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+  // Unit heading, (sin, cos) of theta
+  std::vector<double> forward_x_;
+  std::vector<double> forward_y_;
+
+  // Pairs found by each chunk, kept between calls for their capacity
+  std::vector<std::vector<CollisionPair>> chunk_pairs_;
+
+  // Builds that had to sort, and ones where no robot changed cell so only positions were refreshed
+  uint64_t sorts_ = 0;
+  uint64_t refreshes_ = 0;
+
+  /**
+   * Put every robot of the fleet in its cell. If no robot changed cell since the last Build the
+   * order is kept and only the positions are copied, otherwise it is counting sorted again
+   * \param pool spreads copying the positions over its workers, may be null. The sort itself is
+   *             one pass on the calling thread
+   */
+  void Build(const FleetState &fleet,
+             ThreadPool *pool);
+
+  size_t Size() const {
+    return robots_.size();
+  }
+
+  int32_t CellOf(double position) const {
+    return (int32_t)std::floor(position / cell_size_);
+  }
+
+  /**
+   * Wrapping rather than scrambling the cell keeps neighbouring cells in neighbouring buckets, so
+   * looking at the cells around a robot stays in cache
+   */
+  size_t BucketOf(int32_t cell_x,
+                  int32_t cell_y) const {
+    return (size_t)((uint32_t)cell_y & (bucket_rows_ - 1)) * bucket_columns_ + ((uint32_t)cell_x & (bucket_columns_ - 1));
+  }
+
+  /**
+   * Call visit(entry) for each sorted entry whose cell is within [min, max] cells in both axes
+   */
+  template<typename Visit>
+  void ForEachInCells(int32_t min_cell_x,
+                      int32_t min_cell_y,
+                      int32_t max_cell_x,
+                      int32_t max_cell_y,
+                      Visit &&visit) const {
+    for (int32_t cell_y = min_cell_y; cell_y <= max_cell_y; ++cell_y) {
+      const size_t first = BucketOf(min_cell_x, cell_y);
+      const size_t last = BucketOf(max_cell_x, cell_y);
+      if (first <= last && (uint32_t)(max_cell_x - min_cell_x) < bucket_columns_) {
+        // The row of cells is a run of buckets, so its entries are one run too
+        for (uint32_t entry = bucket_starts_[first]; entry < bucket_starts_[last + 1]; ++entry) {
+          if (cell_y_[entry] == cell_y && cell_x_[entry] >= min_cell_x && cell_x_[entry] <= max_cell_x) {
+            visit(entry);
+          }
+        }
+        continue;
+      }
+      // Wraps around the buckets, or wider than them
+      for (int32_t cell_x = min_cell_x; cell_x <= max_cell_x; ++cell_x) {
+        const size_t bucket = BucketOf(cell_x, cell_y);
+        for (uint32_t entry = bucket_starts_[bucket]; entry < bucket_starts_[bucket + 1]; ++entry) {
+          if (cell_x_[entry] == cell_x && cell_y_[entry] == cell_y) {
+            visit(entry);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Call visit(robot, distance_squared) for every robot whose centre is within radius of (x, y).
+   * Looks at every cell the radius overlaps, so meant for radii of a few cells
+   */
+  template<typename Visit>
+  void ForEachNeighbor(double x,
+                       double y,
+                       double radius,
+                       Visit &&visit) const {
+    if (robots_.empty()) {
+      return;
+    }
+    const double radius_squared = radius * radius;
+    ForEachInCells(CellOf(x - radius), CellOf(y - radius), CellOf(x + radius), CellOf(y + radius),
+                   [&](uint32_t entry) {
+                     const double dx = x_[entry] - x;
+                     const double dy = y_[entry] - y;
+                     const double distance_squared = dx * dx + dy * dy;
+                     if (distance_squared <= radius_squared) {
+                       visit(robots_[entry], distance_squared);
+                     }
+                   });
+  }
+
+  /**
+   * Robots whose centre is within radius of (x, y) into robots (cleared first)
+   */
+  void QueryRadius(double x,
+                   double y,
+                   double radius,
+                   std::vector<uint32_t> &robots) const;
+
+  /**
+   * Every pair of overlapping length x width footprints, from the last Build. Only robots in cells
+   * within a footprint diagonal are tested, and only if their centres are that close.
+   * The pairs come out in the same order whatever the pool size.
+   * \param pairs cleared first
+   * \param pool spreads the chunks over its workers, may be null
+   */
+  void FindCollisions(double length,
+                      double width,
+                      std::vector<CollisionPair> &pairs,
+                      ThreadPool *pool);
+};
+
+/**
+ * Reference for FindCollisions, tests every pair of robots. Pairs are ordered by robot_a_ then
+ * robot_b_
+ */
+void FindCollisionsBruteForce(const FleetState &fleet,
+                              double length,
+                              double width,
+                              std::vector<CollisionPair> &pairs);
+
+#endif
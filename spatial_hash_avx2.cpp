@@ -0,0 +1,36 @@
+#include <immintrin.h>
+#include <cmath>
+#include "spatial_hash_kernels.h"
+#include "simd_math_avx2.h"
+
+/* This file is compiled with -mavx2, nothing in here may run unless the CPU supports it */
+
+static inline __m256d Gather(const double *base,
+                             __m128i indices) {
+  // The masked form with an explicit source, the plain one trips maybe-uninitialized warnings
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, indices, all, 8);
+}
+
+void GatherEntriesAvx2(const SpatialHashGatherSpan &span,
+                       size_t begin,
+                       size_t end) {
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    const __m128i robots = _mm_loadu_si128((const __m128i *)(span.robots + i));
+    const __m256d theta = Gather(span.theta, robots);
+    _mm256_storeu_pd(span.entry_x + i, Gather(span.x, robots));
+    _mm256_storeu_pd(span.entry_y + i, Gather(span.y, robots));
+    __m256d sin_theta, cos_theta;
+    SinCos(theta, sin_theta, cos_theta);
+    _mm256_storeu_pd(span.forward_x + i, sin_theta);
+    _mm256_storeu_pd(span.forward_y + i, cos_theta);
+  }
+  for (; i < end; ++i) {
+    const uint32_t robot = span.robots[i];
+    span.entry_x[i] = span.x[robot];
+    span.entry_y[i] = span.y[robot];
+    span.forward_x[i] = std::sin(span.theta[robot]);
+    span.forward_y[i] = std::cos(span.theta[robot]);
+  }
+}
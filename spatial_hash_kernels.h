@@ -0,0 +1,37 @@
+#ifndef SEPT2023__SPATIAL_HASH_KERNELS_H_
+#define SEPT2023__SPATIAL_HASH_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Internal to the spatial hash, shared between spatial_hash.cpp and the SIMD translation units
+ * which are compiled with different instruction set flags.
+ */
+
+/**
+ * Copy each sorted entry's pose out of the fleet (indexed by robot), as the heading's sin and cos
+ */
+struct SpatialHashGatherSpan {
+  // Fleet, indexed by robot
+  const double *x;
+  const double *y;
+  const double *theta;
+  // Sorted entries
+  const uint32_t *robots;
+  double *entry_x;
+  double *entry_y;
+  double *forward_x;
+  double *forward_y;
+};
+
+void GatherEntriesScalar(const SpatialHashGatherSpan &span,
+                         size_t begin,
+                         size_t end);
+
+// Only built on x86, and must only be called if the CPU supports the instruction set
+void GatherEntriesAvx2(const SpatialHashGatherSpan &span,
+                       size_t begin,
+                       size_t end);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SEPT2023__SPSC_QUEUE_H_
+#define SEPT2023__SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Lock free, fixed capacity queue for exactly one producer thread and one consumer thread.
+ * Neither side ever blocks, TryPush fails when full and TryPop fails when empty.
+ * The storage is allocated once in the constructor, pushing/popping only copies T, so never
+ * allocates as long as copying T doesn't (keep heap allocated payloads out of T, e.g. SimThread::PushPath).
+ */
+template <typename T>
+struct SpscQueue {
+  /**
+   * \param capacity rounded up to a power of 2
+   */
+  explicit SpscQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    items_.resize(size);
+    mask_ = size - 1;
+  }
+
+  /**
+   * Producer only
+   * \return false if the queue is full, item is not added
+   */
+  bool TryPush(const T &item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    items_[tail & mask_] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer only
+   * \return false if the queue is empty
+   */
+  bool TryPop(T &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Approximate when called while the other thread is pushing/popping
+   */
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+  }
+
+  size_t Capacity() const {
+    return mask_ + 1;
+  }
+
+  std::vector<T> items_;
+  size_t mask_ = 0;
+  // Head and tail on their own cache lines so the two threads don't fight over them
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif
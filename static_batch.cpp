@@ -0,0 +1,354 @@
+#include "static_batch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+static uint64_t ChunkKey(uint32_t material,
+                         int32_t cell_x,
+                         int32_t cell_y) {
+  // 16 bits of material and 24 bits of each cell, a 16 m cell covers +-134000 km
+  return ((uint64_t)material << 48) | ((uint64_t)((uint32_t)cell_x & 0xFFFFFF) << 24) |
+      (uint64_t)((uint32_t)cell_y & 0xFFFFFF);
+}
+
+static uint8_t ColorByte(float value) {
+  return (uint8_t)std::lround(std::min(1.0f, std::max(0.0f, value)) * 255);
+}
+
+/**
+ * 4 corners at z = 0 going around the outside, as 2 triangles or 4 lines
+ */
+static void AddQuad(StaticBatch &batch,
+                    uint32_t material,
+                    const float corners[4][2],
+                    const glm::vec4 &color) {
+  StaticVertex vertices[4];
+  for (int i = 0; i < 4; ++i) {
+    vertices[i].position[0] = corners[i][0];
+    vertices[i].position[1] = corners[i][1];
+    vertices[i].position[2] = 0;
+    for (int channel = 0; channel < 4; ++channel) {
+      vertices[i].color[channel] = ColorByte(color[channel]);
+    }
+  }
+  static const uint32_t kTriangles[6] = {0, 1, 2, 0, 2, 3};
+  static const uint32_t kLines[8] = {0, 1, 1, 2, 2, 3, 3, 0};
+  if (batch.materials_[material].mode_ == GL_LINES) {
+    batch.AddMesh(material, vertices, 4, kLines, 8);
+  }
+  else {
+    batch.AddMesh(material, vertices, 4, kTriangles, 6);
+  }
+}
+
+uint32_t StaticBatch::AddMaterial(Shader *shader,
+                                  uint32_t mode,
+                                  bool blend) {
+  StaticMaterial material;
+  material.shader_ = shader;
+  material.mode_ = mode;
+  material.blend_ = blend;
+  materials_.push_back(material);
+  return (uint32_t)materials_.size() - 1;
+}
+
+void StaticBatch::AddMesh(uint32_t material,
+                          const StaticVertex *vertices,
+                          size_t vertex_count,
+                          const uint32_t *indices,
+                          size_t index_count) {
+  if (vertex_count == 0 || index_count == 0 || material >= materials_.size()) {
+    return;
+  }
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  for (size_t i = 0; i < vertex_count; ++i) {
+    for (int axis = 0; axis < 3; ++axis) {
+      min[axis] = std::min(min[axis], vertices[i].position[axis]);
+      max[axis] = std::max(max[axis], vertices[i].position[axis]);
+    }
+  }
+  const int32_t cell_x = (int32_t)std::floor(0.5f * (min[0] + max[0]) / chunk_size_);
+  const int32_t cell_y = (int32_t)std::floor(0.5f * (min[1] + max[1]) / chunk_size_);
+  auto found = chunk_lookup_.emplace(ChunkKey(material, cell_x, cell_y), (uint32_t)chunks_.size());
+  if (found.second) {
+    StaticChunk chunk;
+    chunk.material_ = material;
+    chunk.cell_x_ = cell_x;
+    chunk.cell_y_ = cell_y;
+    chunk.min_ = min;
+    chunk.max_ = max;
+    chunks_.push_back(std::move(chunk));
+  }
+  // Meshes sticking out of their cell just grow its box
+  StaticChunk &chunk = chunks_[found.first->second];
+  for (int axis = 0; axis < 3; ++axis) {
+    chunk.min_[axis] = std::min(chunk.min_[axis], min[axis]);
+    chunk.max_[axis] = std::max(chunk.max_[axis], max[axis]);
+  }
+  const uint32_t base = (uint32_t)chunk.vertices_.size();
+  chunk.vertices_.insert(chunk.vertices_.end(), vertices, vertices + vertex_count);
+  for (size_t i = 0; i < index_count; ++i) {
+    chunk.indices_.push_back(base + indices[i]);
+  }
+}
+
+void StaticBatch::AddBox(uint32_t material,
+                         float x,
+                         float y,
+                         float theta,
+                         float length,
+                         float width,
+                         const glm::vec4 &color) {
+  // Heading is clockwise from +Y, forward is (sin, cos) and right is (cos, -sin)
+  const float s = std::sin(theta);
+  const float c = std::cos(theta);
+  const float forward_x = 0.5f * length * s;
+  const float forward_y = 0.5f * length * c;
+  const float right_x = 0.5f * width * c;
+  const float right_y = -0.5f * width * s;
+  const float corners[4][2] = {
+      {x + forward_x + right_x, y + forward_y + right_y},
+      {x - forward_x + right_x, y - forward_y + right_y},
+      {x - forward_x - right_x, y - forward_y - right_y},
+      {x + forward_x - right_x, y + forward_y - right_y}};
+  AddQuad(*this, material, corners, color);
+}
+
+void StaticBatch::AddWall(uint32_t material,
+                          float x0,
+                          float y0,
+                          float x1,
+                          float y1,
+                          float thickness,
+                          const glm::vec4 &color) {
+  const float dx = x1 - x0;
+  const float dy = y1 - y0;
+  const float length = std::sqrt(dx * dx + dy * dy);
+  if (length <= 0) {
+    return;
+  }
+  // Half the thickness to either side of the centre line
+  const float side_x = -dy / length * 0.5f * thickness;
+  const float side_y = dx / length * 0.5f * thickness;
+  const float corners[4][2] = {
+      {x0 + side_x, y0 + side_y},
+      {x1 + side_x, y1 + side_y},
+      {x1 - side_x, y1 - side_y},
+      {x0 - side_x, y0 - side_y}};
+  AddQuad(*this, material, corners, color);
+}
+
+void StaticBatch::AddMarker(uint32_t material,
+                            float x,
+                            float y,
+                            float radius,
+                            const glm::vec4 &color) {
+  const float corners[4][2] = {{x, y + radius}, {x + radius, y}, {x, y - radius}, {x - radius, y}};
+  AddQuad(*this, material, corners, color);
+}
+
+bool StaticBatch::Upload() {
+  size_t vertex_total = 0;
+  size_t index_total = 0;
+  for (const StaticChunk &chunk : chunks_) {
+    vertex_total += chunk.vertices_.size();
+    index_total += chunk.indices_.size();
+  }
+  if (vertex_total > std::numeric_limits<uint32_t>::max() || index_total > std::numeric_limits<uint32_t>::max()) {
+    printf("ERROR (StaticBatch): %zu vertices/%zu indices is too many for 32 bit indices\n", vertex_total,
+           index_total);
+    return false;
+  }
+
+  // Opaque before blended, then by program so it is switched as rarely as possible, then row by
+  // row through the cells so chunks that are on screen together tend to be next to each other in
+  // the index buffer and merge into one draw
+  auto material_before = [this](uint32_t a, uint32_t b) {
+    const StaticMaterial &x = materials_[a];
+    const StaticMaterial &y = materials_[b];
+    const uint32_t x_program = x.shader_ != nullptr ? x.shader_->id_ : 0;
+    const uint32_t y_program = y.shader_ != nullptr ? y.shader_->id_ : 0;
+    if (x.blend_ != y.blend_) {
+      return y.blend_;
+    }
+    if (x_program != y_program) {
+      return x_program < y_program;
+    }
+    if (x.mode_ != y.mode_) {
+      return x.mode_ < y.mode_;
+    }
+    return a < b;
+  };
+  std::sort(chunks_.begin(), chunks_.end(), [&](const StaticChunk &a, const StaticChunk &b) {
+    if (a.material_ != b.material_) {
+      return material_before(a.material_, b.material_);
+    }
+    if (a.cell_y_ != b.cell_y_) {
+      return a.cell_y_ < b.cell_y_;
+    }
+    return a.cell_x_ < b.cell_x_;
+  });
+  chunk_lookup_.clear();
+
+  std::vector<StaticVertex> vertices;
+  std::vector<uint32_t> indices;
+  vertices.reserve(vertex_total);
+  indices.reserve(index_total);
+  for (StaticChunk &chunk : chunks_) {
+    // One shared vertex buffer, so the chunk's indices become absolute and no draw needs a base vertex
+    const uint32_t base = (uint32_t)vertices.size();
+    chunk.first_index_ = (uint32_t)indices.size();
+    chunk.index_count_ = (uint32_t)chunk.indices_.size();
+    vertices.insert(vertices.end(), chunk.vertices_.begin(), chunk.vertices_.end());
+    for (uint32_t index : chunk.indices_) {
+      indices.push_back(base + index);
+    }
+    std::vector<StaticVertex>().swap(chunk.vertices_);
+    std::vector<uint32_t>().swap(chunk.indices_);
+  }
+  vertex_count_ = vertices.size();
+  index_count_ = indices.size();
+
+  if (vao_ == 0) {
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &ebo_);
+  }
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(StaticVertex), vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(kStaticAttributePosition, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex),
+                        (void*)offsetof(StaticVertex, position));
+  glEnableVertexAttribArray(kStaticAttributePosition);
+  glVertexAttribPointer(kStaticAttributeColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StaticVertex),
+                        (void*)offsetof(StaticVertex, color));
+  glEnableVertexAttribArray(kStaticAttributeColor);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // glad only loads the GL 4.3 entry points if the context has them
+  indirect_ = glMultiDrawElementsIndirect != nullptr;
+  if (indirect_ && indirect_buffer_ == 0) {
+    glGenBuffers(1, &indirect_buffer_);
+  }
+  uploaded_ = true;
+  return true;
+}
+
+void StaticBatch::Draw(const Frustum &frustum) {
+  visible_chunks_ = 0;
+  culled_chunks_ = 0;
+  draw_calls_ = 0;
+  drawn_indices_ = 0;
+  if (!uploaded_ || chunks_.empty()) {
+    return;
+  }
+
+  commands_.clear();
+  groups_.clear();
+  for (const StaticChunk &chunk : chunks_) {
+    if (!frustum.IntersectsBox(chunk.min_, chunk.max_)) {
+      culled_chunks_++;
+      continue;
+    }
+    visible_chunks_++;
+    drawn_indices_ += chunk.index_count_;
+    if (groups_.empty() || groups_.back().material_ != chunk.material_) {
+      groups_.push_back({chunk.material_, commands_.size(), 0});
+    }
+    StaticDrawGroup &group = groups_.back();
+    // Visible chunks next to each other in the index buffer are one draw
+    if (group.command_count_ > 0) {
+      DrawElementsIndirectCommand &last = commands_.back();
+      if (last.first_index_ + last.count_ == chunk.first_index_) {
+        last.count_ += chunk.index_count_;
+        continue;
+      }
+    }
+    commands_.push_back({chunk.index_count_, 1, chunk.first_index_, 0, 0});
+    group.command_count_++;
+  }
+  if (commands_.empty()) {
+    return;
+  }
+
+  if (indirect_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer_);
+    if (commands_.size() > indirect_capacity_) {
+      indirect_capacity_ = commands_.size() + commands_.size() / 2;
+    }
+    // Orphan then fill, same as the fleet instance buffer
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect_capacity_ * sizeof(DrawElementsIndirectCommand), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawElementsIndirectCommand),
+                    commands_.data());
+  }
+
+  glBindVertexArray(vao_);
+  const Shader *bound_shader = nullptr;
+  bool blending = false;
+  for (const StaticDrawGroup &group : groups_) {
+    const StaticMaterial &material = materials_[group.material_];
+    if (material.shader_ == nullptr) {
+      continue;
+    }
+    if (material.shader_ != bound_shader) {
+      material.shader_->Use();
+      bound_shader = material.shader_;
+    }
+    if (material.blend_ != blending) {
+      if (material.blend_) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      else {
+        glDisable(GL_BLEND);
+      }
+      blending = material.blend_;
+    }
+    if (indirect_) {
+      glMultiDrawElementsIndirect(material.mode_, GL_UNSIGNED_INT,
+                                  (void*)(group.first_command_ * sizeof(DrawElementsIndirectCommand)),
+                                  (GLsizei)group.command_count_, 0);
+      draw_calls_++;
+      continue;
+    }
+    for (size_t i = group.first_command_; i < group.first_command_ + group.command_count_; ++i) {
+      glDrawElements(material.mode_, (GLsizei)commands_[i].count_, GL_UNSIGNED_INT,
+                     (void*)(commands_[i].first_index_ * sizeof(uint32_t)));
+      draw_calls_++;
+    }
+  }
+  if (blending) {
+    glDisable(GL_BLEND);
+  }
+  glBindVertexArray(0);
+  if (indirect_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+}
+
+void StaticBatch::Clear() {
+  if (vao_ != 0) {
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ebo_);
+  }
+  if (indirect_buffer_ != 0) {
+    glDeleteBuffers(1, &indirect_buffer_);
+  }
+  vao_ = 0;
+  vbo_ = 0;
+  ebo_ = 0;
+  indirect_buffer_ = 0;
+  indirect_capacity_ = 0;
+  uploaded_ = false;
+  chunks_.clear();
+  chunk_lookup_.clear();
+  vertex_count_ = 0;
+  index_count_ = 0;
+}
@@ -0,0 +1,187 @@
+#ifndef SEPT2023__STATIC_BATCH_H_
+#define SEPT2023__STATIC_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "camera.h"
+#include "shader.h"
+
+/**
+ * Vertex of static world geometry, already in world coordinates. Matches the attributes in
+ * shaders/static_shader.vs
+ */
+struct StaticVertex {
+  float position[3];
+  // rgba, normalized to 0 - 1 by GL
+  uint8_t color[4];
+};
+
+enum StaticAttribute {
+  kStaticAttributePosition = 0,
+  kStaticAttributeColor = 1
+};
+
+/**
+ * How a piece of static geometry is drawn. Draws are sorted by material so each program and
+ * blend state is set once per frame
+ */
+struct StaticMaterial {
+  Shader *shader_ = nullptr;
+  // GL_TRIANGLES or GL_LINES
+  uint32_t mode_ = GL_TRIANGLES;
+  // Alpha blended, drawn after everything opaque
+  bool blend_ = false;
+};
+
+/**
+ * The geometry of one material inside one cell of the world, culled as a whole
+ */
+struct StaticChunk {
+  uint32_t material_ = 0;
+  int32_t cell_x_ = 0;
+  int32_t cell_y_ = 0;
+  glm::vec3 min_;
+  glm::vec3 max_;
+  // Until Upload, indices relative to this chunk's vertices
+  std::vector<StaticVertex> vertices_;
+  std::vector<uint32_t> indices_;
+  // After Upload, where the chunk is in the shared index buffer
+  uint32_t first_index_ = 0;
+  uint32_t index_count_ = 0;
+};
+
+/**
+ * Layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+ */
+struct DrawElementsIndirectCommand {
+  uint32_t count_;
+  uint32_t instance_count_;
+  uint32_t first_index_;
+  int32_t base_vertex_;
+  uint32_t base_instance_;
+};
+
+/**
+ * Consecutive commands of one material, one multi draw
+ */
+struct StaticDrawGroup {
+  uint32_t material_;
+  size_t first_command_;
+  size_t command_count_;
+};
+
+/**
+ * Static world geometry (walls, obstacles, waypoints, ...) merged into one vertex and one index
+ * buffer, instead of a VAO and a draw call per object like Robot.
+ *
+ * Geometry is added on the CPU, grouped by material and by chunk_size_ square cell of the world,
+ * then Upload sorts the chunks by material and cell and copies everything into GL_STATIC_DRAW
+ * buffers once. Every frame Draw culls the chunks against the camera frustum and draws the
+ * visible ones, with a glMultiDrawElementsIndirect per material on GL 4.3, or a glDrawElements per
+ * run of neighbouring visible chunks on GL 3.3. Off screen chunks cost a box test and nothing else.
+ */
+struct StaticBatch {
+  // Side of the cells geometry is grouped into for culling, m. Smaller culls tighter but draws in
+  // more pieces
+  float chunk_size_ = 16;
+
+  std::vector<StaticMaterial> materials_;
+  // Sorted by material then cell after Upload
+  std::vector<StaticChunk> chunks_;
+  // (material, cell) -> index into chunks_, while adding
+  std::unordered_map<uint64_t, uint32_t> chunk_lookup_;
+
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  uint32_t ebo_ = 0;
+  uint32_t indirect_buffer_ = 0;
+  // Number of DrawElementsIndirectCommand the indirect buffer can hold before it needs to grow
+  size_t indirect_capacity_ = 0;
+  bool uploaded_ = false;
+  // glMultiDrawElementsIndirect is there (GL 4.3), picked at Upload
+  bool indirect_ = false;
+  size_t vertex_count_ = 0;
+  size_t index_count_ = 0;
+
+  // This frame's draws, keep their capacity between frames
+  std::vector<DrawElementsIndirectCommand> commands_;
+  std::vector<StaticDrawGroup> groups_;
+
+  // From the last Draw
+  size_t visible_chunks_ = 0;
+  size_t culled_chunks_ = 0;
+  size_t draw_calls_ = 0;
+  size_t drawn_indices_ = 0;
+
+  /**
+   * \param mode GL_TRIANGLES or GL_LINES
+   * \return id to add geometry with
+   */
+  uint32_t AddMaterial(Shader *shader,
+                       uint32_t mode,
+                       bool blend);
+
+  /**
+   * Add an indexed mesh, it goes in the chunk of the cell holding the centre of its bounding box
+   * \param indices into vertices, triangles or lines depending on the material
+   */
+  void AddMesh(uint32_t material,
+               const StaticVertex *vertices,
+               size_t vertex_count,
+               const uint32_t *indices,
+               size_t index_count);
+
+  /**
+   * A flat length x width rectangle at z = 0, rotated clockwise by theta like the robots. Filled
+   * for a triangle material, outlined for a line material
+   */
+  void AddBox(uint32_t material,
+              float x,
+              float y,
+              float theta,
+              float length,
+              float width,
+              const glm::vec4 &color);
+
+  /**
+   * A wall from (x0, y0) to (x1, y1), thickness m wide
+   */
+  void AddWall(uint32_t material,
+               float x0,
+               float y0,
+               float x1,
+               float y1,
+               float thickness,
+               const glm::vec4 &color);
+
+  /**
+   * A diamond marker, e.g. a waypoint
+   * \param radius centre to corner, m
+   */
+  void AddMarker(uint32_t material,
+                 float x,
+                 float y,
+                 float radius,
+                 const glm::vec4 &color);
+
+  /**
+   * Merge everything added into the GPU buffers and free the CPU copies. Add everything first, to
+   * change the geometry afterwards Clear and start again
+   * \return false if there is more geometry than 32 bit indices can address
+   */
+  bool Upload();
+
+  /**
+   * Draw the chunks inside frustum, the camera comes from the FrameUniformBuffer
+   */
+  void Draw(const Frustum &frustum);
+
+  /**
+   * Delete the GL objects and all the geometry, keeps the materials
+   */
+  void Clear();
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "telemetry.h"
+#include <algorithm>
+#include <limits>
+
+TelemetryRing::TelemetryRing(size_t capacity,
+                             int channels) : channels_(channels) {
+  capacity_ = 2 * kTelemetryBlockSize;
+  while (capacity_ < capacity) {
+    capacity_ <<= 1;
+  }
+  mask_ = capacity_ - 1;
+  data_ = std::vector<std::atomic<double>>(capacity_ * channels_);
+  block_min_ = std::vector<std::atomic<double>>(capacity_ / kTelemetryBlockSize * channels_);
+  block_max_ = std::vector<std::atomic<double>>(capacity_ / kTelemetryBlockSize * channels_);
+  running_min_.assign(channels_, std::numeric_limits<double>::infinity());
+  running_max_.assign(channels_, -std::numeric_limits<double>::infinity());
+}
+
+void TelemetryRing::Push(const double *values) {
+  const uint64_t index = count_.load(std::memory_order_relaxed);
+  const size_t slot = index & mask_;
+  for (int c = 0; c < channels_; ++c) {
+    data_[c * capacity_ + slot].store(values[c], std::memory_order_relaxed);
+    running_min_[c] = std::min(running_min_[c], values[c]);
+    running_max_[c] = std::max(running_max_[c], values[c]);
+  }
+  if ((index + 1) % kTelemetryBlockSize == 0) {
+    const size_t blocks = capacity_ / kTelemetryBlockSize;
+    const size_t block_slot = (index / kTelemetryBlockSize) & (blocks - 1);
+    for (int c = 0; c < channels_; ++c) {
+      block_min_[c * blocks + block_slot].store(running_min_[c], std::memory_order_relaxed);
+      block_max_[c * blocks + block_slot].store(running_max_[c], std::memory_order_relaxed);
+      running_min_[c] = std::numeric_limits<double>::infinity();
+      running_max_[c] = -std::numeric_limits<double>::infinity();
+    }
+  }
+  // Release so a reader that sees the new count also sees the values
+  count_.store(index + 1, std::memory_order_release);
+}
+
+uint64_t TelemetryRing::Count() const {
+  return count_.load(std::memory_order_acquire);
+}
+
+uint64_t TelemetryRing::OldestReadable(uint64_t count) const {
+  // Keep 1/8th of the ring (at least a block) between us and the writer
+  const uint64_t margin = std::max<uint64_t>(capacity_ / 8, kTelemetryBlockSize);
+  const uint64_t usable = capacity_ - margin;
+  return count > usable ? count - usable : 0;
+}
+
+double TelemetryRing::Get(int channel,
+                          uint64_t index) const {
+  return data_[channel * capacity_ + (index & mask_)].load(std::memory_order_relaxed);
+}
+
+void TelemetryRing::Clear() {
+  for (int c = 0; c < channels_; ++c) {
+    running_min_[c] = std::numeric_limits<double>::infinity();
+    running_max_[c] = -std::numeric_limits<double>::infinity();
+  }
+  count_.store(0, std::memory_order_release);
+}
+
+uint64_t TelemetryFindTime(const TelemetryRing &ring,
+                           double time,
+                           uint64_t first,
+                           uint64_t last) {
+  while (first < last) {
+    uint64_t middle = first + (last - first) / 2;
+    if (ring.Get(0, middle) < time) {
+      first = middle + 1;
+    }
+    else {
+      last = middle;
+    }
+  }
+  return first;
+}
+
+void TelemetryDecimateMinMax(const TelemetryRing &ring,
+                             int channel,
+                             uint64_t first,
+                             uint64_t last,
+                             size_t max_points,
+                             std::vector<double> &times,
+                             std::vector<double> &values) {
+  times.clear();
+  values.clear();
+  if (last <= first) {
+    return;
+  }
+  const uint64_t count = last - first;
+  if (count <= max_points || max_points < 2) {
+    for (uint64_t i = first; i < last; ++i) {
+      times.push_back(ring.Get(0, i));
+      values.push_back(ring.Get(channel, i));
+    }
+    return;
+  }
+
+  const size_t blocks = ring.capacity_ / kTelemetryBlockSize;
+  const uint64_t buckets = max_points / 2;
+  for (uint64_t b = 0; b < buckets; ++b) {
+    uint64_t start = first + count * b / buckets;
+    uint64_t end = first + count * (b + 1) / buckets;
+    double min_value = std::numeric_limits<double>::infinity();
+    double max_value = -std::numeric_limits<double>::infinity();
+    uint64_t i = start;
+    while (i < end) {
+      if (i % kTelemetryBlockSize == 0 && i + kTelemetryBlockSize <= end) {
+        // A whole block, use its summary instead of touching every sample
+        const size_t block = (i / kTelemetryBlockSize) & (blocks - 1);
+        min_value = std::min(min_value, ring.block_min_[channel * blocks + block].load(std::memory_order_relaxed));
+        max_value = std::max(max_value, ring.block_max_[channel * blocks + block].load(std::memory_order_relaxed));
+        i += kTelemetryBlockSize;
+      }
+      else {
+        double value = ring.Get(channel, i);
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+        i++;
+      }
+    }
+    const double time = ring.Get(0, start);
+    times.push_back(time);
+    values.push_back(min_value);
+    times.push_back(time);
+    values.push_back(max_value);
+  }
+}
+
+void TelemetryDecimateStride(const TelemetryRing &ring,
+                             int channel_x,
+                             int channel_y,
+                             uint64_t first,
+                             uint64_t last,
+                             size_t max_points,
+                             std::vector<double> &xs,
+                             std::vector<double> &ys) {
+  xs.clear();
+  ys.clear();
+  if (last <= first || max_points == 0) {
+    return;
+  }
+  const uint64_t stride = std::max<uint64_t>(1, (last - first + max_points - 1) / max_points);
+  for (uint64_t i = first; i < last; i += stride) {
+    xs.push_back(ring.Get(channel_x, i));
+    ys.push_back(ring.Get(channel_y, i));
+  }
+  if ((last - 1 - first) % stride != 0) {
+    xs.push_back(ring.Get(channel_x, last - 1));
+    ys.push_back(ring.Get(channel_y, last - 1));
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef SEPT2023__TELEMETRY_H_
+#define SEPT2023__TELEMETRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Samples per min/max summary block, see TelemetryRing
+constexpr size_t kTelemetryBlockSize = 64;
+
+/**
+ * Fixed capacity history of samples for plotting. One thread pushes samples, any other thread
+ * can read the history at the same time, neither side locks. Channel 0 is always the time of
+ * the sample and must never go backwards.
+ *
+ * Every value is a relaxed atomic so a reader racing the writer is well defined, it may just see
+ * the newest value in a slot that is being overwritten. Readers stay away from the oldest part of
+ * the ring (see OldestReadable) so in practice that never happens.
+ *
+ * The writer also keeps the min/max of each channel for every kTelemetryBlockSize samples, so
+ * the plots can decimate a long history by only touching the block summaries.
+ */
+struct TelemetryRing {
+  /**
+   * \param capacity number of samples kept, rounded up to a power of 2 (at least 2 blocks)
+   * \param channels number of values per sample, including the time
+   */
+  TelemetryRing(size_t capacity,
+                int channels);
+
+  /**
+   * Writer only, never allocates
+   * \param values one value per channel, values[0] is the time
+   */
+  void Push(const double *values);
+
+  /**
+   * \return total number of samples ever pushed, sample i is in the ring if
+   *         OldestReadable(count) <= i < count
+   */
+  uint64_t Count() const;
+
+  /**
+   * \return index of the oldest sample that is safe to read, keeping a margin so the writer
+   *         can keep pushing while we read
+   */
+  uint64_t OldestReadable(uint64_t count) const;
+
+  double Get(int channel,
+             uint64_t index) const;
+
+  /**
+   * Forget the history. Writer only, readers will see an empty ring
+   */
+  void Clear();
+
+  int channels_;
+  size_t capacity_;
+  size_t mask_;
+  // Channel major, sample i of channel c is at c * capacity_ + (i & mask_)
+  std::vector<std::atomic<double>> data_;
+  // Summaries of complete blocks, channel major like data_
+  std::vector<std::atomic<double>> block_min_;
+  std::vector<std::atomic<double>> block_max_;
+  // Writer only, min/max of the block being filled
+  std::vector<double> running_min_;
+  std::vector<double> running_max_;
+  std::atomic<uint64_t> count_{0};
+};
+
+/**
+ * Index of the first sample in [first, last) with time >= time (binary search on channel 0)
+ */
+uint64_t TelemetryFindTime(const TelemetryRing &ring,
+                           double time,
+                           uint64_t first,
+                           uint64_t last);
+
+/**
+ * Reduce samples [first, last) of a channel to at most max_points points for plotting against time.
+ * Splits the range in max_points / 2 buckets and keeps the min and max of each, so spikes are never
+ * lost however far zoomed out. Whole blocks inside a bucket use the precomputed block summaries.
+ * If the range is small enough all the samples are copied as is.
+ * \param times return variable, time of each point
+ * \param values return variable
+ */
+void TelemetryDecimateMinMax(const TelemetryRing &ring,
+                             int channel,
+                             uint64_t first,
+                             uint64_t last,
+                             size_t max_points,
+                             std::vector<double> &times,
+                             std::vector<double> &values);
+
+/**
+ * Every n'th sample of two channels plotted against each other (e.g. an XY trajectory),
+ * so that there are at most max_points. The last sample is always included.
+ */
+void TelemetryDecimateStride(const TelemetryRing &ring,
+                             int channel_x,
+                             int channel_y,
+                             uint64_t first,
+                             uint64_t last,
+                             size_t max_points,
+                             std::vector<double> &xs,
+                             std::vector<double> &ys);
+
+#endif
@@ -0,0 +1,93 @@
+#include "telemetry_panel.h"
+#include <algorithm>
+#include "imgui.h"
+#include "implot.h"
+#include "sim_thread.h"
+
+/**
+ * Range of samples to plot, the last history seconds of the ring (or all of it)
+ */
+static void VisibleRange(const TelemetryRing &ring,
+                         double history,
+                         bool show_all,
+                         uint64_t &first,
+                         uint64_t &last) {
+  last = ring.Count();
+  first = ring.OldestReadable(last);
+  if (!show_all && last > first) {
+    const double end_time = ring.Get(0, last - 1);
+    first = TelemetryFindTime(ring, end_time - history, first, last);
+  }
+}
+
+void TelemetryPanel::Draw(const TelemetryRing &sim,
+                          const TelemetryRing &frames) {
+  if (!ImGui::Begin("Telemetry")) {
+    ImGui::End();
+    return;
+  }
+  ImGui::Checkbox("All history", &show_all_);
+  ImGui::SameLine();
+  ImGui::BeginDisabled(show_all_);
+  ImGui::InputDouble("History", &history_, 1, 10, "%.1f s");
+  ImGui::EndDisabled();
+  history_ = std::max(history_, 0.1);
+
+  uint64_t first, last;
+  VisibleRange(sim, history_, show_all_, first, last);
+  ImGui::Text("Sim samples: %llu shown of %llu", (unsigned long long)(last - first), (unsigned long long)last);
+  const size_t points = (size_t)max_points_;
+  const ImVec2 plot_size(-1, 150);
+  const double end_time = last > first ? sim.Get(kSimTelemetryTime, last - 1) : 0;
+  const double start_time = show_all_ && last > first ? sim.Get(kSimTelemetryTime, first) : end_time - history_;
+
+  // Plots a channel against time, decimated with min/max buckets
+  auto plot_channel = [&](const char *label, int channel) {
+    TelemetryDecimateMinMax(sim, channel, first, last, points, times_, values_);
+    ImPlot::PlotLine(label, times_.data(), values_.data(), (int)times_.size());
+  };
+
+  if (ImPlot::BeginPlot("Position", plot_size)) {
+    ImPlot::SetupAxes("time (s)", "m", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+    ImPlot::SetupAxisLimits(ImAxis_X1, start_time, end_time, ImPlotCond_Always);
+    plot_channel("x", kSimTelemetryX);
+    plot_channel("y", kSimTelemetryY);
+    ImPlot::EndPlot();
+  }
+  if (ImPlot::BeginPlot("Heading", plot_size)) {
+    ImPlot::SetupAxes("time (s)", "rad", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+    ImPlot::SetupAxisLimits(ImAxis_X1, start_time, end_time, ImPlotCond_Always);
+    plot_channel("theta", kSimTelemetryTheta);
+    ImPlot::EndPlot();
+  }
+  if (ImPlot::BeginPlot("Commands", plot_size)) {
+    ImPlot::SetupAxes("time (s)", "m/s, rad/s", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+    ImPlot::SetupAxisLimits(ImAxis_X1, start_time, end_time, ImPlotCond_Always);
+    plot_channel("v", kSimTelemetryLinearVelocity);
+    plot_channel("w", kSimTelemetryAngularVelocity);
+    ImPlot::EndPlot();
+  }
+  if (ImPlot::BeginPlot("Trajectory", ImVec2(-1, 250), ImPlotFlags_Equal)) {
+    ImPlot::SetupAxes("x (m)", "y (m)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+    // Min/max per bucket doesn't make sense for a path, keep every n'th point instead
+    TelemetryDecimateStride(sim, kSimTelemetryX, kSimTelemetryY, first, last, points, times_, values_);
+    ImPlot::PlotLine("robot", times_.data(), values_.data(), (int)times_.size());
+    ImPlot::EndPlot();
+  }
+  if (ImPlot::BeginPlot("Step time", plot_size)) {
+    ImPlot::SetupAxes("time (s)", "us", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+    ImPlot::SetupAxisLimits(ImAxis_X1, start_time, end_time, ImPlotCond_Always);
+    plot_channel("step", kSimTelemetryStepTime);
+    ImPlot::EndPlot();
+  }
+  // Frames are timed on the wall clock, which only matches sim time at 1x, so separate plot
+  if (ImPlot::BeginPlot("Frame time", plot_size)) {
+    ImPlot::SetupAxes("wall time (s)", "ms", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+    uint64_t frame_first, frame_last;
+    VisibleRange(frames, history_, show_all_, frame_first, frame_last);
+    TelemetryDecimateMinMax(frames, kFrameTelemetryFrameTime, frame_first, frame_last, points, times_, values_);
+    ImPlot::PlotLine("frame", times_.data(), values_.data(), (int)times_.size());
+    ImPlot::EndPlot();
+  }
+  ImGui::End();
+}
@@ -0,0 +1,41 @@
+#ifndef SEPT2023__TELEMETRY_PANEL_H_
+#define SEPT2023__TELEMETRY_PANEL_H_
+
+#include <vector>
+#include "telemetry.h"
+
+// Channels of the render thread's frame telemetry ring
+enum FrameTelemetryChannel {
+  // glfwGetTime() at the start of the frame
+  kFrameTelemetryTime = 0,
+  // Wall time since the previous frame, milliseconds
+  kFrameTelemetryFrameTime,
+  kFrameTelemetryChannelCount
+};
+
+/**
+ * ImPlot window with the recent history of the sim (pose, commands, XY trajectory, step time) and
+ * of the frame times. Reads the rings without locking, every line is decimated to about
+ * max_points_ points so the cost per frame doesn't grow with the history length.
+ */
+struct TelemetryPanel {
+  // Seconds of history shown, ignored if show_all_
+  double history_ = 10;
+  bool show_all_ = false;
+  // Points per plotted line, roughly the width of a plot in pixels
+  int max_points_ = 1000;
+
+  /**
+   * Draw the window, call between ImGui::NewFrame() and ImGui::Render()
+   * \param sim SimThread::telemetry_
+   * \param frames FrameTelemetryChannel samples pushed by the render loop
+   */
+  void Draw(const TelemetryRing &sim,
+            const TelemetryRing &frames);
+
+  // Scratch space for the decimated lines, kept to avoid allocating every frame
+  std::vector<double> times_;
+  std::vector<double> values_;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include "fleet_step.h"
+#include "integrators.h"
+#include "simulator.h"
+#include "unicycle.h"
+
+/*
+ * Correctness of the motion model, so optimizing the step kernels can't quietly break the physics.
+ * Heading is clockwise from +Y: a robot at theta = 0 drives towards +Y, and turning with w > 0
+ * swings it towards +X.
+ */
+
+namespace {
+
+constexpr double kLinearVelocity = 1.5;
+constexpr double kAngularVelocity = 0.7;
+
+double Distance(const Pose2D &a,
+                const Pose2D &b) {
+  return std::hypot(a.x - b.x, a.y - b.y);
+}
+
+double AngleDifference(double a,
+                       double b) {
+  return std::abs(std::remainder(a - b, 2 * M_PI));
+}
+
+Pose2D StartPose() {
+  Pose2D pose;
+  pose.x = 3;
+  pose.y = -2;
+  pose.theta = 0.4;
+  return pose;
+}
+
+template <typename Integrator>
+Pose2D IntegrateUnicycle(const Pose2D &start,
+                         double duration,
+                         double dt) {
+  UnicycleModel model;
+  model.linear_velocity_ = kLinearVelocity;
+  model.angular_velocity_ = kAngularVelocity;
+  UnicycleModel::State state(start.x, start.y, start.theta);
+  Integrator integrator;
+  IntegrateFor(integrator, model, state, 0, duration, dt);
+  Pose2D pose;
+  pose.x = state[0];
+  pose.y = state[1];
+  pose.theta = state[2];
+  return pose;
+}
+
+}  // namespace
+
+TEST(StepUnicycle, StraightLineFollowsHeading) {
+  Pose2D pose = StartPose();
+  StepUnicycle(pose, 2, 0, 3);
+  EXPECT_NEAR(pose.x, 3 + 6 * std::sin(0.4), 1e-12);
+  EXPECT_NEAR(pose.y, -2 + 6 * std::cos(0.4), 1e-12);
+  EXPECT_DOUBLE_EQ(pose.theta, 0.4);
+}
+
+TEST(StepUnicycle, PositiveTurnIsClockwise) {
+  Pose2D pose;
+  StepUnicycle(pose, 1, 0.5, 0.5);
+  EXPECT_GT(pose.x, 0);
+  EXPECT_GT(pose.y, 0);
+  EXPECT_DOUBLE_EQ(pose.theta, 0.25);
+}
+
+TEST(StepUnicycle, CircleClosesAfterOneRevolution) {
+  const double period = 2 * M_PI / kAngularVelocity;
+  // One step for the whole circle, and many small ones that don't divide the period evenly
+  Pose2D one_step = StartPose();
+  StepUnicycle(one_step, kLinearVelocity, kAngularVelocity, period);
+  EXPECT_LT(Distance(one_step, StartPose()), 1e-9);
+  EXPECT_LT(AngleDifference(one_step.theta, StartPose().theta), 1e-9);
+
+  const Pose2D many_steps = IntegrateUnicycle<ExactArcIntegrator>(StartPose(), period, 0.01);
+  EXPECT_LT(Distance(many_steps, StartPose()), 1e-9);
+  EXPECT_LT(AngleDifference(many_steps.theta, StartPose().theta), 1e-9);
+}
+
+TEST(StepUnicycle, HalfRevolutionIsTheOtherSideOfTheCircle) {
+  const double radius = kLinearVelocity / kAngularVelocity;
+  const Pose2D half = IntegrateUnicycle<ExactArcIntegrator>(StartPose(), M_PI / kAngularVelocity, 0.01);
+  EXPECT_NEAR(Distance(half, StartPose()), 2 * radius, 1e-9);
+  EXPECT_LT(AngleDifference(half.theta, StartPose().theta + M_PI), 1e-9);
+  // Every point of the arc is radius from the centre, which is to the right of the start heading
+  const double center_x = StartPose().x + radius * std::cos(StartPose().theta);
+  const double center_y = StartPose().y - radius * std::sin(StartPose().theta);
+  Pose2D pose = StartPose();
+  for (int i = 0; i < 1000; ++i) {
+    StepUnicycle(pose, kLinearVelocity, kAngularVelocity, 0.013);
+    ASSERT_NEAR(std::hypot(pose.x - center_x, pose.y - center_y), radius, 1e-9);
+  }
+}
+
+TEST(StepUnicycle, ContinuousAcrossStraightLineThreshold) {
+  // Just below the threshold is a straight line, just above an arc, they must agree
+  const double dt = 0.01;
+  const double w_below = 0.999 * kStraightLineThreshold / dt;
+  const double w_above = 1.001 * kStraightLineThreshold / dt;
+  Pose2D below = StartPose();
+  Pose2D above = StartPose();
+  StepUnicycle(below, kLinearVelocity, w_below, dt);
+  StepUnicycle(above, kLinearVelocity, w_above, dt);
+  EXPECT_LT(Distance(below, above), 1e-6);
+}
+
+TEST(Integrators, Rk4ClosesTheCircle) {
+  const double period = 2 * M_PI / kAngularVelocity;
+  const Pose2D end = IntegrateUnicycle<Rk4Integrator>(StartPose(), period, 0.01);
+  EXPECT_LT(Distance(end, StartPose()), 1e-8);
+  EXPECT_LT(AngleDifference(end.theta, StartPose().theta), 1e-9);
+}
+
+TEST(Integrators, DormandPrinceClosesTheCircle) {
+  const double period = 2 * M_PI / kAngularVelocity;
+  const Pose2D end = IntegrateUnicycle<DormandPrinceIntegrator>(StartPose(), period, 0.1);
+  EXPECT_LT(Distance(end, StartPose()), 1e-4);
+}
+
+TEST(Integrators, EulerIsFirstOrder) {
+  // A whole number of steps at both step sizes, against the exact solution
+  const Pose2D exact = IntegrateUnicycle<ExactArcIntegrator>(StartPose(), 2, 2);
+  const double coarse = Distance(IntegrateUnicycle<EulerIntegrator>(StartPose(), 2, 0.01), exact);
+  const double fine = Distance(IntegrateUnicycle<EulerIntegrator>(StartPose(), 2, 0.005), exact);
+  // Halving the step halves the error
+  EXPECT_NEAR(coarse / fine, 2, 0.1);
+}
+
+TEST(Simulator, KeepsThetaWrappedAndCountsTime) {
+  Simulator sim;
+  sim.SetCommand(kLinearVelocity, -kAngularVelocity);
+  for (int i = 0; i < 2000; ++i) {
+    sim.Step(0.01);
+    ASSERT_GE(sim.pose_.theta, 0);
+    ASSERT_LT(sim.pose_.theta, 2 * M_PI);
+  }
+  EXPECT_NEAR(sim.time_, 20, 1e-9);
+  EXPECT_EQ(sim.step_count_, 2000u);
+}
+
+TEST(WrapAngle, Range) {
+  EXPECT_DOUBLE_EQ(WrapAngle(0), 0);
+  EXPECT_NEAR(WrapAngle(-0.5), 2 * M_PI - 0.5, 1e-12);
+  EXPECT_NEAR(WrapAngle(7 * M_PI), M_PI, 1e-12);
+  EXPECT_LT(WrapAngle(-1e-20), 2 * M_PI);
+}
+
+TEST(InterpolatePose, TurnsTheShortWay) {
+  Pose2D from;
+  from.theta = 2 * M_PI - 0.1;
+  Pose2D to;
+  to.x = 2;
+  to.theta = 0.1;
+  const Pose2D middle = InterpolatePose(from, to, 0.5);
+  EXPECT_DOUBLE_EQ(middle.x, 1);
+  EXPECT_LT(AngleDifference(middle.theta, 0), 1e-12);
+}
+
+TEST(StepFleet, EveryKernelMatchesStepUnicycle) {
+  FleetState initial;
+  SpawnRandomFleet(initial, 1001, 2023);
+  // Some straight drivers and some turning backwards
+  for (size_t i = 0; i < initial.Size(); i += 7) {
+    initial.w_[i] = 0;
+  }
+  for (size_t i = 3; i < initial.Size(); i += 11) {
+    initial.w_[i] = -initial.w_[i];
+  }
+  const double dt = 0.01;
+  for (FleetKernel kernel : {FleetKernel::kScalar, FleetKernel::kSse2, FleetKernel::kAvx2}) {
+    if (!FleetKernelSupported(kernel)) {
+      continue;
+    }
+    SCOPED_TRACE(FleetKernelName(kernel));
+    FleetState fleet = initial;
+    for (int step = 0; step < 100; ++step) {
+      StepFleet(fleet, dt, kernel);
+    }
+    for (size_t i = 0; i < fleet.Size(); ++i) {
+      Pose2D expected = initial.GetPose(i);
+      for (int step = 0; step < 100; ++step) {
+        StepUnicycle(expected, initial.v_[i], initial.w_[i], dt);
+        expected.theta = WrapAngle(expected.theta);
+      }
+      ASSERT_LT(Distance(fleet.GetPose(i), expected), 1e-9) << "robot " << i;
+      ASSERT_LT(AngleDifference(fleet.theta_[i], expected.theta), 1e-9) << "robot " << i;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include "distance_field.h"
+#include "occupancy_grid.h"
+#include "planner.h"
+
+/*
+ * Grid A* on an empty map, where every cell between the many equally short paths ties on f. The
+ * heap has to break those ties towards the goal or the search floods the whole band.
+ */
+
+namespace {
+
+constexpr double kResolution = 0.05;
+
+struct EmptyMap {
+  OccupancyGrid grid_;
+  DistanceField field_;
+
+  EmptyMap() {
+    grid_.Create(1000, 1000, kResolution, 0, 0);
+    field_.Build(grid_, nullptr);
+  }
+};
+
+PlanResult PlanGrid(const EmptyMap &map,
+                    double start_x,
+                    double start_y,
+                    double goal_x,
+                    double goal_y) {
+  PlanRequest request;
+  request.type_ = PlannerType::kGrid;
+  request.start_.x = start_x;
+  request.start_.y = start_y;
+  request.goal_.x = goal_x;
+  request.goal_.y = goal_y;
+  PlannerSettings settings;
+  PlannerWorkspace workspace;
+  PlanResult result;
+  Plan(map.field_, settings, request, workspace, result);
+  return result;
+}
+
+// Octile distance between the cells, the shortest 8 connected path
+double OctileLength(double dx,
+                    double dy) {
+  const double x = std::abs(std::round(dx / kResolution));
+  const double y = std::abs(std::round(dy / kResolution));
+  return (std::max(x, y) + (M_SQRT2 - 1) * std::min(x, y)) * kResolution;
+}
+
+}  // namespace
+
+TEST(PlanGridAStar, StraightLineOnlyExpandsTheLine) {
+  const EmptyMap map;
+  ASSERT_TRUE(map.grid_.IsOpen());
+  const PlanResult result = PlanGrid(map, 10.025, 25.025, 30.025, 25.025);
+  ASSERT_TRUE(result.found_);
+  EXPECT_NEAR(result.length_, 20.0, 1e-6);
+  // 401 cells on the line, a little slack for the start and goal
+  EXPECT_LE(result.expanded_, 410u);
+}
+
+TEST(PlanGridAStar, StraightAndDiagonalTiesDontFlood) {
+  const EmptyMap map;
+  ASSERT_TRUE(map.grid_.IsOpen());
+  // 8 m across and 20 m up: every mix of 160 diagonal and 240 straight steps is equally short,
+  // which used to expand ~36k cells
+  const PlanResult result = PlanGrid(map, 12.025, 10.025, 20.025, 30.025);
+  ASSERT_TRUE(result.found_);
+  // Measured between the kept corners, so between the straight line and the cell by cell length
+  EXPECT_GE(result.length_, std::hypot(8.0, 20.0) - 1e-6);
+  EXPECT_LE(result.length_, OctileLength(8, 20) + 1e-6);
+  EXPECT_LE(result.expanded_, 410u);
+}
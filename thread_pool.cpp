@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+// Pool and index of the worker running on this thread, so Submit/ParallelFor from inside a task
+// know which deque is theirs
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::Size() const {
+  return workers_.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  size_t index = current_pool == this ? current_worker
+                                      : next_worker_.fetch_add(1, std::memory_order_relaxed) % Size();
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex_);
+    workers_[index]->tasks_.push_back(std::move(task));
+  }
+  {
+    // Taking the lock makes sure a worker that just found nothing can't miss the wake up
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    queued_.fetch_add(1, std::memory_order_release);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::RunOne(size_t self) {
+  std::function<void()> task;
+  const size_t count = Size();
+  if (self < count) {
+    Worker &worker = *workers_[self];
+    std::lock_guard<std::mutex> lock(worker.mutex_);
+    if (!worker.tasks_.empty()) {
+      task = std::move(worker.tasks_.back());
+      worker.tasks_.pop_back();
+    }
+  }
+  // Steal the oldest task from the others, starting after ourselves so thieves spread out
+  for (size_t i = 1; !task && i <= count; ++i) {
+    Worker &victim = *workers_[(self + i) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex_);
+    if (!victim.tasks_.empty()) {
+      task = std::move(victim.tasks_.front());
+      victim.tasks_.pop_front();
+    }
+  }
+  if (!task) {
+    return false;
+  }
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  task();
+  return true;
+}
+
+void ThreadPool::WorkerLoop(size_t self) {
+  current_pool = this;
+  current_worker = self;
+  while (true) {
+    if (RunOne(self)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this] {
+      return quit_ || queued_.load(std::memory_order_acquire) > 0;
+    });
+    if (quit_) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             size_t grain,
+                             const std::function<void(size_t begin, size_t end)> &fn) {
+  if (count == 0) {
+    return;
+  }
+  if (grain == 0) {
+    // A few chunks per worker so stealing has something to balance
+    grain = std::max<size_t>(1, count / (Size() * 4));
+  }
+  const size_t chunks = (count + grain - 1) / grain;
+  std::atomic<size_t> remaining{chunks};
+  for (size_t chunk = 1; chunk < chunks; ++chunk) {
+    Submit([&fn, &remaining, chunk, grain, count] {
+      fn(chunk * grain, std::min(count, (chunk + 1) * grain));
+      remaining.fetch_sub(1, std::memory_order_acq_rel);
+    });
+  }
+  // First chunk on this thread, then help with whatever is left until everything is done
+  fn(0, std::min(count, grain));
+  remaining.fetch_sub(1, std::memory_order_acq_rel);
+  const size_t self = current_pool == this ? current_worker : Size();
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    if (!RunOne(self)) {
+      std::this_thread::yield();
+    }
+  }
+}
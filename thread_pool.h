@@ -0,0 +1,74 @@
+#ifndef SEPT2023__THREAD_POOL_H_
+#define SEPT2023__THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads with one task deque each. A worker takes from the back of its own
+ * deque (most recently pushed, still in cache) and when that is empty steals from the front of
+ * someone else's, so uneven tasks even out without a single shared queue everybody fights over.
+ *
+ * Tasks should not share mutable state, give each one its own output slot instead.
+ */
+struct ThreadPool {
+  /**
+   * \param threads number of workers, 0 for one per hardware thread
+   */
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * \return number of worker threads
+   */
+  size_t Size() const;
+
+  /**
+   * Queue a task. From a worker it goes on that worker's own deque, otherwise they are
+   * spread round robin. Safe from any thread
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * Call fn(begin, end) over [0, count) split in chunks of about grain, and wait for all of them.
+   * The calling thread runs chunks too while it waits, so this can be called from inside a task.
+   * \param grain minimum chunk size, 0 picks one giving a few chunks per worker
+   */
+  void ParallelFor(size_t count,
+                   size_t grain,
+                   const std::function<void(size_t begin, size_t end)> &fn);
+
+  struct Worker {
+    std::mutex mutex_;
+    std::deque<std::function<void()>> tasks_;
+  };
+
+  /**
+   * Run one queued task if there is one, own deque first, then steal
+   * \param self worker index of the calling thread, or Size() for a non worker
+   * \return false if every deque was empty
+   */
+  bool RunOne(size_t self);
+  void WorkerLoop(size_t self);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  // Tasks queued but not taken yet, workers sleep when it's 0
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> next_worker_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool quit_ = false;
+};
+
+#endif
@@ -0,0 +1,302 @@
+#include "trail_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// Robots per Simplify task, enough that a task is worth queueing
+static const size_t kTrailChunkRobots = 256;
+
+void TrailStrips::Clear() {
+  xy_.clear();
+  firsts_.clear();
+  counts_.clear();
+}
+
+void TrailBuffer::Resize(size_t robot_count,
+                         size_t capacity) {
+  robot_count_ = robot_count;
+  capacity_ = (capacity + kTrailBlockPoints - 1) / kTrailBlockPoints * kTrailBlockPoints;
+  points_.assign(robot_count * capacity_ * 2, 0.0f);
+  significance_.assign(robot_count * capacity_, 0.0f);
+  block_significance_.assign(robot_count * capacity_ / kTrailBlockPoints, 0.0f);
+  starts_.assign(robot_count, 0);
+  counts_.assign(robot_count, 0);
+}
+
+void TrailBuffer::Clear() {
+  std::fill(starts_.begin(), starts_.end(), 0);
+  std::fill(counts_.begin(), counts_.end(), 0);
+}
+
+void TrailBuffer::Append(const FleetState &fleet) {
+  if (fleet.Size() != robot_count_) {
+    Resize(fleet.Size(), capacity_);
+  }
+  for (size_t i = 0; i < robot_count_; ++i) {
+    Append(i, (float)fleet.x_[i], (float)fleet.y_[i]);
+  }
+}
+
+void TrailBuffer::Append(size_t robot,
+                         float x,
+                         float y) {
+  if (capacity_ == 0) {
+    return;
+  }
+  float *ring = points_.data() + robot * capacity_ * 2;
+  uint32_t &start = starts_[robot];
+  uint32_t &count = counts_[robot];
+  if (count > 0) {
+    const size_t last = (start + count - 1) % capacity_;
+    const float dx = x - ring[last * 2];
+    const float dy = y - ring[last * 2 + 1];
+    const float distance_squared = dx * dx + dy * dy;
+    if (distance_squared < min_spacing_ * min_spacing_) {
+      return;
+    }
+    if (distance_squared > break_distance_ * break_distance_) {
+      start = 0;
+      count = 0;
+    }
+  }
+  size_t index;
+  if (count < capacity_) {
+    index = (start + count) % capacity_;
+    count++;
+  }
+  else {
+    // Full, the new point takes the oldest one's slot
+    index = start;
+    start = (uint32_t)((start + 1) % capacity_);
+  }
+  ring[index * 2] = x;
+  ring[index * 2 + 1] = y;
+  // Writes go round the ring in order, so this is the last point of a block that was written
+  // since the trail started
+  if (index % kTrailBlockPoints == kTrailBlockPoints - 1) {
+    const size_t first = index + 1 - kTrailBlockPoints;
+    float *significance = significance_.data() + robot * capacity_ + first;
+    PolylineSignificance(ring + first * 2, kTrailBlockPoints, significance);
+    block_significance_[(robot * capacity_ + first) / kTrailBlockPoints] =
+        *std::max_element(significance + 1, significance + kTrailBlockPoints - 1);
+  }
+}
+
+size_t TrailBuffer::PointCount() const {
+  size_t total = 0;
+  for (uint32_t count : counts_) {
+    total += count;
+  }
+  return total;
+}
+
+void TrailBuffer::Simplify(float tolerance,
+                           ThreadPool *pool,
+                           TrailStrips &strips) {
+  strips.Clear();
+  const size_t chunk_count = (robot_count_ + kTrailChunkRobots - 1) / kTrailChunkRobots;
+  if (chunks_.size() < chunk_count) {
+    chunks_.resize(chunk_count);
+  }
+  auto simplify_chunks = [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      TrailStrips &chunk = chunks_[c];
+      chunk.Clear();
+      const size_t last_robot = std::min(robot_count_, (c + 1) * kTrailChunkRobots);
+      for (size_t robot = c * kTrailChunkRobots; robot < last_robot; ++robot) {
+        const size_t count = counts_[robot];
+        if (count < 2) {
+          continue;
+        }
+        const float *ring = points_.data() + robot * capacity_ * 2;
+        const float *significance = significance_.data() + robot * capacity_;
+        const size_t start = starts_[robot];
+        const size_t newest = (start + count - 1) % capacity_;
+        // Points of the block still being written, 0 if the newest point sealed its block
+        const size_t head = newest % kTrailBlockPoints == kTrailBlockPoints - 1
+                            ? 0 : std::min(count, newest % kTrailBlockPoints + 1);
+        const int32_t first = (int32_t)chunk.VertexCount();
+        // The oldest point is kept even if the start of its block has been overwritten
+        size_t kept = 1;
+        chunk.xy_.push_back(ring[start * 2]);
+        chunk.xy_.push_back(ring[start * 2 + 1]);
+        // The sealed points after it in ring order, [start + 1, capacity_) then [0, ...)
+        const size_t sealed_end = start + count - head;
+        const float *blocks = block_significance_.data() + robot * capacity_ / kTrailBlockPoints;
+        auto keep_sealed = [&](size_t begin,
+                               size_t end) {
+          size_t index = begin;
+          while (index < end) {
+            if (index % kTrailBlockPoints == 0 && index + kTrailBlockPoints <= end &&
+                blocks[index / kTrailBlockPoints] <= tolerance) {
+              index += kTrailBlockPoints - 1;
+              chunk.xy_.push_back(ring[(index - kTrailBlockPoints + 1) * 2]);
+              chunk.xy_.push_back(ring[(index - kTrailBlockPoints + 1) * 2 + 1]);
+              kept++;
+            }
+            if (significance[index] > tolerance) {
+              chunk.xy_.push_back(ring[index * 2]);
+              chunk.xy_.push_back(ring[index * 2 + 1]);
+              kept++;
+            }
+            index++;
+          }
+        };
+        keep_sealed(start + 1, std::min(sealed_end, capacity_));
+        if (sealed_end > capacity_) {
+          keep_sealed(0, sealed_end - capacity_);
+        }
+        if (head > 0) {
+          const size_t head_first = newest + 1 - head;
+          if (head == count) {
+            chunk.xy_.resize(chunk.xy_.size() - 2);
+            kept--;
+          }
+          kept += SimplifyPolyline(ring + head_first * 2, head, tolerance, chunk.xy_);
+        }
+        chunk.firsts_.push_back(first);
+        chunk.counts_.push_back((int32_t)kept);
+      }
+    }
+  };
+  if (pool != nullptr) {
+    pool->ParallelFor(chunk_count, 1, simplify_chunks);
+  }
+  else {
+    simplify_chunks(0, chunk_count);
+  }
+
+  // Stitch the chunks together in robot order, so the output doesn't depend on the threads
+  size_t vertices = 0;
+  size_t strip_count = 0;
+  for (size_t c = 0; c < chunk_count; ++c) {
+    vertices += chunks_[c].VertexCount();
+    strip_count += chunks_[c].counts_.size();
+  }
+  strips.xy_.reserve(vertices * 2);
+  strips.firsts_.reserve(strip_count);
+  strips.counts_.reserve(strip_count);
+  for (size_t c = 0; c < chunk_count; ++c) {
+    const TrailStrips &chunk = chunks_[c];
+    const int32_t offset = (int32_t)strips.VertexCount();
+    strips.xy_.insert(strips.xy_.end(), chunk.xy_.begin(), chunk.xy_.end());
+    for (size_t i = 0; i < chunk.firsts_.size(); ++i) {
+      strips.firsts_.push_back(chunk.firsts_[i] + offset);
+      strips.counts_.push_back(chunk.counts_[i]);
+    }
+  }
+}
+
+/**
+ * \return squared distance from (px, py) to the segment a - b
+ */
+static float SegmentDistanceSquared(float px,
+                                    float py,
+                                    float ax,
+                                    float ay,
+                                    float bx,
+                                    float by) {
+  const float dx = bx - ax;
+  const float dy = by - ay;
+  const float length_squared = dx * dx + dy * dy;
+  // Not the infinite line: a trail that doubles back has points beyond the segment ends
+  float t = 0;
+  if (length_squared > 0) {
+    t = std::min(1.0f, std::max(0.0f, ((px - ax) * dx + (py - ay) * dy) / length_squared));
+  }
+  const float ex = ax + t * dx - px;
+  const float ey = ay + t * dy - py;
+  return ex * ex + ey * ey;
+}
+
+size_t SimplifyPolyline(const float *xy,
+                        size_t count,
+                        float tolerance,
+                        std::vector<float> &out) {
+  if (count <= 2) {
+    out.insert(out.end(), xy, xy + count * 2);
+    return count;
+  }
+  // Scratch reused between calls on the same thread
+  thread_local std::vector<uint8_t> keep;
+  thread_local std::vector<std::pair<uint32_t, uint32_t>> ranges;
+  keep.assign(count, 0);
+  keep[0] = 1;
+  keep[count - 1] = 1;
+  ranges.clear();
+  ranges.emplace_back(0, (uint32_t)(count - 1));
+  const float tolerance_squared = tolerance * tolerance;
+  while (!ranges.empty()) {
+    const uint32_t first = ranges.back().first;
+    const uint32_t last = ranges.back().second;
+    ranges.pop_back();
+    float furthest_squared = tolerance_squared;
+    uint32_t furthest = 0;
+    for (uint32_t i = first + 1; i < last; ++i) {
+      const float distance_squared = SegmentDistanceSquared(xy[i * 2], xy[i * 2 + 1], xy[first * 2],
+                                                            xy[first * 2 + 1], xy[last * 2], xy[last * 2 + 1]);
+      if (distance_squared > furthest_squared) {
+        furthest_squared = distance_squared;
+        furthest = i;
+      }
+    }
+    if (furthest != 0) {
+      keep[furthest] = 1;
+      ranges.emplace_back(first, furthest);
+      ranges.emplace_back(furthest, last);
+    }
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (keep[i]) {
+      out.push_back(xy[i * 2]);
+      out.push_back(xy[i * 2 + 1]);
+      kept++;
+    }
+  }
+  return kept;
+}
+
+void PolylineSignificance(const float *xy,
+                          size_t count,
+                          float *significance) {
+  if (count == 0) {
+    return;
+  }
+  std::fill(significance, significance + count, 0.0f);
+  significance[0] = INFINITY;
+  significance[count - 1] = INFINITY;
+  // Same splits as SimplifyPolyline at a tolerance of 0, each point remembering the smallest split
+  // distance on its way down: SimplifyPolyline only gets to a point if every split above it was
+  // over the tolerance
+  struct Range {
+    uint32_t first;
+    uint32_t last;
+    float bound;
+  };
+  thread_local std::vector<Range> ranges;
+  ranges.clear();
+  ranges.push_back({0, (uint32_t)(count - 1), INFINITY});
+  while (!ranges.empty()) {
+    const Range range = ranges.back();
+    ranges.pop_back();
+    if (range.last <= range.first + 1) {
+      continue;
+    }
+    float furthest_squared = -1;
+    uint32_t furthest = range.first + 1;
+    for (uint32_t i = range.first + 1; i < range.last; ++i) {
+      const float distance_squared = SegmentDistanceSquared(xy[i * 2], xy[i * 2 + 1], xy[range.first * 2],
+                                                            xy[range.first * 2 + 1], xy[range.last * 2],
+                                                            xy[range.last * 2 + 1]);
+      if (distance_squared > furthest_squared) {
+        furthest_squared = distance_squared;
+        furthest = i;
+      }
+    }
+    const float bound = std::min(range.bound, std::sqrt(furthest_squared));
+    significance[furthest] = bound;
+    ranges.push_back({range.first, furthest, bound});
+    ranges.push_back({furthest, range.last, bound});
+  }
+}
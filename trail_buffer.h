@@ -0,0 +1,119 @@
+#ifndef SEPT2023__TRAIL_BUFFER_H_
+#define SEPT2023__TRAIL_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "fleet_state.h"
+#include "thread_pool.h"
+
+/**
+ * Trails simplified for drawing: every trail is one line strip of xy_, strip i starts at vertex
+ * firsts_[i] and has counts_[i] vertices (the layout glMultiDrawArrays takes)
+ */
+struct TrailStrips {
+  std::vector<float> xy_;
+  std::vector<int32_t> firsts_;
+  std::vector<int32_t> counts_;
+
+  void Clear();
+
+  size_t VertexCount() const {
+    return xy_.size() / 2;
+  }
+};
+
+// Trails are simplified in blocks of this many points, capacity_ is a multiple of it
+constexpr size_t kTrailBlockPoints = 64;
+
+/**
+ * The recent path of every robot in a fleet, one fixed size ring buffer of x, y points per robot
+ * in one allocation. Full rings overwrite their oldest point, so memory stays at
+ * robots * capacity_ however long the sim runs.
+ *
+ * Simplifying millions of points every frame is too slow, so each block of kTrailBlockPoints
+ * points gets its Douglas-Peucker significance once when its last point is written. A sealed
+ * block at any tolerance is then a filter on significance_, only the block still being written
+ * is simplified from scratch.
+ */
+struct TrailBuffer {
+  // Points kept per robot
+  size_t capacity_ = 0;
+  size_t robot_count_ = 0;
+  // A point closer than this (m) to the last one isn't added, a parked robot doesn't use up its
+  // trail
+  float min_spacing_ = 0.05f;
+  // A jump further than this (m) starts the trail over, e.g. after a reset or loading a state
+  float break_distance_ = 5;
+  // Robot r's ring is points_[r * capacity_ * 2, (r + 1) * capacity_ * 2), x, y interleaved
+  std::vector<float> points_;
+  // Per point of points_, the largest tolerance (m) its sealed block keeps it at
+  std::vector<float> significance_;
+  // Per block, the largest significance_ of the points in between its ends. A block below the
+  // tolerance is just its two ends without looking at the rest
+  std::vector<float> block_significance_;
+  // Ring index of each robot's oldest point, and how many it has
+  std::vector<uint32_t> starts_;
+  std::vector<uint32_t> counts_;
+  // Per chunk output of Simplify, kept to reuse the memory
+  std::vector<TrailStrips> chunks_;
+
+  /**
+   * Forget every trail and make room for robot_count robots of capacity points each
+   * \param capacity rounded up to a multiple of kTrailBlockPoints
+   */
+  void Resize(size_t robot_count,
+              size_t capacity);
+
+  void Clear();
+
+  /**
+   * Add the current pose of every robot, the trails are resized (and cleared) if the fleet size
+   * changed
+   */
+  void Append(const FleetState &fleet);
+
+  void Append(size_t robot,
+              float x,
+              float y);
+
+  /**
+   * \return the total number of points over every trail
+   */
+  size_t PointCount() const;
+
+  /**
+   * Douglas-Peucker simplify every trail into strips. The viewer looks straight down, so a screen
+   * space tolerance of p pixels is a world space tolerance of p * meters per pixel. Block ends are
+   * always kept, so a trail has at least one point per block
+   * \param tolerance max distance (m) of a dropped point from the simplified line
+   * \param pool spreads the robots over its workers, nullptr for the calling thread only
+   */
+  void Simplify(float tolerance,
+                ThreadPool *pool,
+                TrailStrips &strips);
+};
+
+/**
+ * Douglas-Peucker: keep the end points, then recursively the point furthest from the segment
+ * between the kept ones while it is more than tolerance away. Iterative, so a trail of any
+ * length can't overflow the stack
+ * \param xy count x, y pairs
+ * \param out the kept x, y pairs are appended
+ * \return the number of points kept
+ */
+size_t SimplifyPolyline(const float *xy,
+                        size_t count,
+                        float tolerance,
+                        std::vector<float> &out);
+
+/**
+ * Douglas-Peucker for every tolerance at once: significance[i] is the largest tolerance that
+ * SimplifyPolyline keeps point i at (infinite for the end points), so simplifying is keeping the
+ * points with significance above the tolerance
+ */
+void PolylineSignificance(const float *xy,
+                          size_t count,
+                          float *significance);
+
+#endif
@@ -0,0 +1,58 @@
+#include "trail_renderer.h"
+#include "shader_library.h"
+
+bool TrailRenderer::Init() {
+  shader_ = GetShaderLibrary().Load("trail_shader.vs", "simple_shader.fs");
+  if (shader_ == nullptr) {
+    return false;
+  }
+  LookUpUniforms();
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return true;
+}
+
+void TrailRenderer::Upload(const TrailStrips &strips) {
+  vertex_count_ = strips.VertexCount();
+  firsts_ = strips.firsts_;
+  counts_ = strips.counts_;
+  if (vertex_count_ == 0) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  if (vertex_count_ > capacity_) {
+    capacity_ = vertex_count_ + vertex_count_ / 2;
+  }
+  // Orphan then fill, same as the fleet instance buffer
+  glBufferData(GL_ARRAY_BUFFER, capacity_ * 2 * sizeof(float), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count_ * 2 * sizeof(float), strips.xy_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TrailRenderer::Draw(const glm::vec4 &color) {
+  if (vertex_count_ == 0 || shader_ == nullptr) {
+    return;
+  }
+  if (shader_->generation_ != shader_generation_) {
+    LookUpUniforms();
+  }
+  shader_->Use();
+  shader_->SetVec4(color_uniform_, color);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBindVertexArray(vao_);
+  glMultiDrawArrays(GL_LINE_STRIP, firsts_.data(), counts_.data(), (GLsizei)counts_.size());
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+}
+
+void TrailRenderer::LookUpUniforms() {
+  color_uniform_ = shader_->GetUniform("color");
+  shader_generation_ = shader_->generation_;
+}
@@ -0,0 +1,47 @@
+#ifndef SEPT2023__TRAIL_RENDERER_H_
+#define SEPT2023__TRAIL_RENDERER_H_
+
+#include "shader.h"
+#include "trail_buffer.h"
+
+/**
+ * Draws simplified fleet trails (TrailBuffer::Simplify) from one streamed vertex buffer, every
+ * trail a line strip of it, all in one glMultiDrawArrays call.
+ */
+struct TrailRenderer {
+  // Owned by the shader library, shared with everything else drawing with the same program
+  Shader *shader_ = nullptr;
+  // Program generation the uniform handles were looked up in, a hot reload invalidates them
+  uint32_t shader_generation_ = 0;
+  UniformHandle color_uniform_;
+  uint32_t vao_ = 0;
+  uint32_t vbo_ = 0;
+  // Number of vertices the buffer can hold before it needs to grow
+  size_t capacity_ = 0;
+  // Strips of the last Upload, the vertices are on the GPU
+  std::vector<int32_t> firsts_;
+  std::vector<int32_t> counts_;
+  size_t vertex_count_ = 0;
+
+  /**
+   * \return false if the shader failed to load
+   */
+  bool Init();
+
+  /**
+   * Replace the trails with strips
+   */
+  void Upload(const TrailStrips &strips);
+
+  /**
+   * Draw the last upload, the camera comes from the FrameUniformBuffer
+   */
+  void Draw(const glm::vec4 &color);
+
+  /**
+   * Find the uniforms in the current version of the shader
+   */
+  void LookUpUniforms();
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include "trajectory_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(TrajectoryRecord) % 8 == 0, "Compression works on 8 byte words");
+constexpr size_t kRecordWords = sizeof(TrajectoryRecord) / 8;
+
+/**
+ * XOR each word with the previous record then store only the non zero low bytes.
+ * Values that barely change from step to step share their high bytes (sign, exponent,
+ * top of the mantissa) so most of each word becomes zero.
+ */
+static void CompressRecords(const std::vector<TrajectoryRecord> &records,
+                            std::vector<uint8_t> &out) {
+  out.clear();
+  uint64_t previous[kRecordWords] = {};
+  for (const TrajectoryRecord &record : records) {
+    uint64_t words[kRecordWords];
+    memcpy(words, &record, sizeof(record));
+    for (size_t i = 0; i < kRecordWords; ++i) {
+      uint64_t delta = words[i] ^ previous[i];
+      previous[i] = words[i];
+      uint8_t zero_bytes = delta == 0 ? 8 : (uint8_t)(__builtin_clzll(delta) / 8);
+      out.push_back(zero_bytes);
+      for (int b = 0; b < 8 - zero_bytes; ++b) {
+        out.push_back((uint8_t)(delta >> (8 * b)));
+      }
+    }
+  }
+}
+
+/**
+ * \return false if the data is truncated
+ */
+static bool DecompressRecords(const uint8_t *data,
+                              size_t size,
+                              uint32_t record_count,
+                              std::vector<TrajectoryRecord> &out) {
+  out.resize(record_count);
+  uint64_t previous[kRecordWords] = {};
+  size_t position = 0;
+  for (uint32_t r = 0; r < record_count; ++r) {
+    for (size_t i = 0; i < kRecordWords; ++i) {
+      if (position >= size) {
+        return false;
+      }
+      uint8_t zero_bytes = data[position++];
+      if (zero_bytes > 8 || position + (8 - zero_bytes) > size) {
+        return false;
+      }
+      uint64_t delta = 0;
+      for (int b = 0; b < 8 - zero_bytes; ++b) {
+        delta |= (uint64_t)data[position++] << (8 * b);
+      }
+      previous[i] ^= delta;
+    }
+    memcpy(&out[r], previous, sizeof(TrajectoryRecord));
+  }
+  return true;
+}
+
+TrajectoryRecorder::TrajectoryRecorder(size_t ring_capacity) : ring_(ring_capacity) {
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+  Close();
+}
+
+bool TrajectoryRecorder::Open(const std::string &path,
+                              bool compress) {
+  if (file_ != nullptr) {
+    return false;
+  }
+  file_ = fopen(path.c_str(), "wb");
+  if (file_ == nullptr) {
+    printf("ERROR (TrajectoryRecorder): Could not create file: %s\n", path.c_str());
+    return false;
+  }
+  compress_ = compress;
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, kTrajectoryMagic, sizeof(kTrajectoryMagic));
+  header_.version = kTrajectoryVersion;
+  header_.flags = compress ? kTrajectoryCompressed : 0;
+  header_.record_size = sizeof(TrajectoryRecord);
+  header_.chunk_records = kTrajectoryChunkRecords;
+  // Placeholder, rewritten with the real counts/index offset on Close()
+  if (fwrite(&header_, sizeof(header_), 1, file_) != 1) {
+    printf("ERROR (TrajectoryRecorder): Could not write to file: %s\n", path.c_str());
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  path_ = path;
+  write_failed_ = false;
+
+  chunk_.clear();
+  chunk_.reserve(kTrajectoryChunkRecords);
+  index_.clear();
+  dropped_ = 0;
+  written_ = 0;
+  stop_ = false;
+  writer_ = std::thread(&TrajectoryRecorder::WriterLoop, this);
+  return true;
+}
+
+bool TrajectoryRecorder::IsOpen() const {
+  return file_ != nullptr;
+}
+
+bool TrajectoryRecorder::Record(const TrajectoryRecord &record) {
+  if (!ring_.TryPush(record)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void TrajectoryRecorder::WriterLoop() {
+  TrajectoryRecord record;
+  while (true) {
+    // Read stop before draining so nothing pushed before Close() is missed
+    bool stopping = stop_.load(std::memory_order_acquire);
+    bool got_any = false;
+    while (ring_.TryPop(record)) {
+      got_any = true;
+      chunk_.push_back(record);
+      if (chunk_.size() == kTrajectoryChunkRecords) {
+        FlushChunk();
+      }
+    }
+    if (stopping) {
+      break;
+    }
+    if (!got_any) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  FlushChunk();
+}
+
+void TrajectoryRecorder::FlushChunk() {
+  if (chunk_.empty()) {
+    return;
+  }
+  if (write_failed_) {
+    dropped_.fetch_add(chunk_.size(), std::memory_order_relaxed);
+    chunk_.clear();
+    return;
+  }
+  TrajectoryChunkIndex entry;
+  entry.first_time = chunk_.front().time;
+  entry.last_time = chunk_.back().time;
+  entry.offset = (uint64_t)ftell(file_);
+  entry.record_count = (uint32_t)chunk_.size();
+  bool written;
+  if (compress_) {
+    CompressRecords(chunk_, compressed_);
+    entry.stored_size = (uint32_t)compressed_.size();
+    written = fwrite(compressed_.data(), 1, compressed_.size(), file_) == compressed_.size();
+  }
+  else {
+    entry.stored_size = (uint32_t)(chunk_.size() * sizeof(TrajectoryRecord));
+    written = fwrite(chunk_.data(), sizeof(TrajectoryRecord), chunk_.size(), file_) == chunk_.size();
+  }
+  if (!written) {
+    // Disk full or similar, this and every later chunk are dropped and Close() reports it
+    printf("ERROR (TrajectoryRecorder): Could not write to file: %s\n", path_.c_str());
+    write_failed_ = true;
+    dropped_.fetch_add(chunk_.size(), std::memory_order_relaxed);
+    chunk_.clear();
+    return;
+  }
+  if (header_.record_count == 0) {
+    header_.start_time = entry.first_time;
+  }
+  header_.end_time = entry.last_time;
+  header_.record_count += chunk_.size();
+  written_.fetch_add(chunk_.size(), std::memory_order_relaxed);
+  index_.push_back(entry);
+  chunk_.clear();
+}
+
+void TrajectoryRecorder::Close() {
+  if (file_ == nullptr) {
+    return;
+  }
+  stop_.store(true, std::memory_order_release);
+  writer_.join();
+
+  header_.chunk_count = index_.size();
+  header_.index_offset = (uint64_t)ftell(file_);
+  bool written = !write_failed_ &&
+      fwrite(index_.data(), sizeof(TrajectoryChunkIndex), index_.size(), file_) == index_.size() &&
+      fseek(file_, 0, SEEK_SET) == 0 &&
+      fwrite(&header_, sizeof(header_), 1, file_) == 1;
+  written = fclose(file_) == 0 && written;
+  file_ = nullptr;
+  if (!written) {
+    printf("ERROR (TrajectoryRecorder): %s is incomplete, %llu records were written before a write failed\n",
+           path_.c_str(), (unsigned long long)header_.record_count);
+  }
+}
+
+TrajectoryReplay::~TrajectoryReplay() {
+  Close();
+}
+
+bool TrajectoryReplay::Open(const std::string &path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("ERROR (TrajectoryReplay): Could not open file: %s\n", path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(TrajectoryFileHeader)) {
+    printf("ERROR (TrajectoryReplay): Not a trajectory file: %s\n", path.c_str());
+    close(fd);
+    return false;
+  }
+  size_ = (size_t)file_stat.st_size;
+  void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after closing the file descriptor
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    printf("ERROR (TrajectoryReplay): Could not map file: %s\n", path.c_str());
+    size_ = 0;
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(mapped);
+  header_ = reinterpret_cast<const TrajectoryFileHeader*>(data_);
+
+  bool valid = memcmp(header_->magic, kTrajectoryMagic, sizeof(kTrajectoryMagic)) == 0 &&
+      header_->version == kTrajectoryVersion &&
+      header_->record_size == sizeof(TrajectoryRecord) &&
+      header_->index_offset >= sizeof(TrajectoryFileHeader) &&
+      header_->index_offset <= size_ &&
+      // Divided rather than multiplied, a garbage chunk_count can't overflow
+      header_->chunk_count <= (size_ - header_->index_offset) / sizeof(TrajectoryChunkIndex);
+  if (valid) {
+    index_.resize(header_->chunk_count);
+    memcpy(index_.data(), data_ + header_->index_offset, header_->chunk_count * sizeof(TrajectoryChunkIndex));
+  }
+  // Every chunk has to lie between the header and the index and hold what it claims, Chunk()
+  // trusts the index from here on
+  uint64_t record_count = 0;
+  for (size_t i = 0; valid && i < index_.size(); ++i) {
+    const TrajectoryChunkIndex &entry = index_[i];
+    valid = entry.offset >= sizeof(TrajectoryFileHeader) && entry.offset <= header_->index_offset &&
+        entry.stored_size <= header_->index_offset - entry.offset &&
+        entry.record_count > 0 && entry.record_count <= header_->chunk_records;
+    if (header_->flags & kTrajectoryCompressed) {
+      // Every 8 byte word takes at least its 1 byte count
+      valid = valid && (uint64_t)entry.record_count * kRecordWords <= entry.stored_size;
+    }
+    else {
+      valid = valid && entry.stored_size == (uint64_t)entry.record_count * sizeof(TrajectoryRecord);
+    }
+    record_count += entry.record_count;
+  }
+  if (!valid || record_count != header_->record_count) {
+    // An index offset of 0 means the recorder never got to Close()
+    printf("ERROR (TrajectoryReplay): Invalid or incomplete trajectory file: %s\n", path.c_str());
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void TrajectoryReplay::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  header_ = nullptr;
+  index_.clear();
+  cached_chunk_ = UINT64_MAX;
+  cache_.clear();
+}
+
+bool TrajectoryReplay::IsOpen() const {
+  return data_ != nullptr;
+}
+
+double TrajectoryReplay::StartTime() const {
+  return header_ != nullptr ? header_->start_time : 0;
+}
+
+double TrajectoryReplay::EndTime() const {
+  return header_ != nullptr ? header_->end_time : 0;
+}
+
+uint64_t TrajectoryReplay::RecordCount() const {
+  return header_ != nullptr ? header_->record_count : 0;
+}
+
+const std::vector<TrajectoryRecord> &TrajectoryReplay::Chunk(uint64_t chunk) {
+  if (chunk == cached_chunk_) {
+    return cache_;
+  }
+  const TrajectoryChunkIndex &entry = index_[chunk];
+  cached_chunk_ = chunk;
+  const uint8_t *stored = data_ + entry.offset;
+  if (header_->flags & kTrajectoryCompressed) {
+    if (!DecompressRecords(stored, entry.stored_size, entry.record_count, cache_)) {
+      cache_.clear();
+    }
+  }
+  else {
+    cache_.resize(entry.record_count);
+    memcpy(cache_.data(), stored, entry.record_count * sizeof(TrajectoryRecord));
+  }
+  return cache_;
+}
+
+bool TrajectoryReplay::Seek(double time,
+                            std::vector<TrajectoryRecord> &records) {
+  records.clear();
+  if (!IsOpen() || header_->chunk_count == 0 || time < index_[0].first_time) {
+    return false;
+  }
+  // Last chunk that starts at or before time
+  uint64_t chunk = std::upper_bound(index_.begin(), index_.end(), time,
+                                    [](double value, const TrajectoryChunkIndex &entry) {
+                                      return value < entry.first_time;
+                                    }) - index_.begin() - 1;
+
+  const std::vector<TrajectoryRecord> &current = Chunk(chunk);
+  if (current.empty()) {
+    return false;
+  }
+  auto last = std::upper_bound(current.begin(), current.end(), time,
+                               [](double value, const TrajectoryRecord &record) {
+                                 return value < record.time;
+                               }) - 1;
+  const double step_time = last->time;
+  auto first = std::lower_bound(current.begin(), last + 1, step_time,
+                                [](const TrajectoryRecord &record, double value) {
+                                  return record.time < value;
+                                });
+  records.assign(first, last + 1);
+  const bool continues_before = first == current.begin();
+  const bool continues_after = last + 1 == current.end();
+
+  // One sim step can be split over chunk boundaries (a big fleet can even span several chunks)
+  for (uint64_t c = chunk; continues_before && c > 0 && index_[c - 1].last_time == step_time; --c) {
+    const std::vector<TrajectoryRecord> &previous = Chunk(c - 1);
+    auto start = std::lower_bound(previous.begin(), previous.end(), step_time,
+                                  [](const TrajectoryRecord &record, double value) {
+                                    return record.time < value;
+                                  });
+    records.insert(records.begin(), start, previous.end());
+    if (start != previous.begin()) {
+      break;
+    }
+  }
+  for (uint64_t c = chunk + 1; continues_after && c < header_->chunk_count && index_[c].first_time == step_time; ++c) {
+    const std::vector<TrajectoryRecord> &next = Chunk(c);
+    auto end = std::upper_bound(next.begin(), next.end(), step_time,
+                                [](double value, const TrajectoryRecord &record) {
+                                  return value < record.time;
+                                });
+    records.insert(records.end(), next.begin(), end);
+    if (end != next.end()) {
+      break;
+    }
+  }
+  return true;
+}
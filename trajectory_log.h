@@ -0,0 +1,157 @@
+#ifndef SEPT2023__TRAJECTORY_LOG_H_
+#define SEPT2023__TRAJECTORY_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+/**
+ * One robot at one sim step. Robot 0 is the main (keyboard controlled) robot,
+ * robot i + 1 is fleet robot i.
+ */
+struct TrajectoryRecord {
+  double time = 0;
+  uint32_t robot = 0;
+  uint32_t padding = 0;
+  double x = 0;
+  double y = 0;
+  double theta = 0;
+  // Commanded velocities, m/s and rad/s
+  double v = 0;
+  double w = 0;
+};
+
+/*
+ * File layout, all little endian:
+ *   TrajectoryFileHeader
+ *   chunk 0 ... chunk N-1   (kTrajectoryChunkRecords records each, the last one may have less)
+ *   TrajectoryChunkIndex[N] (at header.index_offset)
+ * Chunks are either the raw records or, if compressed, each 8 byte word XOR'd with the same word of
+ * the previous record and written as 1 byte count of leading zero bytes + the remaining bytes.
+ * Records are in time order so we can binary search the index and then the chunk.
+ */
+constexpr char kTrajectoryMagic[8] = {'S', '2', '3', 'T', 'R', 'A', 'J', 0};
+constexpr uint32_t kTrajectoryVersion = 1;
+constexpr uint32_t kTrajectoryCompressed = 1;
+constexpr uint32_t kTrajectoryChunkRecords = 4096;
+
+struct TrajectoryFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t record_size;
+  uint32_t chunk_records;
+  uint64_t record_count;
+  uint64_t chunk_count;
+  uint64_t index_offset;
+  double start_time;
+  double end_time;
+};
+
+struct TrajectoryChunkIndex {
+  double first_time;
+  double last_time;
+  uint64_t offset;
+  uint32_t stored_size;
+  uint32_t record_count;
+};
+
+/**
+ * Writes TrajectoryRecords to a file without ever blocking the thread that produces them.
+ * Record() only copies into a lock free ring buffer, a writer thread drains it into chunks on disk.
+ * If the writer falls behind and the ring fills up records are dropped (and counted), the
+ * producer is never made to wait.
+ */
+struct TrajectoryRecorder {
+  /**
+   * \param ring_capacity how many records can be in flight between the producer and the writer thread
+   */
+  explicit TrajectoryRecorder(size_t ring_capacity = 1 << 20);
+  ~TrajectoryRecorder();
+
+  /**
+   * Start a new file and the writer thread
+   * \return false if the file couldn't be created or we are already recording
+   */
+  bool Open(const std::string &path,
+            bool compress);
+
+  /**
+   * Producer thread only, never blocks or allocates
+   * \return false if the ring buffer is full and the record was dropped
+   */
+  bool Record(const TrajectoryRecord &record);
+
+  /**
+   * Write out everything still in the ring, then the index, and close the file.
+   * The producer must have stopped calling Record() before this is called.
+   */
+  void Close();
+
+  bool IsOpen() const;
+
+  SpscQueue<TrajectoryRecord> ring_;
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> written_{0};
+  // Set this before handing the recorder to the sim to also record every fleet robot
+  bool record_fleet_ = false;
+
+  // Writer thread state
+  std::thread writer_;
+  std::atomic<bool> stop_{false};
+  FILE *file_ = nullptr;
+  std::string path_;
+  bool compress_ = false;
+  // A write failed (e.g. disk full), the file is left without an index so replay rejects it
+  bool write_failed_ = false;
+  TrajectoryFileHeader header_;
+  std::vector<TrajectoryRecord> chunk_;
+  std::vector<uint8_t> compressed_;
+  std::vector<TrajectoryChunkIndex> index_;
+
+  void WriterLoop();
+  void FlushChunk();
+};
+
+/**
+ * Read only, memory mapped view of a trajectory file for random access playback
+ */
+struct TrajectoryReplay {
+  ~TrajectoryReplay();
+
+  /**
+   * \return false if the file can't be mapped or isn't a complete trajectory file
+   */
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const;
+
+  double StartTime() const;
+  double EndTime() const;
+  uint64_t RecordCount() const;
+
+  /**
+   * Every record of the last sim step at or before time, O(log n).
+   * \param records return variable, cleared first
+   * \return false if time is before the first record
+   */
+  bool Seek(double time,
+            std::vector<TrajectoryRecord> &records);
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  const TrajectoryFileHeader *header_ = nullptr;
+  // Copied out of the file, the mapping only guarantees the header is aligned
+  std::vector<TrajectoryChunkIndex> index_;
+  // Last decoded chunk, scrubbing usually stays in the same one
+  uint64_t cached_chunk_ = UINT64_MAX;
+  std::vector<TrajectoryRecord> cache_;
+
+  const std::vector<TrajectoryRecord> &Chunk(uint64_t chunk);
+};
+
+#endif
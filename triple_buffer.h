@@ -0,0 +1,61 @@
+#ifndef SEPT2023__TRIPLE_BUFFER_H_
+#define SEPT2023__TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock free hand off of the latest value from one writer thread to one reader thread.
+ * The writer fills WriteBuffer() and publishes it, the reader picks up the newest published
+ * buffer whenever it wants. Neither side waits on the other, the reader just skips any values
+ * published in between its reads.
+ */
+template <typename T>
+struct TripleBuffer {
+  /**
+   * Writer only. The buffer to fill before calling Publish(), its previous contents are
+   * whatever was published 2 Publish() calls ago (so vectors keep their capacity).
+   */
+  T &WriteBuffer() {
+    return buffers_[write_];
+  }
+
+  /**
+   * Writer only. Make the write buffer the newest value
+   */
+  void Publish() {
+    uint8_t old_middle = middle_.exchange(write_ | kFreshBit, std::memory_order_acq_rel);
+    write_ = old_middle & kIndexMask;
+  }
+
+  /**
+   * Reader only. Swap in the newest published value if there is one
+   * \return true if ReadBuffer() changed
+   */
+  bool Update() {
+    if (!(middle_.load(std::memory_order_relaxed) & kFreshBit)) {
+      return false;
+    }
+    uint8_t old_middle = middle_.exchange(read_, std::memory_order_acq_rel);
+    read_ = old_middle & kIndexMask;
+    return true;
+  }
+
+  /**
+   * Reader only. The value from the last successful Update()
+   */
+  const T &ReadBuffer() const {
+    return buffers_[read_];
+  }
+
+  static constexpr uint8_t kIndexMask = 3;
+  // Set in middle_ when it holds a value the reader hasn't picked up yet
+  static constexpr uint8_t kFreshBit = 4;
+
+  T buffers_[3];
+  uint8_t write_ = 0;
+  uint8_t read_ = 1;
+  std::atomic<uint8_t> middle_{2};
+};
+
+#endif
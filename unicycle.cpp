@@ -0,0 +1,50 @@
+#include "unicycle.h"
+#include <cmath>
+
+double WrapAngle(double theta) {
+  const double two_pi = 2 * M_PI;
+  if (theta >= two_pi || theta < 0) {
+    theta = std::fmod(theta, two_pi);
+    if (theta < 0) {
+      theta += two_pi;
+    }
+    // fmod of a tiny negative number can round back up to 2pi
+    if (theta >= two_pi) {
+      theta = 0;
+    }
+  }
+  return theta;
+}
+
+void StepUnicycle(Pose2D &pose,
+                  double linear_velocity,
+                  double angular_velocity,
+                  double dt) {
+  // Heading is w.r.t the Y axis, which is why the X and Y calculations below are swapped
+  // (sine instead of cosine, and vice versa) compared to the usual textbook unicycle
+  double w = angular_velocity * dt;
+  double v = linear_velocity * dt;
+  // Near 0, so assume driving in a straight line
+  if (std::abs(w) < kStraightLineThreshold) {
+    pose.y += v * std::cos(pose.theta);
+    pose.x += v * std::sin(pose.theta);
+  }
+  else {
+    double theta_old = pose.theta;
+    double r = v / w;
+    pose.theta += w;
+    pose.y += r * (std::sin(pose.theta) - std::sin(theta_old));
+    pose.x += -r * (std::cos(pose.theta) - std::cos(theta_old));
+  }
+}
+
+Pose2D InterpolatePose(const Pose2D &from,
+                       const Pose2D &to,
+                       double alpha) {
+  double dtheta = std::remainder(to.theta - from.theta, 2 * M_PI);
+  Pose2D pose;
+  pose.x = from.x + alpha * (to.x - from.x);
+  pose.y = from.y + alpha * (to.y - from.y);
+  pose.theta = WrapAngle(from.theta + alpha * dtheta);
+  return pose;
+}
@@ -0,0 +1,53 @@
+#ifndef SEPT2023__UNICYCLE_H_
+#define SEPT2023__UNICYCLE_H_
+
+/**
+ * Pose of a robot on the ground plane.
+ *
+ * We want theta to be:
+ * 1. Positive rotation means clockwise (not counter clockwise)
+ * 2. With respect to the Y axis (up/down on the screen, X is left/right)
+ * This way it is the same as heading in geodetic/gnss/ins navigation. Heading angle
+ * is the angle with respect to North axis (up/down) and positive heading rotation means going clockwise
+ */
+struct Pose2D {
+  double x = 0;
+  double y = 0;
+  double theta = 0;
+};
+
+/**
+ * If the change in heading over one step is below this we treat the motion as a straight line,
+ * otherwise the arc radius (v / w) blows up
+ */
+constexpr double kStraightLineThreshold = 1.0e-5;
+
+/**
+ * \param theta any angle in radians
+ * \return theta wrapped to be between [0, 2pi)
+ */
+double WrapAngle(double theta);
+
+/**
+ * Advance a pose with the unicycle model using the exact arc solution (or a straight line
+ * when the heading change is tiny). Theta is not wrapped, call WrapAngle if needed.
+ * \param pose pose to update in place
+ * \param linear_velocity m/s
+ * \param angular_velocity rad/s (positive is clockwise)
+ * \param dt step size in seconds
+ */
+void StepUnicycle(Pose2D &pose,
+                  double linear_velocity,
+                  double angular_velocity,
+                  double dt);
+
+/**
+ * Linear interpolation between two poses, theta goes the short way around
+ * \param alpha 0 gives from, 1 gives to
+ * \return pose with theta between [0, 2pi)
+ */
+Pose2D InterpolatePose(const Pose2D &from,
+                       const Pose2D &to,
+                       double alpha);
+
+#endif